@@ -9,10 +9,39 @@
 
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace shaka {
 
+/// A complete output handed over by BufferCallbackParams::write_output_func.
+struct CallbackOutput {
+  enum class Type {
+    kInitSegment,
+    kMediaSegment,
+    kManifest,
+  };
+
+  Type type = Type::kMediaSegment;
+  /// Name of the output, i.e. the name @a write_func would be called with.
+  std::string name;
+  /// Name of the init segment of the stream the output belongs to, which
+  /// identifies the stream. Empty for manifests.
+  std::string stream;
+  /// Contents of the output, to be concatenated in order. The buffers are not
+  /// touched by the packager after the callback, so they can be kept beyond
+  /// the callback without copying.
+  std::vector<std::shared_ptr<const std::vector<uint8_t>>> buffers;
+
+  /// Number, start time and duration of a media segment. The times are in
+  /// @a timescale units.
+  int64_t segment_number = 0;
+  int64_t start_time = 0;
+  int64_t duration = 0;
+  int32_t timescale = 0;
+};
+
 /// Buffer callback params.
 struct BufferCallbackParams {
   /// If this function is specified, packager treats @a StreamDescriptor.input
@@ -30,6 +59,14 @@ struct BufferCallbackParams {
   std::function<
       int64_t(const std::string& name, const void* buffer, uint64_t size)>
       write_func;
+  /// If this function is specified, output files are treated as labels as
+  /// with @a write_func, but complete outputs are handed over in one call
+  /// each instead of being written piece by piece. This applies to MP4 init
+  /// and media segments written to separate files, to the MPD and to HLS
+  /// playlists. All other outputs still go through @a write_func, so
+  /// packaging fails to initialize if they exist and @a write_func is not set.
+  /// @return true on success, false otherwise, which fails packaging.
+  std::function<bool(const CallbackOutput& output)> write_output_func;
 };
 
 }  // namespace shaka
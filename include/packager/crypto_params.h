@@ -175,6 +175,10 @@ struct CpixEncryptionParams {
   int max_sd_pixels = 768 * 576;
   int max_hd_pixels = 1920 * 1080;
   int max_uhd1_pixels = 4096 * 2160;
+  /// Number of key periods requested per CPIX request for key rotation.
+  /// Larger batches reduce the number of round trips to the key server.
+  /// Only used when `document_source` is an HTTP(S) URL.
+  uint32_t key_periods_per_request = 10;
 };
 
 /// Encryption parameters.
@@ -7,6 +7,8 @@
 #ifndef PACKAGER_PUBLIC_MP4_OUTPUT_PARAMS_H_
 #define PACKAGER_PUBLIC_MP4_OUTPUT_PARAMS_H_
 
+#include <cstdint>
+
 namespace shaka {
 
 /// MP4 (ISO-BMFF) output related parameters.
@@ -26,6 +28,15 @@ struct Mp4OutputParams {
   /// and mdat atom. Each chunk is uploaded immediately upon creation,
   /// decoupling latency from segment duration.
   bool low_latency_dash_mode = false;
+  /// Space, in bytes, reserved at the start of single-file (VOD) output for
+  /// the 'moov' and 'sidx' boxes. If non-zero and the output is a local or
+  /// memory file, fragments are written directly to the output after the
+  /// reserved space, which is filled in when finalizing, with a 'free' box
+  /// padding whatever is left. This avoids writing the fragments to a temp
+  /// file first and copying them to the output. If the boxes end up larger
+  /// than the reserved space, the output is rewritten as if no space was
+  /// reserved. Ignored for segmented output.
+  uint64_t reserved_header_size = 0;
 };
 
 }  // namespace shaka
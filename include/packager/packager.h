@@ -51,6 +51,17 @@ struct PackagingParams {
   // the threshold used to determine if we should assume that the text stream
   // actually starts at time zero
   int32_t default_text_zero_bias_ms = 0;
+  /// Number of finished segments per output which can wait to be written in
+  /// the background, so that slow outputs, e.g. HTTP uploads, do not stall
+  /// packaging. Manifests are updated once a segment is written. If zero,
+  /// segments are written synchronously.
+  int32_t segment_output_queue_depth = 0;
+  /// Maximum number of time ranges each VOD input is split into at segment
+  /// boundaries, which are packaged in parallel with the same output as
+  /// packaging the input as a whole. Only applies to non-fragmented MP4 inputs
+  /// packaged into MP4 segments with a segment template. If smaller than 2,
+  /// inputs are packaged as a whole.
+  int32_t vod_parallel_ranges = 0;
 
   /// Chunking (segmentation) related parameters.
   ChunkingParams chunking_params;
@@ -167,6 +178,16 @@ struct StreamDescriptor {
   std::string dash_label;
 };
 
+/// An independent packaging job, as run by Packager::RunBatch().
+struct PackagingJob {
+  /// Name of the job, used to identify it in logs.
+  std::string name;
+  /// The packaging parameters of the job.
+  PackagingParams packaging_params;
+  /// The streams of the job.
+  std::vector<StreamDescriptor> stream_descriptors;
+};
+
 class SHAKA_EXPORT Packager {
  public:
   Packager();
@@ -187,6 +208,20 @@ class SHAKA_EXPORT Packager {
   /// Cancel packaging. Note that it has to be called from another thread.
   void Cancel();
 
+  /// Run independent packaging jobs to completion, with up to
+  /// @a max_concurrency jobs running at the same time. The jobs share the
+  /// process, so HTTP connections, e.g. to key servers, are kept alive and
+  /// reused between jobs. A failing job does not affect the other jobs. No
+  /// job is started if two jobs have the same output, segment template, MPD
+  /// output or HLS master playlist output. Note that it blocks until all jobs
+  /// are completed.
+  /// @param jobs contains the jobs to run.
+  /// @param max_concurrency is the maximum number of jobs running at the same
+  ///        time. If not positive, the number of hardware threads is used.
+  /// @return The status of each job, in the order of @a jobs.
+  static std::vector<Status> RunBatch(const std::vector<PackagingJob>& jobs,
+                                      int32_t max_concurrency);
+
   /// @return The version of the library.
   static std::string GetLibraryVersion();
 
@@ -0,0 +1,125 @@
+// Copyright 2024 Google LLC. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <packager/app/batch_jobs.h>
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <absl/log/log.h>
+#include <nlohmann/json.hpp>
+
+#include <packager/app/stream_descriptor.h>
+#include <packager/file.h>
+#include <packager/packager.h>
+#include <packager/utils/hex_parser.h>
+
+namespace shaka {
+
+namespace {
+
+// Sets |value| to the string field |name| of |job| if present. Returns false
+// if the field is present but is not a string.
+bool GetOptionalString(const nlohmann::json& job,
+                       const char* name,
+                       std::string* value) {
+  auto iter = job.find(name);
+  if (iter == job.end())
+    return true;
+  if (!iter->is_string()) {
+    LOG(ERROR) << "Batch job field '" << name << "' should be a string.";
+    return false;
+  }
+  *value = iter->get<std::string>();
+  return true;
+}
+
+std::optional<PackagingJob> ParseBatchJob(
+    const nlohmann::json& json,
+    size_t index,
+    const PackagingParams& packaging_params) {
+  if (!json.is_object()) {
+    LOG(ERROR) << "Batch job " << index << " should be a JSON object.";
+    return std::nullopt;
+  }
+
+  PackagingJob job;
+  job.name = "job_" + std::to_string(index);
+  job.packaging_params = packaging_params;
+  std::string content_id;
+  if (!GetOptionalString(json, "name", &job.name) ||
+      !GetOptionalString(json, "mpd_output",
+                         &job.packaging_params.mpd_params.mpd_output) ||
+      !GetOptionalString(
+          json, "hls_master_playlist_output",
+          &job.packaging_params.hls_params.master_playlist_output) ||
+      !GetOptionalString(json, "content_id", &content_id)) {
+    return std::nullopt;
+  }
+  if (!content_id.empty() &&
+      !ValidHexStringToBytes(
+          content_id,
+          &job.packaging_params.encryption_params.widevine.content_id)) {
+    LOG(ERROR) << "Invalid content_id '" << content_id << "' in batch job '"
+               << job.name << "'.";
+    return std::nullopt;
+  }
+
+  auto streams = json.find("streams");
+  if (streams == json.end() || !streams->is_array() || streams->empty()) {
+    LOG(ERROR) << "Batch job '" << job.name
+               << "' should have a non-empty 'streams' array.";
+    return std::nullopt;
+  }
+  for (const nlohmann::json& stream : *streams) {
+    if (!stream.is_string()) {
+      LOG(ERROR) << "Streams of batch job '" << job.name
+                 << "' should be stream descriptor strings.";
+      return std::nullopt;
+    }
+    std::optional<StreamDescriptor> stream_descriptor =
+        ParseStreamDescriptor(stream.get<std::string>());
+    if (!stream_descriptor)
+      return std::nullopt;
+    job.stream_descriptors.push_back(stream_descriptor.value());
+  }
+  return job;
+}
+
+}  // namespace
+
+std::optional<std::vector<PackagingJob>> ParseBatchJobs(
+    const std::string& batch_file,
+    const PackagingParams& packaging_params) {
+  std::string contents;
+  if (!File::ReadFileToString(batch_file.c_str(), &contents)) {
+    LOG(ERROR) << "Failed to read batch file " << batch_file;
+    return std::nullopt;
+  }
+
+  // Parse without exceptions. An invalid document is returned as discarded.
+  const nlohmann::json json = nlohmann::json::parse(contents, nullptr, false);
+  if (json.is_discarded() || !json.is_array()) {
+    LOG(ERROR) << "Batch file " << batch_file
+               << " should contain a JSON array of packaging jobs.";
+    return std::nullopt;
+  }
+
+  std::vector<PackagingJob> jobs;
+  for (size_t i = 0; i < json.size(); ++i) {
+    std::optional<PackagingJob> job =
+        ParseBatchJob(json[i], i, packaging_params);
+    if (!job)
+      return std::nullopt;
+    jobs.push_back(std::move(job.value()));
+  }
+  return jobs;
+}
+
+}  // namespace shaka
@@ -0,0 +1,36 @@
+// Copyright 2024 Google LLC. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef APP_BATCH_JOBS_H_
+#define APP_BATCH_JOBS_H_
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <packager/packager.h>
+
+namespace shaka {
+
+/// Parses a batch file, which is a JSON array of independent packaging jobs.
+/// Each job is an object with these fields:
+/// - streams: Required array of stream descriptor strings.
+/// - name: Optional name of the job, used in logs.
+/// - mpd_output: Optional, overrides --mpd_output.
+/// - hls_master_playlist_output: Optional, overrides
+///   --hls_master_playlist_output.
+/// - content_id: Optional hex string, overrides --content_id.
+/// @param batch_file is the name of the batch file.
+/// @param packaging_params contains the parameters shared by all jobs.
+/// @return the jobs on success, std::nullopt otherwise. May print error
+///         messages.
+std::optional<std::vector<PackagingJob>> ParseBatchJobs(
+    const std::string& batch_file,
+    const PackagingParams& packaging_params);
+
+}  // namespace shaka
+
+#endif  // APP_BATCH_JOBS_H_
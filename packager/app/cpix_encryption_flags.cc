@@ -8,6 +8,7 @@
 
 #include <packager/app/cpix_encryption_flags.h>
 
+#include <cstdint>
 #include <string>
 
 #include <absl/flags/flag.h>
@@ -47,6 +48,13 @@ ABSL_FLAG(std::string,
           "Optional path to the recipient RSA private key (PEM or DER), "
           "used to decrypt encrypted CPIX documents. Required when the "
           "document's content keys are encrypted.");
+ABSL_FLAG(uint32_t,
+          cpix_key_periods_per_request,
+          10,
+          "Number of key periods requested per CPIX request when keys are "
+          "rotated (--crypto_period_duration). Only used when --cpix is an "
+          "HTTP(S) URL; keys of upcoming crypto periods are then fetched in "
+          "batches rather than one request per crypto period.");
 
 namespace shaka {
 
@@ -76,6 +84,10 @@ bool ValidateCpixCryptoFlags() {
                     "--enable_cpix_encryption/decryption")) {
     success = false;
   }
+  if (absl::GetFlag(FLAGS_cpix_key_periods_per_request) == 0) {
+    PrintError("--cpix_key_periods_per_request should be positive.");
+    success = false;
+  }
   return success;
 }
 
@@ -9,6 +9,7 @@
 #ifndef PACKAGER_APP_CPIX_ENCRYPTION_FLAGS_H_
 #define PACKAGER_APP_CPIX_ENCRYPTION_FLAGS_H_
 
+#include <cstdint>
 #include <string>
 
 #include <absl/flags/declare.h>
@@ -20,6 +21,7 @@ ABSL_DECLARE_FLAG(std::string, cpix);
 ABSL_DECLARE_FLAG(std::string, cpix_request_file);
 ABSL_DECLARE_FLAG(std::string, cpix_headers);
 ABSL_DECLARE_FLAG(std::string, cpix_private_key);
+ABSL_DECLARE_FLAG(uint32_t, cpix_key_periods_per_request);
 
 namespace shaka {
 
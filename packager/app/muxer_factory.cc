@@ -6,6 +6,7 @@
 
 #include <packager/app/muxer_factory.h>
 
+#include <algorithm>
 #include <memory>
 
 #include <absl/log/log.h>
@@ -29,11 +30,14 @@ MuxerFactory::MuxerFactory(const PackagingParams& packaging_params)
     : mp4_params_(packaging_params.mp4_output_params),
       temp_dir_(packaging_params.temp_dir),
       transport_stream_timestamp_offset_ms_(
-          packaging_params.transport_stream_timestamp_offset_ms) {}
+          packaging_params.transport_stream_timestamp_offset_ms),
+      segment_output_queue_depth_(
+          std::max(0, packaging_params.segment_output_queue_depth)) {}
 
 std::shared_ptr<Muxer> MuxerFactory::CreateMuxer(
     MediaContainerName output_format,
-    const StreamDescriptor& stream) {
+    const StreamDescriptor& stream,
+    const std::optional<MuxerRangeOptions>& range) {
   MuxerOptions options;
   options.mp4_params = mp4_params_;
   options.transport_stream_timestamp_offset_ms =
@@ -42,6 +46,8 @@ std::shared_ptr<Muxer> MuxerFactory::CreateMuxer(
   options.output_file_name = stream.output;
   options.segment_template = stream.segment_template;
   options.bandwidth = stream.bandwidth;
+  options.segment_output_queue_depth = segment_output_queue_depth_;
+  options.range = range;
 
   std::shared_ptr<Muxer> muxer;
 
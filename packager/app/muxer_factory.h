@@ -9,9 +9,11 @@
 
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 
 #include <packager/media/base/container_names.h>
+#include <packager/media/base/muxer_options.h>
 #include <packager/mp4_output_params.h>
 #include <packager/utils/clock.h>
 
@@ -33,8 +35,11 @@ class MuxerFactory {
 
   /// Create a new muxer using the factory's settings for the given
   /// stream.
-  std::shared_ptr<Muxer> CreateMuxer(MediaContainerName output_format,
-                                     const StreamDescriptor& stream);
+  /// @param range is set if the muxer packages a time range of the stream.
+  std::shared_ptr<Muxer> CreateMuxer(
+      MediaContainerName output_format,
+      const StreamDescriptor& stream,
+      const std::optional<MuxerRangeOptions>& range = std::nullopt);
 
   /// For testing, if you need to replace the clock that muxers work with
   /// this will replace the clock for all muxers created after this call.
@@ -51,6 +56,7 @@ class MuxerFactory {
   const Mp4OutputParams mp4_params_;
   const std::string temp_dir_;
   int32_t transport_stream_timestamp_offset_ms_ = 0;
+  const int32_t segment_output_queue_depth_;
   std::shared_ptr<Clock> clock_ = nullptr;
 };
 
@@ -53,6 +53,16 @@ ABSL_FLAG(bool,
           "Indicates whether to generate 'sidx' box in media segments. Note "
           "that it is required for DASH on-demand profile (not using segment "
           "template).");
+ABSL_FLAG(uint64_t,
+          mp4_reserved_header_size,
+          0,
+          "MP4 only, used only if single_segment=true: space in bytes "
+          "reserved at the start of the output for the 'moov' and 'sidx' "
+          "boxes. If non-zero and the output is a local file, fragments are "
+          "written to the output directly instead of to a temporary file "
+          "copied after the header. Should be large enough for all "
+          "subsegment references (12 bytes each), otherwise the output is "
+          "rewritten through a temporary file. 0 disables.");
 ABSL_FLAG(std::string,
           temp_dir,
           "",
@@ -96,6 +106,24 @@ ABSL_FLAG(
     "triggered text segments are generated later than video segments. "
     "If too small, some text cues may be absent in the output.");
 
+ABSL_FLAG(int32_t,
+          segment_output_queue_depth,
+          0,
+          "Number of finished segments per output which can wait to be "
+          "written in the background, so that slow outputs, e.g. HTTP "
+          "uploads, do not stall packaging. Manifests are updated once a "
+          "segment is written. Applies to segments written to separate "
+          "files. 0 writes segments synchronously.");
+
+ABSL_FLAG(int32_t,
+          vod_parallel_ranges,
+          0,
+          "Maximum number of time ranges each VOD input is split into at "
+          "segment boundaries, which are packaged in parallel with the same "
+          "output as packaging the input as a whole. Applies to non-"
+          "fragmented MP4 inputs packaged into MP4 segments with a segment "
+          "template. 0 or 1 packages inputs as a whole.");
+
 ABSL_FLAG(int64_t,
           start_segment_number,
           1,
@@ -21,11 +21,14 @@ ABSL_DECLARE_FLAG(bool, segment_sap_aligned);
 ABSL_DECLARE_FLAG(double, fragment_duration);
 ABSL_DECLARE_FLAG(bool, fragment_sap_aligned);
 ABSL_DECLARE_FLAG(bool, generate_sidx_in_media_segments);
+ABSL_DECLARE_FLAG(uint64_t, mp4_reserved_header_size);
 ABSL_DECLARE_FLAG(std::string, temp_dir);
 ABSL_DECLARE_FLAG(std::optional<bool>, mp4_include_pssh_in_stream);
 ABSL_DECLARE_FLAG(int32_t, transport_stream_timestamp_offset_ms);
 ABSL_DECLARE_FLAG(int32_t, default_text_zero_bias_ms);
 ABSL_DECLARE_FLAG(int64_t, ts_ttx_heartbeat_shift);
+ABSL_DECLARE_FLAG(int32_t, segment_output_queue_depth);
+ABSL_DECLARE_FLAG(int32_t, vod_parallel_ranges);
 ABSL_DECLARE_FLAG(int64_t, start_segment_number);
 
 #endif  // APP_MUXER_FLAGS_H_
@@ -44,6 +44,7 @@
 #include <absl/strings/str_format.h>
 
 #include <packager/app/ad_cue_generator_flags.h>
+#include <packager/app/batch_jobs.h>
 #include <packager/app/cpix_encryption_flags.h>
 #include <packager/app/crypto_flags.h>
 #include <packager/app/hls_flags.h>
@@ -79,6 +80,17 @@ ABSL_FLAG(bool,
           single_threaded,
           false,
           "If enabled, only use one thread when generating content.");
+ABSL_FLAG(std::string,
+          batch_file,
+          "",
+          "Run the independent packaging jobs listed in this JSON file, "
+          "instead of the streams on the command line. The other flags apply "
+          "to all jobs.");
+ABSL_FLAG(int32_t,
+          batch_max_concurrency,
+          0,
+          "Maximum number of batch jobs running at the same time. 0 means the "
+          "number of hardware threads.");
 
 // From absl/log:
 ABSL_DECLARE_FLAG(int, stderrthreshold);
@@ -465,12 +477,6 @@ std::optional<PackagingParams> GetPackagingParams() {
 
     encryption_params.crypto_period_duration_in_seconds =
         absl::GetFlag(FLAGS_crypto_period_duration);
-    if (encryption_params.crypto_period_duration_in_seconds != 0 &&
-        encryption_params.key_provider == KeyProvider::kCpix) {
-      LOG(ERROR) << "--crypto_period_duration (key rotation) is not "
-                    "supported with --enable_cpix_encryption.";
-      return std::nullopt;
-    }
     encryption_params.vp9_subsample_encryption =
         absl::GetFlag(FLAGS_vp9_subsample_encryption);
     encryption_params.cencv1 = absl::GetFlag(FLAGS_cencv1);
@@ -516,6 +522,8 @@ std::optional<PackagingParams> GetPackagingParams() {
       cpix.max_sd_pixels = absl::GetFlag(FLAGS_max_sd_pixels);
       cpix.max_hd_pixels = absl::GetFlag(FLAGS_max_hd_pixels);
       cpix.max_uhd1_pixels = absl::GetFlag(FLAGS_max_uhd1_pixels);
+      cpix.key_periods_per_request =
+          absl::GetFlag(FLAGS_cpix_key_periods_per_request);
       break;
     }
     case KeyProvider::kNone:
@@ -596,11 +604,17 @@ std::optional<PackagingParams> GetPackagingParams() {
     }
   }
   mp4_params.low_latency_dash_mode = absl::GetFlag(FLAGS_low_latency_dash_mode);
+  mp4_params.reserved_header_size =
+      absl::GetFlag(FLAGS_mp4_reserved_header_size);
 
   packaging_params.transport_stream_timestamp_offset_ms =
       absl::GetFlag(FLAGS_transport_stream_timestamp_offset_ms);
   packaging_params.default_text_zero_bias_ms =
       absl::GetFlag(FLAGS_default_text_zero_bias_ms);
+  packaging_params.segment_output_queue_depth =
+      absl::GetFlag(FLAGS_segment_output_queue_depth);
+  packaging_params.vod_parallel_ranges =
+      absl::GetFlag(FLAGS_vod_parallel_ranges);
   packaging_params.output_media_info = absl::GetFlag(FLAGS_output_media_info);
 
   MpdParams& mpd_params = packaging_params.mpd_params;
@@ -689,6 +703,38 @@ std::optional<PackagingParams> GetPackagingParams() {
   return packaging_params;
 }
 
+int RunBatchJobs(const PackagingParams& packaging_params) {
+  std::optional<std::vector<PackagingJob>> jobs =
+      ParseBatchJobs(absl::GetFlag(FLAGS_batch_file), packaging_params);
+  if (!jobs)
+    return kArgumentValidationFailed;
+
+  if (absl::GetFlag(FLAGS_force_cl_index)) {
+    for (PackagingJob& job : jobs.value()) {
+      int index = 0;
+      for (auto& descriptor : job.stream_descriptors)
+        descriptor.index = index++;
+    }
+  }
+
+  // Each failing job is logged by RunBatch.
+  const std::vector<Status> statuses = Packager::RunBatch(
+      jobs.value(), absl::GetFlag(FLAGS_batch_max_concurrency));
+  size_t num_failed_jobs = 0;
+  for (const Status& status : statuses) {
+    if (!status.ok())
+      ++num_failed_jobs;
+  }
+  if (num_failed_jobs > 0) {
+    LOG(ERROR) << num_failed_jobs << " of " << statuses.size()
+               << " packaging jobs failed.";
+    return kPackagingFailed;
+  }
+  if (!absl::GetFlag(FLAGS_quiet))
+    printf("Packaging completed successfully.\n");
+  return kSuccess;
+}
+
 int PackagerMain(int argc, char** argv) {
   absl::FlagsUsageConfig flag_config;
   flag_config.version_string = []() -> std::string {
@@ -714,7 +760,8 @@ int PackagerMain(int argc, char** argv) {
     return kSuccess;
   }
 
-  if (remaining_args.size() < 2) {
+  const bool batch_mode = !absl::GetFlag(FLAGS_batch_file).empty();
+  if (remaining_args.size() < 2 && !batch_mode) {
     std::cerr << "Usage: " << absl::ProgramUsageMessage();
     return kSuccess;
   }
@@ -735,6 +782,14 @@ int PackagerMain(int argc, char** argv) {
   if (!packaging_params)
     return kArgumentValidationFailed;
 
+  if (batch_mode) {
+    if (remaining_args.size() > 1) {
+      LOG(ERROR) << "Stream descriptors cannot be specified with --batch_file.";
+      return kArgumentValidationFailed;
+    }
+    return RunBatchJobs(packaging_params.value());
+  }
+
   std::vector<StreamDescriptor> stream_descriptors;
   for (size_t i = 1; i < remaining_args.size(); ++i) {
     std::optional<StreamDescriptor> stream_descriptor =
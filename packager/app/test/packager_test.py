@@ -9,6 +9,7 @@
 
 import filecmp
 import glob
+import json
 import logging
 import os
 import re
@@ -2473,6 +2474,57 @@ class PackagerCommandParsingTest(PackagerAppTest):
             output_dash=True))
     self.assertEqual(packaging_result, 1)
 
+  def _WriteBatchFile(self, jobs):
+    batch_file = os.path.join(self.tmp_dir, 'batch.json')
+    with open(batch_file, 'w') as f:
+      json.dump(jobs, f)
+    return batch_file
+
+  def testBatchFileWithStreams(self):
+    batch_file = self._WriteBatchFile([])
+    packaging_result = self.packager.Package(
+        self._GetStreams(['video']), ['--batch_file=' + batch_file])
+    self.assertEqual(packaging_result, 1)
+
+  def testBatchFileWithoutStreams(self):
+    batch_file = self._WriteBatchFile([{'name': 'no streams'}])
+    packaging_result = self.packager.Package([],
+                                             ['--batch_file=' + batch_file])
+    self.assertEqual(packaging_result, 1)
+
+  def testBatchJobs(self):
+    test_file = os.path.join(self.test_data_dir, 'bear-640x360.mp4')
+    jobs = []
+    for name in ['first', 'second']:
+      output_prefix = os.path.join(self.tmp_dir, name)
+      jobs.append({
+          'name': name,
+          'streams': [
+              'input=%s,stream=video,output=%s-video.mp4' %
+              (test_file, output_prefix)
+          ],
+          'mpd_output': output_prefix + '.mpd',
+      })
+    jobs.append({
+        'name': 'missing input',
+        'streams': [
+            'input=%s,stream=video,output=%s' %
+            (os.path.join(self.tmp_dir, 'missing.mp4'),
+             os.path.join(self.tmp_dir, 'missing-video.mp4'))
+        ],
+    })
+    batch_file = self._WriteBatchFile(jobs)
+
+    packaging_result = self.packager.Package(
+        [], ['--batch_file=' + batch_file, '--batch_max_concurrency=2'])
+    # The failing job does not affect the other jobs.
+    self.assertEqual(packaging_result, 2)
+    for name in ['first', 'second']:
+      self.assertTrue(
+          os.path.exists(os.path.join(self.tmp_dir, name + '-video.mp4')))
+      self.assertTrue(os.path.exists(os.path.join(self.tmp_dir,
+                                                  name + '.mpd')))
+
 
 if __name__ == '__main__':
   unittest.main()
@@ -7,6 +7,7 @@
 #include <packager/file/callback_file.h>
 
 #include <cstdint>
+#include <cstring>
 
 #include <absl/log/log.h>
 
@@ -15,11 +16,54 @@
 
 namespace shaka {
 
+namespace {
+
+// Parses |file_name|, which includes the file type prefix. Returns false if it
+// is not a callback file name.
+bool ParseCallbackFileNameWithPrefix(const std::string& file_name,
+                                     const BufferCallbackParams** params,
+                                     std::string* name) {
+  const size_t prefix_size = strlen(kCallbackFilePrefix);
+  if (file_name.compare(0, prefix_size, kCallbackFilePrefix) != 0)
+    return false;
+  return File::ParseCallbackFileName(file_name.substr(prefix_size), params,
+                                     name);
+}
+
+}  // namespace
+
 CallbackFile::CallbackFile(const char* file_name, const char* mode)
     : File(file_name), file_mode_(mode) {}
 
 CallbackFile::~CallbackFile() {}
 
+bool CallbackFile::HasOutputCallback(const std::string& file_name) {
+  const BufferCallbackParams* params = nullptr;
+  std::string name;
+  return ParseCallbackFileNameWithPrefix(file_name, &params, &name) &&
+         params->write_output_func;
+}
+
+bool CallbackFile::WriteOutput(const std::string& file_name,
+                               const std::string& stream_file_name,
+                               CallbackOutput* output) {
+  const BufferCallbackParams* params = nullptr;
+  if (!ParseCallbackFileNameWithPrefix(file_name, &params, &output->name) ||
+      !params->write_output_func) {
+    LOG(ERROR) << "Output function not defined for " << file_name;
+    return false;
+  }
+  output->stream.clear();
+  if (!stream_file_name.empty()) {
+    const BufferCallbackParams* stream_params = nullptr;
+    if (!ParseCallbackFileNameWithPrefix(stream_file_name, &stream_params,
+                                         &output->stream)) {
+      output->stream = stream_file_name;
+    }
+  }
+  return params->write_output_func(*output);
+}
+
 bool CallbackFile::Close() {
   delete this;
   return true;
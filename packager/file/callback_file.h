@@ -23,6 +23,23 @@ class CallbackFile : public File {
   ///        the available modes.
   CallbackFile(const char* file_name, const char* mode);
 
+  /// @param file_name is a file name, including the file type prefix.
+  /// @return true if @a file_name is a callback file name whose
+  ///         BufferCallbackParams has write_output_func set.
+  static bool HasOutputCallback(const std::string& file_name);
+
+  /// Hands a complete output over to BufferCallbackParams::write_output_func.
+  /// @param file_name is the callback file name of the output, including the
+  ///        file type prefix. HasOutputCallback() must be true for it.
+  /// @param stream_file_name is the callback file name of the init segment of
+  ///        the stream the output belongs to, or empty.
+  /// @param output is the output to hand over. Its name and stream are set
+  ///        from @a file_name and @a stream_file_name.
+  /// @return the value returned by the callback.
+  static bool WriteOutput(const std::string& file_name,
+                          const std::string& stream_file_name,
+                          CallbackOutput* output);
+
   /// @name File implementation overrides.
   /// @{
   bool Close() override;
@@ -12,6 +12,7 @@
 #include <cstring>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -173,4 +174,67 @@ TEST(CallbackFileTest, WriteFunctionNotDefined) {
   ASSERT_EQ(-1, writer->Write(kBuffer, kBufferSize));
 }
 
+TEST(CallbackFileTest, WriteOutput) {
+  std::vector<CallbackOutput> outputs;
+  BufferCallbackParams callback_params;
+  callback_params.write_output_func = [&outputs](const CallbackOutput& output) {
+    outputs.push_back(output);
+    return true;
+  };
+
+  std::string file_name =
+      File::MakeCallbackFileName(callback_params, kBufferLabel);
+  std::string stream_file_name =
+      File::MakeCallbackFileName(callback_params, "stream name");
+  ASSERT_TRUE(CallbackFile::HasOutputCallback(file_name));
+
+  auto data = std::make_shared<const std::vector<uint8_t>>(
+      std::begin(kBuffer), std::end(kBuffer));
+  CallbackOutput output;
+  output.segment_number = 3;
+  output.buffers.push_back(data);
+  ASSERT_TRUE(CallbackFile::WriteOutput(file_name, stream_file_name, &output));
+
+  ASSERT_EQ(1u, outputs.size());
+  EXPECT_EQ(kBufferLabel, outputs[0].name);
+  EXPECT_EQ("stream name", outputs[0].stream);
+  EXPECT_EQ(3, outputs[0].segment_number);
+  ASSERT_EQ(1u, outputs[0].buffers.size());
+  // The buffer is handed over, not copied.
+  EXPECT_EQ(data, outputs[0].buffers[0]);
+}
+
+TEST(CallbackFileTest, NoOutputCallback) {
+  MockFunction<int64_t(const std::string& name, const void* buffer,
+                       uint64_t length)>
+      mock_write_func;
+  BufferCallbackParams callback_params;
+  callback_params.write_func = mock_write_func.AsStdFunction();
+
+  EXPECT_FALSE(CallbackFile::HasOutputCallback(
+      File::MakeCallbackFileName(callback_params, kBufferLabel)));
+  EXPECT_FALSE(CallbackFile::HasOutputCallback("memory://some_file"));
+}
+
+TEST(CallbackFileTest, WriteManifestToOutputCallback) {
+  std::vector<CallbackOutput> outputs;
+  BufferCallbackParams callback_params;
+  callback_params.write_output_func = [&outputs](const CallbackOutput& output) {
+    outputs.push_back(output);
+    return true;
+  };
+
+  std::string file_name =
+      File::MakeCallbackFileName(callback_params, kBufferLabel);
+  ASSERT_TRUE(File::WriteFileAtomically(file_name.c_str(), "manifest"));
+
+  ASSERT_EQ(1u, outputs.size());
+  EXPECT_EQ(CallbackOutput::Type::kManifest, outputs[0].type);
+  EXPECT_EQ(kBufferLabel, outputs[0].name);
+  EXPECT_TRUE(outputs[0].stream.empty());
+  ASSERT_EQ(1u, outputs[0].buffers.size());
+  EXPECT_EQ("manifest", std::string(outputs[0].buffers[0]->begin(),
+                                    outputs[0].buffers[0]->end()));
+}
+
 }  // namespace shaka
@@ -18,6 +18,7 @@
 #include <string_view>
 #include <system_error>
 #include <utility>
+#include <vector>
 
 #include <absl/flags/flag.h>
 #include <absl/log/check.h>
@@ -34,6 +35,7 @@
 #include <packager/file/memory_file.h>
 #include <packager/file/threaded_io_file.h>
 #include <packager/file/udp_file.h>
+#include <packager/file/udp_options.h>
 #include <packager/macros/logging.h>
 
 ABSL_FLAG(uint64_t,
@@ -187,6 +189,49 @@ const FileTypeInfo* GetFileTypeInfo(std::string_view file_name,
   return &kFileTypeInfo[0];
 }
 
+// Copies below this size go through the userspace buffer of File::Copy(),
+// which needs a single read and write for them anyway.
+const int64_t kMinKernelCopySize = 0x40000;  // 256KB.
+
+// Returns the LocalFile behind |file|, which may be wrapped in a
+// ThreadedIoFile, or nullptr if |file| is not a local file.
+LocalFile* GetLocalFile(File* file) {
+  if (auto* threaded_file = dynamic_cast<ThreadedIoFile*>(file))
+    file = threaded_file->internal_file();
+  return dynamic_cast<LocalFile*>(file);
+}
+
+// Copies data between two local files in the kernel. Returns the number of
+// bytes copied, which is 0 if the files are not both local regular files, or
+// a negative value on error.
+int64_t CopyLocalFile(File* source, File* destination, int64_t max_copy) {
+  LocalFile* local_source = GetLocalFile(source);
+  LocalFile* local_destination = GetLocalFile(destination);
+  // Files which cannot seek, such as pipes, are left to the caller.
+  if (!local_source || !local_destination ||
+      !LocalFile::CanCopyRange(local_source, local_destination)) {
+    return 0;
+  }
+
+  auto* threaded_source = dynamic_cast<ThreadedIoFile*>(source);
+  auto* threaded_destination = dynamic_cast<ThreadedIoFile*>(destination);
+  bool ok = true;
+  if (threaded_source)
+    ok &= threaded_source->BeginDirectAccess();
+  if (threaded_destination)
+    ok &= threaded_destination->BeginDirectAccess();
+
+  const int64_t bytes_copied =
+      ok ? LocalFile::CopyRange(local_source, local_destination, max_copy)
+         : -1;
+
+  if (threaded_source)
+    ok &= threaded_source->EndDirectAccess();
+  if (threaded_destination)
+    ok &= threaded_destination->EndDirectAccess();
+  return ok ? bytes_copied : -1;
+}
+
 }  // namespace
 
 File* File::Create(const char* file_name, const char* mode) {
@@ -199,6 +244,14 @@ File* File::Create(const char* file_name, const char* mode) {
     // Disable caching for memory and callback files.
     return internal_file.release();
   }
+  if (file_type_prefix == kUdpFilePrefix) {
+    // UdpFile has its own receive thread and buffer if a jitter buffer is
+    // requested.
+    std::unique_ptr<UdpOptions> options = UdpOptions::ParseFromString(
+        std::string_view(file_name).substr(file_type_prefix.size()));
+    if (options && options->jitter_buffer_ms() > 0)
+      return internal_file.release();
+  }
 
   if (absl::GetFlag(FLAGS_io_cache_size)) {
     // Enable threaded I/O for "r", "w", and "a" modes only.
@@ -327,6 +380,14 @@ bool File::WriteStringToFile(const char* file_name,
 bool File::WriteFileAtomically(const char* file_name,
                                const std::string& contents) {
   VLOG(2) << "File::WriteFileAtomically: " << file_name;
+  if (CallbackFile::HasOutputCallback(file_name)) {
+    CallbackOutput output;
+    output.type = CallbackOutput::Type::kManifest;
+    output.buffers.push_back(std::make_shared<const std::vector<uint8_t>>(
+        contents.begin(), contents.end()));
+    return CallbackFile::WriteOutput(file_name, "", &output);
+  }
+
   std::string_view real_file_name;
   const FileTypeInfo* file_type = GetFileTypeInfo(file_name, &real_file_name);
   DCHECK(file_type);
@@ -396,9 +457,17 @@ int64_t File::Copy(File* source, File* destination, int64_t max_copy) {
   VLOG(2) << "File::Copy from " << source->file_name() << " to "
           << destination->file_name();
 
+  // Let the kernel copy between local files, and copy whatever it could not
+  // copy through a userspace buffer.
+  int64_t bytes_copied = 0;
+  if (max_copy >= kMinKernelCopySize) {
+    bytes_copied = CopyLocalFile(source, destination, max_copy);
+    if (bytes_copied < 0)
+      return bytes_copied;
+  }
+
   const int64_t kBufferSize = 0x40000;  // 256KB.
   std::unique_ptr<uint8_t[]> buffer(new uint8_t[kBufferSize]);
-  int64_t bytes_copied = 0;
   while (bytes_copied < max_copy) {
     const int64_t size = std::min(kBufferSize, max_copy - bytes_copied);
     const int64_t bytes_read = source->Read(buffer.get(), size);
@@ -13,8 +13,13 @@
 #include <memory>
 #include <string>
 #include <system_error>
+#include <thread>
 #include <vector>
 
+#if !defined(OS_WIN)
+#include <sys/stat.h>
+#endif  // !defined(OS_WIN)
+
 #include <absl/flags/declare.h>
 #include <absl/flags/flag.h>
 #include <gtest/gtest.h>
@@ -409,6 +414,116 @@ INSTANTIATE_TEST_SUITE_P(TestSeekWithDifferentCacheSizes,
                          // is just under the data size of 1k.
                          ::testing::Values(0u, 20u, 61u, 1000u));
 
+class CopyLocalFileTest : public LocalFileTest,
+                          public ::testing::WithParamInterface<uint64_t> {};
+
+TEST_P(CopyLocalFileTest, CopyBetweenOpenFiles) {
+  // Large enough to be copied in the kernel.
+  const int64_t kSourceSize = 1 << 20;
+  const int64_t kSkipSize = 1000;
+  const int64_t kCopySize = 600000;
+  const std::string kHeader = "header";
+
+  FlagSaver local_backup_io_cache_size(&FLAGS_io_cache_size);
+  absl::SetFlag(&FLAGS_io_cache_size, GetParam());
+
+  std::string source_data(kSourceSize, 0);
+  for (int64_t i = 0; i < kSourceSize; ++i)
+    source_data[i] = static_cast<char>(i % 251);
+  WriteFile(local_file_name_no_prefix_, source_data);
+
+  TempFile temp_file;
+  File* source = File::Open(local_file_name_no_prefix_.c_str(), "r");
+  ASSERT_TRUE(source != nullptr);
+  File* destination = File::Open(temp_file.path().c_str(), "w");
+  ASSERT_TRUE(destination != nullptr);
+
+  // Start from the middle of both files, and keep using them afterwards.
+  std::vector<uint8_t> buffer(kSkipSize);
+  ASSERT_EQ(kSkipSize, source->Read(buffer.data(), kSkipSize));
+  ASSERT_EQ(static_cast<int64_t>(kHeader.size()),
+            destination->Write(kHeader.data(), kHeader.size()));
+
+  EXPECT_EQ(kCopySize, File::Copy(source, destination, kCopySize));
+  uint64_t position = 0;
+  ASSERT_TRUE(source->Tell(&position));
+  EXPECT_EQ(static_cast<uint64_t>(kSkipSize + kCopySize), position);
+  ASSERT_TRUE(destination->Tell(&position));
+  EXPECT_EQ(kHeader.size() + kCopySize, position);
+
+  ASSERT_EQ(1, source->Read(buffer.data(), 1));
+  EXPECT_EQ(source_data[kSkipSize + kCopySize], static_cast<char>(buffer[0]));
+  ASSERT_EQ(1, destination->Write(buffer.data(), 1));
+
+  // Copy the rest of the file.
+  const int64_t kRemainingSize = kSourceSize - kSkipSize - kCopySize - 1;
+  EXPECT_EQ(kRemainingSize, File::Copy(source, destination));
+  EXPECT_TRUE(source->Close());
+  EXPECT_TRUE(destination->Close());
+
+  std::string read_data;
+  ReadFile(temp_file.path(), &read_data, kSourceSize * 2);
+  EXPECT_EQ(kHeader + source_data.substr(kSkipSize), read_data);
+}
+
+#if !defined(OS_WIN)
+TEST_P(CopyLocalFileTest, CopyThroughPipe) {
+  // Large enough to be copied in the kernel between regular files.
+  const int64_t kSourceSize = 1 << 20;
+
+  FlagSaver local_backup_io_cache_size(&FLAGS_io_cache_size);
+  absl::SetFlag(&FLAGS_io_cache_size, GetParam());
+
+  std::string source_data(kSourceSize, 0);
+  for (int64_t i = 0; i < kSourceSize; ++i)
+    source_data[i] = static_cast<char>(i % 251);
+  WriteFile(local_file_name_no_prefix_, source_data);
+
+  TempFile pipe_file;
+  const std::string pipe_path = pipe_file.path() + ".pipe";
+  ASSERT_EQ(0, mkfifo(pipe_path.c_str(), 0600));
+
+  // Copy from the pipe into the destination while the source is copied into
+  // the pipe.
+  TempFile temp_file;
+  int64_t bytes_copied_from_pipe = -1;
+  std::thread pipe_reader([&pipe_path, &temp_file, &bytes_copied_from_pipe]() {
+    File* source = File::Open(pipe_path.c_str(), "r");
+    File* destination = File::Open(temp_file.path().c_str(), "w");
+    if (source && destination)
+      bytes_copied_from_pipe = File::Copy(source, destination);
+    if (source)
+      source->Close();
+    if (destination)
+      destination->Close();
+  });
+
+  File* source = File::Open(local_file_name_no_prefix_.c_str(), "r");
+  File* destination = File::Open(pipe_path.c_str(), "w");
+  EXPECT_TRUE(source != nullptr);
+  EXPECT_TRUE(destination != nullptr);
+  if (source && destination)
+    EXPECT_EQ(kSourceSize, File::Copy(source, destination));
+  if (source)
+    EXPECT_TRUE(source->Close());
+  if (destination)
+    EXPECT_TRUE(destination->Close());
+  pipe_reader.join();
+  DeleteFile(pipe_path);
+
+  EXPECT_EQ(kSourceSize, bytes_copied_from_pipe);
+  std::string read_data;
+  ReadFile(temp_file.path(), &read_data, kSourceSize * 2);
+  EXPECT_EQ(source_data, read_data);
+}
+#endif  // !defined(OS_WIN)
+
+INSTANTIATE_TEST_SUITE_P(TestCopyWithDifferentCacheSizes,
+                         CopyLocalFileTest,
+                         // 0 disables cache, 64K is smaller than the copies, and
+                         // 32M is the default.
+                         ::testing::Values(0u, 0x10000u, 32u << 20));
+
 TEST(FileTest, MakeCallbackFileName) {
   const BufferCallbackParams* params =
       reinterpret_cast<BufferCallbackParams*>(1000);
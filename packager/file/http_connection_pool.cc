@@ -0,0 +1,229 @@
+// Copyright 2024 Google LLC. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <packager/file/http_connection_pool.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <absl/flags/flag.h>
+#include <absl/log/check.h>
+#include <absl/log/log.h>
+#include <absl/time/clock.h>
+
+ABSL_FLAG(int32_t,
+          http_max_connections_per_host,
+          0,
+          "Maximum number of simultaneous HTTP connections to a single host. "
+          "Requests beyond the limit wait for a connection to become "
+          "available. 0 means no limit.");
+ABSL_FLAG(int32_t,
+          http_max_total_connections,
+          0,
+          "Maximum number of simultaneous HTTP connections, including idle "
+          "connections kept alive for reuse. 0 means no limit.");
+ABSL_FLAG(int32_t,
+          http_max_transfers_in_flight,
+          0,
+          "Maximum number of HTTP requests in progress at the same time. "
+          "Additional requests are queued until a request completes. Note "
+          "that a live upload stays in progress while waiting for data. 0 "
+          "means no limit.");
+
+namespace shaka {
+
+namespace {
+
+// Upper bound on the time the pool thread sleeps without checking for new or
+// resumed transfers, in case a wakeup is missed. This is also the accuracy of
+// delayed starts.
+const int kPollTimeoutInMs = 100;
+
+}  // namespace
+
+// static
+HttpConnectionPool& HttpConnectionPool::GetInstance() {
+  static HttpConnectionPool instance;
+  return instance;
+}
+
+HttpConnectionPool::HttpConnectionPool()
+    : global_init_result_(curl_global_init(CURL_GLOBAL_DEFAULT)),
+      multi_(curl_multi_init()),
+      share_(curl_share_init()),
+      max_transfers_in_flight_(
+          std::max(absl::GetFlag(FLAGS_http_max_transfers_in_flight), 0)),
+      terminated_(false) {
+  CHECK_EQ(CURLE_OK, global_init_result_) << "curl_global_init() failed.";
+  CHECK(multi_) << "curl_multi_init() failed.";
+  CHECK(share_) << "curl_share_init() failed.";
+
+  curl_multi_setopt(multi_, CURLMOPT_PIPELINING,
+                    static_cast<long>(CURLPIPE_MULTIPLEX));
+  curl_multi_setopt(
+      multi_, CURLMOPT_MAX_HOST_CONNECTIONS,
+      static_cast<long>(absl::GetFlag(FLAGS_http_max_connections_per_host)));
+  curl_multi_setopt(
+      multi_, CURLMOPT_MAX_TOTAL_CONNECTIONS,
+      static_cast<long>(absl::GetFlag(FLAGS_http_max_total_connections)));
+
+  // Connections are already shared by all transfers of |multi_|. Share the
+  // DNS cache and the TLS sessions too, so a new connection to a known host
+  // skips the lookup and resumes the TLS session.
+  curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, &LockSharedData);
+  curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, &UnlockSharedData);
+  curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+  curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+
+  thread_ = std::thread(&HttpConnectionPool::ThreadMain, this);
+}
+
+HttpConnectionPool::~HttpConnectionPool() {
+  Shutdown();
+  curl_multi_cleanup(multi_);
+  curl_share_cleanup(share_);
+  // No transfer or handle of the pool is left, so it is now safe to clean up
+  // libcurl.
+  curl_global_cleanup();
+}
+
+void HttpConnectionPool::Shutdown() {
+  {
+    absl::MutexLock lock(mutex_);
+    terminated_ = true;
+  }
+  curl_multi_wakeup(multi_);
+  thread_.join();
+
+  for (auto& entry : active_transfers_) {
+    curl_multi_remove_handle(multi_, entry.first);
+    entry.second(CURLE_ABORTED_BY_CALLBACK);
+  }
+  active_transfers_.clear();
+
+  std::deque<PendingTransfer> pending_transfers;
+  {
+    absl::MutexLock lock(mutex_);
+    pending_transfers.swap(pending_transfers_);
+  }
+  for (auto& pending_transfer : pending_transfers)
+    pending_transfer.done_cb(CURLE_ABORTED_BY_CALLBACK);
+}
+
+void HttpConnectionPool::StartTransfer(CURL* curl,
+                                       DoneCallback done_cb,
+                                       absl::Duration delay) {
+  curl_easy_setopt(curl, CURLOPT_SHARE, share_);
+  curl_easy_setopt(curl, CURLOPT_HTTP_VERSION,
+                   static_cast<long>(CURL_HTTP_VERSION_2TLS));
+
+  {
+    absl::MutexLock lock(mutex_);
+    pending_transfers_.push_back(
+        PendingTransfer{curl, std::move(done_cb), absl::Now() + delay});
+  }
+  curl_multi_wakeup(multi_);
+}
+
+void HttpConnectionPool::ResumeTransfer(CURL* curl) {
+  {
+    absl::MutexLock lock(mutex_);
+    transfers_to_resume_.insert(curl);
+  }
+  curl_multi_wakeup(multi_);
+}
+
+void HttpConnectionPool::ThreadMain() {
+  while (true) {
+    std::vector<std::pair<CURL*, DoneCallback>> new_transfers;
+    std::vector<CURL*> resumed_transfers;
+    {
+      absl::MutexLock lock(mutex_);
+      if (terminated_)
+        return;
+
+      const absl::Time now = absl::Now();
+      auto iter = pending_transfers_.begin();
+      while (iter != pending_transfers_.end() &&
+             (max_transfers_in_flight_ == 0 ||
+              active_transfers_.size() + new_transfers.size() <
+                  max_transfers_in_flight_)) {
+        if (iter->start_time > now) {
+          ++iter;
+          continue;
+        }
+        new_transfers.emplace_back(iter->curl, std::move(iter->done_cb));
+        iter = pending_transfers_.erase(iter);
+      }
+      resumed_transfers.assign(transfers_to_resume_.begin(),
+                               transfers_to_resume_.end());
+      transfers_to_resume_.clear();
+    }
+
+    for (auto& entry : new_transfers) {
+      CURLMcode res = curl_multi_add_handle(multi_, entry.first);
+      if (res != CURLM_OK) {
+        LOG(ERROR) << "curl_multi_add_handle() failed: "
+                   << curl_multi_strerror(res);
+        entry.second(CURLE_FAILED_INIT);
+        continue;
+      }
+      active_transfers_.emplace(entry.first, std::move(entry.second));
+    }
+    // Transfers which have not been started yet are not paused.
+    for (CURL* curl : resumed_transfers) {
+      if (active_transfers_.find(curl) != active_transfers_.end())
+        curl_easy_pause(curl, CURLPAUSE_CONT);
+    }
+
+    int running_transfers = 0;
+    curl_multi_perform(multi_, &running_transfers);
+
+    bool transfer_done = false;
+    int messages_left = 0;
+    while (CURLMsg* message = curl_multi_info_read(multi_, &messages_left)) {
+      if (message->msg != CURLMSG_DONE)
+        continue;
+      CURL* curl = message->easy_handle;
+      const CURLcode result = message->data.result;
+      curl_multi_remove_handle(multi_, curl);
+
+      auto iter = active_transfers_.find(curl);
+      DCHECK(iter != active_transfers_.end());
+      DoneCallback done_cb = std::move(iter->second);
+      active_transfers_.erase(iter);
+      // The callback may destroy the easy handle.
+      done_cb(result);
+      transfer_done = true;
+    }
+
+    // Don't wait if a finished transfer may have made room for a queued one.
+    if (!transfer_done)
+      curl_multi_poll(multi_, nullptr, 0, kPollTimeoutInMs, nullptr);
+  }
+}
+
+// static
+void HttpConnectionPool::LockSharedData(CURL* /* curl */,
+                                        curl_lock_data data,
+                                        curl_lock_access /* access */,
+                                        void* user) {
+  auto* pool = static_cast<HttpConnectionPool*>(user);
+  pool->share_mutexes_[data].Lock();
+}
+
+// static
+void HttpConnectionPool::UnlockSharedData(CURL* /* curl */,
+                                          curl_lock_data data,
+                                          void* user) {
+  auto* pool = static_cast<HttpConnectionPool*>(user);
+  pool->share_mutexes_[data].Unlock();
+}
+
+}  // namespace shaka
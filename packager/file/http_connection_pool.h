@@ -0,0 +1,109 @@
+// Copyright 2024 Google LLC. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_FILE_HTTP_CONNECTION_POOL_H_
+#define PACKAGER_FILE_HTTP_CONNECTION_POOL_H_
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <set>
+#include <thread>
+
+#include <absl/base/thread_annotations.h>
+#include <absl/synchronization/mutex.h>
+#include <absl/time/time.h>
+#include <curl/curl.h>
+
+#include <packager/macros/classes.h>
+
+namespace shaka {
+
+/// Runs the transfers of all HttpFile instances of the process on a single
+/// curl multi handle, so that connections are kept alive and reused between
+/// requests, and HTTP/2 requests to the same host are multiplexed on a single
+/// connection. DNS and TLS session caches are shared by all transfers too.
+///
+/// All transfers are driven by one thread owned by the pool, so curl
+/// callbacks must never block. They should return CURL_READFUNC_PAUSE or
+/// CURL_WRITEFUNC_PAUSE instead, and the transfer is resumed with
+/// ResumeTransfer() once it can make progress again.
+///
+/// The number of connections per host and of transfers in flight can be
+/// limited with --http_max_connections_per_host and
+/// --http_max_transfers_in_flight.
+///
+/// The pool initializes libcurl, so GetInstance() must be called before
+/// creating any easy handle. libcurl is cleaned up when the pool is destroyed,
+/// after its thread has stopped and the remaining transfers were aborted.
+class HttpConnectionPool {
+ public:
+  /// Called on the pool thread with the result of the transfer, after the
+  /// easy handle has been removed from the pool.
+  typedef std::function<void(CURLcode result)> DoneCallback;
+
+  /// @return the process-wide pool.
+  static HttpConnectionPool& GetInstance();
+
+  /// Starts the transfer of a fully configured easy handle. The handle must
+  /// stay alive until @a done_cb is called.
+  /// @param delay is the minimum time to wait before starting the transfer,
+  ///        e.g. to back off before retrying a failed request.
+  void StartTransfer(CURL* curl,
+                     DoneCallback done_cb,
+                     absl::Duration delay = absl::ZeroDuration());
+
+  /// Resumes a transfer paused by one of its callbacks. It is fine to call
+  /// this for a transfer which is not paused. Can be called from any thread.
+  void ResumeTransfer(CURL* curl);
+
+ private:
+  HttpConnectionPool();
+  ~HttpConnectionPool();
+
+  struct PendingTransfer {
+    CURL* curl;
+    DoneCallback done_cb;
+    absl::Time start_time;
+  };
+
+  void ThreadMain();
+  // Stops |thread_| and aborts the transfers which have not completed.
+  void Shutdown();
+
+  static void LockSharedData(CURL* curl,
+                             curl_lock_data data,
+                             curl_lock_access access,
+                             void* user);
+  static void UnlockSharedData(CURL* curl, curl_lock_data data, void* user);
+
+  // Declared first, so that libcurl is initialized before the handles are
+  // created.
+  const CURLcode global_init_result_;
+  CURLM* const multi_;
+  CURLSH* const share_;
+  // Protects the data shared through |share_|, one mutex per curl_lock_data.
+  absl::Mutex share_mutexes_[CURL_LOCK_DATA_LAST];
+  // Maximum number of transfers added to |multi_|, 0 for no limit.
+  const size_t max_transfers_in_flight_;
+
+  absl::Mutex mutex_;
+  std::deque<PendingTransfer> pending_transfers_ ABSL_GUARDED_BY(mutex_);
+  std::set<CURL*> transfers_to_resume_ ABSL_GUARDED_BY(mutex_);
+  bool terminated_ ABSL_GUARDED_BY(mutex_);
+
+  // Transfers added to |multi_|. Only accessed on |thread_|.
+  std::map<CURL*, DoneCallback> active_transfers_;
+
+  std::thread thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(HttpConnectionPool);
+};
+
+}  // namespace shaka
+
+#endif  // PACKAGER_FILE_HTTP_CONNECTION_POOL_H_
@@ -6,11 +6,16 @@
 
 #include <packager/file/http_file.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <functional>
 #include <ios>
 #include <memory>
+#include <random>
 #include <string>
 #include <utility>
 #include <vector>
@@ -21,14 +26,16 @@
 #include <absl/log/log.h>
 #include <absl/log/vlog_is_on.h>
 #include <absl/strings/escaping.h>
+#include <absl/strings/match.h>
 #include <absl/strings/str_format.h>
+#include <absl/time/clock.h>
 #include <curl/curl.h>
 #include <curl/easy.h>
 
 #include <packager/file.h>
 #include <packager/file/file_closer.h>
+#include <packager/file/http_connection_pool.h>
 #include <packager/file/io_cache.h>
-#include <packager/file/thread_pool.h>
 #include <packager/macros/compiler.h>
 #include <packager/status.h>
 #include <packager/version/version.h>
@@ -65,6 +72,29 @@ ABSL_FLAG(bool,
           "Ignore HTTP output failures. Can help recover from live stream "
           "upload errors.");
 
+ABSL_FLAG(int32_t,
+          http_upload_max_retries,
+          3,
+          "Maximum number of times a failed HTTP upload (PUT or POST) is "
+          "retried. Only connection errors, timeouts, 429 and 5xx responses "
+          "are retried. 0 disables retries.");
+ABSL_FLAG(int32_t,
+          http_upload_retry_backoff_ms,
+          500,
+          "Delay before retrying a failed HTTP upload, in milliseconds. The "
+          "delay doubles on every retry, and is randomly reduced by up to half "
+          "so that uploads which failed together don't retry together.");
+ABSL_FLAG(int32_t,
+          http_upload_retry_deadline_seconds,
+          30,
+          "HTTP uploads are not retried once this many seconds have elapsed "
+          "since they were opened.");
+ABSL_FLAG(uint64_t,
+          http_upload_replay_buffer_size,
+          16 * 1024 * 1024,
+          "Maximum number of bytes of an HTTP upload kept in memory so they "
+          "can be sent again on retry. Larger uploads are not retried.");
+
 ABSL_DECLARE_FLAG(uint64_t, io_cache_size);
 
 namespace shaka {
@@ -74,26 +104,6 @@ namespace {
 constexpr const char* kBinaryContentType = "application/octet-stream";
 constexpr const int kMinLogLevelForCurlDebugFunction = 2;
 
-size_t CurlWriteCallback(char* buffer, size_t size, size_t nmemb, void* user) {
-  IoCache* cache = reinterpret_cast<IoCache*>(user);
-  size_t length = size * nmemb;
-  if (cache) {
-    length = cache->Write(buffer, length);
-    VLOG(3) << "CurlWriteCallback length=" << length;
-  } else {
-    // For the case of HTTP Put, the returned data may not be consumed. Return
-    // the size of the data to avoid curl errors.
-  }
-  return length;
-}
-
-size_t CurlReadCallback(char* buffer, size_t size, size_t nitems, void* user) {
-  IoCache* cache = reinterpret_cast<IoCache*>(user);
-  size_t length = cache->Read(buffer, size * nitems);
-  VLOG(3) << "CurlRead length=" << length;
-  return length;
-}
-
 int CurlDebugCallback(CURL* /* handle */,
                       curl_infotype type,
                       const char* data,
@@ -152,15 +162,54 @@ int CurlDebugCallback(CURL* /* handle */,
   return 0;
 }
 
-class LibCurlInitializer {
- public:
-  LibCurlInitializer() { curl_global_init(CURL_GLOBAL_DEFAULT); }
+uint64_t GetCacheSize() {
+  return std::max(absl::GetFlag(FLAGS_io_cache_size),
+                  static_cast<uint64_t>(CURL_MAX_WRITE_SIZE));
+}
+
+CURL* CreateEasyHandle() {
+  // The pool initializes libcurl, and cleans it up after shutting down.
+  HttpConnectionPool::GetInstance();
+  return curl_easy_init();
+}
+
+Status CurlResultToStatus(CURL* curl, CURLcode res) {
+  if (res == CURLE_OK)
+    return Status::OK;
 
-  ~LibCurlInitializer() { curl_global_cleanup(); }
+  std::string error_message = curl_easy_strerror(res);
+  if (res == CURLE_HTTP_RETURNED_ERROR) {
+    long response_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+    error_message += absl::StrFormat(", response code: %ld.", response_code);
+  }
+
+  return Status(
+      res == CURLE_OPERATION_TIMEDOUT ? error::TIME_OUT : error::HTTP_FAILURE,
+      error_message);
+}
+
+bool IsRetriableError(CURL* curl, CURLcode res) {
+  switch (res) {
+    case CURLE_COULDNT_CONNECT:
+    case CURLE_OPERATION_TIMEDOUT:
+    case CURLE_SEND_ERROR:
+    case CURLE_RECV_ERROR:
+    case CURLE_GOT_NOTHING:
+    case CURLE_PARTIAL_FILE:
+      return true;
+    case CURLE_HTTP_RETURNED_ERROR: {
+      long response_code = 0;
+      curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+      // Too Many Requests, or a server error.
+      return response_code == 429 || response_code >= 500;
+    }
+    default:
+      return false;
+  }
+}
 
-  LibCurlInitializer(const LibCurlInitializer&) = delete;
-  LibCurlInitializer& operator=(const LibCurlInitializer&) = delete;
-};
+std::atomic<int64_t> g_upload_retry_count(0);
 
 template <typename List>
 bool AppendHeader(const std::string& header, List* list) {
@@ -190,9 +239,9 @@ HttpFile::HttpFile(HttpMethod method,
       timeout_in_seconds_(timeout_in_seconds),
       method_(method),
       isUpload_(method == HttpMethod::kPut || method == HttpMethod::kPost),
-      download_cache_(absl::GetFlag(FLAGS_io_cache_size)),
-      upload_cache_(absl::GetFlag(FLAGS_io_cache_size)),
-      curl_(curl_easy_init()),
+      download_cache_(GetCacheSize()),
+      upload_cache_(GetCacheSize()),
+      curl_(CreateEasyHandle()),
       status_(Status::OK),
       user_agent_(absl::GetFlag(FLAGS_user_agent)),
       ca_file_(absl::GetFlag(FLAGS_ca_file)),
@@ -200,8 +249,18 @@ HttpFile::HttpFile(HttpMethod method,
       client_cert_private_key_file_(
           absl::GetFlag(FLAGS_client_cert_private_key_file)),
       client_cert_private_key_password_(
-          absl::GetFlag(FLAGS_client_cert_private_key_password)) {
-  static LibCurlInitializer lib_curl_initializer;
+          absl::GetFlag(FLAGS_client_cert_private_key_password)),
+      max_retries_(isUpload_ ? absl::GetFlag(FLAGS_http_upload_max_retries)
+                             : 0),
+      retry_backoff_(
+          absl::Milliseconds(absl::GetFlag(FLAGS_http_upload_retry_backoff_ms))),
+      retry_deadline_(absl::InfiniteFuture()),
+      retry_count_(0),
+      max_replay_buffer_size_(
+          absl::GetFlag(FLAGS_http_upload_replay_buffer_size)),
+      replay_offset_(0),
+      can_replay_(isUpload_),
+      response_bytes_written_(0) {
   if (user_agent_.empty()) {
     user_agent_ += "ShakaPackager/" + GetPackagerVersion();
   }
@@ -240,6 +299,11 @@ bool HttpFile::Delete(const std::string& url) {
   return file.release()->Close();
 }
 
+// static
+int64_t HttpFile::GetUploadRetryCount() {
+  return g_upload_retry_count;
+}
+
 bool HttpFile::Open() {
   VLOG(2) << "Opening " << url_;
 
@@ -249,10 +313,11 @@ bool HttpFile::Open() {
   }
   // TODO: Try to connect initially so we can return connection error here.
 
-  // TODO: Implement retrying with exponential backoff, see
-  // "widevine_key_source.cc"
-
-  ThreadPool::instance.PostTask(std::bind(&HttpFile::ThreadMain, this));
+  SetupRequest();
+  retry_deadline_ =
+      absl::Now() +
+      absl::Seconds(absl::GetFlag(FLAGS_http_upload_retry_deadline_seconds));
+  StartRequest(absl::ZeroDuration());
 
   return true;
 }
@@ -266,6 +331,7 @@ Status HttpFile::CloseWithStatus() {
   // code at minimum) can still be written after uploading is complete.
   // The task will close the download cache when it is complete.
   upload_cache_.Close();
+  HttpConnectionPool::GetInstance().ResumeTransfer(curl_.get());
   task_exit_event_.WaitForNotification();
 
   const Status result = status_;
@@ -280,18 +346,34 @@ bool HttpFile::Close() {
 
 int64_t HttpFile::Read(void* buffer, uint64_t length) {
   VLOG(2) << "Reading from " << url_ << ", length=" << length;
-  return download_cache_.Read(buffer, length);
+  const uint64_t bytes_read = download_cache_.Read(buffer, length);
+  // Let the transfer continue if it was paused on a full cache.
+  HttpConnectionPool::GetInstance().ResumeTransfer(curl_.get());
+  return bytes_read;
 }
 
 int64_t HttpFile::Write(const void* buffer, uint64_t length) {
   DCHECK(!upload_cache_.closed());
   VLOG(2) << "Writing to " << url_ << ", length=" << length;
-  return upload_cache_.Write(buffer, length);
+  // Write piece by piece, so that the transfer can be resumed as soon as
+  // there is data for it.
+  const uint8_t* data = static_cast<const uint8_t*>(buffer);
+  uint64_t bytes_left = length;
+  while (bytes_left > 0) {
+    const uint64_t bytes_written = upload_cache_.WriteSome(data, bytes_left);
+    if (bytes_written == 0)
+      return 0;
+    HttpConnectionPool::GetInstance().ResumeTransfer(curl_.get());
+    data += bytes_written;
+    bytes_left -= bytes_written;
+  }
+  return length;
 }
 
 void HttpFile::CloseForWriting() {
   VLOG(2) << "Closing further writes to " << url_;
   upload_cache_.Close();
+  HttpConnectionPool::GetInstance().ResumeTransfer(curl_.get());
 }
 
 int64_t HttpFile::Size() {
@@ -325,6 +407,82 @@ void HttpFile::CurlDelete::operator()(curl_slist* headers) {
   curl_slist_free_all(headers);
 }
 
+// The callbacks run on the connection pool thread, which is shared by all
+// transfers, so they pause the transfer instead of blocking on the cache.
+// HttpFile resumes it once the cache is ready again.
+
+// static
+size_t HttpFile::CurlWriteCallback(char* buffer,
+                                   size_t size,
+                                   size_t nmemb,
+                                   void* user) {
+  HttpFile* file = static_cast<HttpFile*>(user);
+  IoCache* cache = &file->download_cache_;
+  size_t length = size * nmemb;
+  // The cache holds at least CURL_MAX_WRITE_SIZE bytes, which is the most
+  // curl passes at once, so the chunk fits once the reader drains the cache
+  // and writing it never blocks.
+  if (!cache->closed() && cache->BytesFree() < length)
+    return CURL_WRITEFUNC_PAUSE;
+  length = cache->Write(buffer, length);
+  file->response_bytes_written_ += length;
+  VLOG(3) << "CurlWriteCallback length=" << length;
+  return length;
+}
+
+// static
+size_t HttpFile::CurlReadCallback(char* buffer,
+                                  size_t size,
+                                  size_t nitems,
+                                  void* user) {
+  HttpFile* file = static_cast<HttpFile*>(user);
+  const size_t length = size * nitems;
+
+  // Send the data already sent by a failed attempt first.
+  if (file->replay_offset_ < file->replay_buffer_.size()) {
+    const size_t replay_length =
+        std::min(length, file->replay_buffer_.size() - file->replay_offset_);
+    memcpy(buffer, &file->replay_buffer_[file->replay_offset_], replay_length);
+    file->replay_offset_ += replay_length;
+    VLOG(3) << "CurlRead replay length=" << replay_length;
+    return replay_length;
+  }
+
+  IoCache* cache = &file->upload_cache_;
+  if (!cache->closed() && cache->BytesCached() == 0)
+    return CURL_READFUNC_PAUSE;
+  const size_t bytes_read = cache->Read(buffer, length);
+  VLOG(3) << "CurlRead length=" << bytes_read;
+
+  if (file->can_replay_) {
+    if (file->replay_buffer_.size() + bytes_read >
+        file->max_replay_buffer_size_) {
+      VLOG(1) << "Upload to " << file->url_
+              << " exceeds the replay buffer and won't be retried.";
+      file->can_replay_ = false;
+      std::vector<uint8_t>().swap(file->replay_buffer_);
+    } else {
+      file->replay_buffer_.insert(file->replay_buffer_.end(), buffer,
+                                  buffer + bytes_read);
+    }
+    file->replay_offset_ = file->replay_buffer_.size();
+  }
+  return bytes_read;
+}
+
+// static
+int HttpFile::CurlSeekCallback(void* user, int64_t offset, int origin) {
+  // libcurl rewinds the upload when it has to send the request again, e.g.
+  // when a reused connection turns out to be closed.
+  HttpFile* file = static_cast<HttpFile*>(user);
+  if (origin != SEEK_SET || !file->can_replay_ || offset < 0 ||
+      static_cast<uint64_t>(offset) > file->replay_buffer_.size()) {
+    return CURL_SEEKFUNC_CANTSEEK;
+  }
+  file->replay_offset_ = static_cast<size_t>(offset);
+  return CURL_SEEKFUNC_OK;
+}
+
 void HttpFile::SetupRequest() {
   auto* curl = curl_.get();
 
@@ -348,15 +506,24 @@ void HttpFile::SetupRequest() {
   curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout_in_seconds_);
   curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
   curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &CurlWriteCallback);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &download_cache_);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &HttpFile::CurlWriteCallback);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
   if (isUpload_) {
-    curl_easy_setopt(curl, CURLOPT_READFUNCTION, &CurlReadCallback);
-    curl_easy_setopt(curl, CURLOPT_READDATA, &upload_cache_);
+    curl_easy_setopt(curl, CURLOPT_READFUNCTION, &HttpFile::CurlReadCallback);
+    curl_easy_setopt(curl, CURLOPT_READDATA, this);
+    curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, &HttpFile::CurlSeekCallback);
+    curl_easy_setopt(curl, CURLOPT_SEEKDATA, this);
   }
 
   curl_easy_setopt(curl, CURLOPT_HTTPHEADER, request_headers_.get());
 
+  // Prefer waiting for a connection that can be multiplexed over opening a
+  // new one. Only HTTPS connections negotiate HTTP/2. A plain HTTP connection
+  // is not known to be unable to multiplex until its response arrives, so
+  // waiting for it would hold the request back behind a pending upload.
+  if (absl::StartsWith(url_, "https://"))
+    curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+
   if (absl::GetFlag(FLAGS_disable_peer_verification))
     curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
 
@@ -383,23 +550,45 @@ void HttpFile::SetupRequest() {
   }
 }
 
-void HttpFile::ThreadMain() {
-  SetupRequest();
+void HttpFile::StartRequest(absl::Duration delay) {
+  CURL* curl = curl_.get();
+  HttpConnectionPool::GetInstance().StartTransfer(
+      curl,
+      [this, curl](CURLcode res) {
+        OnRequestDone(CurlResultToStatus(curl, res),
+                      IsRetriableError(curl, res));
+      },
+      delay);
+}
 
-  CURLcode res = curl_easy_perform(curl_.get());
-  if (res != CURLE_OK) {
-    std::string error_message = curl_easy_strerror(res);
-    if (res == CURLE_HTTP_RETURNED_ERROR) {
-      long response_code = 0;
-      curl_easy_getinfo(curl_.get(), CURLINFO_RESPONSE_CODE, &response_code);
-      error_message += absl::StrFormat(", response code: %ld.", response_code);
+void HttpFile::OnRequestDone(const Status& status, bool retriable) {
+  // A retry would append a second response to the part of the failed one the
+  // reader may already have consumed.
+  if (!status.ok() && retriable && can_replay_ &&
+      response_bytes_written_ == 0 && retry_count_ < max_retries_) {
+    // Only called on the connection pool thread, so the engine is not shared.
+    static std::default_random_engine random_engine(std::random_device{}());
+    std::uniform_real_distribution<double> jitter(0.5, 1.0);
+    const absl::Duration delay =
+        retry_backoff_ * (int64_t{1} << retry_count_) * jitter(random_engine);
+    if (absl::Now() + delay < retry_deadline_) {
+      ++retry_count_;
+      ++g_upload_retry_count;
+      LOG(WARNING) << "HttpFile request to " << url_ << " failed: " << status
+                   << " Retrying in " << delay << " (" << retry_count_ << "/"
+                   << max_retries_ << ").";
+      replay_offset_ = 0;
+      StartRequest(delay);
+      return;
     }
-
-    status_ = Status(
-        res == CURLE_OPERATION_TIMEDOUT ? error::TIME_OUT : error::HTTP_FAILURE,
-        error_message);
   }
 
+  LOG_IF(WARNING, !status.ok() && retriable && response_bytes_written_ > 0)
+      << "HttpFile request to " << url_
+      << " is not retried, since part of the response has been received.";
+  status_ = status;
+  std::vector<uint8_t>().swap(replay_buffer_);
+
   // In some cases it is possible that the server has already closed the
   // connection without reading the request body. This can for example happen
   // when the server responds with a non-successful status code. In this case we
@@ -7,12 +7,14 @@
 #ifndef PACKAGER_FILE_HTTP_H_
 #define PACKAGER_FILE_HTTP_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include <absl/synchronization/notification.h>
+#include <absl/time/time.h>
 
 #include <packager/file.h>
 #include <packager/file/io_cache.h>
@@ -53,6 +55,10 @@ class HttpFile : public File {
 
   static bool Delete(const std::string& url);
 
+  /// @return the number of times a failed upload has been retried, by all
+  ///         HttpFile instances.
+  static int64_t GetUploadRetryCount();
+
   Status CloseWithStatus();
 
   /// @name File implementation overrides.
@@ -77,14 +83,31 @@ class HttpFile : public File {
     void operator()(curl_slist* headers);
   };
 
+  static size_t CurlWriteCallback(char* buffer,
+                                  size_t size,
+                                  size_t nmemb,
+                                  void* user);
+  static size_t CurlReadCallback(char* buffer,
+                                 size_t size,
+                                 size_t nitems,
+                                 void* user);
+  static int CurlSeekCallback(void* user, int64_t offset, int origin);
+
   void SetupRequest();
-  void ThreadMain();
+  void StartRequest(absl::Duration delay);
+  // Called on the connection pool thread when the transfer completes. Retries
+  // failed uploads if |retriable|, no response data has been received and the
+  // retry policy allows it.
+  void OnRequestDone(const Status& status, bool retriable);
 
   const std::string url_;
   const std::string upload_content_type_;
   const int32_t timeout_in_seconds_;
   const HttpMethod method_;
   const bool isUpload_;
+  // The caches only allocate memory for the data that goes through them, so
+  // the upload cache of a download stays empty, and the download cache of an
+  // upload only holds the response.
   IoCache download_cache_;
   IoCache upload_cache_;
   std::unique_ptr<CURL, CurlDelete> curl_;
@@ -97,7 +120,26 @@ class HttpFile : public File {
   std::string client_cert_private_key_file_;
   std::string client_cert_private_key_password_;
 
-  // Signaled when the "curl easy perform" task completes.
+  // Retry policy for uploads.
+  const int32_t max_retries_;
+  const absl::Duration retry_backoff_;
+  absl::Time retry_deadline_;
+  int32_t retry_count_;
+
+  // Upload data sent so far, so that it can be sent again when retrying. Only
+  // accessed on the connection pool thread.
+  const uint64_t max_replay_buffer_size_;
+  std::vector<uint8_t> replay_buffer_;
+  // Position in |replay_buffer_| of the next byte to send.
+  size_t replay_offset_;
+  // False if this is not an upload or |replay_buffer_| overflowed.
+  bool can_replay_;
+  // Response bytes written to |download_cache_|. The reader may have consumed
+  // them already, so a request is not retried once this is not 0. Only
+  // accessed on the connection pool thread.
+  uint64_t response_bytes_written_;
+
+  // Signaled when the transfer completes.
   absl::Notification task_exit_event_;
 };
 
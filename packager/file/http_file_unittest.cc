@@ -11,16 +11,25 @@
 #include <string>
 #include <vector>
 
+#include <absl/flags/declare.h>
+#include <absl/flags/flag.h>
 #include <absl/log/log.h>
 #include <absl/strings/str_split.h>
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
 #include <gtest/gtest.h>
 #include <nlohmann/json.hpp>
 #include <nlohmann/json_fwd.hpp>
 
 #include <packager/file/file_closer.h>
+#include <packager/flag_saver.h>
 #include <packager/media/test/test_web_server.h>
 #include <packager/status.h>
 
+ABSL_DECLARE_FLAG(uint64_t, io_cache_size);
+ABSL_DECLARE_FLAG(int32_t, http_upload_max_retries);
+ABSL_DECLARE_FLAG(int32_t, http_upload_retry_backoff_ms);
+
 #define ASSERT_JSON_STRING(json, key, value) \
   ASSERT_EQ(GetJsonString((json), (key)), (value)) << "JSON is " << (json)
 
@@ -55,18 +64,24 @@ std::string GetJsonString(const nlohmann::json& json,
   return "";
 }
 
-nlohmann::json HandleResponse(const FilePtr& file) {
-  std::string result;
+bool ReadResponse(const FilePtr& file, std::string* result) {
   while (true) {
     char buffer[64 * 1024];
     auto ret = file->Read(buffer, sizeof(buffer));
     if (ret < 0)
-      return nullptr;
+      return false;
     if (ret == 0)
       break;
-    result.append(buffer, buffer + ret);
+    result->append(buffer, buffer + ret);
   }
-  VLOG(1) << "Response:\n" << result;
+  VLOG(1) << "Response:\n" << *result;
+  return true;
+}
+
+nlohmann::json HandleResponse(const FilePtr& file) {
+  std::string result;
+  if (!ReadResponse(file, &result))
+    return nullptr;
 
   nlohmann::json value = nlohmann::json::parse(result,
                                                /* parser callback */ nullptr,
@@ -331,4 +346,217 @@ TEST_F(HttpFileTest, TimeoutNotTriggered) {
   ASSERT_TRUE(file.release()->Close());
 }
 
+TEST_F(HttpFileTest, ReusesConnection) {
+  const HttpMethod kMethods[] = {HttpMethod::kGet, HttpMethod::kPut,
+                                 HttpMethod::kGet};
+  for (HttpMethod method : kMethods) {
+    FilePtr file(new HttpFile(method, server_.ReflectUrl(), kBinaryContentType,
+                              kNoHeaders, kDefaultTestTimeout));
+    ASSERT_TRUE(file);
+    ASSERT_TRUE(file->Open());
+    if (method == HttpMethod::kPut) {
+      const std::string data = "abcd";
+      ASSERT_EQ(file->Write(data.data(), data.size()),
+                static_cast<int64_t>(data.size()));
+      file->CloseForWriting();
+    }
+
+    auto json = HandleResponse(file);
+    ASSERT_TRUE(json.is_object());
+    ASSERT_TRUE(file.release()->Close());
+  }
+
+  // All of the requests went through the first connection.
+  EXPECT_EQ(1, server_.connections_accepted());
+}
+
+TEST_F(HttpFileTest, ConcurrentUploads) {
+  FilePtr file1(new HttpFile(HttpMethod::kPut, server_.ReflectUrl(),
+                             kBinaryContentType, kNoHeaders,
+                             kDefaultTestTimeout));
+  FilePtr file2(new HttpFile(HttpMethod::kPut, server_.ReflectUrl(),
+                             kBinaryContentType, kNoHeaders,
+                             kDefaultTestTimeout));
+  ASSERT_TRUE(file1->Open());
+  ASSERT_TRUE(file2->Open());
+
+  // Interleave the writes, so that each upload has to wait for data while the
+  // other one is in progress.
+  const std::string data1 = "abcd";
+  const std::string data2 = "efgh";
+  ASSERT_EQ(file1->Write(data1.data(), data1.size()),
+            static_cast<int64_t>(data1.size()));
+  ASSERT_TRUE(file1->Flush());
+  ASSERT_EQ(file2->Write(data2.data(), data2.size()),
+            static_cast<int64_t>(data2.size()));
+  ASSERT_TRUE(file2->Flush());
+  ASSERT_EQ(file1->Write(data2.data(), data2.size()),
+            static_cast<int64_t>(data2.size()));
+  ASSERT_EQ(file2->Write(data1.data(), data1.size()),
+            static_cast<int64_t>(data1.size()));
+  file1->CloseForWriting();
+  file2->CloseForWriting();
+
+  auto json1 = HandleResponse(file1);
+  auto json2 = HandleResponse(file2);
+  ASSERT_TRUE(json1.is_object());
+  ASSERT_TRUE(json2.is_object());
+  ASSERT_TRUE(file1.release()->Close());
+  ASSERT_TRUE(file2.release()->Close());
+
+  ASSERT_JSON_STRING(json1, "body", data1 + data2);
+  ASSERT_JSON_STRING(json2, "body", data2 + data1);
+}
+
+TEST_F(HttpFileTest, SlowReaderDoesNotStallOtherTransfers) {
+  FlagSaver<uint64_t> saver(&FLAGS_io_cache_size);
+  absl::SetFlag(&FLAGS_io_cache_size, 1024);
+
+  // The response of the first request is much larger than its cache, and is
+  // not read until the second request completes.
+  FilePtr file1(new HttpFile(HttpMethod::kPut, server_.ReflectUrl(),
+                             kBinaryContentType, kNoHeaders,
+                             kDefaultTestTimeout));
+  ASSERT_TRUE(file1->Open());
+  const std::string data(256 * 1024, 'a');
+  ASSERT_EQ(file1->Write(data.data(), data.size()),
+            static_cast<int64_t>(data.size()));
+  file1->CloseForWriting();
+  // Give the response time to fill the cache.
+  absl::SleepFor(absl::Milliseconds(500));
+
+  FilePtr file2(new HttpFile(HttpMethod::kGet, server_.ReflectUrl(),
+                             kNoContentType, kNoHeaders, kDefaultTestTimeout));
+  ASSERT_TRUE(file2->Open());
+  auto json2 = HandleResponse(file2);
+  ASSERT_TRUE(json2.is_object());
+  ASSERT_TRUE(file2.release()->Close());
+
+  auto json1 = HandleResponse(file1);
+  ASSERT_TRUE(json1.is_object());
+  ASSERT_TRUE(file1.release()->Close());
+  ASSERT_JSON_STRING(json1, "body", data);
+}
+
+TEST_F(HttpFileTest, UploadRetriedAfterServerError) {
+  FlagSaver<int32_t> saver(&FLAGS_http_upload_retry_backoff_ms);
+  absl::SetFlag(&FLAGS_http_upload_retry_backoff_ms, 10);
+  const int64_t retry_count = HttpFile::GetUploadRetryCount();
+
+  FilePtr file(new HttpFile(HttpMethod::kPut, server_.FailUrl(2, 503),
+                            kBinaryContentType, kNoHeaders,
+                            kDefaultTestTimeout));
+  ASSERT_TRUE(file);
+  ASSERT_TRUE(file->Open());
+
+  const std::string data1 = "abcd";
+  const std::string data2 = "efgh";
+  ASSERT_EQ(file->Write(data1.data(), data1.size()),
+            static_cast<int64_t>(data1.size()));
+  ASSERT_TRUE(file->Flush());
+  ASSERT_EQ(file->Write(data2.data(), data2.size()),
+            static_cast<int64_t>(data2.size()));
+  file->CloseForWriting();
+
+  auto json = HandleResponse(file);
+  ASSERT_TRUE(json.is_object());
+  ASSERT_TRUE(file.release()->Close());
+
+  // The whole body is sent again on every attempt.
+  ASSERT_JSON_STRING(json, "method", "PUT");
+  ASSERT_JSON_STRING(json, "body", data1 + data2);
+  EXPECT_EQ(retry_count + 2, HttpFile::GetUploadRetryCount());
+}
+
+TEST_F(HttpFileTest, UploadRetriedAfterConnectionClosed) {
+  FlagSaver<int32_t> saver(&FLAGS_http_upload_retry_backoff_ms);
+  absl::SetFlag(&FLAGS_http_upload_retry_backoff_ms, 10);
+
+  FilePtr file(new HttpFile(HttpMethod::kPost, server_.FailUrl(1, 0),
+                            kBinaryContentType, kNoHeaders,
+                            kDefaultTestTimeout));
+  ASSERT_TRUE(file);
+  ASSERT_TRUE(file->Open());
+
+  const std::string data = "abcd";
+  ASSERT_EQ(file->Write(data.data(), data.size()),
+            static_cast<int64_t>(data.size()));
+  file->CloseForWriting();
+
+  auto json = HandleResponse(file);
+  ASSERT_TRUE(json.is_object());
+  ASSERT_TRUE(file.release()->Close());
+
+  ASSERT_JSON_STRING(json, "method", "POST");
+  ASSERT_JSON_STRING(json, "body", data);
+}
+
+TEST_F(HttpFileTest, TruncatedResponseNotRetried) {
+  FlagSaver<int32_t> saver(&FLAGS_http_upload_retry_backoff_ms);
+  absl::SetFlag(&FLAGS_http_upload_retry_backoff_ms, 10);
+  const int64_t retry_count = HttpFile::GetUploadRetryCount();
+
+  FilePtr file(new HttpFile(HttpMethod::kPost, server_.TruncateUrl(1),
+                            kBinaryContentType, kNoHeaders,
+                            kDefaultTestTimeout));
+  ASSERT_TRUE(file);
+  ASSERT_TRUE(file->Open());
+
+  const std::string data = "abcd";
+  ASSERT_EQ(file->Write(data.data(), data.size()),
+            static_cast<int64_t>(data.size()));
+  file->CloseForWriting();
+
+  // The part of the response which has been read is not followed by the
+  // response of a retry.
+  std::string response;
+  ASSERT_TRUE(ReadResponse(file, &response));
+  EXPECT_EQ("{\"partial\": \"", response);
+
+  auto status = file.release()->CloseWithStatus();
+  ASSERT_FALSE(status.ok());
+  ASSERT_EQ(status.error_code(), error::HTTP_FAILURE);
+  EXPECT_EQ(retry_count, HttpFile::GetUploadRetryCount());
+}
+
+TEST_F(HttpFileTest, UploadRetriesExhausted) {
+  FlagSaver<int32_t> retries_saver(&FLAGS_http_upload_max_retries);
+  FlagSaver<int32_t> backoff_saver(&FLAGS_http_upload_retry_backoff_ms);
+  absl::SetFlag(&FLAGS_http_upload_max_retries, 1);
+  absl::SetFlag(&FLAGS_http_upload_retry_backoff_ms, 10);
+  const int64_t retry_count = HttpFile::GetUploadRetryCount();
+
+  FilePtr file(new HttpFile(HttpMethod::kPut, server_.FailUrl(2, 503),
+                            kBinaryContentType, kNoHeaders,
+                            kDefaultTestTimeout));
+  ASSERT_TRUE(file);
+  ASSERT_TRUE(file->Open());
+
+  const std::string data = "abcd";
+  ASSERT_EQ(file->Write(data.data(), data.size()),
+            static_cast<int64_t>(data.size()));
+  file->CloseForWriting();
+
+  auto status = file.release()->CloseWithStatus();
+  ASSERT_FALSE(status.ok());
+  ASSERT_EQ(status.error_code(), error::HTTP_FAILURE);
+  EXPECT_EQ(retry_count + 1, HttpFile::GetUploadRetryCount());
+}
+
+TEST_F(HttpFileTest, ClientErrorNotRetried) {
+  const int64_t retry_count = HttpFile::GetUploadRetryCount();
+
+  FilePtr file(new HttpFile(HttpMethod::kPut, server_.FailUrl(1, 403),
+                            kBinaryContentType, kNoHeaders,
+                            kDefaultTestTimeout));
+  ASSERT_TRUE(file);
+  ASSERT_TRUE(file->Open());
+  file->CloseForWriting();
+
+  auto status = file.release()->CloseWithStatus();
+  ASSERT_FALSE(status.ok());
+  ASSERT_EQ(status.error_code(), error::HTTP_FAILURE);
+  EXPECT_EQ(retry_count, HttpFile::GetUploadRetryCount());
+}
+
 }  // namespace shaka
@@ -9,6 +9,8 @@
 #include <algorithm>
 #include <cstdint>
 #include <cstring>
+#include <memory>
+#include <utility>
 
 #include <absl/log/check.h>
 #include <absl/log/log.h>
@@ -16,14 +18,20 @@
 
 namespace shaka {
 
+namespace {
+
+// The buffer starts at this size, or the cache size if smaller, when the cache
+// is first written to. It then doubles as needed.
+const uint64_t kMinBufferSize = 64 * 1024;
+
+}  // namespace
+
 IoCache::IoCache(uint64_t cache_size)
     : cache_size_(cache_size),
-      // Make the buffer one byte larger than the cache so that when the
-      // condition r_ptr == w_ptr is unambiguous (buffer empty).
-      circular_buffer_(cache_size + 1),
-      end_ptr_(&circular_buffer_[0] + cache_size + 1),
-      r_ptr_(circular_buffer_.data()),
-      w_ptr_(circular_buffer_.data()),
+      buffer_size_(0),
+      end_ptr_(nullptr),
+      r_ptr_(nullptr),
+      w_ptr_(nullptr),
       closed_(false) {}
 
 IoCache::~IoCache() {
@@ -39,13 +47,15 @@ uint64_t IoCache::Read(void* buffer, uint64_t size) {
   }
 
   size = std::min(size, BytesCachedInternal());
+  if (size == 0)
+    return 0;
   uint64_t first_chunk_size(
       std::min(size, static_cast<uint64_t>(end_ptr_ - r_ptr_)));
   memcpy(buffer, r_ptr_, first_chunk_size);
   r_ptr_ += first_chunk_size;
   DCHECK_GE(end_ptr_, r_ptr_);
   if (r_ptr_ == end_ptr_)
-    r_ptr_ = &circular_buffer_[0];
+    r_ptr_ = circular_buffer_.get();
   uint64_t second_chunk_size(size - first_chunk_size);
   if (second_chunk_size) {
     memcpy(static_cast<uint8_t*>(buffer) + first_chunk_size, r_ptr_,
@@ -63,41 +73,56 @@ uint64_t IoCache::Write(const void* buffer, uint64_t size) {
   const uint8_t* r_ptr(static_cast<const uint8_t*>(buffer));
   uint64_t bytes_left(size);
   while (bytes_left) {
-    absl::MutexLock lock(mutex_);
-    while (!closed_ && (BytesFreeInternal() == 0)) {
-      VLOG(1) << "Circular buffer is full, which can happen if data arrives "
-                 "faster than being consumed by packager. Ignore if it is not "
-                 "live packaging. Otherwise, try increasing --io_cache_size.";
-      read_event_.Wait(&mutex_);
-    }
-    if (closed_)
+    uint64_t write_size = WriteSome(r_ptr, bytes_left);
+    if (write_size == 0)
       return 0;
-
-    uint64_t write_size(std::min(bytes_left, BytesFreeInternal()));
-    uint64_t first_chunk_size(
-        std::min(write_size, static_cast<uint64_t>(end_ptr_ - w_ptr_)));
-    memcpy(w_ptr_, r_ptr, first_chunk_size);
-    w_ptr_ += first_chunk_size;
-    DCHECK_GE(end_ptr_, w_ptr_);
-    if (w_ptr_ == end_ptr_)
-      w_ptr_ = &circular_buffer_[0];
-    r_ptr += first_chunk_size;
-    uint64_t second_chunk_size(write_size - first_chunk_size);
-    if (second_chunk_size) {
-      memcpy(w_ptr_, r_ptr, second_chunk_size);
-      w_ptr_ += second_chunk_size;
-      DCHECK_GT(end_ptr_, w_ptr_);
-      r_ptr += second_chunk_size;
-    }
+    r_ptr += write_size;
     bytes_left -= write_size;
-    write_event_.Signal();
   }
   return size;
 }
 
+uint64_t IoCache::WriteSome(const void* buffer, uint64_t size) {
+  DCHECK(buffer);
+
+  if (size == 0)
+    return 0;
+
+  absl::MutexLock lock(mutex_);
+  if (!closed_ && BufferFreeInternal() < size)
+    GrowBufferInternal(size);
+  while (!closed_ && (BufferFreeInternal() == 0)) {
+    VLOG(1) << "Circular buffer is full, which can happen if data arrives "
+               "faster than being consumed by packager. Ignore if it is not "
+               "live packaging. Otherwise, try increasing --io_cache_size.";
+    read_event_.Wait(&mutex_);
+  }
+  if (closed_)
+    return 0;
+
+  const uint8_t* r_ptr(static_cast<const uint8_t*>(buffer));
+  uint64_t write_size(std::min(size, BufferFreeInternal()));
+  uint64_t first_chunk_size(
+      std::min(write_size, static_cast<uint64_t>(end_ptr_ - w_ptr_)));
+  memcpy(w_ptr_, r_ptr, first_chunk_size);
+  w_ptr_ += first_chunk_size;
+  DCHECK_GE(end_ptr_, w_ptr_);
+  if (w_ptr_ == end_ptr_)
+    w_ptr_ = circular_buffer_.get();
+  r_ptr += first_chunk_size;
+  uint64_t second_chunk_size(write_size - first_chunk_size);
+  if (second_chunk_size) {
+    memcpy(w_ptr_, r_ptr, second_chunk_size);
+    w_ptr_ += second_chunk_size;
+    DCHECK_GT(end_ptr_, w_ptr_);
+  }
+  write_event_.Signal();
+  return write_size;
+}
+
 void IoCache::Clear() {
   absl::MutexLock lock(mutex_);
-  r_ptr_ = w_ptr_ = circular_buffer_.data();
+  r_ptr_ = w_ptr_ = circular_buffer_.get();
   // Let any writers know that there is room in the cache.
   read_event_.Signal();
 }
@@ -112,7 +137,7 @@ void IoCache::Close() {
 void IoCache::Reopen() {
   absl::MutexLock lock(mutex_);
   CHECK(closed_);
-  r_ptr_ = w_ptr_ = circular_buffer_.data();
+  r_ptr_ = w_ptr_ = circular_buffer_.get();
   closed_ = false;
 }
 
@@ -126,16 +151,59 @@ uint64_t IoCache::BytesFree() {
   return BytesFreeInternal();
 }
 
+uint64_t IoCache::BytesAllocated() {
+  absl::MutexLock lock(mutex_);
+  return buffer_size_;
+}
+
 uint64_t IoCache::BytesCachedInternal() {
   return (r_ptr_ <= w_ptr_)
              ? w_ptr_ - r_ptr_
-             : (end_ptr_ - r_ptr_) + (w_ptr_ - circular_buffer_.data());
+             : (end_ptr_ - r_ptr_) + (w_ptr_ - circular_buffer_.get());
 }
 
 uint64_t IoCache::BytesFreeInternal() {
   return cache_size_ - BytesCachedInternal();
 }
 
+uint64_t IoCache::BufferFreeInternal() {
+  // One byte of the buffer is always left unused, see GrowBufferInternal().
+  const uint64_t capacity = buffer_size_ ? buffer_size_ - 1 : 0;
+  return capacity - BytesCachedInternal();
+}
+
+void IoCache::GrowBufferInternal(uint64_t size) {
+  const uint64_t capacity = buffer_size_ ? buffer_size_ - 1 : 0;
+  if (capacity >= cache_size_)
+    return;
+
+  const uint64_t bytes_cached = BytesCachedInternal();
+  const uint64_t new_capacity = std::min(
+      cache_size_, std::max({capacity * 2, bytes_cached + size,
+                             std::min(kMinBufferSize, cache_size_)}));
+  // Make the buffer one byte larger than the capacity so that the condition
+  // r_ptr == w_ptr is unambiguous (buffer empty). It is left uninitialized,
+  // since only bytes which have been written are ever read.
+  std::unique_ptr<uint8_t[]> new_buffer(new uint8_t[new_capacity + 1]);
+
+  // Move the cached data to the beginning of the new buffer.
+  uint64_t first_chunk_size(
+      std::min(bytes_cached, static_cast<uint64_t>(end_ptr_ - r_ptr_)));
+  if (first_chunk_size)
+    memcpy(new_buffer.get(), r_ptr_, first_chunk_size);
+  uint64_t second_chunk_size(bytes_cached - first_chunk_size);
+  if (second_chunk_size) {
+    memcpy(new_buffer.get() + first_chunk_size, circular_buffer_.get(),
+           second_chunk_size);
+  }
+
+  circular_buffer_ = std::move(new_buffer);
+  buffer_size_ = new_capacity + 1;
+  end_ptr_ = circular_buffer_.get() + buffer_size_;
+  r_ptr_ = circular_buffer_.get();
+  w_ptr_ = circular_buffer_.get() + bytes_cached;
+}
+
 void IoCache::WaitUntilEmptyOrClosed() {
   absl::MutexLock lock(mutex_);
   while (!closed_ && BytesCachedInternal()) {
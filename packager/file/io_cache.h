@@ -8,7 +8,7 @@
 #define PACKAGER_FILE_IO_CACHE_H_
 
 #include <cstdint>
-#include <vector>
+#include <memory>
 
 #include <absl/base/thread_annotations.h>
 #include <absl/synchronization/mutex.h>
@@ -18,8 +18,11 @@
 namespace shaka {
 
 /// Declaration of class which implements a thread-safe circular buffer.
+/// The buffer is allocated lazily and grows on demand up to the cache size,
+/// so a cache which is never written to does not use any memory.
 class IoCache {
  public:
+  /// @param cache_size is the maximum number of bytes held by the cache.
   explicit IoCache(uint64_t cache_size);
   ~IoCache();
 
@@ -40,6 +43,14 @@ class IoCache {
   ///         closed.
   uint64_t Write(const void* buffer, uint64_t size);
 
+  /// Write as much data as fits in the cache. This function only blocks while
+  /// the cache is full.
+  /// @param buffer is a buffer containing the data to be written to the cache.
+  /// @param size is the size of the data to be written to the cache.
+  /// @return the amount of data written to the buffer, which is at least 1 if
+  ///         @a size is not 0, or 0 if the cache has been closed.
+  uint64_t WriteSome(const void* buffer, uint64_t size);
+
   /// Empties the cache.
   void Clear();
 
@@ -61,18 +72,28 @@ class IoCache {
   /// @return the number of free bytes in the cache.
   uint64_t BytesFree();
 
+  /// Returns the size of the memory currently allocated for the cache.
+  /// @return the number of bytes allocated for the cache.
+  uint64_t BytesAllocated();
+
   /// Waits until the cache is empty or has been closed.
   void WaitUntilEmptyOrClosed();
 
  private:
   uint64_t BytesCachedInternal();
   uint64_t BytesFreeInternal();
+  // Free space in the currently allocated buffer.
+  uint64_t BufferFreeInternal();
+  // Grows the buffer, up to |cache_size_|, so that it has room for |size| more
+  // bytes.
+  void GrowBufferInternal(uint64_t size);
 
   const uint64_t cache_size_;
   absl::Mutex mutex_;
   absl::CondVar read_event_ ABSL_GUARDED_BY(mutex_);
   absl::CondVar write_event_ ABSL_GUARDED_BY(mutex_);
-  std::vector<uint8_t> circular_buffer_ ABSL_GUARDED_BY(mutex_);
+  std::unique_ptr<uint8_t[]> circular_buffer_ ABSL_GUARDED_BY(mutex_);
+  uint64_t buffer_size_ ABSL_GUARDED_BY(mutex_);
   const uint8_t* end_ptr_ ABSL_GUARDED_BY(mutex_);
   uint8_t* r_ptr_ ABSL_GUARDED_BY(mutex_);
   uint8_t* w_ptr_ ABSL_GUARDED_BY(mutex_);
@@ -257,4 +257,64 @@ TEST_F(IoCacheTest, LargeRead) {
   cache_->Close();
 }
 
+TEST_F(IoCacheTest, WriteSome) {
+  const uint64_t kTestBytes(kCacheSize + kBlockSize);
+
+  std::vector<uint8_t> write_buffer;
+  GenerateTestBuffer(kTestBytes, &write_buffer);
+  EXPECT_EQ(kBlockSize, cache_->WriteSome(write_buffer.data(), kBlockSize));
+  // Only the free space is written, without blocking.
+  EXPECT_EQ(kCacheSize - kBlockSize,
+            cache_->WriteSome(&write_buffer[kBlockSize], kCacheSize));
+  EXPECT_EQ(0u, cache_->BytesFree());
+
+  std::vector<uint8_t> read_buffer(kTestBytes);
+  EXPECT_EQ(kCacheSize, cache_->Read(read_buffer.data(), kCacheSize));
+  EXPECT_EQ(kBlockSize,
+            cache_->WriteSome(&write_buffer[kCacheSize], kBlockSize));
+  EXPECT_EQ(kBlockSize, cache_->Read(&read_buffer[kCacheSize], kBlockSize));
+  EXPECT_EQ(write_buffer, read_buffer);
+
+  cache_->Close();
+  EXPECT_EQ(0u, cache_->WriteSome(write_buffer.data(), kBlockSize));
+}
+
+TEST(IoCacheGrowthTest, AllocatesOnDemand) {
+  const uint64_t kLargeCacheSize = 32 * 1024 * 1024;
+  IoCache cache(kLargeCacheSize);
+  EXPECT_EQ(0u, cache.BytesAllocated());
+  EXPECT_EQ(kLargeCacheSize, cache.BytesFree());
+
+  const std::vector<uint8_t> data(1000, 0xab);
+  EXPECT_EQ(data.size(), cache.Write(data.data(), data.size()));
+  EXPECT_LT(cache.BytesAllocated(), kLargeCacheSize / 100);
+  EXPECT_EQ(kLargeCacheSize - data.size(), cache.BytesFree());
+}
+
+TEST(IoCacheGrowthTest, GrowsWithWrappedData) {
+  const uint64_t kLargeCacheSize = 1024 * 1024;
+  IoCache cache(kLargeCacheSize);
+
+  std::vector<uint8_t> data(200 * 1024);
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = static_cast<uint8_t>(i * 7);
+  std::vector<uint8_t> read_buffer(data.size());
+
+  // Fill most of the initial buffer, consume part of it, then write enough to
+  // wrap around the end of the buffer.
+  ASSERT_EQ(60u * 1024, cache.Write(data.data(), 60 * 1024));
+  const uint64_t initial_allocation = cache.BytesAllocated();
+  ASSERT_EQ(50u * 1024, cache.Read(read_buffer.data(), 50 * 1024));
+  ASSERT_EQ(20u * 1024, cache.Write(&data[60 * 1024], 20 * 1024));
+  EXPECT_EQ(initial_allocation, cache.BytesAllocated());
+
+  // This write does not fit, so the buffer grows instead of blocking.
+  ASSERT_EQ(120u * 1024, cache.Write(&data[80 * 1024], 120 * 1024));
+  EXPECT_GT(cache.BytesAllocated(), initial_allocation);
+  EXPECT_LE(cache.BytesAllocated(), kLargeCacheSize + 1);
+
+  ASSERT_EQ(150u * 1024, cache.Read(&read_buffer[50 * 1024], 200 * 1024));
+  EXPECT_EQ(data, read_buffer);
+}
+
 }  // namespace shaka
@@ -19,7 +19,16 @@
 #else
 #endif  // defined(OS_WIN)
 
+#if defined(__linux__)
+#include <errno.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // defined(__linux__)
+
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 #include <filesystem>
 
 #include <absl/log/check.h>
@@ -31,6 +40,12 @@ namespace shaka {
 // Always open files in binary mode.
 const char kAdditionalFileMode[] = "b";
 
+#if defined(__linux__)
+// Maximum number of bytes passed to a single copy_file_range() or sendfile()
+// call. Both are limited to a little less than 2GB per call anyway.
+const int64_t kMaxKernelCopySize = 1 << 30;
+#endif  // defined(__linux__)
+
 LocalFile::LocalFile(const char* file_name, const char* mode)
     : File(file_name), file_mode_(mode), internal_file_(NULL) {
   if (file_mode_.find(kAdditionalFileMode) == std::string::npos)
@@ -151,4 +166,98 @@ bool LocalFile::Delete(const char* file_name) {
   return std::filesystem::remove(file_path, ec);
 }
 
+// static
+int64_t LocalFile::CopyRange(LocalFile* source,
+                             LocalFile* destination,
+                             int64_t max_copy) {
+  DCHECK(source && source->internal_file_);
+  DCHECK(destination && destination->internal_file_);
+#if defined(__linux__)
+  if (!CanCopyRange(source, destination))
+    return 0;
+
+  // The copy uses explicit offsets, as the offsets of the file descriptors do
+  // not match the positions of the stdio streams when they buffer data.
+  // Flushing the destination makes sure pending writes land before the copy.
+  uint64_t source_position = 0;
+  uint64_t destination_position = 0;
+  if (!source->Tell(&source_position) ||
+      !destination->Tell(&destination_position) || !destination->Flush()) {
+    return -1;
+  }
+
+  const int source_fd = fileno(source->internal_file_);
+  const int destination_fd = fileno(destination->internal_file_);
+  off_t source_offset = static_cast<off_t>(source_position);
+  off_t destination_offset = static_cast<off_t>(destination_position);
+  bool use_copy_file_range = true;
+  int64_t bytes_copied = 0;
+  while (bytes_copied < max_copy) {
+    const size_t size = static_cast<size_t>(
+        std::min(kMaxKernelCopySize, max_copy - bytes_copied));
+    ssize_t result = 0;
+    if (use_copy_file_range) {
+      result = copy_file_range(source_fd, &source_offset, destination_fd,
+                               &destination_offset, size, 0);
+      // copy_file_range() is not supported by old kernels, between some
+      // filesystems, or if the destination is opened for appending.
+      if (result < 0 && (errno == ENOSYS || errno == EXDEV ||
+                         errno == EINVAL || errno == EOPNOTSUPP ||
+                         errno == EBADF)) {
+        use_copy_file_range = false;
+        continue;
+      }
+    } else {
+      // sendfile() writes at the offset of the destination descriptor.
+      if (lseek(destination_fd, destination_offset, SEEK_SET) < 0)
+        return -1;
+      result = sendfile(destination_fd, source_fd, &source_offset, size);
+      // Let the caller copy the rest if sendfile() is not supported either.
+      if (result < 0 && (errno == ENOSYS || errno == EINVAL))
+        break;
+      if (result > 0)
+        destination_offset += result;
+    }
+    if (result < 0) {
+      if (errno == EINTR)
+        continue;
+      LOG(ERROR) << "Failed to copy from " << source->file_name() << " to "
+                 << destination->file_name() << ", error = "
+                 << strerror(errno);
+      return -1;
+    }
+    if (result == 0)
+      break;
+    bytes_copied += result;
+  }
+
+  VLOG(2) << "Copied " << bytes_copied << " bytes from "
+          << source->file_name() << " to " << destination->file_name()
+          << " in the kernel";
+  if (!source->Seek(source_position + bytes_copied) ||
+      !destination->Seek(destination_position + bytes_copied)) {
+    return -1;
+  }
+  return bytes_copied;
+#else
+  return 0;
+#endif  // defined(__linux__)
+}
+
+// static
+bool LocalFile::CanCopyRange(LocalFile* source, LocalFile* destination) {
+  DCHECK(source && source->internal_file_);
+  DCHECK(destination && destination->internal_file_);
+#if defined(__linux__)
+  struct stat source_info;
+  struct stat destination_info;
+  return fstat(fileno(source->internal_file_), &source_info) == 0 &&
+         S_ISREG(source_info.st_mode) &&
+         fstat(fileno(destination->internal_file_), &destination_info) == 0 &&
+         S_ISREG(destination_info.st_mode);
+#else
+  return false;
+#endif  // defined(__linux__)
+}
+
 }  // namespace shaka
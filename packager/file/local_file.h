@@ -41,6 +41,26 @@ class LocalFile : public File {
   /// @return true if successful, or false otherwise.
   static bool Delete(const char* file_name);
 
+  /// Copies data from the current position of @a source to the current
+  /// position of @a destination without going through userspace, using
+  /// copy_file_range(), which shares the extents on filesystems supporting
+  /// reflinks, or sendfile(). The positions of both files are advanced by the
+  /// number of bytes copied.
+  /// @param max_copy is the maximum number of bytes to copy.
+  /// @return the number of bytes copied, or a negative value on error. Less
+  ///         than @a max_copy bytes are copied at end of file, or if the
+  ///         kernel cannot copy between these files, e.g. on other platforms
+  ///         than Linux. The caller is expected to copy the rest itself.
+  static int64_t CopyRange(LocalFile* source,
+                           LocalFile* destination,
+                           int64_t max_copy);
+
+  /// @return true if CopyRange() can copy between @a source and
+  ///         @a destination, which requires both to be regular files. Files
+  ///         which cannot seek, such as pipes, have to be copied by the
+  ///         caller.
+  static bool CanCopyRange(LocalFile* source, LocalFile* destination);
+
  protected:
   ~LocalFile() override;
 
@@ -7,10 +7,14 @@
 #include <packager/file/memory_file.h>
 
 #include <algorithm>
+#include <array>
 #include <cstdint>
 #include <cstring>  // for memcpy
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <absl/base/thread_annotations.h>
@@ -22,11 +26,112 @@
 #include <packager/macros/logging.h>
 
 namespace shaka {
+
+// The contents of a memory file. The data is stored in chunks which are never
+// moved once allocated. Chunks double in size up to |kMaxChunkSize|, so small
+// files stay small and large files use a reasonable number of chunks.
+class MemoryFileData {
+ public:
+  MemoryFileData() = default;
+
+  uint64_t size() {
+    absl::ReaderMutexLock lock(mutex_);
+    return size_;
+  }
+
+  // Reads up to |length| bytes at |position|. Returns the number of bytes
+  // read.
+  uint64_t Read(uint64_t position, void* buffer, uint64_t length) {
+    absl::ReaderMutexLock lock(mutex_);
+    if (position >= size_)
+      return 0;
+    const uint64_t bytes_to_read = std::min(length, size_ - position);
+    uint8_t* output = static_cast<uint8_t*>(buffer);
+    uint64_t bytes_read = 0;
+    for (size_t i = FindChunk(position); bytes_read < bytes_to_read; ++i) {
+      const Chunk& chunk = chunks_[i];
+      const uint64_t offset_in_chunk = position + bytes_read - chunk.offset;
+      const uint64_t size =
+          std::min(bytes_to_read - bytes_read, chunk.size - offset_in_chunk);
+      memcpy(output + bytes_read, chunk.data.get() + offset_in_chunk, size);
+      bytes_read += size;
+    }
+    return bytes_read;
+  }
+
+  // Writes |length| bytes at |position|, which must not be past the end.
+  void Write(uint64_t position, const void* buffer, uint64_t length) {
+    absl::MutexLock lock(mutex_);
+    DCHECK_LE(position, size_);
+    const uint64_t end = position + length;
+    while (capacity_ < end) {
+      const uint64_t chunk_size =
+          std::min(std::max(kMinChunkSize, capacity_), kMaxChunkSize);
+      chunks_.push_back(
+          Chunk{std::unique_ptr<uint8_t[]>(new uint8_t[chunk_size]),
+                capacity_, chunk_size});
+      capacity_ += chunk_size;
+    }
+
+    const uint8_t* input = static_cast<const uint8_t*>(buffer);
+    uint64_t bytes_written = 0;
+    for (size_t i = FindChunk(position); bytes_written < length; ++i) {
+      Chunk& chunk = chunks_[i];
+      const uint64_t offset_in_chunk = position + bytes_written - chunk.offset;
+      const uint64_t size =
+          std::min(length - bytes_written, chunk.size - offset_in_chunk);
+      memcpy(chunk.data.get() + offset_in_chunk, input + bytes_written, size);
+      bytes_written += size;
+    }
+    size_ = std::max(size_, end);
+  }
+
+  void Clear() {
+    absl::MutexLock lock(mutex_);
+    chunks_.clear();
+    capacity_ = 0;
+    size_ = 0;
+  }
+
+ private:
+  MemoryFileData(const MemoryFileData&) = delete;
+  MemoryFileData& operator=(const MemoryFileData&) = delete;
+
+  static constexpr uint64_t kMinChunkSize = 0x1000;    // 4KB.
+  static constexpr uint64_t kMaxChunkSize = 0x100000;  // 1MB.
+
+  struct Chunk {
+    std::unique_ptr<uint8_t[]> data;
+    // Offset of the chunk in the file.
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  // Returns the index of the chunk containing |position|, which must be less
+  // than |capacity_|.
+  size_t FindChunk(uint64_t position) const ABSL_SHARED_LOCKS_REQUIRED(mutex_) {
+    DCHECK_LT(position, capacity_);
+    auto iter = std::upper_bound(
+        chunks_.begin(), chunks_.end(), position,
+        [](uint64_t position, const Chunk& chunk) {
+          return position < chunk.offset;
+        });
+    return static_cast<size_t>(iter - chunks_.begin()) - 1;
+  }
+
+  absl::Mutex mutex_;
+  std::vector<Chunk> chunks_ ABSL_GUARDED_BY(mutex_);
+  uint64_t capacity_ ABSL_GUARDED_BY(mutex_) = 0;
+  uint64_t size_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
 namespace {
 
 // A helper filesystem object.  This holds the data for the memory files.
 class FileSystem {
  public:
+  typedef MemoryFile::EvictionCallback EvictionCallback;
+
   ~FileSystem() {}
 
   static FileSystem* Instance() {
@@ -35,124 +140,170 @@ class FileSystem {
   }
 
   bool Delete(const std::string& file_name) {
-    absl::MutexLock auto_lock(mutex_);
+    Shard& shard = GetShard(file_name);
+    absl::MutexLock auto_lock(shard.mutex);
 
-    if (open_files_.find(file_name) != open_files_.end()) {
+    auto iter = shard.files.find(file_name);
+    if (iter == shard.files.end())
+      return false;
+    if (iter->second.IsOpen()) {
       LOG(ERROR) << "File '" << file_name
                  << "' is still open. Deleting an open MemoryFile is not "
                     "allowed. Exit without deleting the file.";
       return false;
     }
-
-    return files_.erase(file_name) > 0;
+    shard.files.erase(iter);
+    return true;
   }
 
   void DeleteAll() {
-    absl::MutexLock auto_lock(mutex_);
-    if (!open_files_.empty()) {
-      LOG(ERROR) << "There are still files open. Deleting an open MemoryFile "
-                    "is not allowed. Exit without deleting the file.";
-      return;
+    for (Shard& shard : shards_) {
+      absl::MutexLock auto_lock(shard.mutex);
+      for (const auto& entry : shard.files) {
+        if (entry.second.IsOpen()) {
+          LOG(ERROR) << "There are still files open. Deleting an open "
+                        "MemoryFile is not allowed. Exit without deleting "
+                        "the file.";
+          return;
+        }
+      }
+    }
+    for (Shard& shard : shards_) {
+      absl::MutexLock auto_lock(shard.mutex);
+      shard.files.clear();
     }
-    files_.clear();
   }
 
-  std::vector<uint8_t>* Open(const std::string& file_name,
-                             const std::string& mode) {
-    absl::MutexLock auto_lock(mutex_);
+  std::shared_ptr<MemoryFileData> Open(const std::string& file_name,
+                                       const std::string& mode) {
+    Shard& shard = GetShard(file_name);
+    absl::MutexLock auto_lock(shard.mutex);
 
-    if (open_files_.find(file_name) != open_files_.end()) {
-      NOTIMPLEMENTED() << "File '" << file_name
-                       << "' is already open. MemoryFile does not support "
-                          "opening the same file before it is closed.";
-      return nullptr;
-    }
-
-    auto iter = files_.find(file_name);
+    auto iter = shard.files.find(file_name);
     if (mode == "r") {
-      if (iter == files_.end())
+      if (iter == shard.files.end())
         return nullptr;
-    } else if (mode == "w") {
-      if (iter != files_.end())
-        iter->second.clear();
-    } else {
+      ++iter->second.num_readers;
+      return iter->second.data;
+    }
+    if (mode != "w") {
       NOTIMPLEMENTED() << "File mode '" << mode
                        << "' not supported by MemoryFile";
       return nullptr;
     }
 
-    open_files_[file_name] = mode;
-    return &files_[file_name];
+    if (iter == shard.files.end()) {
+      iter = shard.files.emplace(file_name, Entry()).first;
+      iter->second.data = std::make_shared<MemoryFileData>();
+    } else if (iter->second.IsOpen()) {
+      NOTIMPLEMENTED() << "File '" << file_name
+                       << "' is already open. MemoryFile does not support "
+                          "opening a file for writing before it is closed.";
+      return nullptr;
+    } else {
+      iter->second.data->Clear();
+    }
+    iter->second.is_writing = true;
+    return iter->second.data;
   }
 
-  bool Close(const std::string& file_name) {
-    absl::MutexLock auto_lock(mutex_);
-
-    auto iter = open_files_.find(file_name);
-    if (iter == open_files_.end()) {
-      LOG(ERROR) << "Cannot close file '" << file_name
-                 << "' which is not open.";
-      return false;
+  bool Close(const std::string& file_name, const std::string& mode) {
+    {
+      Shard& shard = GetShard(file_name);
+      absl::MutexLock auto_lock(shard.mutex);
+
+      auto iter = shard.files.find(file_name);
+      const bool is_writing = mode == "w";
+      if (iter == shard.files.end() ||
+          (is_writing ? !iter->second.is_writing
+                      : iter->second.num_readers == 0)) {
+        LOG(ERROR) << "Cannot close file '" << file_name
+                   << "' which is not open.";
+        return false;
+      }
+      if (!is_writing) {
+        --iter->second.num_readers;
+        return true;
+      }
+      iter->second.is_writing = false;
     }
 
-    open_files_.erase(iter);
+    EvictionCallback eviction_callback;
+    {
+      absl::MutexLock auto_lock(eviction_callback_mutex_);
+      eviction_callback = eviction_callback_;
+    }
+    if (eviction_callback && eviction_callback(file_name))
+      Delete(file_name);
     return true;
   }
 
+  void SetEvictionCallback(EvictionCallback callback) {
+    absl::MutexLock auto_lock(eviction_callback_mutex_);
+    eviction_callback_ = std::move(callback);
+  }
+
  private:
   FileSystem(const FileSystem&) = delete;
   FileSystem& operator=(const FileSystem&) = delete;
 
   FileSystem() = default;
 
-  // Filename to file data map.
-  std::map<std::string, std::vector<uint8_t>> files_ ABSL_GUARDED_BY(mutex_);
-  // Filename to file open modes map.
-  std::map<std::string, std::string> open_files_ ABSL_GUARDED_BY(mutex_);
+  // Number of independently locked shards the files are spread over.
+  static constexpr size_t kNumShards = 16;
 
-  absl::Mutex mutex_;
+  struct Entry {
+    bool IsOpen() const { return is_writing || num_readers > 0; }
+
+    std::shared_ptr<MemoryFileData> data;
+    bool is_writing = false;
+    int num_readers = 0;
+  };
+
+  struct Shard {
+    absl::Mutex mutex;
+    // Filename to file map.
+    std::map<std::string, Entry> files ABSL_GUARDED_BY(mutex);
+  };
+
+  Shard& GetShard(const std::string& file_name) {
+    return shards_[std::hash<std::string>()(file_name) % kNumShards];
+  }
+
+  std::array<Shard, kNumShards> shards_;
+
+  absl::Mutex eviction_callback_mutex_;
+  EvictionCallback eviction_callback_
+      ABSL_GUARDED_BY(eviction_callback_mutex_);
 };
 
 }  // namespace
 
 MemoryFile::MemoryFile(const std::string& file_name, const std::string& mode)
-    : File(file_name), mode_(mode), file_(NULL), position_(0) {}
+    : File(file_name), mode_(mode), position_(0) {}
 
 MemoryFile::~MemoryFile() {}
 
 bool MemoryFile::Close() {
-  if (!FileSystem::Instance()->Close(file_name()))
+  if (!FileSystem::Instance()->Close(file_name(), mode_))
     return false;
   delete this;
   return true;
 }
 
 int64_t MemoryFile::Read(void* buffer, uint64_t length) {
-  const uint64_t size = Size();
-  DCHECK_LE(position_, size);
-  if (position_ >= size)
-    return 0;
-
-  const uint64_t bytes_to_read = std::min(length, size - position_);
-  memcpy(buffer, &(*file_)[position_], bytes_to_read);
-  position_ += bytes_to_read;
-  return bytes_to_read;
+  DCHECK(file_);
+  const uint64_t bytes_read = file_->Read(position_, buffer, length);
+  position_ += bytes_read;
+  return bytes_read;
 }
 
 int64_t MemoryFile::Write(const void* buffer, uint64_t length) {
-  // If length is zero, we won't resize the buffer and it is possible for
-  // |position| to equal the length of the buffer. This will cause a segfault
-  // when indexing into the buffer for the memcpy.
-  if (length == 0) {
+  DCHECK(file_);
+  if (length == 0)
     return 0;
-  }
 
-  const uint64_t size = Size();
-  if (size < position_ + length) {
-    file_->resize(position_ + length);
-  }
-
-  memcpy(&(*file_)[position_], buffer, length);
+  file_->Write(position_, buffer, length);
   position_ += length;
   return length;
 }
@@ -198,4 +349,8 @@ bool MemoryFile::Delete(const std::string& file_name) {
   return FileSystem::Instance()->Delete(file_name);
 }
 
+void MemoryFile::SetEvictionCallback(EvictionCallback callback) {
+  FileSystem::Instance()->SetEvictionCallback(std::move(callback));
+}
+
 }  // namespace shaka
@@ -8,18 +8,34 @@
 #define MEDIA_FILE_MEDIA_FILE_H_
 
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
-#include <vector>
 
 #include <packager/file.h>
 #include <packager/macros/classes.h>
 
 namespace shaka {
 
-/// Implements a File that is stored in memory.  This should be only used for
-/// testing, since this does not support larger files.
+class MemoryFileData;
+
+/// Implements a File that is stored in memory.
+///
+/// The contents of a file are kept in a list of chunks, so growing a file does
+/// not copy the data already written. Files are spread over several shards,
+/// each with its own lock, so that files do not contend with each other.
+///
+/// A file can be opened for reading any number of times, including while it
+/// is open for writing, in which case readers see the data written so far.
+/// It cannot be opened for writing while it is open.
 class MemoryFile : public File {
  public:
+  /// Called when a memory file opened for writing is closed, e.g. to hand the
+  /// file off to another component. It is called without any internal lock
+  /// held, so it can open and read the file.
+  /// @return true to delete the file from memory once the callback returns.
+  typedef std::function<bool(const std::string& file_name)> EvictionCallback;
+
   MemoryFile(const std::string& file_name, const std::string& mode);
 
   /// @name File implementation overrides.
@@ -41,6 +57,10 @@ class MemoryFile : public File {
   /// Deletes the memory file data with the given file_name.  Any objects open
   /// with that file name will be in an undefined state.
   static bool Delete(const std::string& file_name);
+  /// Sets the callback called when a memory file written to is closed.
+  /// @param callback replaces the previous callback. It can be null to remove
+  ///        it.
+  static void SetEvictionCallback(EvictionCallback callback);
 
  protected:
   ~MemoryFile() override;
@@ -48,7 +68,7 @@ class MemoryFile : public File {
 
  private:
   std::string mode_;
-  std::vector<uint8_t>* file_;
+  std::shared_ptr<MemoryFileData> file_;
   uint64_t position_;
 
   DISALLOW_COPY_AND_ASSIGN(MemoryFile);
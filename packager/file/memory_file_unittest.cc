@@ -7,6 +7,8 @@
 #include <cstdint>
 #include <cstring>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -23,7 +25,10 @@ const int64_t kWriteBufferSize = sizeof(kWriteBuffer);
 
 class MemoryFileTest : public testing::Test {
  protected:
-  void TearDown() override { MemoryFile::DeleteAll(); }
+  void TearDown() override {
+    MemoryFile::SetEvictionCallback(nullptr);
+    MemoryFile::DeleteAll();
+  }
 };
 
 TEST_F(MemoryFileTest, ModifiesSameFile) {
@@ -114,4 +119,99 @@ TEST_F(MemoryFileTest, WriteExistingFileDeletes) {
   EXPECT_EQ(0, file2->Size());
 }
 
+TEST_F(MemoryFileTest, WritesAcrossChunks) {
+  // Large enough to need several chunks, written in pieces which do not line
+  // up with the chunk boundaries.
+  const size_t kDataSize = 3 * 1024 * 1024 + 17;
+  const size_t kPieceSize = 10000;
+  std::vector<uint8_t> data(kDataSize);
+  for (size_t i = 0; i < kDataSize; ++i)
+    data[i] = static_cast<uint8_t>(i * 7);
+
+  std::unique_ptr<File, FileCloser> file(File::Open("memory://file1", "w"));
+  ASSERT_TRUE(file);
+  for (size_t pos = 0; pos < kDataSize; pos += kPieceSize) {
+    const size_t size = std::min(kPieceSize, kDataSize - pos);
+    ASSERT_EQ(static_cast<int64_t>(size), file->Write(&data[pos], size));
+  }
+  EXPECT_EQ(static_cast<int64_t>(kDataSize), file->Size());
+
+  // Overwrite a range spanning a chunk boundary.
+  const size_t kOverwritePos = 4096 - 3;
+  ASSERT_TRUE(file->Seek(kOverwritePos));
+  ASSERT_EQ(kWriteBufferSize, file->Write(kWriteBuffer, kWriteBufferSize));
+  memcpy(&data[kOverwritePos], kWriteBuffer, kWriteBufferSize);
+  EXPECT_EQ(static_cast<int64_t>(kDataSize), file->Size());
+
+  std::vector<uint8_t> read_data(kDataSize);
+  ASSERT_TRUE(file->Seek(0));
+  ASSERT_EQ(static_cast<int64_t>(kDataSize),
+            file->Read(read_data.data(), kDataSize));
+  EXPECT_EQ(data, read_data);
+}
+
+TEST_F(MemoryFileTest, ReadsWhileWriting) {
+  std::unique_ptr<File, FileCloser> writer(File::Open("memory://file1", "w"));
+  ASSERT_TRUE(writer);
+  ASSERT_EQ(kWriteBufferSize, writer->Write(kWriteBuffer, kWriteBufferSize));
+
+  std::unique_ptr<File, FileCloser> reader1(File::Open("memory://file1", "r"));
+  std::unique_ptr<File, FileCloser> reader2(File::Open("memory://file1", "r"));
+  ASSERT_TRUE(reader1);
+  ASSERT_TRUE(reader2);
+
+  uint8_t read_buffer[kWriteBufferSize];
+  ASSERT_EQ(kWriteBufferSize, reader1->Read(read_buffer, kWriteBufferSize));
+  EXPECT_EQ(0, memcmp(kWriteBuffer, read_buffer, kWriteBufferSize));
+  EXPECT_EQ(0, reader1->Read(read_buffer, kWriteBufferSize));
+
+  // Readers see data written after they were opened.
+  ASSERT_EQ(kWriteBufferSize, writer->Write(kWriteBuffer, kWriteBufferSize));
+  EXPECT_EQ(kWriteBufferSize, reader1->Read(read_buffer, kWriteBufferSize));
+  EXPECT_EQ(2 * kWriteBufferSize, reader2->Size());
+
+  // The file cannot be opened for writing or deleted while it is open.
+  EXPECT_FALSE(File::Open("memory://file1", "w"));
+  writer.reset();
+  EXPECT_FALSE(File::Open("memory://file1", "w"));
+  EXPECT_FALSE(MemoryFile::Delete("file1"));
+  reader1.reset();
+  reader2.reset();
+  EXPECT_TRUE(File::Delete("memory://file1"));
+}
+
+TEST_F(MemoryFileTest, EvictionCallback) {
+  std::vector<std::string> closed_files;
+  std::vector<uint8_t> evicted_data;
+  MemoryFile::SetEvictionCallback([&](const std::string& file_name) {
+    closed_files.push_back(file_name);
+    if (file_name != "file1")
+      return false;
+    // The file can be read from the callback.
+    std::unique_ptr<File, FileCloser> reader(File::Open("memory://file1", "r"));
+    EXPECT_TRUE(reader);
+    evicted_data.resize(reader->Size());
+    EXPECT_EQ(reader->Size(),
+              reader->Read(evicted_data.data(), evicted_data.size()));
+    return true;
+  });
+
+  for (const char* file_name : {"memory://file1", "memory://file2"}) {
+    std::unique_ptr<File, FileCloser> writer(File::Open(file_name, "w"));
+    ASSERT_TRUE(writer);
+    ASSERT_EQ(kWriteBufferSize, writer->Write(kWriteBuffer, kWriteBufferSize));
+  }
+  // Closing a reader does not call the callback.
+  std::unique_ptr<File, FileCloser> reader(File::Open("memory://file2", "r"));
+  ASSERT_TRUE(reader);
+  reader.reset();
+
+  EXPECT_EQ(std::vector<std::string>({"file1", "file2"}), closed_files);
+  EXPECT_EQ(std::vector<uint8_t>(std::begin(kWriteBuffer),
+                                 std::end(kWriteBuffer)),
+            evicted_data);
+  EXPECT_FALSE(File::Open("memory://file1", "r"));
+  EXPECT_TRUE(File::Open("memory://file2", "r"));
+}
+
 }  // namespace shaka
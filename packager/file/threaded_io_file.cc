@@ -152,8 +152,7 @@ bool ThreadedIoFile::Seek(uint64_t position) {
     cache_.Reopen();
     eof_ = false;
 
-    ThreadPool::instance.PostTask(
-        std::bind(&ThreadedIoFile::TaskHandler, this));
+    RestartTask();
     if (!result)
       return false;
   }
@@ -168,6 +167,46 @@ bool ThreadedIoFile::Tell(uint64_t* position) {
   return true;
 }
 
+bool ThreadedIoFile::BeginDirectAccess() {
+  DCHECK(internal_file_);
+
+  if (mode_ == kOutputMode) {
+    // The task only writes to the internal file when there is data in the
+    // cache, so it can stay alive.
+    return Flush();
+  }
+  cache_.Close();
+  WaitForSignal(&task_exited_mutex_, &task_exited_);
+  if (internal_file_error_.load(std::memory_order_relaxed))
+    return false;
+  return internal_file_->Seek(position_);
+}
+
+bool ThreadedIoFile::EndDirectAccess() {
+  DCHECK(internal_file_);
+
+  bool result = internal_file_->Tell(&position_);
+  if (mode_ == kOutputMode) {
+    if (position_ > size_)
+      size_ = position_;
+    return result;
+  }
+  cache_.Reopen();
+  eof_ = false;
+  RestartTask();
+  return result;
+}
+
+void ThreadedIoFile::RestartTask() {
+  // Mark the task as running before it gets scheduled, so that waiting for it
+  // to exit does not return early.
+  {
+    absl::MutexLock lock(task_exited_mutex_);
+    task_exited_ = false;
+  }
+  ThreadPool::instance.PostTask(std::bind(&ThreadedIoFile::TaskHandler, this));
+}
+
 void ThreadedIoFile::TaskHandler() {
   {
     absl::MutexLock lock(task_exited_mutex_);
@@ -44,6 +44,21 @@ class ThreadedIoFile : public File {
   bool Tell(uint64_t* position) override;
   /// @}
 
+  /// @return the wrapped file. It must not be accessed directly outside of
+  ///         BeginDirectAccess() and EndDirectAccess().
+  File* internal_file() { return internal_file_.get(); }
+
+  /// Suspends the background I/O, and positions the wrapped file at the
+  /// position of this file, so that the wrapped file can be accessed
+  /// directly, e.g. to copy data without going through the cache.
+  /// @return true if successful. EndDirectAccess() must be called before this
+  ///         file is used again, even if unsuccessful.
+  bool BeginDirectAccess();
+  /// Resumes the background I/O from the current position of the wrapped
+  /// file.
+  /// @return true if successful, or false otherwise.
+  bool EndDirectAccess();
+
  protected:
   ~ThreadedIoFile() override;
 
@@ -53,6 +68,8 @@ class ThreadedIoFile : public File {
   // Internal task handler implementation. Will dispatch to either
   // |RunInInputMode| or |RunInOutputMode| depending on |mode_|.
   void TaskHandler();
+  // Posts |TaskHandler| again after it has exited.
+  void RestartTask();
   void RunInInputMode();
   void RunInOutputMode();
   void WaitForSignal(absl::Mutex* mutex, bool* condition);
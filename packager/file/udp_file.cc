@@ -6,9 +6,12 @@
 
 #include <packager/file/udp_file.h>
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <limits>
 #include <memory>
+#include <vector>
 
 #if defined(OS_WIN)
 #include <ws2tcpip.h>
@@ -18,6 +21,8 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/time.h>
@@ -31,8 +36,13 @@
 #endif
 #endif  // defined(OS_WIN)
 
+#include <absl/flags/declare.h>
+#include <absl/flags/flag.h>
 #include <absl/log/check.h>
 #include <absl/log/log.h>
+#include <absl/synchronization/mutex.h>
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
 
 #include <packager/file.h>
 #include <packager/file/udp_options.h>
@@ -40,10 +50,21 @@
 #include <packager/macros/compiler.h>
 #include <packager/macros/logging.h>
 
+ABSL_DECLARE_FLAG(uint64_t, io_cache_size);
+
 namespace shaka {
 
 namespace {
 
+// How often the receive thread checks whether it should stop, in
+// microseconds.
+const int kReceiveThreadTimeoutUs = 100000;
+
+#if defined(__linux__)
+// Large enough for any UDP datagram.
+const size_t kMaxDatagramSize = 65536;
+#endif  // defined(__linux__)
+
 bool IsIpv4MulticastAddress(const struct in_addr& addr) {
   return (ntohl(addr.s_addr) & 0xf0000000) == 0xe0000000;
 }
@@ -56,18 +77,100 @@ int GetSocketErrorCode() {
 #endif
 }
 
+bool IsTimeoutError(int error_code) {
+#if defined(OS_WIN)
+  return error_code == WSAETIMEDOUT;
+#else
+  return error_code == EAGAIN || error_code == EWOULDBLOCK;
+#endif
+}
+
+bool SetReceiveTimeout(SOCKET socket, unsigned timeout_us) {
+  struct timeval tv;
+  tv.tv_sec = timeout_us / 1000000;
+  tv.tv_usec = timeout_us % 1000000;
+  if (setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO,
+                 reinterpret_cast<const char*>(&tv), sizeof(tv)) < 0) {
+    LOG(ERROR) << "Failed to set socket timeout, error = "
+               << GetSocketErrorCode();
+    return false;
+  }
+  return true;
+}
+
 }  // anonymous namespace
 
+#if defined(__linux__)
+// Buffers for recvmmsg(). Each datagram gets its own slot in |data|, and its
+// own control buffer for the timestamp and drop counter messages.
+struct UdpFile::ReceiveBatch {
+  explicit ReceiveBatch(int batch_size)
+      : data(batch_size * kMaxDatagramSize),
+        control(batch_size * kControlSize),
+        iovecs(batch_size),
+        messages(batch_size),
+        arrival_times_ns(batch_size) {
+    for (int i = 0; i < batch_size; ++i) {
+      iovecs[i].iov_base = &data[i * kMaxDatagramSize];
+      iovecs[i].iov_len = kMaxDatagramSize;
+      messages[i].msg_hdr.msg_iov = &iovecs[i];
+      messages[i].msg_hdr.msg_iovlen = 1;
+    }
+  }
+
+  // Room for a SCM_TIMESTAMPNS and a SO_RXQ_OVFL message.
+  static constexpr size_t kControlSize =
+      CMSG_SPACE(sizeof(struct timespec)) + CMSG_SPACE(sizeof(uint32_t));
+
+  std::vector<uint8_t> data;
+  std::vector<uint8_t> control;
+  std::vector<struct iovec> iovecs;
+  std::vector<struct mmsghdr> messages;
+  // Kernel arrival time of each datagram, 0 if not available.
+  std::vector<int64_t> arrival_times_ns;
+  // Number of datagrams received in the batch.
+  int num_datagrams = 0;
+  // Index of the next datagram to read.
+  int next_datagram = 0;
+  // Last value of the drop counter of the socket.
+  uint32_t drop_count = 0;
+};
+#else
+struct UdpFile::ReceiveBatch {};
+#endif  // defined(__linux__)
+
 UdpFile::UdpFile(const char* file_name)
     : File(file_name), socket_(INVALID_SOCKET) {}
 
 UdpFile::~UdpFile() {}
 
 bool UdpFile::Close() {
+  if (receive_thread_) {
+    {
+      absl::MutexLock lock(mutex_);
+      receive_stopped_ = true;
+    }
+    receive_thread_->join();
+    receive_thread_.reset();
+  }
   if (socket_ != INVALID_SOCKET) {
     close(socket_);
     socket_ = INVALID_SOCKET;
   }
+  const Stats final_stats = stats();
+  LOG_IF(WARNING, final_stats.datagrams_dropped > 0)
+      << "UDP stream " << file_name() << " dropped "
+      << final_stats.datagrams_dropped << " datagrams in " << final_stats.gaps
+      << " gaps. Consider increasing buffer_size in the UDP options.";
+  LOG_IF(WARNING, final_stats.datagrams_discarded > 0)
+      << "UDP stream " << file_name() << " discarded "
+      << final_stats.datagrams_discarded << " datagrams ("
+      << final_stats.bytes_discarded
+      << " bytes) from the jitter buffer. Consider increasing "
+         "jitter_buffer_ms in the UDP options.";
+  VLOG(1) << "UDP stream " << file_name() << " received "
+          << final_stats.datagrams_received << " datagrams, "
+          << final_stats.bytes_received << " bytes.";
   delete this;
 #if defined(OS_WIN)
   if (wsa_started_)
@@ -84,15 +187,241 @@ int64_t UdpFile::Read(void* buffer, uint64_t length) {
   if (socket_ == INVALID_SOCKET)
     return -1;
 
+  if (receive_thread_)
+    return ReadFromJitterBuffer(buffer, length);
+
+#if defined(__linux__)
+  if (batch_) {
+    if (batch_->next_datagram == batch_->num_datagrams &&
+        ReceiveNextBatch() < 0) {
+      return -1;
+    }
+
+    // Copy as many whole datagrams as fit in |buffer|.
+    uint8_t* output = static_cast<uint8_t*>(buffer);
+    uint64_t bytes_read = 0;
+    while (batch_->next_datagram < batch_->num_datagrams) {
+      const int index = batch_->next_datagram;
+      uint64_t size = batch_->messages[index].msg_len;
+      if (bytes_read + size > length) {
+        if (bytes_read > 0)
+          break;
+        LOG(ERROR) << "Buffer too small to read entire datagram, truncating.";
+        size = length;
+      }
+      memcpy(output + bytes_read, batch_->iovecs[index].iov_base, size);
+      bytes_read += size;
+      ++batch_->next_datagram;
+    }
+    return bytes_read;
+  }
+#endif  // defined(__linux__)
+
   int64_t result;
   do {
     result = recvfrom(socket_, reinterpret_cast<char*>(buffer),
                       static_cast<int>(length), 0, NULL, 0);
   } while (result == -1 && GetSocketErrorCode() == EINTR_CODE);
 
+  if (result > 0) {
+    absl::MutexLock lock(mutex_);
+    ++stats_.datagrams_received;
+    stats_.bytes_received += result;
+  }
   return result;
 }
 
+UdpFile::Stats UdpFile::stats() {
+  absl::MutexLock lock(mutex_);
+  return stats_;
+}
+
+int64_t UdpFile::ReadFromJitterBuffer(void* buffer, uint64_t length) {
+  absl::MutexLock lock(mutex_);
+  const absl::Time deadline =
+      read_timeout_us_ ? absl::Now() + absl::Microseconds(read_timeout_us_)
+                       : absl::InfiniteFuture();
+  while (jitter_buffer_.empty() && !receive_stopped_) {
+    if (data_available_.WaitWithDeadline(&mutex_, deadline) &&
+        jitter_buffer_.empty()) {
+      // Timed out, like a read from the socket would.
+      return -1;
+    }
+  }
+  if (jitter_buffer_.empty())
+    return -1;
+
+  // Copy as many whole datagrams as fit in |buffer|.
+  uint8_t* output = static_cast<uint8_t*>(buffer);
+  uint64_t bytes_read = 0;
+  while (!jitter_buffer_.empty()) {
+    const std::vector<uint8_t>& data = jitter_buffer_.front().data;
+    uint64_t size = data.size();
+    if (bytes_read + size > length) {
+      if (bytes_read > 0)
+        break;
+      LOG(ERROR) << "Buffer too small to read entire datagram, truncating.";
+      size = length;
+    }
+    memcpy(output + bytes_read, data.data(), size);
+    bytes_read += size;
+    jitter_buffer_bytes_ -= data.size();
+    jitter_buffer_.pop_front();
+  }
+  return bytes_read;
+}
+
+void UdpFile::AddToJitterBuffer(const uint8_t* data,
+                                size_t size,
+                                int64_t arrival_time_ns) {
+  jitter_buffer_.push_back(
+      Datagram{arrival_time_ns, std::vector<uint8_t>(data, data + size)});
+  jitter_buffer_bytes_ += size;
+
+  // Discard the oldest datagrams if the reader is too far behind. The stream
+  // then misses whole datagrams, i.e. whole TS packets, as it would if the
+  // kernel dropped them, but the loss is accounted for.
+  while (jitter_buffer_.size() > 1 &&
+         (arrival_time_ns - jitter_buffer_.front().arrival_time_ns >
+              jitter_buffer_duration_ns_ ||
+          (max_jitter_buffer_bytes_ > 0 &&
+           jitter_buffer_bytes_ > max_jitter_buffer_bytes_))) {
+    const size_t discarded_size = jitter_buffer_.front().data.size();
+    ++stats_.datagrams_discarded;
+    stats_.bytes_discarded += discarded_size;
+    jitter_buffer_bytes_ -= discarded_size;
+    jitter_buffer_.pop_front();
+  }
+}
+
+void UdpFile::ReceiveThreadMain() {
+#if defined(__linux__)
+  // Try to preempt the packaging threads, so that datagrams are picked up
+  // promptly even when the system is busy. This needs CAP_SYS_NICE.
+  struct sched_param param;
+  param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+  const int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+  if (error != 0) {
+    VLOG(1) << "Could not raise the priority of the UDP receive thread, "
+               "error = "
+            << error;
+  }
+#else
+  std::vector<uint8_t> datagram(65536);
+#endif  // defined(__linux__)
+
+  while (true) {
+    {
+      absl::MutexLock lock(mutex_);
+      if (receive_stopped_)
+        return;
+    }
+
+#if defined(__linux__)
+    const int result = ReceiveNextBatch();
+#else
+    int result;
+    do {
+      result = recvfrom(socket_, reinterpret_cast<char*>(datagram.data()),
+                        static_cast<int>(datagram.size()), 0, NULL, 0);
+    } while (result == -1 && GetSocketErrorCode() == EINTR_CODE);
+#endif  // defined(__linux__)
+    if (result < 0) {
+      // The socket times out regularly so that we can check for Close().
+      if (IsTimeoutError(GetSocketErrorCode()))
+        continue;
+      LOG(ERROR) << "Failed to receive from " << file_name()
+                 << ", error = " << GetSocketErrorCode();
+      absl::MutexLock lock(mutex_);
+      receive_stopped_ = true;
+      data_available_.Signal();
+      return;
+    }
+
+    const int64_t now_ns = absl::ToUnixNanos(absl::Now());
+    absl::MutexLock lock(mutex_);
+#if defined(__linux__)
+    for (int i = 0; i < batch_->num_datagrams; ++i) {
+      const int64_t arrival_time_ns = batch_->arrival_times_ns[i]
+                                          ? batch_->arrival_times_ns[i]
+                                          : now_ns;
+      AddToJitterBuffer(
+          static_cast<const uint8_t*>(batch_->iovecs[i].iov_base),
+          batch_->messages[i].msg_len, arrival_time_ns);
+    }
+    batch_->next_datagram = batch_->num_datagrams;
+#else
+    ++stats_.datagrams_received;
+    stats_.bytes_received += result;
+    AddToJitterBuffer(datagram.data(), result, now_ns);
+#endif  // defined(__linux__)
+    data_available_.Signal();
+  }
+}
+
+int UdpFile::ReceiveNextBatch() {
+#if defined(__linux__)
+  DCHECK(batch_);
+  const int batch_size = static_cast<int>(batch_->messages.size());
+  for (int i = 0; i < batch_size; ++i) {
+    struct msghdr& header = batch_->messages[i].msg_hdr;
+    header.msg_control = &batch_->control[i * ReceiveBatch::kControlSize];
+    header.msg_controllen = ReceiveBatch::kControlSize;
+    header.msg_flags = 0;
+  }
+
+  // Wait for the first datagram only, then take whatever else is queued.
+  int result;
+  do {
+    result = recvmmsg(socket_, batch_->messages.data(), batch_size,
+                      MSG_WAITFORONE, NULL);
+  } while (result == -1 && GetSocketErrorCode() == EINTR_CODE);
+
+  batch_->next_datagram = 0;
+  batch_->num_datagrams = std::max(result, 0);
+
+  absl::MutexLock lock(mutex_);
+  for (int i = 0; i < batch_->num_datagrams; ++i) {
+    struct msghdr& header = batch_->messages[i].msg_hdr;
+    batch_->arrival_times_ns[i] = 0;
+    ++stats_.datagrams_received;
+    stats_.bytes_received += batch_->messages[i].msg_len;
+    if (header.msg_flags & MSG_TRUNC)
+      LOG(ERROR) << "Truncated datagram received from " << file_name();
+
+    for (struct cmsghdr* message = CMSG_FIRSTHDR(&header); message;
+         message = CMSG_NXTHDR(&header, message)) {
+      if (message->cmsg_level != SOL_SOCKET)
+        continue;
+      if (message->cmsg_type == SCM_TIMESTAMPNS) {
+        struct timespec arrival_time;
+        memcpy(&arrival_time, CMSG_DATA(message), sizeof(arrival_time));
+        batch_->arrival_times_ns[i] =
+            static_cast<int64_t>(arrival_time.tv_sec) * 1000000000 +
+            arrival_time.tv_nsec;
+        stats_.last_arrival_time_ns = batch_->arrival_times_ns[i];
+      } else if (message->cmsg_type == SO_RXQ_OVFL) {
+        // Number of datagrams dropped by the socket since it was created.
+        uint32_t drop_count;
+        memcpy(&drop_count, CMSG_DATA(message), sizeof(drop_count));
+        if (drop_count != batch_->drop_count) {
+          const uint32_t dropped = drop_count - batch_->drop_count;
+          VLOG(1) << "UDP stream " << file_name() << " dropped " << dropped
+                  << " datagrams.";
+          stats_.datagrams_dropped += dropped;
+          ++stats_.gaps;
+          batch_->drop_count = drop_count;
+        }
+      }
+    }
+  }
+  return result;
+#else
+  // Datagrams are only received in batches on Linux.
+  return -1;
+#endif  // defined(__linux__)
+}
+
 int64_t UdpFile::Write(const void* buffer, uint64_t length) {
   UNUSED(buffer);
   UNUSED(length);
@@ -279,17 +608,15 @@ bool UdpFile::Open() {
 #endif  // #if defined(__linux__)
   }
 
-  // Set timeout if needed.
-  if (options->timeout_us() != 0) {
-    struct timeval tv;
-    tv.tv_sec = options->timeout_us() / 1000000;
-    tv.tv_usec = options->timeout_us() % 1000000;
-    if (setsockopt(new_socket.get(), SOL_SOCKET, SO_RCVTIMEO,
-                   reinterpret_cast<const char*>(&tv), sizeof(tv)) < 0) {
-      LOG(ERROR) << "Failed to set socket timeout, error = "
-                 << GetSocketErrorCode();
+  // Set timeout if needed. With a receive thread, the timeout applies to
+  // reading from the jitter buffer instead.
+  const bool use_receive_thread = options->jitter_buffer_ms() > 0;
+  if (use_receive_thread) {
+    if (!SetReceiveTimeout(new_socket.get(), kReceiveThreadTimeoutUs))
+      return false;
+  } else if (options->timeout_us() != 0) {
+    if (!SetReceiveTimeout(new_socket.get(), options->timeout_us()))
       return false;
-    }
   }
 
   if (options->buffer_size() > 0) {
@@ -303,7 +630,43 @@ bool UdpFile::Open() {
     }
   }
 
+#if defined(__linux__)
+  if (options->timestamps()) {
+    const int optval = 1;
+    if (setsockopt(new_socket.get(), SOL_SOCKET, SO_TIMESTAMPNS, &optval,
+                   sizeof(optval)) < 0) {
+      LOG(ERROR) << "Failed to enable SO_TIMESTAMPNS, error = "
+                 << GetSocketErrorCode();
+      return false;
+    }
+  }
+
+  // The receive thread always receives into a batch, even of one datagram.
+  if (options->batch_size() > 1 || options->timestamps() ||
+      use_receive_thread) {
+    // Report the datagrams dropped by the socket. Not fatal, since it only
+    // serves diagnostics.
+    const int optval = 1;
+    if (setsockopt(new_socket.get(), SOL_SOCKET, SO_RXQ_OVFL, &optval,
+                   sizeof(optval)) < 0) {
+      LOG(WARNING) << "Failed to enable SO_RXQ_OVFL, error = "
+                   << GetSocketErrorCode();
+    }
+    batch_.reset(new ReceiveBatch(options->batch_size()));
+  }
+#endif  // defined(__linux__)
+
   socket_ = new_socket.release();
+
+  if (use_receive_thread) {
+    jitter_buffer_duration_ns_ =
+        static_cast<int64_t>(options->jitter_buffer_ms()) * 1000000;
+    // Bound the memory used too, in case of a very high bitrate.
+    max_jitter_buffer_bytes_ = absl::GetFlag(FLAGS_io_cache_size);
+    read_timeout_us_ = options->timeout_us();
+    receive_thread_.reset(
+        new std::thread(&UdpFile::ReceiveThreadMain, this));
+  }
   return true;
 }
 
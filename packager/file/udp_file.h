@@ -8,6 +8,10 @@
 #define MEDIA_FILE_UDP_FILE_H_
 
 #include <cstdint>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
 
 #if defined(OS_WIN)
 #include <windows.h>
@@ -16,14 +20,41 @@
 typedef int SOCKET;
 #endif  // defined(OS_WIN)
 
+#include <absl/base/thread_annotations.h>
+#include <absl/synchronization/mutex.h>
+
 #include <packager/file.h>
 #include <packager/macros/classes.h>
 
 namespace shaka {
 
 /// Implements UdpFile, which receives UDP unicast and multicast streams.
+/// On Linux, datagrams are received in batches with a single system call, and
+/// Read() returns as many whole datagrams as fit in the buffer.
+/// If a jitter buffer is requested in the UDP options, datagrams are received
+/// on a dedicated thread as soon as they arrive, and kept in memory until they
+/// are read. The oldest datagrams are discarded when the reader falls behind
+/// by more than the jitter buffer duration.
 class UdpFile : public File {
  public:
+  /// Receive statistics.
+  struct Stats {
+    uint64_t datagrams_received = 0;
+    uint64_t bytes_received = 0;
+    /// Datagrams dropped by the kernel because the socket receive buffer was
+    /// full. Only available on Linux.
+    uint64_t datagrams_dropped = 0;
+    /// Number of times datagrams were dropped, i.e. gaps in the stream.
+    uint64_t gaps = 0;
+    /// Kernel arrival time of the last datagram received, in nanoseconds since
+    /// the epoch, if timestamps were requested in the UDP options. 0
+    /// otherwise.
+    int64_t last_arrival_time_ns = 0;
+    /// Datagrams discarded from the jitter buffer because it overflowed.
+    uint64_t datagrams_discarded = 0;
+    uint64_t bytes_discarded = 0;
+  };
+
   /// @param file_name C string containing the address of the stream to receive.
   ///        It should be of the form "<ip_address>:<port>".
   explicit UdpFile(const char* address_and_port);
@@ -40,13 +71,55 @@ class UdpFile : public File {
   bool Tell(uint64_t* position) override;
   /// @}
 
+  /// @return the receive statistics so far.
+  Stats stats();
+
  protected:
   ~UdpFile() override;
 
   bool Open() override;
 
  private:
+  struct ReceiveBatch;
+
+  struct Datagram {
+    // Arrival time in nanoseconds, from the kernel if timestamps were
+    // requested, or from the receive thread otherwise.
+    int64_t arrival_time_ns;
+    std::vector<uint8_t> data;
+  };
+
+  // Receives the next batch of datagrams. Returns the number of datagrams
+  // received, or -1 on error.
+  int ReceiveNextBatch();
+  // Receives datagrams into |jitter_buffer_| until Close().
+  void ReceiveThreadMain();
+  // Reads whole datagrams from |jitter_buffer_|.
+  int64_t ReadFromJitterBuffer(void* buffer, uint64_t length);
+  void AddToJitterBuffer(const uint8_t* data,
+                         size_t size,
+                         int64_t arrival_time_ns)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   SOCKET socket_;
+  // Datagrams received but not read yet. Only used on Linux.
+  std::unique_ptr<ReceiveBatch> batch_;
+
+  absl::Mutex mutex_;
+  Stats stats_ ABSL_GUARDED_BY(mutex_);
+
+  // Receive thread and jitter buffer, only used if a jitter buffer duration
+  // is set in the UDP options.
+  std::unique_ptr<std::thread> receive_thread_;
+  int64_t jitter_buffer_duration_ns_ = 0;
+  uint64_t max_jitter_buffer_bytes_ = 0;
+  // Read() timeout in microseconds, 0 for no timeout.
+  unsigned read_timeout_us_ = 0;
+  absl::CondVar data_available_ ABSL_GUARDED_BY(mutex_);
+  std::deque<Datagram> jitter_buffer_ ABSL_GUARDED_BY(mutex_);
+  uint64_t jitter_buffer_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Set to stop the receive thread, or by the receive thread on error.
+  bool receive_stopped_ ABSL_GUARDED_BY(mutex_) = false;
 #if defined(OS_WIN)
   // For Winsock in Windows.
   bool wsa_started_ = false;
@@ -0,0 +1,126 @@
+// Copyright 2024 Google LLC. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <packager/file/udp_file.h>
+
+#if !defined(OS_WIN)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif  // !defined(OS_WIN)
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <packager/file.h>
+#include <packager/file/file_closer.h>
+
+namespace shaka {
+
+// The datagrams are sent with POSIX sockets.
+#if !defined(OS_WIN)
+
+namespace {
+
+// A random port is chosen to receive on, and if it is in use, we try again up
+// to |kMaxPortTries| times.
+const int kMinPortNumber = 47000;
+const int kMaxPortNumber = 47999;
+const int kMaxPortTries = 10;
+const size_t kReadBufferSize = 65536;
+
+using FilePtr = std::unique_ptr<File, FileCloser>;
+
+}  // namespace
+
+class UdpFileTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    sender_ = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(sender_, 0);
+  }
+
+  void TearDown() override { close(sender_); }
+
+  // Opens a file receiving on a random local port with the UDP |options|.
+  bool Open(const std::string& options) {
+    std::random_device random_device;
+    std::uniform_int_distribution<int> port_distribution(kMinPortNumber,
+                                                         kMaxPortNumber);
+    for (int i = 0; i < kMaxPortTries && !file_; ++i) {
+      port_ = port_distribution(random_device);
+      const std::string file_name =
+          "udp://127.0.0.1:" + std::to_string(port_) + "?" + options;
+      file_.reset(File::Open(file_name.c_str(), "r"));
+    }
+    return file_ != nullptr;
+  }
+
+  bool Send(const std::string& datagram) {
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port_));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return sendto(sender_, datagram.data(), datagram.size(), 0,
+                  reinterpret_cast<struct sockaddr*>(&address),
+                  sizeof(address)) == static_cast<ssize_t>(datagram.size());
+  }
+
+  // Reads until |size| bytes have been read, or a read fails. A read may
+  // return several datagrams.
+  std::string Read(size_t size) {
+    std::string data;
+    std::vector<char> buffer(kReadBufferSize);
+    while (data.size() < size) {
+      const int64_t bytes_read = file_->Read(buffer.data(), buffer.size());
+      if (bytes_read <= 0)
+        break;
+      data.append(buffer.data(), bytes_read);
+    }
+    return data;
+  }
+
+  int sender_ = -1;
+  int port_ = 0;
+  FilePtr file_;
+};
+
+TEST_F(UdpFileTest, Read) {
+  ASSERT_TRUE(Open("timeout=1000000"));
+  ASSERT_TRUE(Send("abcd"));
+  EXPECT_EQ("abcd", Read(4));
+}
+
+TEST_F(UdpFileTest, ReadFromJitterBuffer) {
+  // Datagrams are received one at a time.
+  ASSERT_TRUE(Open("jitter_buffer_ms=50&batch_size=1&timeout=1000000"));
+  ASSERT_TRUE(Send("abcd"));
+  ASSERT_TRUE(Send("efgh"));
+  EXPECT_EQ("abcdefgh", Read(8));
+}
+
+TEST_F(UdpFileTest, ReadFromJitterBufferInBatches) {
+  ASSERT_TRUE(Open("jitter_buffer_ms=50&batch_size=4&timeout=1000000"));
+  ASSERT_TRUE(Send("abcd"));
+  ASSERT_TRUE(Send("efgh"));
+  EXPECT_EQ("abcdefgh", Read(8));
+}
+
+TEST_F(UdpFileTest, ReadTimesOutWithJitterBuffer) {
+  ASSERT_TRUE(Open("jitter_buffer_ms=50&timeout=100000"));
+  std::vector<char> buffer(kReadBufferSize);
+  EXPECT_LT(file_->Read(buffer.data(), buffer.size()), 0);
+}
+
+#endif  // !defined(OS_WIN)
+
+}  // namespace shaka
@@ -33,11 +33,14 @@ namespace {
 
 enum FieldType {
   kUnknownField = 0,
+  kBatchSizeField,
   kBufferSizeField,
   kInterfaceAddressField,
+  kJitterBufferField,
   kMulticastSourceField,
   kReuseField,
   kTimeoutField,
+  kTimestampsField,
 };
 
 struct FieldNameToTypeMapping {
@@ -46,11 +49,14 @@ struct FieldNameToTypeMapping {
 };
 
 const FieldNameToTypeMapping kFieldNameTypeMappings[] = {
+    {"batch_size", kBatchSizeField},
     {"buffer_size", kBufferSizeField},
     {"interface", kInterfaceAddressField},
+    {"jitter_buffer_ms", kJitterBufferField},
     {"reuse", kReuseField},
     {"source", kMulticastSourceField},
     {"timeout", kTimeoutField},
+    {"timestamps", kTimestampsField},
 };
 
 FieldType GetFieldType(const std::string& field_name) {
@@ -99,6 +105,14 @@ std::unique_ptr<UdpOptions> UdpOptions::ParseFromString(
 
     for (const auto& pair : kv_pairs) {
       switch (GetFieldType(pair.first)) {
+        case kBatchSizeField:
+          if (!absl::SimpleAtoi(pair.second, &options->batch_size_) ||
+              options->batch_size_ < 1) {
+            LOG(ERROR) << "Invalid udp option for batch_size field "
+                       << pair.second;
+            return nullptr;
+          }
+          break;
         case kBufferSizeField:
           if (!absl::SimpleAtoi(pair.second, &options->buffer_size_)) {
             LOG(ERROR) << "Invalid udp option for buffer_size field "
@@ -109,6 +123,14 @@ std::unique_ptr<UdpOptions> UdpOptions::ParseFromString(
         case kInterfaceAddressField:
           options->interface_address_ = pair.second;
           break;
+        case kJitterBufferField:
+          if (!absl::SimpleAtoi(pair.second, &options->jitter_buffer_ms_) ||
+              options->jitter_buffer_ms_ < 0) {
+            LOG(ERROR) << "Invalid udp option for jitter_buffer_ms field "
+                       << pair.second;
+            return nullptr;
+          }
+          break;
         case kMulticastSourceField:
           options->source_address_ = pair.second;
           options->is_source_specific_multicast_ = true;
@@ -129,6 +151,16 @@ std::unique_ptr<UdpOptions> UdpOptions::ParseFromString(
             return nullptr;
           }
           break;
+        case kTimestampsField: {
+          int timestamps_value = 0;
+          if (!absl::SimpleAtoi(pair.second, &timestamps_value)) {
+            LOG(ERROR) << "Invalid udp option for timestamps field "
+                       << pair.second;
+            return nullptr;
+          }
+          options->timestamps_ = timestamps_value > 0;
+          break;
+        }
         default:
           LOG(ERROR) << "Unknown field in udp options (\"" << pair.first
                      << "\").";
@@ -31,6 +31,9 @@ class UdpOptions {
     return is_source_specific_multicast_;
   }
   int buffer_size() const { return buffer_size_; }
+  int batch_size() const { return batch_size_; }
+  bool timestamps() const { return timestamps_; }
+  int jitter_buffer_ms() const { return jitter_buffer_ms_; }
 
  private:
   UdpOptions() = default;
@@ -52,6 +55,16 @@ class UdpOptions {
   // by the underlying operating system ('sysctl net.core.rmem_max' on Linux
   // returns the maximum receive memory size).
   int buffer_size_ = 0;
+  // Maximum number of datagrams received with a single system call. Only
+  // effective on Linux.
+  int batch_size_ = 32;
+  // Request kernel arrival timestamps for received datagrams. Only effective
+  // on Linux.
+  bool timestamps_ = false;
+  // Duration of the jitter buffer in milliseconds. If not 0, datagrams are
+  // received on a dedicated thread and buffered in memory for up to this
+  // duration.
+  int jitter_buffer_ms_ = 0;
 };
 
 }  // namespace shaka
@@ -39,6 +39,9 @@ TEST_F(UdpOptionsTest, AddressAndPort) {
   EXPECT_EQ(0u, options->timeout_us());
   EXPECT_FALSE(options->is_source_specific_multicast());
   EXPECT_EQ("0.0.0.0", options->source_address());
+  EXPECT_EQ(32, options->batch_size());
+  EXPECT_FALSE(options->timestamps());
+  EXPECT_EQ(0, options->jitter_buffer_ms());
 }
 
 TEST_F(UdpOptionsTest, MissingPort) {
@@ -132,4 +135,39 @@ TEST_F(UdpOptionsTest, BufferSize) {
   EXPECT_EQ(1234, options->buffer_size());
 }
 
+TEST_F(UdpOptionsTest, BatchSize) {
+  auto options = UdpOptions::ParseFromString("224.1.2.30:88?batch_size=64");
+  ASSERT_TRUE(options);
+  EXPECT_EQ(64, options->batch_size());
+}
+
+TEST_F(UdpOptionsTest, InvalidBatchSize) {
+  ASSERT_FALSE(UdpOptions::ParseFromString("224.1.2.30:88?batch_size=0"));
+  ASSERT_FALSE(UdpOptions::ParseFromString("224.1.2.30:88?batch_size=a"));
+}
+
+TEST_F(UdpOptionsTest, Timestamps) {
+  auto options = UdpOptions::ParseFromString("224.1.2.30:88?timestamps=1");
+  ASSERT_TRUE(options);
+  EXPECT_TRUE(options->timestamps());
+}
+
+TEST_F(UdpOptionsTest, InvalidTimestamps) {
+  ASSERT_FALSE(UdpOptions::ParseFromString("224.1.2.30:88?timestamps=yes"));
+}
+
+TEST_F(UdpOptionsTest, JitterBuffer) {
+  auto options =
+      UdpOptions::ParseFromString("224.1.2.30:88?jitter_buffer_ms=500");
+  ASSERT_TRUE(options);
+  EXPECT_EQ(500, options->jitter_buffer_ms());
+}
+
+TEST_F(UdpOptionsTest, InvalidJitterBuffer) {
+  ASSERT_FALSE(
+      UdpOptions::ParseFromString("224.1.2.30:88?jitter_buffer_ms=-1"));
+  ASSERT_FALSE(
+      UdpOptions::ParseFromString("224.1.2.30:88?jitter_buffer_ms=1s"));
+}
+
 }  // namespace shaka
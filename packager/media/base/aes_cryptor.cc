@@ -71,6 +71,20 @@ bool AesCryptor::Crypt(const std::string& text, std::string* crypt_text) {
   return true;
 }
 
+bool AesCryptor::CryptBatch(const std::vector<CryptJob>& jobs) {
+  if (constant_iv_flag_ == kUseConstantIv) {
+    // Every job starts over with the constant iv.
+    for (const CryptJob& job : jobs) {
+      if (!Crypt(job.text, job.text_size, job.crypt_text))
+        return false;
+    }
+    return true;
+  }
+  for (const CryptJob& job : jobs)
+    num_crypt_bytes_ += job.text_size;
+  return CryptBatchInternal(jobs);
+}
+
 bool AesCryptor::SetIv(const std::vector<uint8_t>& iv) {
   if (!IsIvSizeValid(iv.size())) {
     LOG(ERROR) << "Invalid IV size: " << iv.size();
@@ -135,6 +149,17 @@ bool AesCryptor::GenerateRandomIv(FourCC protection_scheme,
   return true;
 }
 
+bool AesCryptor::CryptBatchInternal(const std::vector<CryptJob>& jobs) {
+  for (const CryptJob& job : jobs) {
+    size_t crypt_text_size = job.text_size;
+    if (!CryptInternal(job.text, job.text_size, job.crypt_text,
+                       &crypt_text_size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 size_t AesCryptor::NumPaddingBytes(size_t size) const {
   // No padding by default.
   UNUSED(size);
@@ -145,19 +170,19 @@ bool AesCryptor::SetupCipher(size_t key_size, CipherMode mode) {
   mbedtls_cipher_type_t type;
 
   // AES defines three key sizes: 128, 192 and 256 bits.
-  // NOTE: Because we use ECB mode in the CTR cryptors, this returns ECB
-  // instead of CTR.  Counters and block offsets are managed internally.
+  // NOTE: The CTR cryptors only use CTR mode to generate the key stream.
+  // Counters and block offsets are managed internally.
   switch (key_size) {
     case 16:
-      type = mode == kCtrMode ? MBEDTLS_CIPHER_AES_128_ECB
+      type = mode == kCtrMode ? MBEDTLS_CIPHER_AES_128_CTR
                               : MBEDTLS_CIPHER_AES_128_CBC;
       break;
     case 24:
-      type = mode == kCtrMode ? MBEDTLS_CIPHER_AES_192_ECB
+      type = mode == kCtrMode ? MBEDTLS_CIPHER_AES_192_CTR
                               : MBEDTLS_CIPHER_AES_192_CBC;
       break;
     case 32:
-      type = mode == kCtrMode ? MBEDTLS_CIPHER_AES_256_ECB
+      type = mode == kCtrMode ? MBEDTLS_CIPHER_AES_256_CTR
                               : MBEDTLS_CIPHER_AES_256_CBC;
       break;
     default:
@@ -29,6 +29,15 @@ class AesCryptor {
     kDontUseConstantIv,
   };
 
+  /// A job for CryptBatch.
+  struct CryptJob {
+    const uint8_t* text;
+    size_t text_size;
+    /// Should have at least @a text_size bytes. It can be the same address as
+    /// @a text for in place encryption/decryption.
+    uint8_t* crypt_text;
+  };
+
   /// @param constant_iv_flag indicates whether a constant iv is used,
   ///        kUseConstantIv means that the same iv is used for all Crypt calls
   ///        until iv is changed via SetIv; otherwise, iv can be incremented
@@ -72,6 +81,13 @@ class AesCryptor {
   }
   /// @}
 
+  /// Crypts @a jobs as consecutive Crypt calls would, e.g. the encrypted
+  /// ranges of a sample. Cryptors may process the jobs together, which is
+  /// faster than a Crypt call per job. Only for cryptors that do not pad,
+  /// i.e. with crypt text as large as the text.
+  /// @return true on success, false otherwise.
+  bool CryptBatch(const std::vector<CryptJob>& jobs);
+
   /// Set IV. SetIv() implementation guarantees that the iv passed to SetIv()
   /// is set to iv() and then calls SetIvInternal().
   /// @return true if successful, false if the input is invalid.
@@ -122,6 +138,10 @@ class AesCryptor {
                              uint8_t* crypt_text,
                              size_t* crypt_text_size) = 0;
 
+  // Internal implementation of CryptBatch for cryptors that do not use a
+  // constant iv. The default implementation calls CryptInternal for each job.
+  virtual bool CryptBatchInternal(const std::vector<CryptJob>& jobs);
+
   // Internal implementation of SetIv, which setup internal iv.
   virtual void SetIvInternal() = 0;
 
@@ -258,6 +258,32 @@ TEST_P(AesCtrEncryptorSubsampleTest, NistTestCaseSubsamples) {
   EXPECT_EQ(plaintext_, decrypted);
 }
 
+TEST_P(AesCtrEncryptorSubsampleTest, NistTestCaseSubsamplesInBatch) {
+  const SubsampleTestCase* test_case = &GetParam();
+
+  std::vector<uint8_t> encrypted(plaintext_.size(), 0);
+  std::vector<AesCryptor::CryptJob> encrypt_jobs;
+  for (uint32_t i = 0, offset = 0; i < test_case->subsample_count; ++i) {
+    uint32_t len = test_case->subsample_sizes[i];
+    encrypt_jobs.push_back({&plaintext_[offset], len, &encrypted[offset]});
+    offset += len;
+  }
+  ASSERT_TRUE(encryptor_.CryptBatch(encrypt_jobs));
+  EXPECT_EQ(ciphertext_, encrypted);
+  EXPECT_EQ(plaintext_.size() % kAesBlockSize, encryptor_.block_offset());
+
+  // In place decryption.
+  ASSERT_TRUE(decryptor_.SetIv(iv_));
+  std::vector<AesCryptor::CryptJob> decrypt_jobs;
+  for (uint32_t i = 0, offset = 0; i < test_case->subsample_count; ++i) {
+    uint32_t len = test_case->subsample_sizes[i];
+    decrypt_jobs.push_back({&encrypted[offset], len, &encrypted[offset]});
+    offset += len;
+  }
+  ASSERT_TRUE(decryptor_.CryptBatch(decrypt_jobs));
+  EXPECT_EQ(plaintext_, encrypted);
+}
+
 namespace {
 const SubsampleTestCase kSubsampleTestCases[] = {
     {kSubsampleTest1, std::size(kSubsampleTest1)},
@@ -547,6 +573,38 @@ TEST_F(AesCbcTest, NoPaddingChainAcrossCalls) {
   EXPECT_EQ(plaintext, decrypted);
 }
 
+TEST_F(AesCbcTest, CryptBatchMatchesCryptCalls) {
+  std::vector<uint8_t> plaintext(kAesCtrPlaintext,
+                                 kAesCtrPlaintext + std::size(kAesCtrPlaintext));
+  // The second job ends with a residual block, which is left in the clear.
+  const size_t kFirstJobSize = 2 * kAesBlockSize;
+  const size_t kSecondJobSize = plaintext.size() - kFirstJobSize - 3;
+
+  for (AesCryptor::ConstantIvFlag constant_iv_flag :
+       {AesCryptor::kUseConstantIv, AesCryptor::kDontUseConstantIv}) {
+    AesCbcEncryptor encryptor(kNoPadding, constant_iv_flag);
+    ASSERT_TRUE(encryptor.InitializeWithIv(key_, iv_));
+    std::vector<uint8_t> expected(plaintext);
+    ASSERT_TRUE(
+        encryptor.Crypt(plaintext.data(), kFirstJobSize, expected.data()));
+    ASSERT_TRUE(encryptor.Crypt(plaintext.data() + kFirstJobSize,
+                                kSecondJobSize,
+                                expected.data() + kFirstJobSize));
+    encryptor.UpdateIv();
+    const std::vector<uint8_t> expected_next_iv = encryptor.iv();
+
+    ASSERT_TRUE(encryptor.SetIv(iv_));
+    std::vector<uint8_t> encrypted(plaintext);
+    ASSERT_TRUE(encryptor.CryptBatch(
+        {{plaintext.data(), kFirstJobSize, encrypted.data()},
+         {plaintext.data() + kFirstJobSize, kSecondJobSize,
+          encrypted.data() + kFirstJobSize}}));
+    EXPECT_EQ(expected, encrypted);
+    encryptor.UpdateIv();
+    EXPECT_EQ(expected_next_iv, encryptor.iv());
+  }
+}
+
 TEST_F(AesCbcTest, UnsupportedKeySize) {
   EXPECT_FALSE(encryptor_->InitializeWithIv(std::vector<uint8_t>(15, 0), iv_));
   EXPECT_FALSE(decryptor_->InitializeWithIv(std::vector<uint8_t>(15, 0), iv_));
@@ -696,5 +754,20 @@ TEST_F(AesPerformanceTest, AesCtr) {
     ASSERT_TRUE(ctr_encryptor_.Crypt(plaintext_, &encrypted));
 }
 
+TEST_F(AesPerformanceTest, AesCtrBatch) {
+  ASSERT_TRUE(ctr_encryptor_.InitializeWithIv(key_, iv_));
+  // Subsample-like jobs with clear gaps in between.
+  const size_t kJobSize = 0x1000;
+  const size_t kGapSize = 0x100;
+  std::vector<uint8_t> encrypted(plaintext_.size());
+  std::vector<AesCryptor::CryptJob> jobs;
+  for (size_t offset = 0; offset + kJobSize <= plaintext_.size();
+       offset += kJobSize + kGapSize) {
+    jobs.push_back({&plaintext_[offset], kJobSize, &encrypted[offset]});
+  }
+  for (int i = 0; i < 0x100; i++)
+    ASSERT_TRUE(ctr_encryptor_.CryptBatch(jobs));
+}
+
 }  // namespace media
 }  // namespace shaka
@@ -6,6 +6,7 @@
 
 #include <packager/media/base/aes_encryptor.h>
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
@@ -20,14 +21,30 @@
 
 namespace {
 
-// Increment an 8-byte counter by 1. Return true if overflowed.
-bool Increment64(uint8_t* counter) {
-  DCHECK(counter);
+// Xors |size| bytes of |text| with |key_stream| into |crypt_text|, which can be
+// the same address as |text|.
+void XorKeyStream(const uint8_t* text,
+                  size_t size,
+                  const uint8_t* key_stream,
+                  uint8_t* crypt_text) {
+  for (size_t i = 0; i < size; ++i)
+    crypt_text[i] = text[i] ^ key_stream[i];
+}
+
+// Reads an 8-byte big endian integer.
+uint64_t ReadUint64(const uint8_t* data) {
+  uint64_t value = 0;
+  for (int i = 0; i < 8; ++i)
+    value = (value << 8) | data[i];
+  return value;
+}
+
+// Writes |value| as an 8-byte big endian integer.
+void WriteUint64(uint64_t value, uint8_t* data) {
   for (int i = 7; i >= 0; --i) {
-    if (++counter[i] != 0)
-      return false;
+    data[i] = static_cast<uint8_t>(value);
+    value >>= 8;
   }
-  return true;
 }
 
 }  // namespace
@@ -75,28 +92,86 @@ bool AesCtrEncryptor::CryptInternal(const uint8_t* plaintext,
   }
   *ciphertext_size = plaintext_size;
 
-  for (size_t i = 0; i < plaintext_size; ++i) {
-    if (block_offset_ == 0) {
-      size_t ignored_output_size;
-      CHECK_EQ(
-          mbedtls_cipher_crypt(&cipher_ctx_, /* iv= */ NULL, /* iv_len= */ 0,
-                               &counter_[0], AES_BLOCK_SIZE,
-                               &encrypted_counter_[0], &ignored_output_size),
-          0);
-
-      // As mentioned in ISO/IEC 23001-7:2016 CENC spec, of the 16 byte counter
-      // block, bytes 8 to 15 (i.e. the least significant bytes) are used as a
-      // simple 64 bit unsigned integer that is incremented by one for each
-      // subsequent block of sample data processed and is kept in network byte
-      // order.
-      Increment64(&counter_[8]);
-    }
-    ciphertext[i] = plaintext[i] ^ encrypted_counter_[block_offset_];
-    block_offset_ = (block_offset_ + 1) % AES_BLOCK_SIZE;
+  GenerateKeyStream(plaintext_size);
+  XorKeyStream(plaintext, plaintext_size, key_stream_.data(), ciphertext);
+  return true;
+}
+
+bool AesCtrEncryptor::CryptBatchInternal(const std::vector<CryptJob>& jobs) {
+  size_t total_size = 0;
+  for (const CryptJob& job : jobs)
+    total_size += job.text_size;
+
+  // Generating the key stream of all the jobs in one go keeps the AES rounds
+  // in a tight loop, apart from the xor passes over the jobs.
+  GenerateKeyStream(total_size);
+  const uint8_t* key_stream = key_stream_.data();
+  for (const CryptJob& job : jobs) {
+    DCHECK(job.text);
+    DCHECK(job.crypt_text);
+    XorKeyStream(job.text, job.text_size, key_stream, job.crypt_text);
+    key_stream += job.text_size;
   }
   return true;
 }
 
+void AesCtrEncryptor::GenerateKeyStream(size_t size) {
+  // The key stream is generated in whole blocks, so leave room for a partial
+  // last block.
+  if (key_stream_.size() < size + AES_BLOCK_SIZE)
+    key_stream_.resize(size + AES_BLOCK_SIZE);
+  uint8_t* key_stream = key_stream_.data();
+
+  // Use up the rest of the current encrypted counter first.
+  if (block_offset_ != 0) {
+    const size_t num_bytes =
+        std::min(size, static_cast<size_t>(AES_BLOCK_SIZE - block_offset_));
+    memcpy(key_stream, &encrypted_counter_[block_offset_], num_bytes);
+    key_stream += num_bytes;
+    size -= num_bytes;
+    block_offset_ = (block_offset_ + num_bytes) % AES_BLOCK_SIZE;
+  }
+  if (size == 0)
+    return;
+
+  // The key stream is the counter mode encryption of zeros, which takes a
+  // single call for all the blocks.
+  size_t num_blocks = (size + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE;
+  memset(key_stream, 0, num_blocks * AES_BLOCK_SIZE);
+  uint8_t* output = key_stream;
+  while (num_blocks > 0) {
+    // As mentioned in ISO/IEC 23001-7:2016 CENC spec, of the 16 byte counter
+    // block, bytes 8 to 15 (i.e. the least significant bytes) are used as a
+    // simple 64 bit unsigned integer that is incremented by one for each
+    // subsequent block of sample data processed and is kept in network byte
+    // order. mbedtls increments the whole 16 byte counter instead, so the
+    // blocks are split where the 64 bit integer wraps around.
+    const uint64_t counter = ReadUint64(&counter_[8]);
+    const uint64_t num_blocks_before_wraparound = 0 - counter;
+    const size_t num_blocks_to_crypt =
+        counter != 0 && num_blocks_before_wraparound < num_blocks
+            ? static_cast<size_t>(num_blocks_before_wraparound)
+            : num_blocks;
+    const size_t num_bytes_to_crypt = num_blocks_to_crypt * AES_BLOCK_SIZE;
+    size_t ignored_output_size;
+    CHECK_EQ(mbedtls_cipher_crypt(&cipher_ctx_, &counter_[0], AES_BLOCK_SIZE,
+                                  output, num_bytes_to_crypt, output,
+                                  &ignored_output_size),
+             0);
+    WriteUint64(counter + num_blocks_to_crypt, &counter_[8]);
+    output += num_bytes_to_crypt;
+    num_blocks -= num_blocks_to_crypt;
+  }
+
+  // Keep the partial last block for the next call.
+  const size_t partial_block_size = size % AES_BLOCK_SIZE;
+  if (partial_block_size != 0) {
+    memcpy(&encrypted_counter_[0], key_stream + size - partial_block_size,
+           AES_BLOCK_SIZE);
+    block_offset_ = static_cast<uint32_t>(partial_block_size);
+  }
+}
+
 void AesCtrEncryptor::SetIvInternal() {
   block_offset_ = 0;
   counter_ = iv();
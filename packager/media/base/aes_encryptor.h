@@ -37,14 +37,21 @@ class AesCtrEncryptor : public AesCryptor {
                      size_t plaintext_size,
                      uint8_t* ciphertext,
                      size_t* ciphertext_size) override;
+  bool CryptBatchInternal(const std::vector<CryptJob>& jobs) override;
   void SetIvInternal() override;
 
+  // Fills |key_stream_| with the next |size| bytes of the key stream.
+  void GenerateKeyStream(size_t size);
+
   // Current block offset.
   uint32_t block_offset_;
   // Current AES-CTR counter.
   std::vector<uint8_t> counter_;
   // Encrypted counter.
   std::vector<uint8_t> encrypted_counter_;
+  // Key stream of the text being crypted, generated for all the jobs of a
+  // batch at once. Reused across calls.
+  std::vector<uint8_t> key_stream_;
 
   DISALLOW_COPY_AND_ASSIGN(AesCtrEncryptor);
 };
@@ -59,6 +59,9 @@ bool AesPatternCryptor::CryptInternal(const uint8_t* text,
   }
   *crypt_text_size = text_size;
 
+  // The skipped blocks are copied right away, while the encrypted blocks are
+  // collected and crypted in one batch.
+  crypt_jobs_.clear();
   while (text_size > 0) {
     const size_t crypt_byte_size = crypt_byte_block_ * AES_BLOCK_SIZE;
 
@@ -71,8 +74,7 @@ bool AesPatternCryptor::CryptInternal(const uint8_t* text,
         // remains unencrypted.
         const size_t aligned_crypt_byte_size =
             text_size / AES_BLOCK_SIZE * AES_BLOCK_SIZE;
-        if (!cryptor_->Crypt(text, aligned_crypt_byte_size, crypt_text))
-          return false;
+        crypt_jobs_.push_back({text, aligned_crypt_byte_size, crypt_text});
         text += aligned_crypt_byte_size;
         text_size -= aligned_crypt_byte_size;
         crypt_text += aligned_crypt_byte_size;
@@ -80,11 +82,10 @@ bool AesPatternCryptor::CryptInternal(const uint8_t* text,
 
       // The remaining bytes are not encrypted.
       memcpy(crypt_text, text, text_size);
-      return true;
+      break;
     }
 
-    if (!cryptor_->Crypt(text, crypt_byte_size, crypt_text))
-      return false;
+    crypt_jobs_.push_back({text, crypt_byte_size, crypt_text});
     text += crypt_byte_size;
     text_size -= crypt_byte_size;
     crypt_text += crypt_byte_size;
@@ -96,7 +97,7 @@ bool AesPatternCryptor::CryptInternal(const uint8_t* text,
     text_size -= skip_byte_size;
     crypt_text += skip_byte_size;
   }
-  return true;
+  return cryptor_->CryptBatch(crypt_jobs_);
 }
 
 void AesPatternCryptor::SetIvInternal() {
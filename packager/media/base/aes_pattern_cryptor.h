@@ -74,6 +74,9 @@ class AesPatternCryptor : public AesCryptor {
   const uint8_t skip_byte_block_;
   const PatternEncryptionMode encryption_mode_;
   std::unique_ptr<AesCryptor> cryptor_;
+  // Encrypted blocks of the text being crypted, handed to |cryptor_| in one
+  // batch. Reused across calls.
+  std::vector<CryptJob> crypt_jobs_;
 
   DISALLOW_COPY_AND_ASSIGN(AesPatternCryptor);
 };
@@ -74,6 +74,12 @@ void BufferWriter::AppendBuffer(const BufferWriter& buffer) {
   buf_.insert(buf_.end(), buffer.buf_.begin(), buffer.buf_.end());
 }
 
+uint8_t* BufferWriter::AppendSpace(size_t size) {
+  const size_t old_size = buf_.size();
+  buf_.resize(old_size + size);
+  return buf_.data() + old_size;
+}
+
 Status BufferWriter::WriteToFile(File* file) {
   DCHECK(file);
   DCHECK(!buf_.empty());
@@ -54,6 +54,11 @@ class BufferWriter {
   void AppendString(const std::string& s);
   void AppendArray(const uint8_t* buf, size_t size);
   void AppendBuffer(const BufferWriter& buffer);
+  /// Append @a size bytes to be filled in by the caller, e.g. to write a
+  /// large table without appending it field by field.
+  /// @return a pointer to the appended bytes, which is valid until the buffer
+  ///         is modified again.
+  uint8_t* AppendSpace(size_t size);
 
   void Swap(BufferWriter* buffer) { buf_.swap(buffer->buf_); }
   void SwapBuffer(std::vector<uint8_t>* buffer) { buf_.swap(*buffer); }
@@ -62,6 +67,9 @@ class BufferWriter {
   size_t Size() const { return buf_.size(); }
   /// @return Underlying buffer. Behavior is undefined if the buffer size is 0.
   const uint8_t* Buffer() const { return buf_.data(); }
+  /// @return Underlying buffer, which may be modified in place. Behavior is
+  ///         undefined if the buffer size is 0.
+  uint8_t* MutableBuffer() { return buf_.data(); }
 
   /// Write the buffer to file. The internal buffer will be cleared after
   /// writing.
@@ -9,6 +9,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <iterator>
 #include <limits>
 #include <memory>
 #include <string>
@@ -171,6 +172,24 @@ TEST_F(BufferWriterTest, AppendBufferWriter) {
   ASSERT_NO_FATAL_FAILURE(ReadAndExpect(kuint32));
 }
 
+TEST_F(BufferWriterTest, AppendSpace) {
+  writer_->AppendInt(kuint16);
+  uint8_t* space = writer_->AppendSpace(sizeof(kuint8Array));
+  memcpy(space, kuint8Array, sizeof(kuint8Array));
+  writer_->AppendInt(kuint32);
+  ASSERT_EQ(sizeof(kuint16) + sizeof(kuint8Array) + sizeof(kuint32),
+            writer_->Size());
+
+  CreateReader();
+  ASSERT_NO_FATAL_FAILURE(ReadAndExpect(kuint16));
+  std::vector<uint8_t> data_read;
+  ASSERT_TRUE(reader_->ReadToVector(&data_read, sizeof(kuint8Array)));
+  EXPECT_EQ(std::vector<uint8_t>(std::begin(kuint8Array),
+                                 std::end(kuint8Array)),
+            data_read);
+  ASSERT_NO_FATAL_FAILURE(ReadAndExpect(kuint32));
+}
+
 TEST_F(BufferWriterTest, Swap) {
   BufferWriter local_writer;
   local_writer.AppendInt(kuint16);
@@ -11,6 +11,7 @@
 #include <cstring>
 #include <iterator>
 #include <string>
+#include <vector>
 
 #include <absl/log/check.h>
 #include <libxml/parser.h>
@@ -411,34 +412,92 @@ static bool CheckGsm(const uint8_t* buffer, int buffer_size) {
   return true;
 }
 
+// Finds every offset in |buffer| where a start code beginning with 0x0000 or
+// 0x0001 could occur. All of the H.261, H.263, H.264, MPEG-4 and VC-1 start
+// codes begin this way, so DetermineContainer() computes this list once and
+// the checkers walk it instead of each rescanning the buffer byte by byte.
+// memchr() is used to skip ahead to the zero bytes.
+static std::vector<int> FindStartCodeCandidates(const uint8_t* buffer,
+                                                int buffer_size) {
+  std::vector<int> candidates;
+  // A start code needs at least 3 bytes.
+  const uint8_t* const end = buffer + std::max(buffer_size - 2, 0);
+  const uint8_t* p = buffer;
+  while (p < end) {
+    p = static_cast<const uint8_t*>(memchr(p, 0, end - p));
+    if (!p)
+      break;
+    if (p[1] <= 1)
+      candidates.push_back(static_cast<int>(p - buffer));
+    ++p;
+  }
+  return candidates;
+}
+
 // Advance to the first set of |num_bits| bits that match |start_code|. |offset|
 // is the current location in the buffer, and is updated. |bytes_needed| is the
 // number of bytes that must remain in the buffer when |start_code| is found.
+// Only offsets in |candidates| (see FindStartCodeCandidates()) are examined,
+// so |start_code| must begin with 0x0000 or 0x0001.
 // Returns true if start_code found (and enough space in the buffer after it),
 // false otherwise.
 static bool AdvanceToStartCode(const uint8_t* buffer,
                                int buffer_size,
+                               const std::vector<int>& candidates,
                                int* offset,
                                int bytes_needed,
                                int num_bits,
                                uint32_t start_code) {
   DCHECK_GE(bytes_needed, 3);
   DCHECK_LE(num_bits, 24);  // Only supports up to 24 bits.
+  DCHECK_GE(num_bits, 15);  // Leading 15 bits must be covered by |start_code|.
 
   // Create a mask to isolate |num_bits| bits, once shifted over.
   uint32_t bits_to_shift = 24 - num_bits;
   uint32_t mask = (1 << num_bits) - 1;
+  DCHECK_EQ((start_code << bits_to_shift) >> 9, 0u);
+
+  auto it = std::lower_bound(candidates.begin(), candidates.end(), *offset);
+  for (; it != candidates.end() && *it + bytes_needed < buffer_size; ++it) {
+    uint32_t next = Read24(buffer + *it);
+    if (((next >> bits_to_shift) & mask) == start_code) {
+      *offset = *it;
+      return true;
+    }
+  }
+  *offset = std::max(*offset, buffer_size - bytes_needed);
+  return false;
+}
+
+// Advance to the first |sync_word| at or after |offset|, which is updated.
+// |bytes_needed| is the number of bytes that must remain in the buffer when
+// |sync_word| is found. Returns true if found, false otherwise.
+static bool AdvanceToSyncWord(const uint8_t* buffer,
+                              int buffer_size,
+                              int* offset,
+                              int bytes_needed,
+                              uint16_t sync_word) {
+  DCHECK_GE(bytes_needed, 2);
+
   while (*offset + bytes_needed < buffer_size) {
-    uint32_t next = Read24(buffer + *offset);
-    if (((next >> bits_to_shift) & mask) == start_code)
+    const uint8_t* p = static_cast<const uint8_t*>(
+        memchr(buffer + *offset, sync_word >> 8,
+               buffer_size - bytes_needed - *offset));
+    if (!p)
+      break;
+    *offset = static_cast<int>(p - buffer);
+    if (p[1] == (sync_word & 0xff))
       return true;
     ++(*offset);
   }
+  *offset = std::max(*offset, buffer_size - bytes_needed);
   return false;
 }
 
 // Checks for an H.261 container.
-static bool CheckH261(const uint8_t* buffer, int buffer_size) {
+static bool CheckH261(const uint8_t* buffer,
+                      int buffer_size,
+                      const std::vector<int>& start_codes) {
   // Reference: ITU-T Recommendation H.261 (03/1993)
   // (http://www.itu.int/rec/T-REC-H.261-199303-I/en)
   RCHECK(buffer_size > 16);
@@ -447,7 +506,8 @@ static bool CheckH261(const uint8_t* buffer, int buffer_size) {
   bool seen_start_code = false;
   while (true) {
     // Advance to picture_start_code, if there is one.
-    if (!AdvanceToStartCode(buffer, buffer_size, &offset, 4, 20, 0x10)) {
+    if (!AdvanceToStartCode(buffer, buffer_size, start_codes, &offset, 4, 20,
+                            0x10)) {
       // No start code found (or off end of buffer), so success if
       // there was at least one valid header.
       return seen_start_code;
@@ -486,7 +546,9 @@ static bool CheckH261(const uint8_t* buffer, int buffer_size) {
 }
 
 // Checks for an H.263 container.
-static bool CheckH263(const uint8_t* buffer, int buffer_size) {
+static bool CheckH263(const uint8_t* buffer,
+                      int buffer_size,
+                      const std::vector<int>& start_codes) {
   // Reference: ITU-T Recommendation H.263 (01/2005)
   // (http://www.itu.int/rec/T-REC-H.263-200501-I/en)
   // header is PSC(22b) + TR(8b) + PTYPE(8+b).
@@ -496,7 +558,8 @@ static bool CheckH263(const uint8_t* buffer, int buffer_size) {
   bool seen_start_code = false;
   while (true) {
     // Advance to picture_start_code, if there is one.
-    if (!AdvanceToStartCode(buffer, buffer_size, &offset, 9, 22, 0x20)) {
+    if (!AdvanceToStartCode(buffer, buffer_size, start_codes, &offset, 9, 22,
+                            0x20)) {
       // No start code found (or off end of buffer), so success if
       // there was at least one valid header.
       return seen_start_code;
@@ -554,7 +617,9 @@ static bool CheckH263(const uint8_t* buffer, int buffer_size) {
 }
 
 // Checks for an H.264 container.
-static bool CheckH264(const uint8_t* buffer, int buffer_size) {
+static bool CheckH264(const uint8_t* buffer,
+                      int buffer_size,
+                      const std::vector<int>& start_codes) {
   // Reference: ITU-T Recommendation H.264 (01/2012)
   // (http://www.itu.int/rec/T-REC-H.264)
   // Section B.1: Byte stream NAL unit syntax and semantics.
@@ -564,7 +629,8 @@ static bool CheckH264(const uint8_t* buffer, int buffer_size) {
   int parameter_count = 0;
   while (true) {
     // Advance to picture_start_code, if there is one.
-    if (!AdvanceToStartCode(buffer, buffer_size, &offset, 4, 24, 1)) {
+    if (!AdvanceToStartCode(buffer, buffer_size, start_codes, &offset, 4, 24,
+                            1)) {
       // No start code found (or off end of buffer), so success if
       // there was at least one valid header.
       return parameter_count > 0;
@@ -875,7 +941,9 @@ enum Mpeg4StartCodes {
 };
 
 // Checks for a raw MPEG4 bitstream container.
-static bool CheckMpeg4BitStream(const uint8_t* buffer, int buffer_size) {
+static bool CheckMpeg4BitStream(const uint8_t* buffer,
+                                int buffer_size,
+                                const std::vector<int>& start_codes) {
   // Defined in ISO/IEC 14496-2:2001.
   // However, no length ... simply scan for start code values.
   // Note tags are very similar to H.264.
@@ -888,7 +956,8 @@ static bool CheckMpeg4BitStream(const uint8_t* buffer, int buffer_size) {
   int vop_count = 0;
   while (true) {
     // Advance to start_code, if there is one.
-    if (!AdvanceToStartCode(buffer, buffer_size, &offset, 6, 24, 1)) {
+    if (!AdvanceToStartCode(buffer, buffer_size, start_codes, &offset, 6, 24,
+                            1)) {
       // Not a complete sequence in memory, so return true if we've seen a
       // visual_object_sequence_start_code and a visual_object_start_code.
       return (sequence_start_count > 0 && visual_object_count > 0);
@@ -1303,7 +1372,9 @@ enum VC1StartCodes {
 };
 
 // Checks for a VC1 bitstream container.
-static bool CheckVC1(const uint8_t* buffer, int buffer_size) {
+static bool CheckVC1(const uint8_t* buffer,
+                     int buffer_size,
+                     const std::vector<int>& start_codes) {
   // Reference: SMPTE 421M
   // (http://standards.smpte.org/content/978-1-61482-555-5/st-421-2006/SEC1.body.pdf)
   // However, no length ... simply scan for start code values.
@@ -1362,7 +1433,8 @@ static bool CheckVC1(const uint8_t* buffer, int buffer_size) {
   int frame_start_code = 0;
   while (true) {
     // Advance to start_code, if there is one.
-    if (!AdvanceToStartCode(buffer, buffer_size, &offset, 5, 24, 1)) {
+    if (!AdvanceToStartCode(buffer, buffer_size, start_codes, &offset, 5, 24,
+                            1)) {
       // Not a complete sequence in memory, so return true if we've seen a
       // sequence start and a frame start (not checking entry points since
       // they only occur in advanced profiles).
@@ -1678,15 +1750,20 @@ MediaContainerName DetermineContainer(const uint8_t* buffer, int buffer_size) {
     return CONTAINER_MJPEG;
   if (CheckDV(buffer, buffer_size))
     return CONTAINER_DV;
-  if (CheckH261(buffer, buffer_size))
+
+  // The elementary stream checks below all look for start codes, so find the
+  // possible start code positions once and share them.
+  const std::vector<int> start_codes =
+      FindStartCodeCandidates(buffer, buffer_size);
+  if (CheckH261(buffer, buffer_size, start_codes))
     return CONTAINER_H261;
-  if (CheckH263(buffer, buffer_size))
+  if (CheckH263(buffer, buffer_size, start_codes))
     return CONTAINER_H263;
-  if (CheckH264(buffer, buffer_size))
+  if (CheckH264(buffer, buffer_size, start_codes))
     return CONTAINER_H264;
-  if (CheckMpeg4BitStream(buffer, buffer_size))
+  if (CheckMpeg4BitStream(buffer, buffer_size, start_codes))
     return CONTAINER_MPEG4BS;
-  if (CheckVC1(buffer, buffer_size))
+  if (CheckVC1(buffer, buffer_size, start_codes))
     return CONTAINER_VC1;
   if (CheckSrt(buffer, buffer_size))
     return CONTAINER_SRT;
@@ -1696,7 +1773,7 @@ MediaContainerName DetermineContainer(const uint8_t* buffer, int buffer_size) {
   // AC3/EAC3 might not start at the beginning of the stream,
   // so scan for a start code.
   int offset = 1;  // No need to start at byte 0 due to First4 check.
-  if (AdvanceToStartCode(buffer, buffer_size, &offset, 4, 16, kAc3SyncWord)) {
+  if (AdvanceToSyncWord(buffer, buffer_size, &offset, 4, kAc3SyncWord)) {
     if (CheckAc3(buffer + offset, buffer_size - offset))
       return CONTAINER_AC3;
     if (CheckEac3(buffer + offset, buffer_size - offset))
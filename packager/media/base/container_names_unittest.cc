@@ -240,6 +240,15 @@ TEST(ContainerNamesTest, FileCheckAVI) {
   TestFile(CONTAINER_AVI, "bear.avi");
 }
 
+// AC3 is also recognized when the first sync word is not at the start.
+TEST(ContainerNamesTest, FileCheckAC3WithLeadingJunk) {
+  std::vector<uint8_t> data = ReadTestDataFile("bear.ac3");
+  ASSERT_FALSE(data.empty());
+  const uint8_t kJunk[] = {0x01, 0x0b, 0x00, 0x0b, 0x76, 0x00, 0x0b};
+  data.insert(data.begin(), kJunk, kJunk + std::size(kJunk));
+  EXPECT_EQ(CONTAINER_AC3, DetermineContainer(data.data(), data.size()));
+}
+
 TEST(ContainerNamesTest, FileCheckEAC3) {
   TestFile(CONTAINER_EAC3, "bear.eac3");
 }
@@ -260,6 +269,10 @@ TEST(ContainerNamesTest, FileCheckH263) {
   TestFile(CONTAINER_H263, "bear.h263");
 }
 
+TEST(ContainerNamesTest, FileCheckH264) {
+  TestFile(CONTAINER_H264, "bear.h264");
+}
+
 TEST(ContainerNamesTest, FileCheckMJPEG) {
   TestFile(CONTAINER_MJPEG, "bear.mjpeg");
 }
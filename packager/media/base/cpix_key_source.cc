@@ -9,7 +9,9 @@
 #include <algorithm>
 #include <cstdint>
 #include <limits>
+#include <map>
 #include <memory>
+#include <optional>
 #include <set>
 #include <string>
 #include <utility>
@@ -19,6 +21,7 @@
 #include <absl/log/log.h>
 #include <absl/strings/escaping.h>
 #include <absl/strings/match.h>
+#include <absl/synchronization/mutex.h>
 #include <mbedtls/md.h>
 
 #include <packager/file.h>
@@ -466,25 +469,26 @@ Status GetKeySystemInfo(
   return Status::OK;
 }
 
-Status BuildEncryptionKeyMap(const CpixEncryptionParams& cpix_params,
-                             CpixFetcher* fetcher,
-                             bool for_decryption,
-                             EncryptionKeyMap* encryption_key_map) {
-  if (cpix_params.document_source.empty()) {
-    return Status(error::INVALID_ARGUMENT,
-                  "CPIX document source should not be empty.");
+Status ReadRequestDocument(const CpixEncryptionParams& cpix_params,
+                           std::string* request) {
+  if (!cpix_params.request_document_source.empty() &&
+      !File::ReadFileToString(cpix_params.request_document_source.c_str(),
+                              request)) {
+    return Status(error::FILE_FAILURE,
+                  "Failed to read CPIX request document from '" +
+                      cpix_params.request_document_source + "'.");
   }
+  return Status::OK;
+}
 
+// Reads the CPIX document, POSTing |request_body| if it is non-empty, and
+// decrypts its content keys.
+Status ReadDocument(const CpixEncryptionParams& cpix_params,
+                    CpixFetcher* fetcher,
+                    const std::string& request_body,
+                    CpixDocument* document) {
   std::string xml;
   if (IsHttpUrl(cpix_params.document_source)) {
-    std::string request_body;
-    if (!cpix_params.request_document_source.empty() &&
-        !File::ReadFileToString(cpix_params.request_document_source.c_str(),
-                                &request_body)) {
-      return Status(error::FILE_FAILURE,
-                    "Failed to read CPIX request document from '" +
-                        cpix_params.request_document_source + "'.");
-    }
     RETURN_IF_ERROR(fetcher->Fetch(cpix_params.document_source, request_body,
                                    cpix_params.headers, &xml));
   } else {
@@ -500,10 +504,48 @@ Status BuildEncryptionKeyMap(const CpixEncryptionParams& cpix_params,
     }
   }
 
-  CpixDocument document;
-  RETURN_IF_ERROR(ParseCpixDocument(xml, &document));
-  RETURN_IF_ERROR(DecryptDocument(cpix_params, &document));
+  RETURN_IF_ERROR(ParseCpixDocument(xml, document));
+  return DecryptDocument(cpix_params, document);
+}
+
+// Resolves the crypto period indices of the key periods a usage rule is
+// restricted to.
+Status RuleToCryptoPeriods(const CpixUsageRule& usage_rule,
+                           const CpixDocument& document,
+                           std::set<uint32_t>* crypto_period_indices) {
+  for (const std::string& period_id : usage_rule.key_period_ids) {
+    auto key_period = std::find_if(
+        document.content_key_periods.begin(),
+        document.content_key_periods.end(),
+        [&period_id](const CpixContentKeyPeriod& content_key_period) {
+          return content_key_period.id == period_id;
+        });
+    if (key_period == document.content_key_periods.end()) {
+      return Status(error::INVALID_ARGUMENT,
+                    "ContentKeyUsageRule for key " +
+                        KeyIdToString(usage_rule.key_id) +
+                        " references unknown key period " + period_id + ".");
+    }
+    if (!key_period->index) {
+      return Status(error::UNIMPLEMENTED,
+                    "ContentKeyPeriod " + period_id +
+                        " has no 'index' attribute. Only index based key "
+                        "periods are supported.");
+    }
+    crypto_period_indices->insert(*key_period->index);
+  }
+  return Status::OK;
+}
 
+// Maps the keys of |document| to stream labels. Keys restricted to key
+// periods are added to |crypto_period_key_maps|, keyed by crypto period
+// index; the other keys are added to |encryption_key_map|.
+Status BuildEncryptionKeyMaps(
+    const CpixDocument& document,
+    const CpixEncryptionParams& cpix_params,
+    bool for_decryption,
+    EncryptionKeyMap* encryption_key_map,
+    std::map<uint32_t, EncryptionKeyMap>* crypto_period_key_maps) {
   // DRM signaling is only used for encryption; decryption needs the raw key
   // values only, so an imperfect DRMSystemList should not fail decryption.
   if (!for_decryption) {
@@ -527,18 +569,33 @@ Status BuildEncryptionKeyMap(const CpixEncryptionParams& cpix_params,
   struct UsedKey {
     const CpixContentKey* content_key;
     std::set<std::string> labels;
+    // Empty if the key is used in all crypto periods.
+    std::set<uint32_t> crypto_period_indices;
   };
   std::vector<UsedKey> used_keys;
   for (const CpixContentKey& content_key : document.content_keys) {
     std::set<std::string> labels;
+    std::set<uint32_t> crypto_period_indices;
     if (for_decryption) {
       // Decryption looks up keys by key ID only; a synthetic unique label
       // keeps every key in the map without requiring usage rules.
       labels.insert(KeyIdToString(content_key.key_id));
     } else {
+      bool has_period_independent_rule = false;
       for (const CpixUsageRule& usage_rule : document.usage_rules) {
-        if (usage_rule.key_id == content_key.key_id)
-          RETURN_IF_ERROR(RuleToLabels(usage_rule, cpix_params, &labels));
+        if (usage_rule.key_id != content_key.key_id)
+          continue;
+        RETURN_IF_ERROR(RuleToLabels(usage_rule, cpix_params, &labels));
+        RETURN_IF_ERROR(
+            RuleToCryptoPeriods(usage_rule, document, &crypto_period_indices));
+        if (usage_rule.key_period_ids.empty())
+          has_period_independent_rule = true;
+      }
+      if (has_period_independent_rule && !crypto_period_indices.empty()) {
+        return Status(error::INVALID_ARGUMENT,
+                      "Key " + KeyIdToString(content_key.key_id) +
+                          " has usage rules both with and without a "
+                          "KeyPeriodFilter.");
       }
       if (labels.empty()) {
         if (document.usage_rules.empty() && document.content_keys.size() == 1) {
@@ -566,7 +623,8 @@ Status BuildEncryptionKeyMap(const CpixEncryptionParams& cpix_params,
       }
       return valid;
     }
-    used_keys.push_back({&content_key, std::move(labels)});
+    used_keys.push_back(
+        {&content_key, std::move(labels), std::move(crypto_period_indices)});
   }
 
   if (used_keys.empty()) {
@@ -575,39 +633,94 @@ Status BuildEncryptionKeyMap(const CpixEncryptionParams& cpix_params,
                   "mapped to streams.");
   }
 
-  std::vector<std::vector<uint8_t>> key_ids;
-  for (const UsedKey& used_key : used_keys)
-    key_ids.emplace_back(used_key.content_key->key_id);
-
+  // Group the keys by crypto period; std::nullopt groups the keys used in all
+  // crypto periods.
+  std::map<std::optional<uint32_t>, std::vector<const UsedKey*>> key_groups;
   for (const UsedKey& used_key : used_keys) {
-    const CpixContentKey& content_key = *used_key.content_key;
-    EncryptionKey encryption_key;
-    encryption_key.key_id = content_key.key_id;
-    encryption_key.key = content_key.key;
-    encryption_key.iv = content_key.iv;
-    encryption_key.common_encryption_scheme =
-        content_key.common_encryption_scheme;
-    if (!for_decryption) {
-      // key_ids and the DRM signaling are only used to build PSSH info for
-      // encryption; decryption looks up keys by key ID alone.
-      encryption_key.key_ids = key_ids;
-      RETURN_IF_ERROR(GetKeySystemInfo(document, content_key,
-                                       &encryption_key.key_system_info));
-    }
+    if (used_key.crypto_period_indices.empty())
+      key_groups[std::nullopt].push_back(&used_key);
+    for (uint32_t crypto_period_index : used_key.crypto_period_indices)
+      key_groups[crypto_period_index].push_back(&used_key);
+  }
+
+  for (const auto& key_group : key_groups) {
+    EncryptionKeyMap* key_map =
+        key_group.first ? &(*crypto_period_key_maps)[*key_group.first]
+                        : encryption_key_map;
+
+    std::vector<std::vector<uint8_t>> key_ids;
+    for (const UsedKey* used_key : key_group.second)
+      key_ids.emplace_back(used_key->content_key->key_id);
+
+    for (const UsedKey* used_key : key_group.second) {
+      const CpixContentKey& content_key = *used_key->content_key;
+      EncryptionKey encryption_key;
+      encryption_key.key_id = content_key.key_id;
+      encryption_key.key = content_key.key;
+      encryption_key.iv = content_key.iv;
+      encryption_key.common_encryption_scheme =
+          content_key.common_encryption_scheme;
+      if (!for_decryption) {
+        // key_ids and the DRM signaling are only used to build PSSH info for
+        // encryption; decryption looks up keys by key ID alone.
+        encryption_key.key_ids = key_ids;
+        RETURN_IF_ERROR(GetKeySystemInfo(document, content_key,
+                                         &encryption_key.key_system_info));
+      }
 
-    for (const std::string& label : used_key.labels) {
-      if (encryption_key_map->find(label) != encryption_key_map->end()) {
-        return Status(
-            error::INVALID_ARGUMENT,
-            "Multiple keys map to the same stream label '" + label + "'.");
+      for (const std::string& label : used_key->labels) {
+        if (key_map->find(label) != key_map->end()) {
+          std::string error_message =
+              "Multiple keys map to the same stream label '" + label + "'";
+          if (key_group.first) {
+            error_message +=
+                " in crypto period " + std::to_string(*key_group.first);
+          }
+          return Status(error::INVALID_ARGUMENT, error_message + ".");
+        }
+        (*key_map)[label] = std::make_unique<EncryptionKey>(encryption_key);
       }
-      (*encryption_key_map)[label] =
-          std::make_unique<EncryptionKey>(encryption_key);
     }
   }
   return Status::OK;
 }
 
+// Looks up the key of |stream_label| in |key_map|, falling back to the default
+// empty label.
+const EncryptionKey* FindKey(const EncryptionKeyMap& key_map,
+                             const std::string& stream_label) {
+  auto iter = key_map.find(stream_label);
+  if (iter == key_map.end())
+    iter = key_map.find(kEmptyDrmLabel);
+  return iter == key_map.end() ? nullptr : iter->second.get();
+}
+
+// Reads the initial CPIX document and maps its keys.
+Status LoadKeys(const CpixEncryptionParams& cpix_params,
+                CpixFetcher* fetcher,
+                bool for_decryption,
+                EncryptionKeyMap* encryption_key_map,
+                std::map<uint32_t, EncryptionKeyMap>* crypto_period_key_maps) {
+  if (cpix_params.document_source.empty()) {
+    return Status(error::INVALID_ARGUMENT,
+                  "CPIX document source should not be empty.");
+  }
+  if (cpix_params.key_periods_per_request == 0) {
+    return Status(error::INVALID_ARGUMENT,
+                  "CPIX key periods per request should be positive.");
+  }
+  std::string request_body;
+  RETURN_IF_ERROR(ReadRequestDocument(cpix_params, &request_body));
+  CpixDocument document;
+  RETURN_IF_ERROR(ReadDocument(cpix_params, fetcher, request_body, &document));
+  return BuildEncryptionKeyMaps(document, cpix_params, for_decryption,
+                                encryption_key_map, crypto_period_key_maps);
+}
+
+std::string KeyPeriodId(uint32_t crypto_period_index) {
+  return "keyPeriod-" + std::to_string(crypto_period_index);
+}
+
 }  // namespace
 
 CpixKeySource::~CpixKeySource() {}
@@ -616,25 +729,21 @@ Status CpixKeySource::FetchKeys(EmeInitDataType init_data_type,
                                 const std::vector<uint8_t>& init_data) {
   UNUSED(init_data_type);
   UNUSED(init_data);
-  // All keys are fetched upfront when the key source is created.
+  // All keys are fetched upfront when the key source is created, except the
+  // keys of crypto periods, which are fetched on demand.
   return Status::OK;
 }
 
 Status CpixKeySource::GetKey(const std::string& stream_label,
                              EncryptionKey* key) {
   DCHECK(key);
-  // Try to find the key with label |stream_label|. If it is not available,
-  // fall back to the default empty label if it is available.
-  auto iter = encryption_key_map_.find(stream_label);
-  if (iter == encryption_key_map_.end()) {
-    iter = encryption_key_map_.find(kEmptyDrmLabel);
-    if (iter == encryption_key_map_.end()) {
-      return Status(error::NOT_FOUND, "Key for '" + stream_label +
-                                          "' was not found in the CPIX "
-                                          "document.");
-    }
+  const EncryptionKey* found_key = FindKey(encryption_key_map_, stream_label);
+  if (!found_key) {
+    return Status(error::NOT_FOUND, "Key for '" + stream_label +
+                                        "' was not found in the CPIX "
+                                        "document.");
   }
-  *key = *iter->second;
+  *key = *found_key;
   return Status::OK;
 }
 
@@ -658,50 +767,168 @@ Status CpixKeySource::GetCryptoPeriodKey(
     int32_t crypto_period_duration_in_seconds,
     const std::string& stream_label,
     EncryptionKey* key) {
-  UNUSED(crypto_period_index);
+  DCHECK(key);
+  // Key periods are identified by their index, so the duration is not needed.
   UNUSED(crypto_period_duration_in_seconds);
-  UNUSED(stream_label);
-  UNUSED(key);
-  return Status(error::UNIMPLEMENTED,
-                "The CPIX key source does not support key rotation.");
+
+  Status status;
+  if (!GetCachedCryptoPeriodKey(crypto_period_index, stream_label, key,
+                                &status)) {
+    // Only one request is made at a time; concurrent lookups of the same
+    // missing period wait for it and then find the period in the cache.
+    absl::MutexLock fetch_lock(fetch_mutex_);
+    if (!GetCachedCryptoPeriodKey(crypto_period_index, stream_label, key,
+                                  &status)) {
+      RETURN_IF_ERROR(FetchCryptoPeriodKeys(crypto_period_index));
+      if (!GetCachedCryptoPeriodKey(crypto_period_index, stream_label, key,
+                                    &status)) {
+        return Status(error::NOT_FOUND,
+                      "The CPIX response has no keys for crypto period " +
+                          std::to_string(crypto_period_index) + ".");
+      }
+    }
+  }
+  RETURN_IF_ERROR(status);
+
+  // Evict the periods the live edge has moved past, keeping a few for
+  // streams lagging behind.
+  absl::MutexLock lock(mutex_);
+  if (crypto_period_index > cpix_params_.key_periods_per_request) {
+    crypto_period_key_maps_.erase(
+        crypto_period_key_maps_.begin(),
+        crypto_period_key_maps_.lower_bound(
+            crypto_period_index - cpix_params_.key_periods_per_request));
+  }
+  return Status::OK;
 }
 
 std::unique_ptr<CpixKeySource> CpixKeySource::Create(
     const CpixEncryptionParams& cpix_params) {
-  HttpCpixFetcher fetcher;
-  return CreateWithFetcher(cpix_params, &fetcher);
+  std::unique_ptr<CpixFetcher> fetcher(new HttpCpixFetcher);
+  CpixFetcher* fetcher_ptr = fetcher.get();
+  return CreateInternal(cpix_params, std::move(fetcher), fetcher_ptr,
+                        /* for_decryption= */ false);
 }
 
 std::unique_ptr<CpixKeySource> CpixKeySource::CreateWithFetcher(
     const CpixEncryptionParams& cpix_params,
     CpixFetcher* fetcher) {
-  return CreateInternal(cpix_params, fetcher, /* for_decryption= */ false);
+  return CreateInternal(cpix_params, nullptr, fetcher,
+                        /* for_decryption= */ false);
 }
 
 std::unique_ptr<CpixKeySource> CpixKeySource::CreateForDecryption(
     const CpixEncryptionParams& cpix_params) {
-  HttpCpixFetcher fetcher;
-  return CreateInternal(cpix_params, &fetcher, /* for_decryption= */ true);
+  std::unique_ptr<CpixFetcher> fetcher(new HttpCpixFetcher);
+  CpixFetcher* fetcher_ptr = fetcher.get();
+  return CreateInternal(cpix_params, std::move(fetcher), fetcher_ptr,
+                        /* for_decryption= */ true);
 }
 
 std::unique_ptr<CpixKeySource> CpixKeySource::CreateInternal(
     const CpixEncryptionParams& cpix_params,
+    std::unique_ptr<CpixFetcher> owned_fetcher,
     CpixFetcher* fetcher,
     bool for_decryption) {
   DCHECK(fetcher);
   EncryptionKeyMap encryption_key_map;
-  Status status = BuildEncryptionKeyMap(cpix_params, fetcher, for_decryption,
-                                        &encryption_key_map);
+  CryptoPeriodKeyMaps crypto_period_key_maps;
+  Status status =
+      LoadKeys(cpix_params, fetcher, for_decryption, &encryption_key_map,
+               &crypto_period_key_maps);
   if (!status.ok()) {
     LOG(ERROR) << "Failed to create CPIX key source: " << status.ToString();
     return nullptr;
   }
-  return std::unique_ptr<CpixKeySource>(
-      new CpixKeySource(std::move(encryption_key_map)));
+  return std::unique_ptr<CpixKeySource>(new CpixKeySource(
+      cpix_params, std::move(owned_fetcher), fetcher,
+      std::move(encryption_key_map), std::move(crypto_period_key_maps)));
 }
 
-CpixKeySource::CpixKeySource(EncryptionKeyMap&& encryption_key_map)
-    : encryption_key_map_(std::move(encryption_key_map)) {}
+CpixKeySource::CpixKeySource(const CpixEncryptionParams& cpix_params,
+                             std::unique_ptr<CpixFetcher> owned_fetcher,
+                             CpixFetcher* fetcher,
+                             EncryptionKeyMap&& encryption_key_map,
+                             CryptoPeriodKeyMaps&& crypto_period_key_maps)
+    : cpix_params_(cpix_params),
+      owned_fetcher_(std::move(owned_fetcher)),
+      fetcher_(fetcher),
+      encryption_key_map_(std::move(encryption_key_map)),
+      crypto_period_key_maps_(std::move(crypto_period_key_maps)) {}
+
+bool CpixKeySource::GetCachedCryptoPeriodKey(uint32_t crypto_period_index,
+                                             const std::string& stream_label,
+                                             EncryptionKey* key,
+                                             Status* status) {
+  absl::MutexLock lock(mutex_);
+  auto iter = crypto_period_key_maps_.find(crypto_period_index);
+  if (iter == crypto_period_key_maps_.end())
+    return false;
+  const EncryptionKey* found_key = FindKey(iter->second, stream_label);
+  if (!found_key) {
+    *status = Status(error::NOT_FOUND,
+                     "Key for '" + stream_label + "' in crypto period " +
+                         std::to_string(crypto_period_index) +
+                         " was not found in the CPIX document.");
+  } else {
+    *key = *found_key;
+    *status = Status::OK;
+  }
+  return true;
+}
+
+Status CpixKeySource::FetchCryptoPeriodKeys(uint32_t crypto_period_index) {
+  if (!IsHttpUrl(cpix_params_.document_source)) {
+    return Status(error::NOT_FOUND,
+                  "Crypto period " + std::to_string(crypto_period_index) +
+                      " has no keys in the CPIX document, and keys can only "
+                      "be requested from an HTTP(S) CPIX source.");
+  }
+
+  // Request a batch of periods starting at |crypto_period_index|, so that
+  // the following periods are served from the cache. The batch stops short
+  // of the periods already cached.
+  uint64_t end_index =
+      uint64_t{crypto_period_index} + cpix_params_.key_periods_per_request;
+  {
+    absl::MutexLock lock(mutex_);
+    auto next_cached = crypto_period_key_maps_.upper_bound(crypto_period_index);
+    if (next_cached != crypto_period_key_maps_.end())
+      end_index = std::min<uint64_t>(end_index, next_cached->first);
+  }
+  end_index = std::min<uint64_t>(end_index,
+                                 std::numeric_limits<uint32_t>::max() + 1ull);
+  std::vector<CpixContentKeyPeriod> key_periods;
+  for (uint64_t index = crypto_period_index; index < end_index; ++index) {
+    const uint32_t period_index = static_cast<uint32_t>(index);
+    key_periods.push_back({KeyPeriodId(period_index), period_index});
+  }
+
+  std::string request_template;
+  RETURN_IF_ERROR(ReadRequestDocument(cpix_params_, &request_template));
+  std::string request_body;
+  RETURN_IF_ERROR(
+      BuildCpixKeyPeriodRequest(request_template, key_periods, &request_body));
+  CpixDocument document;
+  RETURN_IF_ERROR(ReadDocument(cpix_params_, fetcher_, request_body, &document));
+
+  EncryptionKeyMap encryption_key_map;
+  CryptoPeriodKeyMaps crypto_period_key_maps;
+  RETURN_IF_ERROR(BuildEncryptionKeyMaps(document, cpix_params_,
+                                         /* for_decryption= */ false,
+                                         &encryption_key_map,
+                                         &crypto_period_key_maps));
+  if (!encryption_key_map.empty()) {
+    LOG(WARNING) << "Ignoring the keys without a KeyPeriodFilter in the CPIX "
+                    "response for crypto periods "
+                 << crypto_period_index << " to " << end_index - 1 << ".";
+  }
+
+  absl::MutexLock lock(mutex_);
+  for (auto& entry : crypto_period_key_maps)
+    crypto_period_key_maps_.insert(std::move(entry));
+  return Status::OK;
+}
 
 }  // namespace media
 }  // namespace shaka
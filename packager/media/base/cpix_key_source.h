@@ -8,10 +8,14 @@
 #define PACKAGER_MEDIA_BASE_CPIX_KEY_SOURCE_H_
 
 #include <cstdint>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include <absl/base/thread_annotations.h>
+#include <absl/synchronization/mutex.h>
+
 #include <packager/crypto_params.h>
 #include <packager/media/base/key_source.h>
 
@@ -39,6 +43,13 @@ class CpixFetcher {
 /// document's ContentKeyUsageRuleList: the `intendedTrackType` attribute is
 /// matched against the DRM label of the stream (e.g. AUDIO, SD, HD, UHD1).
 /// DRM signaling (PSSH) is taken from the document's DRMSystemList.
+///
+/// For key rotation, keys are bound to crypto periods through the document's
+/// ContentKeyPeriodList: a key whose usage rule has a `KeyPeriodFilter` is
+/// used in the crypto period matching the referenced period's `index`. Keys
+/// of periods missing from the document are requested from an HTTP(S) CPIX
+/// source in batches of `key_periods_per_request` periods, so most crypto
+/// periods are served from the cache without a round trip.
 class CpixKeySource : public KeySource {
  public:
   ~CpixKeySource() override;
@@ -64,8 +75,8 @@ class CpixKeySource : public KeySource {
   static std::unique_ptr<CpixKeySource> Create(
       const CpixEncryptionParams& cpix_params);
 
-  /// Same as above, with an injected document fetcher. Should be used for
-  /// testing only.
+  /// Same as above, with an injected document fetcher, which must outlive the
+  /// key source. Should be used for testing only.
   static std::unique_ptr<CpixKeySource> CreateWithFetcher(
       const CpixEncryptionParams& cpix_params,
       CpixFetcher* fetcher);
@@ -79,16 +90,44 @@ class CpixKeySource : public KeySource {
       const CpixEncryptionParams& cpix_params);
 
  private:
+  // Crypto period index to the keys of the period.
+  typedef std::map<uint32_t, EncryptionKeyMap> CryptoPeriodKeyMaps;
+
   static std::unique_ptr<CpixKeySource> CreateInternal(
       const CpixEncryptionParams& cpix_params,
+      std::unique_ptr<CpixFetcher> owned_fetcher,
       CpixFetcher* fetcher,
       bool for_decryption);
 
-  explicit CpixKeySource(EncryptionKeyMap&& encryption_key_map);
+  CpixKeySource(const CpixEncryptionParams& cpix_params,
+                std::unique_ptr<CpixFetcher> owned_fetcher,
+                CpixFetcher* fetcher,
+                EncryptionKeyMap&& encryption_key_map,
+                CryptoPeriodKeyMaps&& crypto_period_key_maps);
   CpixKeySource(const CpixKeySource&) = delete;
   CpixKeySource& operator=(const CpixKeySource&) = delete;
 
+  // Returns false if the crypto period is not cached. Otherwise |status|
+  // tells whether the key of |stream_label| was found.
+  bool GetCachedCryptoPeriodKey(uint32_t crypto_period_index,
+                                const std::string& stream_label,
+                                EncryptionKey* key,
+                                Status* status) ABSL_LOCKS_EXCLUDED(mutex_);
+  // Requests the keys of a batch of key periods starting at
+  // |crypto_period_index| and adds them to the cache.
+  Status FetchCryptoPeriodKeys(uint32_t crypto_period_index)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(fetch_mutex_) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  const CpixEncryptionParams cpix_params_;
+  std::unique_ptr<CpixFetcher> owned_fetcher_;
+  CpixFetcher* const fetcher_;
   EncryptionKeyMap encryption_key_map_;
+
+  // Serializes the key period requests. Not held while looking up cached
+  // keys, so a request in flight does not block cache hits.
+  absl::Mutex fetch_mutex_;
+  absl::Mutex mutex_ ABSL_ACQUIRED_AFTER(fetch_mutex_);
+  CryptoPeriodKeyMaps crypto_period_key_maps_ ABSL_GUARDED_BY(mutex_);
 };
 
 }  // namespace media
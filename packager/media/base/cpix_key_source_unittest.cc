@@ -7,6 +7,7 @@
 #include <packager/media/base/cpix_key_source.h>
 
 #include <cstdint>
+#include <cstdio>
 #include <memory>
 #include <string>
 #include <vector>
@@ -83,6 +84,41 @@ std::string TwoKeyDocument() {
          "</ContentKeyUsageRuleList></CPIX>";
 }
 
+std::string KeyPeriodKeyIdUuid(uint32_t crypto_period_index) {
+  char suffix[3];
+  snprintf(suffix, sizeof(suffix), "%02x", crypto_period_index);
+  return std::string("01010203-0508-0d15-2237-5990e90000") + suffix;
+}
+
+std::string KeyPeriodKeyIdHex(uint32_t crypto_period_index) {
+  char suffix[3];
+  snprintf(suffix, sizeof(suffix), "%02x", crypto_period_index);
+  return std::string("0101020305080d1522375990e90000") + suffix;
+}
+
+// A document with a key for all streams in each of the crypto periods in
+// |crypto_period_indices|.
+std::string KeyPeriodDocument(
+    const std::vector<uint32_t>& crypto_period_indices) {
+  std::string content_keys;
+  std::string key_periods;
+  std::string usage_rules;
+  for (uint32_t index : crypto_period_indices) {
+    const std::string period_id = "keyPeriod-" + std::to_string(index);
+    content_keys += ContentKeyElement(KeyPeriodKeyIdUuid(index), kKey1Base64,
+                                      "");
+    key_periods += "<ContentKeyPeriod id=\"" + period_id + "\" index=\"" +
+                   std::to_string(index) + "\"/>";
+    usage_rules += "<ContentKeyUsageRule kid=\"" + KeyPeriodKeyIdUuid(index) +
+                   "\"><KeyPeriodFilter periodId=\"" + period_id +
+                   "\"/></ContentKeyUsageRule>";
+  }
+  return "<CPIX xmlns=\"urn:dashif:org:cpix\"><ContentKeyList>" +
+         content_keys + "</ContentKeyList><ContentKeyPeriodList>" +
+         key_periods + "</ContentKeyPeriodList><ContentKeyUsageRuleList>" +
+         usage_rules + "</ContentKeyUsageRuleList></CPIX>";
+}
+
 }  // namespace
 
 class CpixKeySourceTest : public ::testing::Test {
@@ -366,14 +402,58 @@ TEST_F(CpixKeySourceTest, FetchKeysIsNoOp) {
   ASSERT_OK(key_source->FetchKeys(EmeInitDataType::CENC, {}));
 }
 
-TEST_F(CpixKeySourceTest, GetCryptoPeriodKeyIsNotSupported) {
+TEST_F(CpixKeySourceTest, GetCryptoPeriodKeyFromKeyPeriods) {
   std::unique_ptr<CpixKeySource> key_source =
-      CreateFromDocument(TwoKeyDocument());
+      CreateFromDocument(KeyPeriodDocument({0, 1}));
+  ASSERT_NE(nullptr, key_source);
+
+  EncryptionKey key;
+  ASSERT_OK(key_source->GetCryptoPeriodKey(0, 100, "SD", &key));
+  EXPECT_HEX_EQ(KeyPeriodKeyIdHex(0), key.key_id);
+  // key_ids lists the keys of the crypto period only.
+  ASSERT_EQ(1u, key.key_ids.size());
+  EXPECT_HEX_EQ(KeyPeriodKeyIdHex(0), key.key_ids[0]);
+
+  ASSERT_OK(key_source->GetCryptoPeriodKey(1, 100, "AUDIO", &key));
+  EXPECT_HEX_EQ(KeyPeriodKeyIdHex(1), key.key_id);
+
+  // Keys bound to key periods are not used without key rotation.
+  Status status = key_source->GetKey("SD", &key);
+  EXPECT_EQ(error::NOT_FOUND, status.error_code());
+}
+
+TEST_F(CpixKeySourceTest, CryptoPeriodMissingFromLocalDocumentFails) {
+  std::unique_ptr<CpixKeySource> key_source =
+      CreateFromDocument(KeyPeriodDocument({0, 1}));
   ASSERT_NE(nullptr, key_source);
 
   EncryptionKey key;
-  Status status = key_source->GetCryptoPeriodKey(0, 100, "SD", &key);
-  EXPECT_EQ(error::UNIMPLEMENTED, status.error_code());
+  Status status = key_source->GetCryptoPeriodKey(2, 100, "SD", &key);
+  EXPECT_EQ(error::NOT_FOUND, status.error_code());
+}
+
+TEST_F(CpixKeySourceTest, UnknownKeyPeriodFails) {
+  const std::string document_text =
+      std::string("<CPIX><ContentKeyList>") +
+      ContentKeyElement(kKeyId1Uuid, kKey1Base64, "") +
+      "</ContentKeyList><ContentKeyUsageRuleList><ContentKeyUsageRule kid=\"" +
+      kKeyId1Uuid +
+      "\"><KeyPeriodFilter periodId=\"keyPeriod-0\"/></ContentKeyUsageRule>"
+      "</ContentKeyUsageRuleList></CPIX>";
+  EXPECT_EQ(nullptr, CreateFromDocument(document_text));
+}
+
+TEST_F(CpixKeySourceTest, KeyPeriodWithoutIndexFails) {
+  const std::string document_text =
+      std::string("<CPIX><ContentKeyList>") +
+      ContentKeyElement(kKeyId1Uuid, kKey1Base64, "") +
+      "</ContentKeyList><ContentKeyPeriodList><ContentKeyPeriod "
+      "id=\"keyPeriod-0\"/></ContentKeyPeriodList><ContentKeyUsageRuleList>"
+      "<ContentKeyUsageRule kid=\"" +
+      kKeyId1Uuid +
+      "\"><KeyPeriodFilter periodId=\"keyPeriod-0\"/></ContentKeyUsageRule>"
+      "</ContentKeyUsageRuleList></CPIX>";
+  EXPECT_EQ(nullptr, CreateFromDocument(document_text));
 }
 
 namespace {
@@ -384,6 +464,7 @@ class FakeCpixFetcher : public CpixFetcher {
                const std::string& request_body,
                const std::vector<std::string>& headers,
                std::string* response) override {
+    ++num_requests;
     last_url = url;
     last_request_body = request_body;
     last_headers = headers;
@@ -396,6 +477,7 @@ class FakeCpixFetcher : public CpixFetcher {
   std::string response_body;
   Status status = Status::OK;
 
+  int num_requests = 0;
   std::string last_url;
   std::string last_request_body;
   std::vector<std::string> last_headers;
@@ -460,6 +542,89 @@ TEST_F(CpixKeySourceTest, FetchErrorFails) {
   EXPECT_EQ(nullptr, CpixKeySource::CreateWithFetcher(params, &fetcher));
 }
 
+TEST_F(CpixKeySourceTest, FetchesKeyPeriodsInBatches) {
+  FakeCpixFetcher fetcher;
+  fetcher.response_body = TwoKeyDocument();
+
+  CpixEncryptionParams params;
+  params.document_source = "https://key-server.example.com/cpix";
+  params.key_periods_per_request = 3;
+  std::unique_ptr<CpixKeySource> key_source =
+      CpixKeySource::CreateWithFetcher(params, &fetcher);
+  ASSERT_NE(nullptr, key_source);
+  ASSERT_EQ(1, fetcher.num_requests);
+
+  fetcher.response_body = KeyPeriodDocument({5, 6, 7});
+  EncryptionKey key;
+  ASSERT_OK(key_source->GetCryptoPeriodKey(5, 100, "SD", &key));
+  EXPECT_HEX_EQ(KeyPeriodKeyIdHex(5), key.key_id);
+  ASSERT_EQ(2, fetcher.num_requests);
+
+  // The request lists the batch of key periods.
+  const std::string& request = fetcher.last_request_body;
+  EXPECT_NE(std::string::npos, request.find("<ContentKeyPeriodList>"));
+  EXPECT_NE(std::string::npos, request.find("index=\"5\""));
+  EXPECT_NE(std::string::npos, request.find("index=\"7\""));
+  EXPECT_EQ(std::string::npos, request.find("index=\"8\""));
+
+  // The following periods are served from the cache.
+  ASSERT_OK(key_source->GetCryptoPeriodKey(6, 100, "SD", &key));
+  EXPECT_HEX_EQ(KeyPeriodKeyIdHex(6), key.key_id);
+  ASSERT_OK(key_source->GetCryptoPeriodKey(7, 100, "HD", &key));
+  EXPECT_HEX_EQ(KeyPeriodKeyIdHex(7), key.key_id);
+  EXPECT_EQ(2, fetcher.num_requests);
+
+  fetcher.response_body = KeyPeriodDocument({8, 9, 10});
+  ASSERT_OK(key_source->GetCryptoPeriodKey(8, 100, "SD", &key));
+  EXPECT_HEX_EQ(KeyPeriodKeyIdHex(8), key.key_id);
+  EXPECT_EQ(3, fetcher.num_requests);
+}
+
+TEST_F(CpixKeySourceTest, KeyPeriodRequestKeepsRequestDocument) {
+  ASSERT_TRUE(File::WriteStringToFile(
+      "memory://request.cpix",
+      "<CPIX xmlns=\"urn:dashif:org:cpix\" contentId=\"live\"/>"));
+
+  FakeCpixFetcher fetcher;
+  fetcher.response_body = TwoKeyDocument();
+
+  CpixEncryptionParams params;
+  params.document_source = "https://key-server.example.com/cpix";
+  params.request_document_source = "memory://request.cpix";
+  params.key_periods_per_request = 2;
+  std::unique_ptr<CpixKeySource> key_source =
+      CpixKeySource::CreateWithFetcher(params, &fetcher);
+  ASSERT_NE(nullptr, key_source);
+
+  fetcher.response_body = KeyPeriodDocument({0, 1});
+  EncryptionKey key;
+  ASSERT_OK(key_source->GetCryptoPeriodKey(0, 100, "SD", &key));
+  EXPECT_NE(std::string::npos,
+            fetcher.last_request_body.find("contentId=\"live\""));
+  EXPECT_NE(std::string::npos,
+            fetcher.last_request_body.find("<ContentKeyPeriod id="));
+}
+
+TEST_F(CpixKeySourceTest, KeyPeriodResponseWithoutRequestedPeriodFails) {
+  FakeCpixFetcher fetcher;
+  fetcher.response_body = TwoKeyDocument();
+
+  CpixEncryptionParams params;
+  params.document_source = "https://key-server.example.com/cpix";
+  std::unique_ptr<CpixKeySource> key_source =
+      CpixKeySource::CreateWithFetcher(params, &fetcher);
+  ASSERT_NE(nullptr, key_source);
+
+  fetcher.response_body = KeyPeriodDocument({3});
+  EncryptionKey key;
+  Status status = key_source->GetCryptoPeriodKey(2, 100, "SD", &key);
+  EXPECT_EQ(error::NOT_FOUND, status.error_code());
+
+  fetcher.status = Status(error::HTTP_FAILURE, "server error");
+  status = key_source->GetCryptoPeriodKey(4, 100, "SD", &key);
+  EXPECT_EQ(error::HTTP_FAILURE, status.error_code());
+}
+
 TEST_F(CpixKeySourceTest, VideoFilterMapsToPixelBuckets) {
   // Key 1 covers SD ([0, max_sd_pixels]), key 2 covers everything above.
   const std::string document_text =
@@ -278,14 +278,20 @@ Status ParseUsageRule(xmlNodePtr node, CpixUsageRule* usage_rule) {
       RETURN_IF_ERROR(reject_unsupported_attributes(
           child, "an AudioFilter", {"minChannels", "maxChannels"}));
       usage_rule->has_audio_filter = true;
+    } else if (IsElement(child, "KeyPeriodFilter")) {
+      std::string period_id;
+      RETURN_IF_ERROR(GetRequiredAttribute(
+          child, "periodId", "KeyPeriodFilter of the rule for key " + kid,
+          &period_id));
+      usage_rule->key_period_ids.push_back(std::move(period_id));
     } else {
       return Status(
           error::UNIMPLEMENTED,
           "ContentKeyUsageRule for key " + kid + " contains a " +
               reinterpret_cast<const char*>(child->name) +
               " element, which is not supported yet. Only VideoFilter, "
-              "AudioFilter and the 'intendedTrackType' attribute are "
-              "supported.");
+              "AudioFilter, KeyPeriodFilter and the 'intendedTrackType' "
+              "attribute are supported.");
     }
   }
 
@@ -301,6 +307,23 @@ Status ParseUsageRule(xmlNodePtr node, CpixUsageRule* usage_rule) {
   return Status::OK;
 }
 
+Status ParseContentKeyPeriod(xmlNodePtr node,
+                             CpixContentKeyPeriod* key_period) {
+  RETURN_IF_ERROR(GetRequiredAttribute(node, "id", "ContentKeyPeriod element",
+                                       &key_period->id));
+  std::optional<std::string> index = GetAttribute(node, "index");
+  if (index) {
+    uint32_t value = 0;
+    if (!absl::SimpleAtoi(*index, &value)) {
+      return Status(error::INVALID_ARGUMENT,
+                    "Invalid ContentKeyPeriod@index for period " +
+                        key_period->id + ": " + *index);
+    }
+    key_period->index = value;
+  }
+  return Status::OK;
+}
+
 // Parses every |element_name| child of |list| with |parse| into |out|.
 template <typename T>
 Status ParseList(xmlNodePtr list,
@@ -349,9 +372,13 @@ Status ParseCpixDocument(const std::string& xml, CpixDocument* document) {
     } else if (IsElement(list, "DeliveryDataList")) {
       RETURN_IF_ERROR(ParseList(list, "DeliveryData", &ParseDeliveryData,
                                 &document->delivery_data));
+    } else if (IsElement(list, "ContentKeyPeriodList")) {
+      RETURN_IF_ERROR(ParseList(list, "ContentKeyPeriod",
+                                &ParseContentKeyPeriod,
+                                &document->content_key_periods));
     }
-    // Other lists (ContentKeyPeriodList, UpdateHistory, Signature, ...) are
-    // not needed for packaging and are ignored.
+    // Other lists (UpdateHistory, Signature, ...) are not needed for
+    // packaging and are ignored.
   }
 
   if (document->content_keys.empty()) {
@@ -370,6 +397,80 @@ Status ParseCpixDocument(const std::string& xml, CpixDocument* document) {
       }
     }
   }
+  for (size_t i = 0; i < document->content_key_periods.size(); ++i) {
+    for (size_t j = i + 1; j < document->content_key_periods.size(); ++j) {
+      if (document->content_key_periods[i].id ==
+          document->content_key_periods[j].id) {
+        return Status(error::INVALID_ARGUMENT,
+                      "Duplicate ContentKeyPeriod id " +
+                          document->content_key_periods[i].id);
+      }
+    }
+  }
+  return Status::OK;
+}
+
+Status BuildCpixKeyPeriodRequest(
+    const std::string& request_template,
+    const std::vector<CpixContentKeyPeriod>& key_periods,
+    std::string* request) {
+  DCHECK(request);
+
+  const std::string xml = request_template.empty()
+                              ? "<CPIX xmlns=\"urn:dashif:org:cpix\"/>"
+                              : request_template;
+  xml::scoped_xml_ptr<xmlDoc> doc(xmlReadMemory(
+      xml.data(), static_cast<int>(xml.size()), /* URL= */ nullptr,
+      /* encoding= */ nullptr, XML_PARSE_NONET));
+  if (!doc) {
+    return Status(error::INVALID_ARGUMENT,
+                  "Failed to parse the CPIX request document as XML.");
+  }
+  xmlNodePtr root = xmlDocGetRootElement(doc.get());
+  if (!IsElement(root, "CPIX")) {
+    return Status(error::INVALID_ARGUMENT,
+                  "The root element of a CPIX request document must be CPIX.");
+  }
+
+  // Replace any period list of the template, keeping the schema order of the
+  // lists: ContentKeyPeriodList precedes ContentKeyUsageRuleList,
+  // UpdateHistoryItemList and Signature.
+  xmlNodePtr next_sibling = nullptr;
+  for (xmlNodePtr child = root->children; child;) {
+    xmlNodePtr next = child->next;
+    if (IsElement(child, "ContentKeyPeriodList")) {
+      xmlUnlinkNode(child);
+      xmlFreeNode(child);
+    } else if (!next_sibling && (IsElement(child, "ContentKeyUsageRuleList") ||
+                                 IsElement(child, "UpdateHistoryItemList") ||
+                                 IsElement(child, "Signature"))) {
+      next_sibling = child;
+    }
+    child = next;
+  }
+
+  xmlNodePtr period_list = xmlNewDocNode(doc.get(), root->ns,
+                                         BAD_CAST "ContentKeyPeriodList",
+                                         nullptr);
+  for (const CpixContentKeyPeriod& key_period : key_periods) {
+    xmlNodePtr period = xmlNewChild(period_list, root->ns,
+                                    BAD_CAST "ContentKeyPeriod", nullptr);
+    xmlNewProp(period, BAD_CAST "id", BAD_CAST key_period.id.c_str());
+    if (key_period.index) {
+      xmlNewProp(period, BAD_CAST "index",
+                 BAD_CAST std::to_string(*key_period.index).c_str());
+    }
+  }
+  if (next_sibling)
+    xmlAddPrevSibling(next_sibling, period_list);
+  else
+    xmlAddChild(root, period_list);
+
+  xmlChar* doc_str = nullptr;
+  int doc_str_size = 0;
+  xmlDocDumpMemoryEnc(doc.get(), &doc_str, &doc_str_size, "UTF-8");
+  request->assign(doc_str, doc_str + doc_str_size);
+  xmlFree(doc_str);
   return Status::OK;
 }
 
@@ -84,6 +84,18 @@ struct CpixUsageRule {
   /// `VideoFilter` elements, restricting the rule to video streams. Multiple
   /// filters form a union of their pixel ranges.
   std::vector<CpixVideoFilter> video_filters;
+  /// `periodId` attributes of the `KeyPeriodFilter` elements, restricting the
+  /// rule to key periods. Empty if the rule applies to all key periods.
+  std::vector<std::string> key_period_ids;
+};
+
+/// A key period from a CPIX ContentKeyPeriodList. Key periods bind keys to
+/// crypto periods for key rotation.
+struct CpixContentKeyPeriod {
+  /// From the `id` attribute, referenced by `KeyPeriodFilter@periodId`.
+  std::string id;
+  /// From the optional `index` attribute, the index of the crypto period.
+  std::optional<uint32_t> index;
 };
 
 /// Delivery data for one document recipient, from a CPIX DeliveryDataList.
@@ -107,6 +119,7 @@ struct CpixDocument {
   std::vector<CpixDrmSystem> drm_systems;
   std::vector<CpixUsageRule> usage_rules;
   std::vector<CpixDeliveryData> delivery_data;
+  std::vector<CpixContentKeyPeriod> content_key_periods;
 };
 
 /// Parses a CPIX document. Encrypted content key values are parsed into
@@ -117,6 +130,20 @@ struct CpixDocument {
 /// @return OK on success, an error status otherwise.
 Status ParseCpixDocument(const std::string& xml, CpixDocument* document);
 
+/// Builds a CPIX request document asking for the keys of @a key_periods, by
+/// setting the ContentKeyPeriodList of @a request_template. The response is
+/// expected to bind a key to each period with `KeyPeriodFilter` usage rules.
+/// @param request_template contains the request document the periods are
+///        added to. A minimal CPIX document is used if empty.
+/// @param key_periods contains the requested key periods.
+/// @param request is a pointer to the request document text. Should not be
+///        NULL.
+/// @return OK on success, an error status otherwise.
+Status BuildCpixKeyPeriodRequest(
+    const std::string& request_template,
+    const std::vector<CpixContentKeyPeriod>& key_periods,
+    std::string* request);
+
 }  // namespace media
 }  // namespace shaka
 
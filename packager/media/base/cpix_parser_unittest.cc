@@ -409,5 +409,86 @@ TEST(CpixParserTest, IgnoresUnknownElements) {
   EXPECT_EQ(1u, document.content_keys.size());
 }
 
+TEST(CpixParserTest, ParsesKeyPeriods) {
+  const std::string document_text = std::string(R"(<CPIX>
+    <ContentKeyList><ContentKey kid=")") +
+                                    kKeyId1Uuid + R"(">
+      <Data><Secret><PlainValue>)" + kKey1Base64 +
+                                    R"(</PlainValue></Secret></Data>
+    </ContentKey></ContentKeyList>
+    <ContentKeyPeriodList>
+      <ContentKeyPeriod id="period-a" index="7"/>
+      <ContentKeyPeriod id="period-b"/>
+    </ContentKeyPeriodList>
+    <ContentKeyUsageRuleList>
+      <ContentKeyUsageRule kid=")" + kKeyId1Uuid +
+                                    R"(">
+        <KeyPeriodFilter periodId="period-a"/>
+      </ContentKeyUsageRule>
+    </ContentKeyUsageRuleList></CPIX>)";
+  CpixDocument document;
+  ASSERT_OK(ParseCpixDocument(document_text, &document));
+  ASSERT_EQ(2u, document.content_key_periods.size());
+  EXPECT_EQ("period-a", document.content_key_periods[0].id);
+  EXPECT_EQ(7u, document.content_key_periods[0].index);
+  EXPECT_EQ("period-b", document.content_key_periods[1].id);
+  EXPECT_FALSE(document.content_key_periods[1].index);
+  ASSERT_EQ(1u, document.usage_rules.size());
+  EXPECT_EQ(std::vector<std::string>{"period-a"},
+            document.usage_rules[0].key_period_ids);
+}
+
+TEST(CpixParserTest, RejectsDuplicateKeyPeriodIds) {
+  const std::string document_text = std::string(R"(<CPIX>
+    <ContentKeyList><ContentKey kid=")") +
+                                    kKeyId1Uuid + R"(">
+      <Data><Secret><PlainValue>)" + kKey1Base64 +
+                                    R"(</PlainValue></Secret></Data>
+    </ContentKey></ContentKeyList>
+    <ContentKeyPeriodList>
+      <ContentKeyPeriod id="period-a" index="1"/>
+      <ContentKeyPeriod id="period-a" index="2"/>
+    </ContentKeyPeriodList></CPIX>)";
+  CpixDocument document;
+  Status status = ParseCpixDocument(document_text, &document);
+  EXPECT_EQ(error::INVALID_ARGUMENT, status.error_code());
+}
+
+TEST(CpixParserTest, BuildsKeyPeriodRequest) {
+  const std::string request_template = R"(<cpix:CPIX
+      xmlns:cpix="urn:dashif:org:cpix" contentId="live">
+    <cpix:ContentKeyPeriodList>
+      <cpix:ContentKeyPeriod id="stale" index="0"/>
+    </cpix:ContentKeyPeriodList>
+    <cpix:ContentKeyUsageRuleList/>
+  </cpix:CPIX>)";
+  std::string request;
+  ASSERT_OK(BuildCpixKeyPeriodRequest(
+      request_template, {{"keyPeriod-3", 3}, {"keyPeriod-4", 4}}, &request));
+
+  EXPECT_NE(std::string::npos, request.find("contentId=\"live\""));
+  EXPECT_EQ(std::string::npos, request.find("stale"));
+  // The period list precedes the usage rule list.
+  const size_t period_list = request.find("<cpix:ContentKeyPeriodList>");
+  ASSERT_NE(std::string::npos, period_list);
+  EXPECT_LT(period_list, request.find("<cpix:ContentKeyUsageRuleList"));
+  EXPECT_NE(std::string::npos,
+            request.find("<cpix:ContentKeyPeriod id=\"keyPeriod-3\" "
+                         "index=\"3\"/>"));
+  EXPECT_NE(std::string::npos,
+            request.find("<cpix:ContentKeyPeriod id=\"keyPeriod-4\" "
+                         "index=\"4\"/>"));
+}
+
+TEST(CpixParserTest, BuildsKeyPeriodRequestWithoutTemplate) {
+  std::string request;
+  ASSERT_OK(BuildCpixKeyPeriodRequest("", {{"keyPeriod-0", 0}}, &request));
+  EXPECT_NE(std::string::npos,
+            request.find("<CPIX xmlns=\"urn:dashif:org:cpix\">"));
+  EXPECT_NE(std::string::npos,
+            request.find("<ContentKeyPeriod id=\"keyPeriod-0\" "
+                         "index=\"0\"/>"));
+}
+
 }  // namespace media
 }  // namespace shaka
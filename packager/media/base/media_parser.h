@@ -10,9 +10,11 @@
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <set>
 #include <vector>
 
 #include <packager/macros/classes.h>
+#include <packager/macros/compiler.h>
 
 namespace shaka {
 namespace media {
@@ -76,7 +78,41 @@ class MediaParser {
   /// @return true if successful.
   [[nodiscard]] virtual bool Parse(const uint8_t* buf, int size) = 0;
 
+  /// Restrict the parser to a subset of the tracks reported through InitCB.
+  /// Samples of the other tracks are not emitted, and parsers may skip the
+  /// container data carrying them instead of building samples which would be
+  /// discarded later. Can be called from InitCB.
+  /// @param track_ids contains the ids of the tracks which are consumed.
+  virtual void SetSelectedTracks(const std::set<uint32_t>& track_ids) {
+    selected_tracks_ = track_ids;
+    has_track_selection_ = true;
+  }
+
+  /// Start the samples of a track at its first sample with a decoding
+  /// timestamp of at least @a start_dts. Parsers may skip the earlier samples
+  /// without reading them, but do not have to. Can be called from InitCB.
+  /// @param track_id is the id of the track, as reported through InitCB.
+  /// @param start_dts is the start decoding timestamp.
+  virtual void SetTrackStartTimestamp(uint32_t track_id, int64_t start_dts) {
+    UNUSED(track_id);
+    UNUSED(start_dts);
+  }
+
+ protected:
+  /// @return true if SetSelectedTracks() has been called.
+  bool has_track_selection() const { return has_track_selection_; }
+  /// @return the tracks set by SetSelectedTracks().
+  const std::set<uint32_t>& selected_tracks() const { return selected_tracks_; }
+  /// @return true if the samples of |track_id| are consumed, i.e. if there is
+  ///         no track selection or |track_id| is part of it.
+  bool IsTrackSelected(uint32_t track_id) const {
+    return !has_track_selection_ || selected_tracks_.count(track_id) > 0;
+  }
+
  private:
+  bool has_track_selection_ = false;
+  std::set<uint32_t> selected_tracks_;
+
   DISALLOW_COPY_AND_ASSIGN(MediaParser);
 };
 
@@ -128,6 +128,14 @@ class MediaSample {
     return data_size_;
   }
 
+  /// @return the buffer holding data(). Sample data is never modified once
+  ///         set, so the buffer can be referenced beyond the lifetime of this
+  ///         sample instead of being copied.
+  std::shared_ptr<const uint8_t> shared_data() const {
+    DCHECK(!end_of_stream());
+    return data_;
+  }
+
   const uint8_t* side_data() const { return side_data_.get(); }
 
   size_t side_data_size() const { return side_data_size_; }
@@ -190,6 +198,14 @@ class MediaSample {
 
 typedef std::deque<std::shared_ptr<MediaSample>> BufferQueue;
 
+/// The timing of a media sample, without its data.
+struct SampleTiming {
+  int64_t pts = 0;
+  int64_t dts = 0;
+  int64_t duration = 0;
+  bool is_key_frame = false;
+};
+
 }  // namespace media
 }  // namespace shaka
 
@@ -21,6 +21,7 @@
 #include <packager/media/base/media_sample.h>
 #include <packager/media/base/muxer_options.h>
 #include <packager/media/base/muxer_util.h>
+#include <packager/media/base/segment_output_queue.h>
 #include <packager/media/base/text_sample.h>
 #include <packager/media/event/muxer_listener.h>
 #include <packager/media/event/progress_listener.h>
@@ -40,6 +41,10 @@ Muxer::Muxer(const MuxerOptions& options)
   // support one file per Representation per Period when there are Ad Cues.
   if (options_.output_file_name.find("$") != std::string::npos)
     output_file_template_ = options_.output_file_name;
+  if (options_.segment_output_queue_depth > 0) {
+    segment_output_queue_.reset(
+        new SegmentOutputQueue(options_.segment_output_queue_depth));
+  }
 }
 
 Muxer::~Muxer() {}
@@ -49,6 +54,12 @@ void Muxer::Cancel() {
 }
 
 void Muxer::SetMuxerListener(std::unique_ptr<MuxerListener> muxer_listener) {
+  if (segment_output_queue_ && muxer_listener) {
+    // The events follow the segment writes through the queue, so that e.g. a
+    // segment is added to the manifest only after it is written.
+    muxer_listener.reset(new QueuedMuxerListener(std::move(muxer_listener),
+                                                 segment_output_queue_.get()));
+  }
   muxer_listener_ = std::move(muxer_listener);
 }
 
@@ -81,6 +92,9 @@ Status Muxer::Process(std::unique_ptr<StreamData> stream_data) {
           muxer_listener_->OnEncryptionStart();
         }
       }
+      // Report failed background writes as soon as possible.
+      if (segment_output_queue_)
+        RETURN_IF_ERROR(segment_output_queue_->status());
       return FinalizeSegment(stream_data->stream_index, segment_info);
     }
     case StreamDataType::kMediaSample:
@@ -117,7 +131,10 @@ Status Muxer::Process(std::unique_ptr<StreamData> stream_data) {
 
 Status Muxer::OnFlushRequest(size_t input_stream_index) {
   UNUSED(input_stream_index);
-  return Finalize();
+  RETURN_IF_ERROR(Finalize());
+  if (segment_output_queue_)
+    return segment_output_queue_->Flush();
+  return Status::OK;
 }
 
 Status Muxer::AddMediaSample(size_t stream_id, const MediaSample& sample) {
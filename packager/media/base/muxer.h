@@ -18,6 +18,7 @@
 
 #include <packager/media/base/media_handler.h>
 #include <packager/media/base/muxer_options.h>
+#include <packager/media/base/segment_output_queue.h>
 #include <packager/media/base/text_sample.h>
 #include <packager/media/event/muxer_listener.h>
 #include <packager/media/event/progress_listener.h>
@@ -72,6 +73,12 @@ class Muxer : public MediaHandler {
   const MuxerOptions& options() const { return options_; }
   MuxerListener* muxer_listener() { return muxer_listener_.get(); }
   ProgressListener* progress_listener() { return progress_listener_.get(); }
+  /// @return the queue writing segments in the background, or nullptr if
+  ///         segments are written synchronously. Events sent to
+  ///         muxer_listener() are delivered in order with the queued writes.
+  SegmentOutputQueue* segment_output_queue() {
+    return segment_output_queue_.get();
+  }
 
   uint64_t Now() const {
     auto duration = clock_->now().time_since_epoch();
@@ -117,6 +124,9 @@ class Muxer : public MediaHandler {
   std::unique_ptr<MuxerListener> muxer_listener_;
   std::unique_ptr<ProgressListener> progress_listener_;
   std::shared_ptr<Clock> clock_;
+  // Declared after |muxer_listener_|, so that the queued events are delivered
+  // before the listener is destroyed.
+  std::unique_ptr<SegmentOutputQueue> segment_output_queue_;
 
   // In VOD single segment case with Ad Cues, |output_file_name| is allowed to
   // be a template. In this case, there will be NumAdCues + 1 files generated.
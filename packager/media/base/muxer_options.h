@@ -7,7 +7,9 @@
 #ifndef PACKAGER_MEDIA_BASE_MUXER_OPTIONS_H_
 #define PACKAGER_MEDIA_BASE_MUXER_OPTIONS_H_
 
+#include <cstddef>
 #include <cstdint>
+#include <optional>
 #include <string>
 
 #include <packager/mp4_output_params.h>
@@ -15,6 +17,23 @@
 namespace shaka {
 namespace media {
 
+/// Options of a muxer which writes one time range of a stream, when the
+/// ranges of the stream are muxed in parallel. Together, the muxers of the
+/// ranges write the same output as a single muxer of the whole stream.
+struct MuxerRangeOptions {
+  /// Only the muxer of the first range writes the init segment.
+  bool is_first_range = true;
+  /// Timestamps of the first sample of the whole stream, which determine the
+  /// edit list.
+  int64_t stream_start_pts = 0;
+  int64_t stream_start_dts = 0;
+  /// Sum of the sample durations of the whole stream, in the stream's time
+  /// scale.
+  int64_t stream_duration = 0;
+  /// Number of fragments in the ranges before this one.
+  uint32_t preceding_fragments = 0;
+};
+
 /// This structure contains the list of configuration options for Muxer.
 struct MuxerOptions {
   MuxerOptions();
@@ -44,6 +63,14 @@ struct MuxerOptions {
   /// User-specified bit rate for the media stream. If zero, the muxer will
   /// attempt to estimate.
   uint32_t bandwidth = 0;
+
+  /// Number of finished segments which can wait to be written in the
+  /// background. If zero, segments are written synchronously.
+  size_t segment_output_queue_depth = 0;
+
+  /// Set if the muxer writes one time range of the stream. Only supported by
+  /// the MP4 muxer with a segment template.
+  std::optional<MuxerRangeOptions> range;
 };
 
 }  // namespace media
@@ -7,6 +7,7 @@
 #include <cstddef>
 #include <cstdint>
 
+#include <absl/log/check.h>
 #include <absl/log/log.h>
 
 
@@ -61,6 +62,12 @@ bool OffsetByteQueue::Trim(int64_t max_offset) {
   return true;
 }
 
+void OffsetByteQueue::SkipTo(int64_t offset) {
+  DCHECK_GE(offset, tail());
+  Pop(size_);
+  head_ = offset;
+}
+
 void OffsetByteQueue::Sync() {
   queue_.Peek(&buf_, &size_);
 }
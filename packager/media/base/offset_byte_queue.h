@@ -49,6 +49,11 @@ class OffsetByteQueue {
   ///         buffered are still cleared).
   bool Trim(int64_t max_offset);
 
+  /// Clear the buffered bytes and skip the bytes up to (but not including)
+  /// @a offset, which must not be before tail(). The next pushed byte is at
+  /// @a offset.
+  void SkipTo(int64_t offset);
+
   /// @return The head position, in terms of the file's absolute offset.
   int64_t head() { return head_; }
   /// @return The tail position (exclusive), in terms of the file's absolute
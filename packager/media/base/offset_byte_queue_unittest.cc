@@ -91,5 +91,21 @@ TEST_F(OffsetByteQueueTest, Trim) {
   EXPECT_TRUE(queue_->Trim(512));
 }
 
+TEST_F(OffsetByteQueueTest, SkipTo) {
+  queue_->SkipTo(1000);
+  EXPECT_EQ(1000, queue_->head());
+  EXPECT_EQ(1000, queue_->tail());
+
+  const uint8_t kData[] = {1, 2, 3};
+  queue_->Push(kData, sizeof(kData));
+  EXPECT_EQ(1003, queue_->tail());
+
+  const uint8_t* buf;
+  int size;
+  queue_->PeekAt(1001, &buf, &size);
+  EXPECT_EQ(2, size);
+  EXPECT_EQ(2, buf[0]);
+}
+
 }  // namespace media
 }  // namespace shaka
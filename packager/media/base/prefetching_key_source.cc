@@ -0,0 +1,209 @@
+// Copyright 2024 Google LLC. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <packager/media/base/prefetching_key_source.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <absl/log/check.h>
+#include <absl/log/log.h>
+
+#include <packager/macros/status.h>
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+// Number of crypto periods before the latest requested crypto period for which
+// the keys are kept, for streams lagging behind.
+const uint32_t kNumRetainedPastPeriods = 16;
+
+}  // namespace
+
+PrefetchingKeySource::PrefetchingKeySource(
+    std::unique_ptr<KeySource> key_source,
+    uint32_t num_prefetch_periods)
+    : key_source_(std::move(key_source)),
+      num_prefetch_periods_(num_prefetch_periods) {
+  DCHECK(key_source_);
+  thread_ = std::thread(&PrefetchingKeySource::ThreadMain, this);
+}
+
+PrefetchingKeySource::~PrefetchingKeySource() {
+  {
+    absl::MutexLock lock(mutex_);
+    terminated_ = true;
+    prefetch_requested_.Signal();
+  }
+  thread_.join();
+}
+
+Status PrefetchingKeySource::FetchKeys(EmeInitDataType init_data_type,
+                                       const std::vector<uint8_t>& init_data) {
+  return key_source_->FetchKeys(init_data_type, init_data);
+}
+
+Status PrefetchingKeySource::GetKey(const std::string& stream_label,
+                                    EncryptionKey* key) {
+  return key_source_->GetKey(stream_label, key);
+}
+
+Status PrefetchingKeySource::GetKey(const std::vector<uint8_t>& key_id,
+                                    EncryptionKey* key) {
+  return key_source_->GetKey(key_id, key);
+}
+
+Status PrefetchingKeySource::GetCryptoPeriodKey(
+    uint32_t crypto_period_index,
+    int32_t crypto_period_duration_in_seconds,
+    const std::string& stream_label,
+    EncryptionKey* key) {
+  DCHECK(key);
+  {
+    absl::MutexLock lock(mutex_);
+    if (crypto_period_duration_in_seconds_ != 0 &&
+        crypto_period_duration_in_seconds_ !=
+            crypto_period_duration_in_seconds) {
+      return Status(error::INVALID_ARGUMENT,
+                    "Crypto period duration should not change.");
+    }
+    crypto_period_duration_in_seconds_ = crypto_period_duration_in_seconds;
+    stream_labels_.insert(stream_label);
+  }
+
+  const PeriodKey period_key(crypto_period_index, stream_label);
+  bool fetched = false;
+  Status status = GetEntry(period_key, crypto_period_duration_in_seconds,
+                           &fetched, key);
+  // The prefetch failed. Try again before giving up.
+  if (!status.ok() && !fetched) {
+    status = GetEntry(period_key, crypto_period_duration_in_seconds, &fetched,
+                      key);
+  }
+  RETURN_IF_ERROR(status);
+
+  absl::MutexLock lock(mutex_);
+  if (crypto_period_index > latest_crypto_period_index_)
+    latest_crypto_period_index_ = crypto_period_index;
+  SchedulePrefetch(crypto_period_index);
+  EvictOldPeriods();
+  return Status::OK;
+}
+
+Status PrefetchingKeySource::GetEntry(const PeriodKey& period_key,
+                                      int32_t crypto_period_duration_in_seconds,
+                                      bool* fetched,
+                                      EncryptionKey* key) {
+  std::shared_ptr<Entry> entry;
+  {
+    absl::MutexLock lock(mutex_);
+    auto iter = entries_.find(period_key);
+    if (iter == entries_.end() ||
+        (iter->second->done && !iter->second->status.ok())) {
+      // Not prefetched, e.g. for the first crypto period, or the prefetch
+      // failed. Fetch it on this thread instead of queueing it.
+      pending_.erase(period_key);
+      entry = std::make_shared<Entry>();
+      entries_[period_key] = entry;
+      *fetched = true;
+    } else {
+      entry = iter->second;
+      // Fetch it right away if the prefetch has not started yet.
+      *fetched = pending_.erase(period_key) > 0;
+    }
+  }
+
+  if (*fetched)
+    Fetch(period_key, crypto_period_duration_in_seconds, entry.get());
+
+  absl::MutexLock lock(mutex_);
+  // The key is usually fetched already, unless the stream caught up with the
+  // prefetch.
+  while (!entry->done)
+    entry_done_.Wait(&mutex_);
+  if (entry->status.ok())
+    *key = entry->key;
+  return entry->status;
+}
+
+void PrefetchingKeySource::ThreadMain() {
+  while (true) {
+    PeriodKey period_key;
+    std::shared_ptr<Entry> entry;
+    int32_t crypto_period_duration_in_seconds = 0;
+    {
+      absl::MutexLock lock(mutex_);
+      while (!terminated_ && pending_.empty())
+        prefetch_requested_.Wait(&mutex_);
+      if (terminated_)
+        return;
+      period_key = *pending_.begin();
+      pending_.erase(pending_.begin());
+      entry = entries_[period_key];
+      crypto_period_duration_in_seconds = crypto_period_duration_in_seconds_;
+    }
+    VLOG(2) << "Prefetching key of crypto period " << period_key.first
+            << " for stream label '" << period_key.second << "'.";
+    Fetch(period_key, crypto_period_duration_in_seconds, entry.get());
+  }
+}
+
+void PrefetchingKeySource::Fetch(const PeriodKey& period_key,
+                                 int32_t crypto_period_duration_in_seconds,
+                                 Entry* entry) {
+  EncryptionKey key;
+  Status status = key_source_->GetCryptoPeriodKey(
+      period_key.first, crypto_period_duration_in_seconds, period_key.second,
+      &key);
+  if (!status.ok()) {
+    LOG(WARNING) << "Failed to fetch key of crypto period " << period_key.first
+                 << " for stream label '" << period_key.second
+                 << "': " << status;
+  }
+
+  absl::MutexLock lock(mutex_);
+  entry->status = status;
+  entry->key = std::move(key);
+  entry->done = true;
+  entry_done_.SignalAll();
+}
+
+void PrefetchingKeySource::SchedulePrefetch(uint32_t crypto_period_index) {
+  bool scheduled = false;
+  for (uint32_t i = 1; i <= num_prefetch_periods_; ++i) {
+    for (const std::string& stream_label : stream_labels_) {
+      const PeriodKey period_key(crypto_period_index + i, stream_label);
+      if (entries_.find(period_key) != entries_.end())
+        continue;
+      entries_[period_key] = std::make_shared<Entry>();
+      pending_.insert(period_key);
+      scheduled = true;
+    }
+  }
+  if (scheduled)
+    prefetch_requested_.Signal();
+}
+
+void PrefetchingKeySource::EvictOldPeriods() {
+  if (latest_crypto_period_index_ <= kNumRetainedPastPeriods)
+    return;
+  const uint32_t oldest_retained_index =
+      latest_crypto_period_index_ - kNumRetainedPastPeriods;
+  // Entries being fetched are kept alive by their fetchers.
+  while (!entries_.empty() &&
+         entries_.begin()->first.first < oldest_retained_index) {
+    pending_.erase(entries_.begin()->first);
+    entries_.erase(entries_.begin());
+  }
+}
+
+}  // namespace media
+}  // namespace shaka
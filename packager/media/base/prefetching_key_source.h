@@ -0,0 +1,112 @@
+// Copyright 2024 Google LLC. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_MEDIA_BASE_PREFETCHING_KEY_SOURCE_H_
+#define PACKAGER_MEDIA_BASE_PREFETCHING_KEY_SOURCE_H_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <absl/base/thread_annotations.h>
+#include <absl/synchronization/mutex.h>
+
+#include <packager/macros/classes.h>
+#include <packager/media/base/key_source.h>
+#include <packager/status.h>
+
+namespace shaka {
+namespace media {
+
+/// A key source which fetches the keys of upcoming crypto periods from another
+/// key source in the background, so that key rotation does not block the
+/// media threads at crypto period boundaries.
+///
+/// When the key of a crypto period is requested, the keys of the following
+/// crypto periods are fetched on a background thread, for every stream label
+/// requested so far. The fetched keys are shared by all streams, so streams
+/// with the same stream label, e.g. the renditions of a title, fetch each key
+/// only once.
+class PrefetchingKeySource : public KeySource {
+ public:
+  /// @param key_source is the key source to fetch the keys from. It must be
+  ///        safe to call from multiple threads.
+  /// @param num_prefetch_periods is the number of crypto periods to fetch
+  ///        ahead of the last requested crypto period.
+  PrefetchingKeySource(std::unique_ptr<KeySource> key_source,
+                       uint32_t num_prefetch_periods);
+  ~PrefetchingKeySource() override;
+
+  /// @name KeySource implementation overrides.
+  /// @{
+  Status FetchKeys(EmeInitDataType init_data_type,
+                   const std::vector<uint8_t>& init_data) override;
+  Status GetKey(const std::string& stream_label, EncryptionKey* key) override;
+  Status GetKey(const std::vector<uint8_t>& key_id,
+                EncryptionKey* key) override;
+  Status GetCryptoPeriodKey(uint32_t crypto_period_index,
+                            int32_t crypto_period_duration_in_seconds,
+                            const std::string& stream_label,
+                            EncryptionKey* key) override;
+  /// @}
+
+ private:
+  // Crypto period index and stream label.
+  typedef std::pair<uint32_t, std::string> PeriodKey;
+
+  struct Entry {
+    bool done = false;
+    Status status;
+    EncryptionKey key;
+  };
+
+  void ThreadMain();
+  // Gets the key of |period_key|, waiting for the prefetch if it is in
+  // progress, or fetching it on this thread otherwise. |fetched| is set to
+  // true in the latter case.
+  Status GetEntry(const PeriodKey& period_key,
+                  int32_t crypto_period_duration_in_seconds,
+                  bool* fetched,
+                  EncryptionKey* key);
+  // Fetches the key of |period_key| from |key_source_| into |entry|.
+  void Fetch(const PeriodKey& period_key,
+             int32_t crypto_period_duration_in_seconds,
+             Entry* entry);
+  // Schedules fetching the keys of the crypto periods following
+  // |crypto_period_index| for all stream labels.
+  void SchedulePrefetch(uint32_t crypto_period_index)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Drops the keys of crypto periods far behind the latest requested one.
+  void EvictOldPeriods() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const std::unique_ptr<KeySource> key_source_;
+  const uint32_t num_prefetch_periods_;
+
+  absl::Mutex mutex_;
+  absl::CondVar entry_done_ ABSL_GUARDED_BY(mutex_);
+  absl::CondVar prefetch_requested_ ABSL_GUARDED_BY(mutex_);
+  std::map<PeriodKey, std::shared_ptr<Entry>> entries_ ABSL_GUARDED_BY(mutex_);
+  // Entries to be fetched by the background thread, in crypto period order.
+  std::set<PeriodKey> pending_ ABSL_GUARDED_BY(mutex_);
+  std::set<std::string> stream_labels_ ABSL_GUARDED_BY(mutex_);
+  int32_t crypto_period_duration_in_seconds_ ABSL_GUARDED_BY(mutex_) = 0;
+  uint32_t latest_crypto_period_index_ ABSL_GUARDED_BY(mutex_) = 0;
+  bool terminated_ ABSL_GUARDED_BY(mutex_) = false;
+
+  std::thread thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(PrefetchingKeySource);
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // PACKAGER_MEDIA_BASE_PREFETCHING_KEY_SOURCE_H_
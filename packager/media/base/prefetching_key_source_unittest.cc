@@ -0,0 +1,204 @@
+// Copyright 2024 Google LLC. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <packager/media/base/prefetching_key_source.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <absl/synchronization/mutex.h>
+#include <absl/time/time.h>
+#include <gtest/gtest.h>
+
+#include <packager/status/status_test_util.h>
+
+namespace shaka {
+namespace media {
+namespace {
+
+const int32_t kCryptoPeriodDurationInSeconds = 10;
+const uint32_t kNumPrefetchPeriods = 2;
+const char kSdLabel[] = "SD";
+const char kHdLabel[] = "HD";
+
+// A key source generating a distinct key for each crypto period and stream
+// label, and counting the requests.
+class FakeKeySource : public KeySource {
+ public:
+  Status FetchKeys(EmeInitDataType init_data_type,
+                   const std::vector<uint8_t>& init_data) override {
+    return Status::OK;
+  }
+
+  Status GetKey(const std::string& stream_label, EncryptionKey* key) override {
+    key->key_id.assign(stream_label.begin(), stream_label.end());
+    return Status::OK;
+  }
+
+  Status GetKey(const std::vector<uint8_t>& key_id,
+                EncryptionKey* key) override {
+    key->key_id = key_id;
+    return Status::OK;
+  }
+
+  Status GetCryptoPeriodKey(uint32_t crypto_period_index,
+                            int32_t crypto_period_duration_in_seconds,
+                            const std::string& stream_label,
+                            EncryptionKey* key) override {
+    absl::MutexLock lock(mutex_);
+    const auto period_key = std::make_pair(crypto_period_index, stream_label);
+    ++num_requests_[period_key];
+    if (failures_.erase(period_key) > 0)
+      return Status(error::SERVER_ERROR, "Failed to fetch key.");
+    *key = MakeKey(crypto_period_index, stream_label);
+    return Status::OK;
+  }
+
+  static EncryptionKey MakeKey(uint32_t crypto_period_index,
+                               const std::string& stream_label) {
+    EncryptionKey key;
+    key.key_id.assign(stream_label.begin(), stream_label.end());
+    key.key_id.push_back(static_cast<uint8_t>(crypto_period_index));
+    return key;
+  }
+
+  void FailOnce(uint32_t crypto_period_index, const std::string& stream_label) {
+    absl::MutexLock lock(mutex_);
+    failures_.emplace(crypto_period_index, stream_label);
+  }
+
+  int NumRequests(uint32_t crypto_period_index,
+                  const std::string& stream_label) {
+    absl::MutexLock lock(mutex_);
+    return num_requests_[std::make_pair(crypto_period_index, stream_label)];
+  }
+
+  // Waits until the key of the crypto period is requested.
+  bool WaitForRequest(uint32_t crypto_period_index,
+                      const std::string& stream_label) {
+    const auto period_key = std::make_pair(crypto_period_index, stream_label);
+    auto requested = [this, &period_key]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(
+                         mutex_) { return num_requests_[period_key] > 0; };
+    const bool result = mutex_.LockWhenWithTimeout(
+        absl::Condition(&requested), absl::Seconds(10));
+    mutex_.Unlock();
+    return result;
+  }
+
+ private:
+  absl::Mutex mutex_;
+  std::map<std::pair<uint32_t, std::string>, int> num_requests_
+      ABSL_GUARDED_BY(mutex_);
+  std::set<std::pair<uint32_t, std::string>> failures_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace
+
+class PrefetchingKeySourceTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    std::unique_ptr<FakeKeySource> fake_key_source(new FakeKeySource);
+    fake_key_source_ = fake_key_source.get();
+    key_source_.reset(new PrefetchingKeySource(std::move(fake_key_source),
+                                               kNumPrefetchPeriods));
+  }
+
+ protected:
+  Status GetCryptoPeriodKey(uint32_t crypto_period_index,
+                            const std::string& stream_label,
+                            EncryptionKey* key) {
+    return key_source_->GetCryptoPeriodKey(crypto_period_index,
+                                           kCryptoPeriodDurationInSeconds,
+                                           stream_label, key);
+  }
+
+  FakeKeySource* fake_key_source_ = nullptr;
+  std::unique_ptr<PrefetchingKeySource> key_source_;
+};
+
+TEST_F(PrefetchingKeySourceTest, GetKey) {
+  EncryptionKey key;
+  ASSERT_OK(key_source_->GetKey(kSdLabel, &key));
+  EXPECT_EQ(std::vector<uint8_t>({'S', 'D'}), key.key_id);
+}
+
+TEST_F(PrefetchingKeySourceTest, PrefetchesFollowingPeriods) {
+  EncryptionKey key;
+  ASSERT_OK(GetCryptoPeriodKey(5, kSdLabel, &key));
+  EXPECT_EQ(FakeKeySource::MakeKey(5, kSdLabel).key_id, key.key_id);
+
+  ASSERT_TRUE(fake_key_source_->WaitForRequest(6, kSdLabel));
+  ASSERT_TRUE(fake_key_source_->WaitForRequest(7, kSdLabel));
+
+  ASSERT_OK(GetCryptoPeriodKey(6, kSdLabel, &key));
+  EXPECT_EQ(FakeKeySource::MakeKey(6, kSdLabel).key_id, key.key_id);
+  ASSERT_TRUE(fake_key_source_->WaitForRequest(8, kSdLabel));
+
+  EXPECT_EQ(1, fake_key_source_->NumRequests(5, kSdLabel));
+  EXPECT_EQ(1, fake_key_source_->NumRequests(6, kSdLabel));
+  EXPECT_EQ(0, fake_key_source_->NumRequests(9, kSdLabel));
+}
+
+TEST_F(PrefetchingKeySourceTest, SharesKeysAcrossStreams) {
+  EncryptionKey key;
+  ASSERT_OK(GetCryptoPeriodKey(0, kSdLabel, &key));
+  ASSERT_OK(GetCryptoPeriodKey(0, kHdLabel, &key));
+  EXPECT_EQ(FakeKeySource::MakeKey(0, kHdLabel).key_id, key.key_id);
+  // Another rendition with the same stream label.
+  ASSERT_OK(GetCryptoPeriodKey(0, kSdLabel, &key));
+  EXPECT_EQ(FakeKeySource::MakeKey(0, kSdLabel).key_id, key.key_id);
+
+  // The following periods are prefetched for both stream labels.
+  ASSERT_TRUE(fake_key_source_->WaitForRequest(1, kSdLabel));
+  ASSERT_TRUE(fake_key_source_->WaitForRequest(1, kHdLabel));
+  ASSERT_OK(GetCryptoPeriodKey(1, kSdLabel, &key));
+  ASSERT_OK(GetCryptoPeriodKey(1, kHdLabel, &key));
+  ASSERT_OK(GetCryptoPeriodKey(1, kHdLabel, &key));
+
+  EXPECT_EQ(1, fake_key_source_->NumRequests(0, kSdLabel));
+  EXPECT_EQ(1, fake_key_source_->NumRequests(0, kHdLabel));
+  EXPECT_EQ(1, fake_key_source_->NumRequests(1, kSdLabel));
+  EXPECT_EQ(1, fake_key_source_->NumRequests(1, kHdLabel));
+}
+
+TEST_F(PrefetchingKeySourceTest, RetriesFailedPrefetch) {
+  fake_key_source_->FailOnce(1, kSdLabel);
+
+  EncryptionKey key;
+  ASSERT_OK(GetCryptoPeriodKey(0, kSdLabel, &key));
+  ASSERT_TRUE(fake_key_source_->WaitForRequest(1, kSdLabel));
+  ASSERT_OK(GetCryptoPeriodKey(1, kSdLabel, &key));
+  EXPECT_EQ(FakeKeySource::MakeKey(1, kSdLabel).key_id, key.key_id);
+  EXPECT_EQ(2, fake_key_source_->NumRequests(1, kSdLabel));
+}
+
+TEST_F(PrefetchingKeySourceTest, Failure) {
+  fake_key_source_->FailOnce(0, kSdLabel);
+
+  EncryptionKey key;
+  EXPECT_EQ(error::SERVER_ERROR,
+            GetCryptoPeriodKey(0, kSdLabel, &key).error_code());
+  // Failures are not cached.
+  ASSERT_OK(GetCryptoPeriodKey(0, kSdLabel, &key));
+}
+
+TEST_F(PrefetchingKeySourceTest, CryptoPeriodDurationChanged) {
+  EncryptionKey key;
+  ASSERT_OK(GetCryptoPeriodKey(0, kSdLabel, &key));
+  EXPECT_EQ(error::INVALID_ARGUMENT,
+            key_source_
+                ->GetCryptoPeriodKey(1, kCryptoPeriodDurationInSeconds + 1,
+                                     kSdLabel, &key)
+                .error_code());
+}
+
+}  // namespace media
+}  // namespace shaka
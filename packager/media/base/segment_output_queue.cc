@@ -0,0 +1,274 @@
+// Copyright 2024 Google LLC. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <packager/media/base/segment_output_queue.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <absl/log/check.h>
+#include <absl/log/log.h>
+
+#include <packager/file.h>
+#include <packager/media/base/buffer_writer.h>
+#include <packager/media/base/muxer_options.h>
+#include <packager/media/base/stream_info.h>
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+Status WriteSegmentFile(const std::string& file_name,
+                        const std::vector<std::vector<uint8_t>>& data) {
+  File* file = File::Open(file_name.c_str(), "w");
+  if (!file)
+    return Status(error::FILE_FAILURE, "Cannot open file for write " + file_name);
+  for (const std::vector<uint8_t>& chunk : data) {
+    size_t bytes_written = 0;
+    while (bytes_written < chunk.size()) {
+      const int64_t size = file->Write(chunk.data() + bytes_written,
+                                       chunk.size() - bytes_written);
+      if (size <= 0) {
+        file->Close();
+        return Status(error::FILE_FAILURE, "Cannot write to file " + file_name);
+      }
+      bytes_written += size;
+    }
+  }
+  // Close the file, which also does flushing, to make sure the file is written
+  // before the listener is notified.
+  if (!file->Close()) {
+    return Status(
+        error::FILE_FAILURE,
+        "Cannot close file " + file_name +
+            ", possibly file permission issue or running out of disk space.");
+  }
+  return Status::OK;
+}
+
+}  // namespace
+
+SegmentOutputQueue::SegmentOutputQueue(size_t max_pending_segments)
+    : max_pending_segments_(max_pending_segments) {
+  DCHECK_GT(max_pending_segments_, 0u);
+  thread_ = std::thread(&SegmentOutputQueue::ThreadMain, this);
+}
+
+SegmentOutputQueue::~SegmentOutputQueue() {
+  {
+    absl::MutexLock lock(mutex_);
+    terminated_ = true;
+    task_posted_.Signal();
+  }
+  thread_.join();
+}
+
+Status SegmentOutputQueue::PostSegment(const std::string& file_name,
+                                       BufferWriter* segment_buffer) {
+  DCHECK(segment_buffer);
+  Task task;
+  task.file_name = file_name;
+  task.data.resize(1);
+  segment_buffer->SwapBuffer(&task.data[0]);
+  return PostSegmentTask(std::move(task));
+}
+
+Status SegmentOutputQueue::PostSegment(const std::string& file_name,
+                                       BufferWriter* segment_header,
+                                       BufferWriter* segment_body) {
+  DCHECK(segment_header);
+  DCHECK(segment_body);
+  Task task;
+  task.file_name = file_name;
+  task.data.resize(2);
+  segment_header->SwapBuffer(&task.data[0]);
+  segment_body->SwapBuffer(&task.data[1]);
+  return PostSegmentTask(std::move(task));
+}
+
+Status SegmentOutputQueue::PostSegmentTask(Task task) {
+  absl::MutexLock lock(mutex_);
+  while (status_.ok() && num_pending_segments_ >= max_pending_segments_)
+    task_done_.Wait(&mutex_);
+  if (!status_.ok())
+    return status_;
+  ++num_pending_segments_;
+  tasks_.push_back(std::move(task));
+  task_posted_.Signal();
+  return Status::OK;
+}
+
+void SegmentOutputQueue::PostEvent(std::function<void()> event) {
+  Task task;
+  task.event = std::move(event);
+
+  absl::MutexLock lock(mutex_);
+  if (!status_.ok())
+    return;
+  tasks_.push_back(std::move(task));
+  task_posted_.Signal();
+}
+
+Status SegmentOutputQueue::Flush() {
+  absl::MutexLock lock(mutex_);
+  while (!tasks_.empty() || running_task_)
+    task_done_.Wait(&mutex_);
+  return status_;
+}
+
+Status SegmentOutputQueue::status() {
+  absl::MutexLock lock(mutex_);
+  return status_;
+}
+
+void SegmentOutputQueue::ThreadMain() {
+  while (true) {
+    Task task;
+    {
+      absl::MutexLock lock(mutex_);
+      // Tasks posted before termination are still completed.
+      while (!terminated_ && tasks_.empty())
+        task_posted_.Wait(&mutex_);
+      if (tasks_.empty())
+        return;
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+      running_task_ = true;
+    }
+
+    Status status;
+    if (task.event)
+      task.event();
+    else
+      status = WriteSegmentFile(task.file_name, task.data);
+
+    absl::MutexLock lock(mutex_);
+    running_task_ = false;
+    if (!task.event)
+      --num_pending_segments_;
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to write segment: " << status;
+      status_ = status;
+      // Nothing is written or notified after a missing segment.
+      for (const Task& dropped_task : tasks_) {
+        if (!dropped_task.event)
+          --num_pending_segments_;
+      }
+      tasks_.clear();
+    }
+    task_done_.SignalAll();
+  }
+}
+
+QueuedMuxerListener::QueuedMuxerListener(
+    std::unique_ptr<MuxerListener> listener,
+    SegmentOutputQueue* queue)
+    : listener_(std::move(listener)), queue_(queue) {
+  DCHECK(listener_);
+  DCHECK(queue_);
+}
+
+void QueuedMuxerListener::OnEncryptionInfoReady(
+    bool is_initial_encryption_info,
+    FourCC protection_scheme,
+    const std::vector<uint8_t>& key_id,
+    const std::vector<uint8_t>& iv,
+    const std::vector<ProtectionSystemSpecificInfo>& key_system_info) {
+  std::shared_ptr<MuxerListener> listener = listener_;
+  queue_->PostEvent([listener, is_initial_encryption_info, protection_scheme,
+                     key_id, iv, key_system_info]() {
+    listener->OnEncryptionInfoReady(is_initial_encryption_info,
+                                    protection_scheme, key_id, iv,
+                                    key_system_info);
+  });
+}
+
+void QueuedMuxerListener::OnEncryptionStart() {
+  std::shared_ptr<MuxerListener> listener = listener_;
+  queue_->PostEvent([listener]() { listener->OnEncryptionStart(); });
+}
+
+void QueuedMuxerListener::OnMediaStart(const MuxerOptions& muxer_options,
+                                       const StreamInfo& stream_info,
+                                       int32_t time_scale,
+                                       ContainerType container_type) {
+  // Manifests list the streams in the order they start, so the start is
+  // notified in pipeline order, once the earlier events have run, rather than
+  // racing with the queues of the other muxers. A write error is returned by
+  // the next call to the queue.
+  queue_->Flush();
+  listener_->OnMediaStart(muxer_options, stream_info, time_scale,
+                          container_type);
+}
+
+void QueuedMuxerListener::OnAvailabilityOffsetReady() {
+  std::shared_ptr<MuxerListener> listener = listener_;
+  queue_->PostEvent([listener]() { listener->OnAvailabilityOffsetReady(); });
+}
+
+void QueuedMuxerListener::OnSampleDurationReady(int32_t sample_duration) {
+  std::shared_ptr<MuxerListener> listener = listener_;
+  queue_->PostEvent([listener, sample_duration]() {
+    listener->OnSampleDurationReady(sample_duration);
+  });
+}
+
+void QueuedMuxerListener::OnSegmentDurationReady() {
+  std::shared_ptr<MuxerListener> listener = listener_;
+  queue_->PostEvent([listener]() { listener->OnSegmentDurationReady(); });
+}
+
+void QueuedMuxerListener::OnMediaEnd(const MediaRanges& media_ranges,
+                                     float duration_seconds) {
+  std::shared_ptr<MuxerListener> listener = listener_;
+  queue_->PostEvent([listener, media_ranges, duration_seconds]() {
+    listener->OnMediaEnd(media_ranges, duration_seconds);
+  });
+}
+
+void QueuedMuxerListener::OnNewSegment(const std::string& segment_name,
+                                       int64_t start_time,
+                                       int64_t duration,
+                                       uint64_t segment_file_size,
+                                       int64_t segment_number) {
+  std::shared_ptr<MuxerListener> listener = listener_;
+  queue_->PostEvent([listener, segment_name, start_time, duration,
+                     segment_file_size, segment_number]() {
+    listener->OnNewSegment(segment_name, start_time, duration,
+                           segment_file_size, segment_number);
+  });
+}
+
+void QueuedMuxerListener::OnCompletedSegment(int64_t duration,
+                                             uint64_t segment_file_size) {
+  std::shared_ptr<MuxerListener> listener = listener_;
+  queue_->PostEvent([listener, duration, segment_file_size]() {
+    listener->OnCompletedSegment(duration, segment_file_size);
+  });
+}
+
+void QueuedMuxerListener::OnKeyFrame(int64_t timestamp,
+                                     uint64_t start_byte_offset,
+                                     uint64_t size) {
+  std::shared_ptr<MuxerListener> listener = listener_;
+  queue_->PostEvent([listener, timestamp, start_byte_offset, size]() {
+    listener->OnKeyFrame(timestamp, start_byte_offset, size);
+  });
+}
+
+void QueuedMuxerListener::OnCueEvent(int64_t timestamp,
+                                     const std::string& cue_data) {
+  std::shared_ptr<MuxerListener> listener = listener_;
+  queue_->PostEvent([listener, timestamp, cue_data]() {
+    listener->OnCueEvent(timestamp, cue_data);
+  });
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,153 @@
+// Copyright 2024 Google LLC. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_MEDIA_BASE_SEGMENT_OUTPUT_QUEUE_H_
+#define PACKAGER_MEDIA_BASE_SEGMENT_OUTPUT_QUEUE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <absl/base/thread_annotations.h>
+#include <absl/synchronization/mutex.h>
+
+#include <packager/macros/classes.h>
+#include <packager/media/event/muxer_listener.h>
+#include <packager/status.h>
+
+namespace shaka {
+namespace media {
+
+class BufferWriter;
+
+/// Writes finished segments on a background thread, so that slow outputs, e.g.
+/// HTTP uploads, do not stall the media pipeline. Segment writes and muxer
+/// listener events run in the order they are posted, so a listener learns
+/// about a segment only after its file is written and closed.
+///
+/// Once a segment write fails, the later writes and events are dropped, and
+/// the error is returned to the media pipeline by the next call.
+class SegmentOutputQueue {
+ public:
+  /// @param max_pending_segments is the number of segments that can wait to
+  ///        be written. Posting a segment blocks while it is reached.
+  explicit SegmentOutputQueue(size_t max_pending_segments);
+  /// Waits for the posted writes and events to complete.
+  ~SegmentOutputQueue();
+
+  /// Writes the content of @a segment_buffer to a new file @a file_name in the
+  /// background. @a segment_buffer is empty afterwards.
+  /// @return the error of a previous write if one has failed, OK otherwise.
+  Status PostSegment(const std::string& file_name,
+                     BufferWriter* segment_buffer);
+
+  /// Same as above, except that the file contains @a segment_header followed
+  /// by @a segment_body. Both buffers are taken over without copying, and are
+  /// empty afterwards.
+  Status PostSegment(const std::string& file_name,
+                     BufferWriter* segment_header,
+                     BufferWriter* segment_body);
+
+  /// Runs @a event after everything posted before it.
+  void PostEvent(std::function<void()> event);
+
+  /// Waits for everything posted so far to complete.
+  /// @return the error of a write if one has failed, OK otherwise.
+  Status Flush();
+
+  /// @return the error of a write if one has failed, OK otherwise.
+  Status status();
+
+ private:
+  struct Task {
+    // Empty for events.
+    std::string file_name;
+    // Written one after the other.
+    std::vector<std::vector<uint8_t>> data;
+    std::function<void()> event;
+  };
+
+  Status PostSegmentTask(Task task);
+  void ThreadMain();
+
+  const size_t max_pending_segments_;
+
+  absl::Mutex mutex_;
+  absl::CondVar task_posted_ ABSL_GUARDED_BY(mutex_);
+  absl::CondVar task_done_ ABSL_GUARDED_BY(mutex_);
+  std::deque<Task> tasks_ ABSL_GUARDED_BY(mutex_);
+  size_t num_pending_segments_ ABSL_GUARDED_BY(mutex_) = 0;
+  // True while the background thread runs a task taken off |tasks_|.
+  bool running_task_ ABSL_GUARDED_BY(mutex_) = false;
+  Status status_ ABSL_GUARDED_BY(mutex_);
+  bool terminated_ ABSL_GUARDED_BY(mutex_) = false;
+
+  std::thread thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(SegmentOutputQueue);
+};
+
+/// A MuxerListener which forwards the events to another MuxerListener on a
+/// SegmentOutputQueue, keeping them in order with the segment writes.
+/// OnMediaStart() is the exception: it waits for the queue and is forwarded
+/// right away, so that streams start in the same order as without the queue.
+class QueuedMuxerListener : public MuxerListener {
+ public:
+  /// @param listener is the listener receiving the events.
+  /// @param queue is the queue running the events. It must outlive this
+  ///        object.
+  QueuedMuxerListener(std::unique_ptr<MuxerListener> listener,
+                      SegmentOutputQueue* queue);
+
+  /// @name MuxerListener implementation overrides.
+  /// @{
+  void OnEncryptionInfoReady(bool is_initial_encryption_info,
+                             FourCC protection_scheme,
+                             const std::vector<uint8_t>& key_id,
+                             const std::vector<uint8_t>& iv,
+                             const std::vector<ProtectionSystemSpecificInfo>&
+                                 key_system_info) override;
+  void OnEncryptionStart() override;
+  void OnMediaStart(const MuxerOptions& muxer_options,
+                    const StreamInfo& stream_info,
+                    int32_t time_scale,
+                    ContainerType container_type) override;
+  void OnAvailabilityOffsetReady() override;
+  void OnSampleDurationReady(int32_t sample_duration) override;
+  void OnSegmentDurationReady() override;
+  void OnMediaEnd(const MediaRanges& media_ranges,
+                  float duration_seconds) override;
+  void OnNewSegment(const std::string& segment_name,
+                    int64_t start_time,
+                    int64_t duration,
+                    uint64_t segment_file_size,
+                    int64_t segment_number) override;
+  void OnCompletedSegment(int64_t duration,
+                          uint64_t segment_file_size) override;
+  void OnKeyFrame(int64_t timestamp,
+                  uint64_t start_byte_offset,
+                  uint64_t size) override;
+  void OnCueEvent(int64_t timestamp, const std::string& cue_data) override;
+  /// @}
+
+ private:
+  QueuedMuxerListener(const QueuedMuxerListener&) = delete;
+  QueuedMuxerListener& operator=(const QueuedMuxerListener&) = delete;
+
+  // Shared with the posted events, which may run after this object is gone.
+  const std::shared_ptr<MuxerListener> listener_;
+  SegmentOutputQueue* const queue_;
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // PACKAGER_MEDIA_BASE_SEGMENT_OUTPUT_QUEUE_H_
@@ -0,0 +1,152 @@
+// Copyright 2024 Google LLC. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <packager/media/base/segment_output_queue.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <packager/file.h>
+#include <packager/file/file_test_util.h>
+#include <packager/file/memory_file.h>
+#include <packager/media/base/buffer_writer.h>
+#include <packager/media/base/muxer_options.h>
+#include <packager/media/base/video_stream_info.h>
+#include <packager/media/event/mock_muxer_listener.h>
+#include <packager/status/status_test_util.h>
+
+namespace shaka {
+namespace media {
+namespace {
+
+using ::testing::_;
+using ::testing::Invoke;
+
+const size_t kMaxPendingSegments = 2;
+const char kSegment1[] = "memory://segment1.m4s";
+const char kSegment2[] = "memory://segment2.m4s";
+const char kSegment3[] = "memory://segment3.m4s";
+const int64_t kStartTime = 0;
+const int64_t kDuration = 1000;
+const int64_t kSegmentNumber = 1;
+const int32_t kTimeScale = 90000;
+
+std::string ReadFile(const std::string& file_name) {
+  std::string contents;
+  if (!File::ReadFileToString(file_name.c_str(), &contents))
+    return "<missing>";
+  return contents;
+}
+
+}  // namespace
+
+class SegmentOutputQueueTest : public ::testing::Test {
+ protected:
+  void TearDown() override { MemoryFile::DeleteAll(); }
+
+  // Posts a segment containing |contents|.
+  Status PostSegment(const std::string& file_name,
+                     const std::string& contents) {
+    BufferWriter buffer;
+    buffer.AppendString(contents);
+    Status status = queue_.PostSegment(file_name, &buffer);
+    EXPECT_EQ(0u, buffer.Size());
+    return status;
+  }
+
+  SegmentOutputQueue queue_{kMaxPendingSegments};
+};
+
+TEST_F(SegmentOutputQueueTest, EventsFollowSegmentWrites) {
+  std::vector<std::string> seen_contents;
+  ASSERT_OK(PostSegment(kSegment1, "segment 1"));
+  queue_.PostEvent(
+      [&seen_contents]() { seen_contents.push_back(ReadFile(kSegment1)); });
+  ASSERT_OK(PostSegment(kSegment2, "segment 2"));
+  ASSERT_OK(PostSegment(kSegment3, "segment 3"));
+  queue_.PostEvent(
+      [&seen_contents]() { seen_contents.push_back(ReadFile(kSegment3)); });
+  ASSERT_OK(queue_.Flush());
+
+  EXPECT_THAT(seen_contents, ::testing::ElementsAre("segment 1", "segment 3"));
+  EXPECT_EQ("segment 2", ReadFile(kSegment2));
+}
+
+TEST_F(SegmentOutputQueueTest, SegmentHeaderAndBody) {
+  BufferWriter header;
+  header.AppendString("header ");
+  BufferWriter body;
+  body.AppendString("body");
+  ASSERT_OK(queue_.PostSegment(kSegment1, &header, &body));
+  EXPECT_EQ(0u, header.Size());
+  EXPECT_EQ(0u, body.Size());
+  ASSERT_OK(queue_.Flush());
+
+  EXPECT_EQ("header body", ReadFile(kSegment1));
+}
+
+TEST_F(SegmentOutputQueueTest, FailedWriteDropsLaterTasks) {
+  // A segment cannot be written under a regular file.
+  const std::string blocking_file = generate_unique_temp_path();
+  ASSERT_TRUE(File::WriteStringToFile(blocking_file.c_str(), "file"));
+  const std::string bad_segment =
+      (std::filesystem::u8path(blocking_file) / "segment.m4s").string();
+
+  bool event_run = false;
+  ASSERT_OK(PostSegment(bad_segment, "segment 1"));
+  queue_.PostEvent([&event_run]() { event_run = true; });
+  EXPECT_EQ(error::FILE_FAILURE, queue_.Flush().error_code());
+  EXPECT_FALSE(event_run);
+
+  EXPECT_EQ(error::FILE_FAILURE,
+            PostSegment(kSegment2, "segment 2").error_code());
+  EXPECT_EQ(error::FILE_FAILURE, queue_.status().error_code());
+  ASSERT_TRUE(File::Delete(blocking_file.c_str()));
+}
+
+TEST_F(SegmentOutputQueueTest, QueuedMuxerListener) {
+  std::unique_ptr<MockMuxerListener> mock_listener(new MockMuxerListener);
+  EXPECT_CALL(*mock_listener, OnNewSegment(kSegment1, kStartTime, kDuration,
+                                           9u, kSegmentNumber))
+      .WillOnce(Invoke([](const std::string& file_name, int64_t, int64_t,
+                          uint64_t, int64_t) {
+        EXPECT_EQ("segment 1", ReadFile(file_name));
+      }));
+  QueuedMuxerListener listener(std::move(mock_listener), &queue_);
+
+  ASSERT_OK(PostSegment(kSegment1, "segment 1"));
+  listener.OnNewSegment(kSegment1, kStartTime, kDuration, 9u, kSegmentNumber);
+  ASSERT_OK(queue_.Flush());
+}
+
+TEST_F(SegmentOutputQueueTest, QueuedMuxerListenerMediaStart) {
+  std::unique_ptr<MockMuxerListener> mock_listener(new MockMuxerListener);
+  bool media_started = false;
+  EXPECT_CALL(*mock_listener, OnMediaStart(_, _, _, _))
+      .WillOnce(Invoke([&media_started](const MuxerOptions&, const StreamInfo&,
+                                        int32_t, MuxerListener::ContainerType) {
+        EXPECT_EQ("segment 1", ReadFile(kSegment1));
+        media_started = true;
+      }));
+  QueuedMuxerListener listener(std::move(mock_listener), &queue_);
+
+  ASSERT_OK(PostSegment(kSegment1, "segment 1"));
+  MuxerOptions muxer_options;
+  VideoStreamInfo stream_info;
+  listener.OnMediaStart(muxer_options, stream_info, kTimeScale,
+                        MuxerListener::kContainerMp4);
+  // Forwarded without waiting for a flush.
+  EXPECT_TRUE(media_started);
+}
+
+}  // namespace media
+}  // namespace shaka
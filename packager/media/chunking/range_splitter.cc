@@ -0,0 +1,359 @@
+// Copyright 2024 Google LLC. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <packager/media/chunking/range_splitter.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <absl/log/check.h>
+#include <absl/log/log.h>
+
+#include <packager/macros/status.h>
+#include <packager/media/base/media_handler.h>
+#include <packager/media/base/media_sample.h>
+#include <packager/media/base/stream_info.h>
+#include <packager/media/chunking/chunking_handler.h>
+#include <packager/status.h>
+
+namespace shaka {
+namespace media {
+namespace {
+
+const size_t kStreamIndex = 0;
+// The ChunkingHandler unwraps timestamps in (-kMaxTimestamp, kMaxTimestamp)
+// with a constant offset once they are not negative, so the ranges chunk them
+// as the whole stream does.
+const int64_t kMaxTimestamp = 1ll << 32;
+
+// A segment of a chunked stream.
+struct ChunkedSegment {
+  // Index of the first sample of the segment.
+  size_t first_sample_index = 0;
+  int64_t segment_number = 0;
+  int64_t duration = 0;
+  // Number of fragments, i.e. subsegments, in the segment.
+  uint32_t num_fragments = 0;
+};
+
+// The result of chunking a stream.
+struct ChunkedStream {
+  std::vector<ChunkedSegment> segments;
+  // The first sample passed on by the ChunkingHandler.
+  std::shared_ptr<const MediaSample> first_sample;
+  // Sum of the durations of the samples passed on by the ChunkingHandler.
+  int64_t duration = 0;
+};
+
+// Feeds sample timings to the downstream handler.
+class SampleTimingFeeder : public MediaHandler {
+ public:
+  SampleTimingFeeder() = default;
+
+  Status Feed(std::shared_ptr<const StreamInfo> stream_info,
+              const std::vector<SampleTiming>& sample_timings) {
+    RETURN_IF_ERROR(DispatchStreamInfo(kStreamIndex, std::move(stream_info)));
+    for (sample_index_ = 0; sample_index_ < sample_timings.size();
+         ++sample_index_) {
+      const SampleTiming& timing = sample_timings[sample_index_];
+      std::shared_ptr<MediaSample> sample =
+          MediaSample::CreateEmptyMediaSample();
+      sample->set_pts(timing.pts);
+      sample->set_dts(timing.dts);
+      sample->set_duration(timing.duration);
+      sample->set_is_key_frame(timing.is_key_frame);
+      RETURN_IF_ERROR(DispatchMediaSample(kStreamIndex, std::move(sample)));
+    }
+    return FlushDownstream(kStreamIndex);
+  }
+
+  // Index of the sample being fed.
+  size_t sample_index() const { return sample_index_; }
+
+ protected:
+  Status InitializeInternal() override { return Status::OK; }
+  Status Process(std::unique_ptr<StreamData> /*stream_data*/) override {
+    return Status(error::INTERNAL_ERROR,
+                  "SampleTimingFeeder should not be the downstream handler.");
+  }
+  bool ValidateOutputStreamIndex(size_t stream_index) const override {
+    return stream_index == kStreamIndex;
+  }
+
+ private:
+  SampleTimingFeeder(const SampleTimingFeeder&) = delete;
+  SampleTimingFeeder& operator=(const SampleTimingFeeder&) = delete;
+
+  size_t sample_index_ = 0;
+};
+
+// Records the segments of a chunked stream.
+class SegmentRecorder : public MediaHandler {
+ public:
+  SegmentRecorder(const SampleTimingFeeder* feeder, ChunkedStream* stream)
+      : feeder_(feeder), stream_(stream) {}
+
+ protected:
+  Status InitializeInternal() override { return Status::OK; }
+
+  Status Process(std::unique_ptr<StreamData> stream_data) override {
+    switch (stream_data->stream_data_type) {
+      case StreamDataType::kMediaSample: {
+        // The ChunkingHandler passes on the samples as they are fed.
+        if (!segment_open_) {
+          ChunkedSegment segment;
+          segment.first_sample_index = feeder_->sample_index();
+          stream_->segments.push_back(segment);
+          segment_open_ = true;
+        }
+        if (!stream_->first_sample)
+          stream_->first_sample = stream_data->media_sample;
+        stream_->duration += stream_data->media_sample->duration();
+        break;
+      }
+      case StreamDataType::kSegmentInfo: {
+        DCHECK(segment_open_);
+        const SegmentInfo& segment_info = *stream_data->segment_info;
+        ChunkedSegment& segment = stream_->segments.back();
+        ++segment.num_fragments;
+        if (!segment_info.is_subsegment) {
+          segment.segment_number = segment_info.segment_number;
+          segment.duration = segment_info.duration;
+          segment_open_ = false;
+        }
+        break;
+      }
+      default:
+        break;
+    }
+    return Status::OK;
+  }
+
+  Status OnFlushRequest(size_t /*input_stream_index*/) override {
+    return Status::OK;
+  }
+
+ private:
+  SegmentRecorder(const SegmentRecorder&) = delete;
+  SegmentRecorder& operator=(const SegmentRecorder&) = delete;
+
+  const SampleTimingFeeder* const feeder_;
+  ChunkedStream* const stream_;
+  bool segment_open_ = false;
+};
+
+Status ChunkStream(const ChunkingParams& chunking_params,
+                   std::shared_ptr<const StreamInfo> stream_info,
+                   const std::vector<SampleTiming>& sample_timings,
+                   ChunkedStream* chunked_stream) {
+  auto feeder = std::make_shared<SampleTimingFeeder>();
+  RETURN_IF_ERROR(MediaHandler::Chain(
+      {feeder, std::make_shared<ChunkingHandler>(chunking_params),
+       std::make_shared<SegmentRecorder>(feeder.get(), chunked_stream)}));
+  RETURN_IF_ERROR(feeder->Initialize());
+  return feeder->Feed(std::move(stream_info), sample_timings);
+}
+
+bool HasSmallTimestamps(const std::vector<SampleTiming>& sample_timings) {
+  for (const SampleTiming& timing : sample_timings) {
+    if (timing.pts <= -kMaxTimestamp || timing.dts <= -kMaxTimestamp ||
+        timing.duration < 0 || timing.pts + timing.duration >= kMaxTimestamp) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns the index of the first sample after the samples with negative
+// presentation timestamps, e.g. from edit lists.
+size_t GetFirstNonNegativeSampleIndex(
+    const std::vector<SampleTiming>& sample_timings) {
+  size_t index = 0;
+  for (size_t i = 0; i < sample_timings.size(); ++i) {
+    if (sample_timings[i].pts < 0)
+      index = i + 1;
+  }
+  return index;
+}
+
+}  // namespace
+
+RangeSplitter::RangeSplitter(const ChunkingParams& chunking_params,
+                             double clear_lead_in_seconds,
+                             double crypto_period_duration_in_seconds)
+    : chunking_params_(chunking_params),
+      clear_lead_in_seconds_(clear_lead_in_seconds),
+      crypto_period_duration_in_seconds_(crypto_period_duration_in_seconds) {}
+
+Status RangeSplitter::Split(
+    const std::vector<std::shared_ptr<StreamInfo>>& stream_infos,
+    const std::vector<std::vector<SampleTiming>>& sample_timings,
+    size_t max_ranges,
+    std::vector<std::vector<StreamRange>>* ranges) const {
+  DCHECK_EQ(stream_infos.size(), sample_timings.size());
+  DCHECK(ranges);
+
+  ranges->assign(1, std::vector<StreamRange>(stream_infos.size()));
+  for (StreamRange& stream_range : ranges->front())
+    stream_range.first_segment_number = chunking_params_.start_segment_number;
+  if (max_ranges < 2 || stream_infos.empty())
+    return Status::OK;
+
+  std::vector<ChunkedStream> chunked_streams(stream_infos.size());
+  // Segment time index -> segment index, for the segments each stream can be
+  // split at.
+  std::vector<std::map<int64_t, size_t>> split_points(stream_infos.size());
+  double end_time_in_seconds = 0;
+  for (size_t i = 0; i < stream_infos.size(); ++i) {
+    const StreamInfo& stream_info = *stream_infos[i];
+    const std::vector<SampleTiming>& timings = sample_timings[i];
+    if (!HasSmallTimestamps(timings)) {
+      VLOG(1) << "Not splitting stream " << i << " with large timestamps.";
+      return Status::OK;
+    }
+    ChunkedStream& chunked_stream = chunked_streams[i];
+    RETURN_IF_ERROR(ChunkStream(chunking_params_, stream_infos[i], timings,
+                                &chunked_stream));
+    if (chunked_stream.segments.empty())
+      return Status::OK;
+
+    const int32_t time_scale = stream_info.time_scale();
+    // Computed as in ChunkingHandler and EncryptionHandler.
+    const int64_t segment_duration =
+        chunking_params_.segment_duration_in_seconds * time_scale;
+    if (segment_duration <= 0)
+      return Status::OK;
+    int64_t remaining_clear_lead = clear_lead_in_seconds_ * time_scale;
+    const int64_t crypto_period_duration =
+        crypto_period_duration_in_seconds_ * time_scale;
+
+    const size_t first_non_negative_sample_index =
+        GetFirstNonNegativeSampleIndex(timings);
+
+    std::set<int64_t> duplicate_time_indexes;
+    for (size_t j = 0; j < chunked_stream.segments.size(); ++j) {
+      const ChunkedSegment& segment = chunked_stream.segments[j];
+      const size_t sample_index = segment.first_sample_index;
+      const int64_t time_index = timings[sample_index].pts / segment_duration;
+      const bool after_clear_lead = remaining_clear_lead <= 0;
+      if (remaining_clear_lead > 0)
+        remaining_clear_lead -= segment.duration;
+      // The first segment is never split at, nor the segments before the
+      // timestamps the ChunkingHandler unwraps with their final offset.
+      if (j == 0 || sample_index < first_non_negative_sample_index)
+        continue;
+      // The earlier samples must all be decoded before the segment.
+      if (timings[sample_index].dts <= timings[sample_index - 1].dts)
+        continue;
+      if (!after_clear_lead)
+        continue;
+      if (crypto_period_duration > 0) {
+        const size_t previous_sample_index =
+            chunked_stream.segments[j - 1].first_sample_index;
+        if (timings[sample_index].dts / crypto_period_duration ==
+            timings[previous_sample_index].dts / crypto_period_duration) {
+          continue;
+        }
+      }
+      if (!split_points[i].emplace(time_index, j).second)
+        duplicate_time_indexes.insert(time_index);
+    }
+    for (int64_t time_index : duplicate_time_indexes)
+      split_points[i].erase(time_index);
+
+    const SampleTiming& last_timing = timings.back();
+    end_time_in_seconds =
+        std::max(end_time_in_seconds,
+                 static_cast<double>(last_timing.pts + last_timing.duration) /
+                     time_scale);
+  }
+
+  // The time indexes all the streams can be split at.
+  std::vector<int64_t> shared_time_indexes;
+  for (const auto& entry : split_points.front()) {
+    const int64_t time_index = entry.first;
+    bool shared = true;
+    for (const auto& stream_split_points : split_points)
+      shared = shared && stream_split_points.count(time_index) > 0;
+    if (shared)
+      shared_time_indexes.push_back(time_index);
+  }
+
+  // Split at the time indexes closest after evenly spaced times.
+  std::vector<int64_t> split_time_indexes;
+  auto next = shared_time_indexes.begin();
+  for (size_t r = 1; r < max_ranges; ++r) {
+    const double target_time_in_seconds =
+        end_time_in_seconds * r / max_ranges;
+    while (next != shared_time_indexes.end() &&
+           *next * chunking_params_.segment_duration_in_seconds <
+               target_time_in_seconds) {
+      ++next;
+    }
+    if (next == shared_time_indexes.end())
+      break;
+    split_time_indexes.push_back(*next++);
+  }
+  if (split_time_indexes.empty())
+    return Status::OK;
+
+  // Index of the first segment of each range in each stream, with an end
+  // marker.
+  std::vector<std::vector<size_t>> first_segments(stream_infos.size());
+  for (size_t i = 0; i < stream_infos.size(); ++i) {
+    first_segments[i].push_back(0);
+    for (int64_t time_index : split_time_indexes)
+      first_segments[i].push_back(split_points[i].at(time_index));
+    first_segments[i].push_back(chunked_streams[i].segments.size());
+    if (std::adjacent_find(first_segments[i].begin(), first_segments[i].end(),
+                           std::greater_equal<size_t>()) !=
+        first_segments[i].end()) {
+      LOG(WARNING) << "Not splitting stream " << i
+                   << " with out of order segments.";
+      return Status::OK;
+    }
+  }
+
+  const size_t num_ranges = split_time_indexes.size() + 1;
+  ranges->assign(num_ranges, std::vector<StreamRange>(stream_infos.size()));
+  for (size_t i = 0; i < stream_infos.size(); ++i) {
+    const ChunkedStream& chunked_stream = chunked_streams[i];
+    const std::vector<SampleTiming>& timings = sample_timings[i];
+    uint32_t preceding_fragments = 0;
+    for (size_t r = 0; r < num_ranges; ++r) {
+      StreamRange& stream_range = (*ranges)[r][i];
+      const ChunkedSegment& first_segment =
+          chunked_stream.segments[first_segments[i][r]];
+      if (r > 0) {
+        stream_range.start_dts = timings[first_segment.first_sample_index].dts;
+        (*ranges)[r - 1][i].end_dts = stream_range.start_dts;
+      }
+      stream_range.first_segment_number =
+          r > 0 ? first_segment.segment_number
+                : chunking_params_.start_segment_number;
+
+      MuxerRangeOptions& muxer_range = stream_range.muxer_range;
+      muxer_range.is_first_range = r == 0;
+      muxer_range.stream_start_pts = chunked_stream.first_sample->pts();
+      muxer_range.stream_start_dts = chunked_stream.first_sample->dts();
+      muxer_range.stream_duration = chunked_stream.duration;
+      muxer_range.preceding_fragments = preceding_fragments;
+      for (size_t j = first_segments[i][r]; j < first_segments[i][r + 1]; ++j)
+        preceding_fragments += chunked_stream.segments[j].num_fragments;
+    }
+  }
+  return Status::OK;
+}
+
+}  // namespace media
+}  // namespace shaka
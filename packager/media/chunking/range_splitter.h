@@ -0,0 +1,81 @@
+// Copyright 2024 Google LLC. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_MEDIA_CHUNKING_RANGE_SPLITTER_H_
+#define PACKAGER_MEDIA_CHUNKING_RANGE_SPLITTER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <packager/chunking_params.h>
+#include <packager/media/base/media_sample.h>
+#include <packager/media/base/muxer_options.h>
+#include <packager/status.h>
+
+namespace shaka {
+namespace media {
+
+class StreamInfo;
+
+/// The part of a stream in one time range.
+struct StreamRange {
+  /// The range has the samples with decoding timestamps in
+  /// [start_dts, end_dts).
+  int64_t start_dts = std::numeric_limits<int64_t>::min();
+  int64_t end_dts = std::numeric_limits<int64_t>::max();
+  /// Number of the first segment of the range.
+  int64_t first_segment_number = 1;
+  /// Options of the muxers of the range.
+  MuxerRangeOptions muxer_range;
+};
+
+/// RangeSplitter splits the streams of an input into consecutive time ranges
+/// which can be packaged independently, e.g. in parallel, with the same result
+/// as packaging the streams as a whole.
+///
+/// The sample timings of each stream are chunked up front by a
+/// ChunkingHandler, so that the ranges start at segment boundaries. A range
+/// starts at a segment boundary shared by all the streams, after the clear
+/// lead, and at the start of a crypto period if keys are rotated, so that
+/// every range starts in the same encryption state.
+class RangeSplitter {
+ public:
+  /// @param chunking_params are the params the streams are chunked with.
+  /// @param clear_lead_in_seconds is the clear lead of the encrypted streams.
+  /// @param crypto_period_duration_in_seconds is the crypto period duration
+  ///        of the encrypted streams, or zero without key rotation.
+  RangeSplitter(const ChunkingParams& chunking_params,
+                double clear_lead_in_seconds,
+                double crypto_period_duration_in_seconds);
+
+  /// Splits the streams into time ranges of similar duration.
+  /// @param stream_infos are the streams of the input.
+  /// @param sample_timings are the sample timings of each stream, in decoding
+  ///        order.
+  /// @param max_ranges is the maximum number of ranges.
+  /// @param[out] ranges gets the ranges, each with the range of every stream.
+  ///        It has a single range if the streams cannot be split.
+  Status Split(const std::vector<std::shared_ptr<StreamInfo>>& stream_infos,
+               const std::vector<std::vector<SampleTiming>>& sample_timings,
+               size_t max_ranges,
+               std::vector<std::vector<StreamRange>>* ranges) const;
+
+ private:
+  RangeSplitter(const RangeSplitter&) = delete;
+  RangeSplitter& operator=(const RangeSplitter&) = delete;
+
+  const ChunkingParams chunking_params_;
+  const double clear_lead_in_seconds_;
+  const double crypto_period_duration_in_seconds_;
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // PACKAGER_MEDIA_CHUNKING_RANGE_SPLITTER_H_
@@ -0,0 +1,171 @@
+// Copyright 2024 Google LLC. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <packager/media/chunking/range_splitter.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <packager/chunking_params.h>
+#include <packager/media/base/media_handler_test_base.h>
+#include <packager/media/base/media_sample.h>
+#include <packager/media/base/stream_info.h>
+#include <packager/status/status_test_util.h>
+
+namespace shaka {
+namespace media {
+namespace {
+
+const int32_t kTimeScale = 1000;
+// 3 one second segments of 100ms video frames with a key frame every second,
+// and of 50ms audio frames.
+const size_t kNumVideoSamples = 30;
+const int64_t kVideoSampleDuration = 100;
+const size_t kKeyFrameInterval = 10;
+const size_t kNumAudioSamples = 60;
+const int64_t kAudioSampleDuration = 50;
+const int64_t kStreamDuration = 3000;
+const double kSegmentDurationInSeconds = 1;
+const double kSubsegmentDurationInSeconds = 0.5;
+const size_t kMaxRanges = 3;
+const size_t kVideoStream = 0;
+const size_t kAudioStream = 1;
+
+std::vector<SampleTiming> GetSampleTimings(int64_t start_time,
+                                           size_t num_samples,
+                                           int64_t sample_duration,
+                                           size_t key_frame_interval) {
+  std::vector<SampleTiming> timings(num_samples);
+  for (size_t i = 0; i < num_samples; ++i) {
+    timings[i].pts = start_time + i * sample_duration;
+    timings[i].dts = timings[i].pts;
+    timings[i].duration = sample_duration;
+    timings[i].is_key_frame = i % key_frame_interval == 0;
+  }
+  return timings;
+}
+
+}  // namespace
+
+class RangeSplitterTest : public MediaHandlerTestBase {
+ protected:
+  RangeSplitterTest() {
+    chunking_params_.segment_duration_in_seconds = kSegmentDurationInSeconds;
+    stream_infos_.push_back(GetVideoStreamInfo(kTimeScale));
+    stream_infos_.push_back(GetAudioStreamInfo(kTimeScale));
+    SetStartTime(0);
+  }
+
+  void SetStartTime(int64_t start_time) {
+    sample_timings_ = {
+        GetSampleTimings(start_time, kNumVideoSamples, kVideoSampleDuration,
+                         kKeyFrameInterval),
+        GetSampleTimings(start_time, kNumAudioSamples, kAudioSampleDuration,
+                         1)};
+  }
+
+  Status Split(double clear_lead_in_seconds,
+               double crypto_period_duration_in_seconds) {
+    RangeSplitter splitter(chunking_params_, clear_lead_in_seconds,
+                           crypto_period_duration_in_seconds);
+    return splitter.Split(stream_infos_, sample_timings_, kMaxRanges,
+                          &ranges_);
+  }
+
+  ChunkingParams chunking_params_;
+  std::vector<std::shared_ptr<StreamInfo>> stream_infos_;
+  std::vector<std::vector<SampleTiming>> sample_timings_;
+  std::vector<std::vector<StreamRange>> ranges_;
+};
+
+TEST_F(RangeSplitterTest, SplitsAtSegments) {
+  chunking_params_.subsegment_duration_in_seconds =
+      kSubsegmentDurationInSeconds;
+  chunking_params_.start_segment_number = 5;
+  ASSERT_OK(Split(0, 0));
+
+  ASSERT_EQ(3u, ranges_.size());
+  for (size_t i : {kVideoStream, kAudioStream}) {
+    EXPECT_EQ(std::numeric_limits<int64_t>::min(), ranges_[0][i].start_dts);
+    EXPECT_EQ(1000, ranges_[0][i].end_dts);
+    EXPECT_EQ(1000, ranges_[1][i].start_dts);
+    EXPECT_EQ(2000, ranges_[1][i].end_dts);
+    EXPECT_EQ(2000, ranges_[2][i].start_dts);
+    EXPECT_EQ(std::numeric_limits<int64_t>::max(), ranges_[2][i].end_dts);
+    for (size_t r = 0; r < ranges_.size(); ++r) {
+      const StreamRange& stream_range = ranges_[r][i];
+      EXPECT_EQ(static_cast<int64_t>(5 + r), stream_range.first_segment_number);
+      EXPECT_EQ(r == 0, stream_range.muxer_range.is_first_range);
+      EXPECT_EQ(0, stream_range.muxer_range.stream_start_pts);
+      EXPECT_EQ(0, stream_range.muxer_range.stream_start_dts);
+      EXPECT_EQ(kStreamDuration, stream_range.muxer_range.stream_duration);
+      // Video subsegments have no key frames to start at.
+      const uint32_t fragments_per_segment = i == kAudioStream ? 2 : 1;
+      EXPECT_EQ(fragments_per_segment * r,
+                stream_range.muxer_range.preceding_fragments);
+    }
+  }
+}
+
+TEST_F(RangeSplitterTest, SplitsAfterClearLead) {
+  ASSERT_OK(Split(1.5, 0));
+
+  ASSERT_EQ(2u, ranges_.size());
+  EXPECT_EQ(2000, ranges_[0][kVideoStream].end_dts);
+  EXPECT_EQ(2000, ranges_[1][kVideoStream].start_dts);
+  EXPECT_EQ(3, ranges_[1][kVideoStream].first_segment_number);
+}
+
+TEST_F(RangeSplitterTest, SplitsAtCryptoPeriods) {
+  ASSERT_OK(Split(0, 2));
+
+  ASSERT_EQ(2u, ranges_.size());
+  EXPECT_EQ(2000, ranges_[1][kVideoStream].start_dts);
+  EXPECT_EQ(2000, ranges_[1][kAudioStream].start_dts);
+}
+
+TEST_F(RangeSplitterTest, SplitsStreamsAtTheSameSegmentTime) {
+  // The video only has another key frame at 2.5 seconds, which starts its
+  // second segment at the time of the third audio segment.
+  for (size_t i = 0; i < kNumVideoSamples; ++i)
+    sample_timings_[kVideoStream][i].is_key_frame = i == 0 || i == 25;
+  ASSERT_OK(Split(0, 0));
+
+  ASSERT_EQ(2u, ranges_.size());
+  EXPECT_EQ(2500, ranges_[1][kVideoStream].start_dts);
+  EXPECT_EQ(2, ranges_[1][kVideoStream].first_segment_number);
+  EXPECT_EQ(2000, ranges_[1][kAudioStream].start_dts);
+  EXPECT_EQ(3, ranges_[1][kAudioStream].first_segment_number);
+  EXPECT_EQ(1u, ranges_[1][kVideoStream].muxer_range.preceding_fragments);
+  EXPECT_EQ(2u, ranges_[1][kAudioStream].muxer_range.preceding_fragments);
+}
+
+TEST_F(RangeSplitterTest, SplitsAfterNegativeTimestamps) {
+  // An audio frame before the start, e.g. from an edit list.
+  sample_timings_[kAudioStream] = GetSampleTimings(
+      -kAudioSampleDuration, kNumAudioSamples + 1, kAudioSampleDuration, 1);
+  ASSERT_OK(Split(0, 0));
+
+  ASSERT_EQ(3u, ranges_.size());
+  EXPECT_EQ(1000, ranges_[1][kAudioStream].start_dts);
+  EXPECT_EQ(-kAudioSampleDuration,
+            ranges_[1][kAudioStream].muxer_range.stream_start_pts);
+}
+
+TEST_F(RangeSplitterTest, DoesNotSplitLargeTimestamps) {
+  SetStartTime(int64_t{1} << 32);
+  ASSERT_OK(Split(0, 0));
+  EXPECT_EQ(1u, ranges_.size());
+}
+
+}  // namespace media
+}  // namespace shaka
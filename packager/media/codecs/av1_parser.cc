@@ -292,6 +292,12 @@ bool AV1Parser::ParseOpenBitstreamUnit(BitReader* reader,
       break;
     case OBU_FRAME_HEADER:
     case OBU_REDUNDENT_FRAME_HEADER:
+      if (frame_header_.seen_frame_header) {
+        // frame_header_copy(), which is identical to the frame header already
+        // parsed. Jump over the entire OBU without reading it.
+        RCHECK(reader->SkipBits(obu_size * 8));
+        return true;
+      }
       RCHECK(ParseFrameHeaderObu(obu_header, reader));
       break;
     case OBU_TILE_GROUP:
@@ -1681,11 +1687,15 @@ bool AV1Parser::ParseTileGroupObu(size_t size,
     RCHECK(reader->ReadBits(tile_bits, &tg_end));
   }
   RCHECK(ByteAlignment(reader));
+  RCHECK(tg_start <= tg_end && tg_end < num_tiles);
 
   const size_t end_bit_pos = reader->bit_position();
   const size_t header_bytes = (end_bit_pos - start_bit_pos) / 8;
   size -= header_bytes;
 
+  // Only the tile sizes are read; the tile payloads are skipped over.
+  tiles->reserve(tiles->size() + tg_end - tg_start + 1);
+
   for (int tile_num = tg_start; tile_num <= tg_end; tile_num++) {
     const bool last_tile = tile_num == tg_end;
     size_t tile_size = size;
@@ -34,6 +34,47 @@ TEST(AV1ParserTest, ParseIFrameSuccess) {
   EXPECT_THAT(tiles, ElementsAre(AV1Parser::Tile{0x1d, 0x4e1}));
 }
 
+// Same frame as in ParseIFrameSuccess, but with the frame header and the tile
+// group in separate OBUs and redundant frame headers in between.
+TEST(AV1ParserTest, ParseSeparateFrameHeaderAndTileGroupSuccess) {
+  const std::vector<uint8_t> buffer = ReadTestDataFile("av1-I-frame-320x240");
+  ASSERT_FALSE(buffer.empty());
+
+  // Temporal delimiter and sequence header OBUs.
+  const size_t kFrameObuOffset = 0x0b;
+  // Payload of the frame OBU after the OBU header and the obu_size.
+  const size_t kFrameHeaderOffset = 0x0e;
+  const size_t kTileOffset = 0x1d;
+
+  std::vector<uint8_t> frame_header(buffer.begin() + kFrameHeaderOffset,
+                                    buffer.begin() + kTileOffset);
+  // The frame header ends at a byte boundary; add trailing bits.
+  frame_header.push_back(0x80);
+
+  const uint8_t kFrameHeaderObu = 0x1a;
+  const uint8_t kRedundantFrameHeaderObu = 0x3a;
+  const uint8_t kTileGroupObu = 0x22;
+
+  std::vector<uint8_t> data(buffer.begin(), buffer.begin() + kFrameObuOffset);
+  for (uint8_t obu_header : {kFrameHeaderObu, kRedundantFrameHeaderObu,
+                             kRedundantFrameHeaderObu}) {
+    data.push_back(obu_header);
+    data.push_back(static_cast<uint8_t>(frame_header.size()));
+    data.insert(data.end(), frame_header.begin(), frame_header.end());
+  }
+  const size_t tile_size = buffer.size() - kTileOffset;
+  data.push_back(kTileGroupObu);
+  data.push_back(0x80 | (tile_size & 0x7f));
+  data.push_back(static_cast<uint8_t>(tile_size >> 7));
+  const size_t tile_offset = data.size();
+  data.insert(data.end(), buffer.begin() + kTileOffset, buffer.end());
+
+  AV1Parser parser;
+  std::vector<AV1Parser::Tile> tiles;
+  ASSERT_TRUE(parser.Parse(data.data(), data.size(), &tiles));
+  EXPECT_THAT(tiles, ElementsAre(AV1Parser::Tile{tile_offset, tile_size}));
+}
+
 TEST(AV1ParserTest, ParseConfigOBUSuccess) {
   const std::vector<uint8_t> buffer = ReadTestDataFile("av1-hdr-config.obu");
   ASSERT_FALSE(buffer.empty());
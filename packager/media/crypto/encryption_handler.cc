@@ -25,6 +25,7 @@
 #include <packager/media/base/aes_cryptor.h>
 #include <packager/media/base/common_pssh_generator.h>
 #include <packager/media/base/decrypt_config.h>
+#include <packager/media/base/decryptor_source.h>
 #include <packager/media/base/encryption_config.h>
 #include <packager/media/base/fourccs.h>
 #include <packager/media/base/key_source.h>
@@ -223,6 +224,13 @@ EncryptionHandler::EncryptionHandler(const EncryptionParams& encryption_params,
 
 EncryptionHandler::~EncryptionHandler() = default;
 
+void EncryptionHandler::SetDecryptionKeySource(
+    KeySource* decryption_key_source) {
+  DCHECK(decryption_key_source);
+  decryption_key_source_ = decryption_key_source;
+  decryptor_source_.reset(new DecryptorSource(decryption_key_source));
+}
+
 Status EncryptionHandler::InitializeInternal() {
   if (!encryption_params_.stream_label_func) {
     return Status(error::INVALID_ARGUMENT, "Stream label function not set.");
@@ -266,7 +274,9 @@ Status EncryptionHandler::Process(std::unique_ptr<StreamData> stream_data) {
 }
 
 Status EncryptionHandler::ProcessStreamInfo(const StreamInfo& clear_info) {
-  if (clear_info.is_encrypted()) {
+  // Encrypted input is decrypted sample by sample if a decryption key source
+  // is set.
+  if (clear_info.is_encrypted() && !decryptor_source_) {
     return Status(error::INVALID_ARGUMENT,
                   "Input stream is already encrypted.");
   }
@@ -324,29 +334,37 @@ Status EncryptionHandler::ProcessStreamInfo(const StreamInfo& clear_info) {
 }
 
 Status EncryptionHandler::ProcessMediaSample(
-    std::shared_ptr<const MediaSample> clear_sample) {
-  DCHECK(clear_sample);
+    std::shared_ptr<const MediaSample> sample) {
+  DCHECK(sample);
+
+  const bool is_encrypted_input = sample->is_encrypted();
+  if (is_encrypted_input && !decryptor_source_) {
+    return Status(error::INVALID_ARGUMENT,
+                  "Encrypted input sample without a decryption key source.");
+  }
 
   // AES-128 encrypts full TS segments in TsWriter, not individual samples.
   // Pass samples through as clear so TsWriter can build the unencrypted
   // transport stream buffer which is then encrypted as a whole unit.
   if (protection_scheme_ == kAes128ProtectionScheme) {
-    return DispatchMediaSample(kStreamIndex, std::move(clear_sample));
+    if (is_encrypted_input) {
+      RETURN_IF_ERROR(DecryptToClearBuffer(*sample));
+      std::shared_ptr<MediaSample> clear_sample(sample->Clone());
+      clear_sample->SetData(clear_buffer_.data(), clear_buffer_.size());
+      clear_sample->set_is_encrypted(false);
+      clear_sample->set_decrypt_config(nullptr);
+      sample = std::move(clear_sample);
+    }
+    return DispatchMediaSample(kStreamIndex, std::move(sample));
   }
 
-  // Process the frame even if the frame is not encrypted as the next
-  // (encrypted) frame may be dependent on this clear frame.
-  std::vector<SubsampleEntry> subsamples;
-  RETURN_IF_ERROR(subsample_generator_->GenerateSubsamples(
-      clear_sample->data(), clear_sample->data_size(), &subsamples));
-
   // Need to setup the encryptor for new segments even if this segment does not
   // need to be encrypted, so we can signal encryption metadata earlier to
   // allows clients to prefetch the keys.
   if (check_new_crypto_period_) {
     // |dts| can be negative, e.g. after EditList adjustments. Normalized to 0
     // in that case.
-    const int64_t dts = std::max(clear_sample->dts(), static_cast<int64_t>(0));
+    const int64_t dts = std::max(sample->dts(), static_cast<int64_t>(0));
     const int64_t current_crypto_period_index = dts / crypto_period_duration_;
     const int32_t crypto_period_duration_in_seconds = static_cast<int32_t>(
         encryption_params_.crypto_period_duration_in_seconds);
@@ -362,21 +380,60 @@ Status EncryptionHandler::ProcessMediaSample(
     check_new_crypto_period_ = false;
   }
 
+  // Input encrypted with the output key in the output scheme only needs the
+  // output key ID, so the payload is not touched.
+  if (is_encrypted_input && remaining_clear_lead_ <= 0 &&
+      CanReuseCiphertext(*sample)) {
+    const DecryptConfig& input_config = *sample->decrypt_config();
+    std::shared_ptr<MediaSample> cipher_sample(sample->Clone());
+    cipher_sample->set_decrypt_config(std::unique_ptr<DecryptConfig>(
+        new DecryptConfig(encryption_config_->key_id, input_config.iv(),
+                          input_config.subsamples(), protection_scheme_,
+                          crypt_byte_block_, skip_byte_block_)));
+    return DispatchMediaSample(kStreamIndex, std::move(cipher_sample));
+  }
+
+  // Other encrypted input is decrypted into |clear_buffer_| and encrypted
+  // from there while it is still in cache, rather than being decrypted into
+  // a sample of its own.
+  const uint8_t* clear_data = sample->data();
+  const size_t clear_data_size = sample->data_size();
+  if (is_encrypted_input) {
+    RETURN_IF_ERROR(DecryptToClearBuffer(*sample));
+    clear_data = clear_buffer_.data();
+  }
+
+  // Process the frame even if the frame is not encrypted as the next
+  // (encrypted) frame may be dependent on this clear frame.
+  std::vector<SubsampleEntry> subsamples;
+  RETURN_IF_ERROR(subsample_generator_->GenerateSubsamples(
+      clear_data, clear_data_size, &subsamples));
+
   // Since there is no encryption needed right now, send the clear copy
   // downstream so we can save the costs of copying it.
   if (remaining_clear_lead_ > 0) {
-    return DispatchMediaSample(kStreamIndex, std::move(clear_sample));
+    if (is_encrypted_input) {
+      std::shared_ptr<MediaSample> clear_sample(sample->Clone());
+      clear_sample->SetData(clear_data, clear_data_size);
+      clear_sample->set_is_encrypted(false);
+      clear_sample->set_decrypt_config(nullptr);
+      sample = std::move(clear_sample);
+    }
+    return DispatchMediaSample(kStreamIndex, std::move(sample));
   }
 
-  size_t ciphertext_size =
-      encryptor_->RequiredOutputSize(clear_sample->data_size());
+  size_t ciphertext_size = encryptor_->RequiredOutputSize(clear_data_size);
 
   std::shared_ptr<uint8_t> cipher_sample_data(new uint8_t[ciphertext_size],
                                               std::default_delete<uint8_t[]>());
 
-  const uint8_t* source = clear_sample->data();
+  const uint8_t* source = clear_data;
   uint8_t* dest = cipher_sample_data.get();
   if (!subsamples.empty()) {
+    // The clear bytes are copied right away, while the bytes to encrypt are
+    // collected and encrypted in one batch.
+    std::vector<AesCryptor::CryptJob> crypt_jobs;
+    crypt_jobs.reserve(subsamples.size());
     size_t total_size = 0;
     for (const SubsampleEntry& subsample : subsamples) {
       if (subsample.clear_bytes > 0) {
@@ -388,20 +445,20 @@ Status EncryptionHandler::ProcessMediaSample(
       }
       if (subsample.cipher_bytes > 0) {
         // cipher_bytes is the number of bytes we want to encrypt
-        EncryptBytes(source, subsample.cipher_bytes, dest, ciphertext_size);
+        crypt_jobs.push_back({source, subsample.cipher_bytes, dest});
         source += subsample.cipher_bytes;
         dest += subsample.cipher_bytes;
         total_size += subsample.cipher_bytes;
       }
     }
-    DCHECK_EQ(total_size, clear_sample->data_size());
+    DCHECK_EQ(total_size, clear_data_size);
+    CHECK(encryptor_->CryptBatch(crypt_jobs));
   } else {
-    EncryptBytes(source, clear_sample->data_size(), dest, ciphertext_size);
+    EncryptBytes(source, clear_data_size, dest, ciphertext_size);
   }
 
-  std::shared_ptr<MediaSample> cipher_sample(clear_sample->Clone());
-  cipher_sample->TransferData(std::move(cipher_sample_data),
-                              clear_sample->data_size());
+  std::shared_ptr<MediaSample> cipher_sample(sample->Clone());
+  cipher_sample->TransferData(std::move(cipher_sample_data), clear_data_size);
 
   // Finish initializing the sample before sending it downstream. We must
   // wait until now to finish the initialization as we will lose access to
@@ -417,6 +474,55 @@ Status EncryptionHandler::ProcessMediaSample(
   return DispatchMediaSample(kStreamIndex, std::move(cipher_sample));
 }
 
+Status EncryptionHandler::DecryptToClearBuffer(const MediaSample& sample) {
+  if (!sample.decrypt_config()) {
+    return Status(error::INVALID_ARGUMENT,
+                  "Encrypted input sample without decrypt config.");
+  }
+  clear_buffer_.resize(sample.data_size());
+  if (!decryptor_source_->DecryptSampleBuffer(sample.decrypt_config(),
+                                              sample.data(), sample.data_size(),
+                                              clear_buffer_.data())) {
+    return Status(error::ENCRYPTION_FAILURE, "Failed to decrypt input sample.");
+  }
+  return Status::OK;
+}
+
+bool EncryptionHandler::CanReuseCiphertext(const MediaSample& sample) {
+  const DecryptConfig* input_config = sample.decrypt_config();
+  if (!input_config)
+    return false;
+  // The subsample layout of the input is reused, so the codecs whose
+  // subsample generator tracks state across frames are excluded: the state
+  // would be stale for the next re-encrypted frame.
+  if (codec_ == kCodecVP9 || codec_ == kCodecAV1)
+    return false;
+  if (input_config->protection_scheme() != protection_scheme_ ||
+      input_config->crypt_byte_block() != crypt_byte_block_ ||
+      input_config->skip_byte_block() != skip_byte_block_) {
+    return false;
+  }
+  // Mixing the per-sample IVs of the input with the ones of |encryptor_|
+  // could reuse an IV under the same key, so only constant IV schemes, where
+  // IV reuse is by design, are passed through.
+  if (encryption_config_->per_sample_iv_size != 0 ||
+      input_config->iv() != encryption_config_->constant_iv) {
+    return false;
+  }
+
+  auto iter = input_key_matches_.find(input_config->key_id());
+  if (iter == input_key_matches_.end()) {
+    EncryptionKey input_key;
+    const bool key_matches =
+        decryption_key_source_->GetKey(input_config->key_id(), &input_key)
+            .ok() &&
+        input_key.key == key_;
+    iter = input_key_matches_.emplace(input_config->key_id(), key_matches)
+               .first;
+  }
+  return iter->second;
+}
+
 void EncryptionHandler::SetupProtectionPattern(StreamType stream_type,
                                                Codec codec) {
   if ((stream_type == kStreamVideo || codec == kCodecAC4) &&
@@ -439,6 +545,8 @@ bool EncryptionHandler::CreateEncryptor(const EncryptionKey& encryption_key) {
   if (!encryptor)
     return false;
   encryptor_ = std::move(encryptor);
+  key_ = encryption_key.key;
+  input_key_matches_.clear();
 
   encryption_config_.reset(new EncryptionConfig);
   encryption_config_->protection_scheme = protection_scheme_;
@@ -9,6 +9,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -27,6 +28,7 @@ namespace media {
 
 class AesCryptor;
 class AesEncryptorFactory;
+class DecryptorSource;
 class SubsampleGenerator;
 struct EncryptionKey;
 
@@ -37,6 +39,15 @@ class EncryptionHandler : public MediaHandler {
 
   ~EncryptionHandler() override;
 
+  /// Enables re-encryption of encrypted input, i.e. streams the demuxer left
+  /// encrypted (see Demuxer::set_leave_samples_encrypted). Each sample is
+  /// decrypted and re-encrypted in one pass over a reused buffer; samples
+  /// already encrypted with the output key and scheme are passed through
+  /// with the output key ID.
+  /// @param decryption_key_source provides the keys of the input. It must
+  ///        outlive the handler.
+  void SetDecryptionKeySource(KeySource* decryption_key_source);
+
  protected:
   /// @name MediaHandler implementation overrides.
   /// @{
@@ -53,7 +64,12 @@ class EncryptionHandler : public MediaHandler {
   // Processes |stream_info| and sets up stream specific variables.
   Status ProcessStreamInfo(const StreamInfo& stream_info);
   // Processes media sample and encrypts it if needed.
-  Status ProcessMediaSample(std::shared_ptr<const MediaSample> clear_sample);
+  Status ProcessMediaSample(std::shared_ptr<const MediaSample> sample);
+  // Decrypts encrypted input |sample| into |clear_buffer_|.
+  Status DecryptToClearBuffer(const MediaSample& sample);
+  // Returns true if encrypted input |sample| can be output as is, as it is
+  // encrypted with the current key, scheme, pattern and constant IV.
+  bool CanReuseCiphertext(const MediaSample& sample);
 
   void SetupProtectionPattern(StreamType stream_type, Codec codec);
   bool CreateEncryptor(const EncryptionKey& encryption_key);
@@ -89,6 +105,8 @@ class EncryptionHandler : public MediaHandler {
   // Current encryption config and encryptor.
   std::shared_ptr<EncryptionConfig> encryption_config_;
   std::unique_ptr<AesCryptor> encryptor_;
+  // Key of |encryptor_|.
+  std::vector<uint8_t> key_;
   Codec codec_ = kUnknownCodec;
   // Remaining clear lead in the stream's time scale.
   int64_t remaining_clear_lead_ = 0;
@@ -104,6 +122,15 @@ class EncryptionHandler : public MediaHandler {
   uint8_t crypt_byte_block_ = 0;
   /// Number of unencrypted blocks (16-byte-block) in pattern based encryption.
   uint8_t skip_byte_block_ = 0;
+
+  // Set if encrypted input is re-encrypted.
+  KeySource* decryption_key_source_ = nullptr;
+  std::unique_ptr<DecryptorSource> decryptor_source_;
+  // Decrypted payload of the current encrypted input sample. Reused across
+  // samples, so that it stays allocated and cache resident.
+  std::vector<uint8_t> clear_buffer_;
+  // Input key ID to whether the input key equals |key_|.
+  std::map<std::vector<uint8_t>, bool> input_key_matches_;
 };
 
 }  // namespace media
@@ -21,6 +21,7 @@
 #include <packager/crypto_params.h>
 #include <packager/media/base/aes_cryptor.h>
 #include <packager/media/base/decrypt_config.h>
+#include <packager/media/base/decryptor_source.h>
 #include <packager/media/base/encryption_config.h>
 #include <packager/media/base/fourccs.h>
 #include <packager/media/base/media_handler.h>
@@ -742,5 +743,168 @@ TEST_F(EncryptionHandlerPsshTest, UsesKeyInfoFirst) {
       stream_info->encryption_config().key_system_info[0].psshs.empty());
 }
 
+namespace {
+
+const uint8_t kInputKeyId[]{
+    0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27,
+    0x28, 0x29, 0x30, 0x31, 0x32, 0x33, 0x34, 0x35,
+};
+const uint8_t kInputKey[]{
+    0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47,
+    0x48, 0x49, 0x50, 0x51, 0x52, 0x53, 0x54, 0x55,
+};
+
+std::unique_ptr<RawKeySource> CreateRawKeySource(
+    const std::vector<uint8_t>& key_id,
+    const std::vector<uint8_t>& key) {
+  RawKeyParams raw_key_params;
+  raw_key_params.key_map[""].key_id = key_id;
+  raw_key_params.key_map[""].key = key;
+  return RawKeySource::Create(raw_key_params);
+}
+
+}  // namespace
+
+class EncryptionHandlerReencryptionTest : public EncryptionHandlerTest {
+ public:
+  // The handler is set up by the tests.
+  void SetUp() override {}
+
+ protected:
+  void SetUpReencryption(FourCC protection_scheme,
+                         double clear_lead_in_seconds,
+                         const std::vector<uint8_t>& input_key) {
+    EncryptionParams encryption_params;
+    encryption_params.protection_scheme = protection_scheme;
+    encryption_params.clear_lead_in_seconds = clear_lead_in_seconds;
+    SetUpEncryptionHandler(encryption_params);
+
+    decryption_key_source_ = CreateRawKeySource(input_key_id_, input_key);
+    ASSERT_TRUE(decryption_key_source_);
+    encryption_handler_->SetDecryptionKeySource(decryption_key_source_.get());
+
+    EXPECT_CALL(mock_key_source_, GetKey(_, _))
+        .WillOnce(DoAll(SetArgPointee<1>(GetMockEncryptionKey()),
+                        Return(Status::OK)));
+    std::shared_ptr<StreamInfo> stream_info = GetAudioStreamInfo(kTimeScale);
+    stream_info->set_is_encrypted(true);
+    ASSERT_OK(
+        Process(StreamData::FromStreamInfo(kStreamIndex, stream_info)));
+  }
+
+  // Returns a sample with |kData| encrypted with |kInputKey| in 'cenc'.
+  std::shared_ptr<MediaSample> GetEncryptedInputSample(int64_t timestamp) {
+    const std::vector<uint8_t> input_key(std::begin(kInputKey),
+                                         std::end(kInputKey));
+    const std::vector<uint8_t> iv(std::begin(kIv), std::end(kIv));
+    std::unique_ptr<AesCryptor> encryptor =
+        AesEncryptorFactory().CreateEncryptor(FOURCC_cenc, 0, 0, kCodecAAC,
+                                              input_key, iv);
+    std::vector<uint8_t> encrypted_data(kDataSize);
+    size_t encrypted_data_size = encrypted_data.size();
+    EXPECT_TRUE(encryptor->Crypt(kData, kDataSize, encrypted_data.data(),
+                                 &encrypted_data_size));
+
+    std::shared_ptr<MediaSample> sample =
+        GetMediaSample(timestamp, kSampleDuration, kIsKeyFrame,
+                       encrypted_data.data(), encrypted_data.size());
+    sample->set_is_encrypted(true);
+    sample->set_decrypt_config(std::unique_ptr<DecryptConfig>(
+        new DecryptConfig(input_key_id_, iv, std::vector<SubsampleEntry>(),
+                          FOURCC_cenc, 0, 0)));
+    return sample;
+  }
+
+  const std::vector<uint8_t> input_key_id_{std::begin(kInputKeyId),
+                                           std::end(kInputKeyId)};
+  std::unique_ptr<RawKeySource> decryption_key_source_;
+};
+
+TEST_F(EncryptionHandlerReencryptionTest,
+       RejectsEncryptedInputWithoutDecryptionKeySource) {
+  SetUpEncryptionHandler(EncryptionParams());
+  std::shared_ptr<StreamInfo> stream_info = GetAudioStreamInfo(kTimeScale);
+  stream_info->set_is_encrypted(true);
+  ASSERT_EQ(error::INVALID_ARGUMENT,
+            Process(StreamData::FromStreamInfo(kStreamIndex, stream_info))
+                .error_code());
+}
+
+TEST_F(EncryptionHandlerReencryptionTest, ReencryptsWithOutputKey) {
+  SetUpReencryption(FOURCC_cenc, 0,
+                    std::vector<uint8_t>(std::begin(kInputKey),
+                                         std::end(kInputKey)));
+  std::shared_ptr<MediaSample> input_sample = GetEncryptedInputSample(0);
+  ASSERT_OK(Process(StreamData::FromMediaSample(kStreamIndex, input_sample)));
+
+  const auto& output_stream_data = GetOutputStreamDataVector();
+  ASSERT_THAT(output_stream_data,
+              ElementsAre(IsStreamInfo(kStreamIndex, kTimeScale, kEncrypted, _),
+                          IsMediaSample(kStreamIndex, 0, kSampleDuration,
+                                        kEncrypted, _)));
+  const MediaSample& sample = *output_stream_data.back()->media_sample;
+  EXPECT_EQ(std::vector<uint8_t>(std::begin(kKeyId), std::end(kKeyId)),
+            sample.decrypt_config()->key_id());
+
+  std::unique_ptr<RawKeySource> output_key_source = CreateRawKeySource(
+      std::vector<uint8_t>(std::begin(kKeyId), std::end(kKeyId)),
+      std::vector<uint8_t>(std::begin(kKey), std::end(kKey)));
+  DecryptorSource decryptor_source(output_key_source.get());
+  std::vector<uint8_t> decrypted_data(sample.data_size());
+  ASSERT_TRUE(decryptor_source.DecryptSampleBuffer(
+      sample.decrypt_config(), sample.data(), sample.data_size(),
+      decrypted_data.data()));
+  EXPECT_EQ(std::vector<uint8_t>(std::begin(kData), std::end(kData)),
+            decrypted_data);
+}
+
+TEST_F(EncryptionHandlerReencryptionTest, DecryptsInputInClearLead) {
+  const double kClearLeadInSeconds = 1.5;
+  SetUpReencryption(FOURCC_cenc, kClearLeadInSeconds,
+                    std::vector<uint8_t>(std::begin(kInputKey),
+                                         std::end(kInputKey)));
+  ASSERT_OK(Process(
+      StreamData::FromMediaSample(kStreamIndex, GetEncryptedInputSample(0))));
+
+  const auto& output_stream_data = GetOutputStreamDataVector();
+  ASSERT_THAT(output_stream_data,
+              ElementsAre(IsStreamInfo(kStreamIndex, kTimeScale, kEncrypted, _),
+                          IsMediaSample(kStreamIndex, 0, kSampleDuration,
+                                        !kEncrypted, _)));
+  const MediaSample& sample = *output_stream_data.back()->media_sample;
+  EXPECT_FALSE(sample.decrypt_config());
+  EXPECT_EQ(std::vector<uint8_t>(std::begin(kData), std::end(kData)),
+            std::vector<uint8_t>(sample.data(),
+                                 sample.data() + sample.data_size()));
+}
+
+TEST_F(EncryptionHandlerReencryptionTest, PassesThroughCiphertextOfOutputKey) {
+  // The input key is the output key, only with a different key ID.
+  SetUpReencryption(FOURCC_cbcs, 0,
+                    std::vector<uint8_t>(std::begin(kKey), std::end(kKey)));
+
+  // The payload is passed through as is, so it does not need to be actual
+  // ciphertext.
+  std::shared_ptr<MediaSample> input_sample =
+      GetMediaSample(0, kSampleDuration, kIsKeyFrame, kData, kDataSize);
+  input_sample->set_is_encrypted(true);
+  input_sample->set_decrypt_config(std::unique_ptr<DecryptConfig>(
+      new DecryptConfig(input_key_id_,
+                        std::vector<uint8_t>(std::begin(kIv), std::end(kIv)),
+                        std::vector<SubsampleEntry>(), FOURCC_cbcs, 0, 0)));
+  ASSERT_OK(Process(StreamData::FromMediaSample(kStreamIndex, input_sample)));
+
+  const auto& output_stream_data = GetOutputStreamDataVector();
+  ASSERT_THAT(output_stream_data,
+              ElementsAre(IsStreamInfo(kStreamIndex, kTimeScale, kEncrypted, _),
+                          IsMediaSample(kStreamIndex, 0, kSampleDuration,
+                                        kEncrypted, _)));
+  const MediaSample& sample = *output_stream_data.back()->media_sample;
+  EXPECT_EQ(input_sample->data(), sample.data());
+  EXPECT_EQ(std::vector<uint8_t>(std::begin(kKeyId), std::end(kKeyId)),
+            sample.decrypt_config()->key_id());
+  EXPECT_EQ(FOURCC_cbcs, sample.decrypt_config()->protection_scheme());
+}
+
 }  // namespace media
 }  // namespace shaka
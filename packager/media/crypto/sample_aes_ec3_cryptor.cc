@@ -100,21 +100,20 @@ bool SampleAesEc3Cryptor::CryptInternal(const uint8_t* text,
   // encrypted.
   const size_t kLeadingClearBytesSize = 16u;
 
+  crypt_jobs_.clear();
   for (size_t syncframe_size : syncframe_sizes) {
     memcpy(crypt_text, text, std::min(syncframe_size, kLeadingClearBytesSize));
     if (syncframe_size > kLeadingClearBytesSize) {
       // The residual block is left untouched (copied without
       // encryption/decryption). No need to do special handling here.
-      if (!cryptor_->Crypt(text + kLeadingClearBytesSize,
-                           syncframe_size - kLeadingClearBytesSize,
-                           crypt_text + kLeadingClearBytesSize)) {
-        return false;
-      }
+      crypt_jobs_.push_back({text + kLeadingClearBytesSize,
+                             syncframe_size - kLeadingClearBytesSize,
+                             crypt_text + kLeadingClearBytesSize});
     }
     text += syncframe_size;
     crypt_text += syncframe_size;
   }
-  return true;
+  return cryptor_->CryptBatch(crypt_jobs_);
 }
 
 void SampleAesEc3Cryptor::SetIvInternal() {
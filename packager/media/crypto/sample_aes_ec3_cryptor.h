@@ -44,6 +44,9 @@ class SampleAesEc3Cryptor : public AesCryptor {
   void SetIvInternal() override;
 
   std::unique_ptr<AesCryptor> cryptor_;
+  // Encrypted parts of the syncframes being crypted, handed to |cryptor_| in
+  // one batch. Reused across calls.
+  std::vector<CryptJob> crypt_jobs_;
 };
 
 }  // namespace media
@@ -393,14 +393,14 @@ Status SubsampleGenerator::GenerateSubsamplesFromAV1Frame(
     size_t frame_size,
     std::vector<SubsampleEntry>* subsamples) {
   DCHECK(av1_parser_);
-  std::vector<AV1Parser::Tile> av1_tiles;
-  if (!av1_parser_->Parse(frame, frame_size, &av1_tiles))
+  // |av1_tiles_| is reused so that it is not reallocated for every frame.
+  if (!av1_parser_->Parse(frame, frame_size, &av1_tiles_))
     return Status(error::ENCRYPTION_FAILURE, "Failed to parse AV1 frame.");
 
   SubsampleOrganizer subsample_organizer(align_protected_data_, subsamples);
 
   size_t last_tile_end_offset = 0;
-  for (const AV1Parser::Tile& tile : av1_tiles) {
+  for (const AV1Parser::Tile& tile : av1_tiles_) {
     DCHECK_LE(last_tile_end_offset, tile.start_offset_in_bytes);
     // Per AV1 in ISO-BMFF spec [1], only decode_tile is encrypted.
     // [1] https://aomediacodec.github.io/av1-isobmff/#subsample-encryption
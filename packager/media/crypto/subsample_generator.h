@@ -14,12 +14,12 @@
 
 #include <packager/media/base/fourccs.h>
 #include <packager/media/base/stream_info.h>
+#include <packager/media/codecs/av1_parser.h>
 #include <packager/status.h>
 
 namespace shaka {
 namespace media {
 
-class AV1Parser;
 class VideoSliceHeaderParser;
 class VPxParser;
 class AC4Parser;
@@ -112,6 +112,8 @@ class SubsampleGenerator {
   std::unique_ptr<VideoSliceHeaderParser> header_parser_;
   // AV1 parser for AV1 streams.
   std::unique_ptr<AV1Parser> av1_parser_;
+  // Tiles of the current AV1 frame.
+  std::vector<AV1Parser::Tile> av1_tiles_;
 };
 
 }  // namespace media
@@ -11,7 +11,9 @@
 #include <cstdint>
 #include <cstdio>
 #include <functional>
+#include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
@@ -24,8 +26,10 @@
 #include <absl/strings/string_view.h>
 
 #include <packager/file.h>
+#include <packager/file/file_closer.h>
 #include <packager/macros/compiler.h>
 #include <packager/macros/logging.h>
+#include <packager/macros/status.h>
 #include <packager/media/base/container_names.h>
 #include <packager/media/base/key_source.h>
 #include <packager/media/base/media_handler.h>
@@ -88,6 +92,47 @@ bool GetStreamIndex(const std::string& stream_label, size_t* stream_index) {
 
 namespace shaka {
 namespace media {
+namespace {
+
+// Returns the output stream index of each stream in |stream_infos|, given the
+// output stream indexes which are consumed. Streams which are not consumed get
+// kInvalidStreamIndex.
+std::vector<size_t> GetOutputStreamIndexes(
+    const std::vector<std::shared_ptr<StreamInfo>>& stream_infos,
+    const std::set<size_t>& consumed_stream_indexes) {
+  std::vector<size_t> output_stream_indexes;
+  size_t base_stream_index = 0;
+  bool video_consumed =
+      consumed_stream_indexes.count(kBaseVideoOutputStreamIndex) > 0;
+  bool audio_consumed =
+      consumed_stream_indexes.count(kBaseAudioOutputStreamIndex) > 0;
+  bool text_consumed =
+      consumed_stream_indexes.count(kBaseTextOutputStreamIndex) > 0;
+  for (const std::shared_ptr<StreamInfo>& stream_info : stream_infos) {
+    size_t stream_index = base_stream_index;
+    if (video_consumed && stream_info->stream_type() == kStreamVideo) {
+      stream_index = kBaseVideoOutputStreamIndex;
+      // Only for the first video stream.
+      video_consumed = false;
+    }
+    if (audio_consumed && stream_info->stream_type() == kStreamAudio) {
+      stream_index = kBaseAudioOutputStreamIndex;
+      // Only for the first audio stream.
+      audio_consumed = false;
+    }
+    if (text_consumed && stream_info->stream_type() == kStreamText) {
+      stream_index = kBaseTextOutputStreamIndex;
+      text_consumed = false;
+    }
+    output_stream_indexes.push_back(
+        consumed_stream_indexes.count(stream_index) ? stream_index
+                                                    : kInvalidStreamIndex);
+    ++base_stream_index;
+  }
+  return output_stream_indexes;
+}
+
+}  // namespace
 
 Demuxer::Demuxer(const std::string& file_name)
     : file_name_(file_name), buffer_(new uint8_t[kBufSize]) {}
@@ -126,12 +171,14 @@ Status Demuxer::Run() {
     }
   }
 
-  while (!cancelled_ && status.ok())
+  while (!cancelled_ && status.ok() && !SampleRangesDone())
     status.Update(Parse());
   if (cancelled_ && status.ok())
     return Status(error::CANCELLED, "Demuxer run cancelled");
 
-  if (status.error_code() == error::END_OF_STREAM) {
+  // The end of the sample ranges ends the streams as the end of the file.
+  if (status.error_code() == error::END_OF_STREAM ||
+      (status.ok() && SampleRangesDone())) {
     for (size_t stream_index : stream_indexes_) {
       status = FlushDownstream(stream_index);
       if (!status.ok())
@@ -163,6 +210,99 @@ void Demuxer::SetLanguageOverride(const std::string& stream_label,
   language_overrides_[stream_index] = language_override;
 }
 
+Status Demuxer::ReadSampleTimings(
+    const std::vector<std::string>& stream_labels,
+    std::vector<std::shared_ptr<StreamInfo>>* stream_infos,
+    std::vector<std::vector<SampleTiming>>* sample_timings) {
+  DCHECK(stream_infos);
+  DCHECK(sample_timings);
+
+  std::vector<size_t> requested_stream_indexes;
+  for (const std::string& stream_label : stream_labels) {
+    size_t stream_index = kInvalidStreamIndex;
+    if (!GetStreamIndex(stream_label, &stream_index))
+      return Status(error::INVALID_ARGUMENT, "Invalid stream: " + stream_label);
+    requested_stream_indexes.push_back(stream_index);
+  }
+
+  MediaContainerName container_name = CONTAINER_UNKNOWN;
+  if (input_format_.empty()) {
+    std::unique_ptr<File, FileCloser> file(File::Open(file_name_.c_str(), "r"));
+    if (!file) {
+      return Status(error::FILE_FAILURE,
+                    "Cannot open file for reading " + file_name_);
+    }
+    std::vector<uint8_t> buffer(kInitBufSize);
+    size_t bytes_read = 0;
+    while (bytes_read < buffer.size()) {
+      const int64_t read_result =
+          file->Read(buffer.data() + bytes_read, buffer.size() - bytes_read);
+      if (read_result < 0)
+        return Status(error::FILE_FAILURE, "Cannot read file " + file_name_);
+      if (read_result == 0)
+        break;
+      bytes_read += read_result;
+    }
+    container_name = DetermineContainer(buffer.data(), bytes_read);
+  } else {
+    container_name = DetermineContainerFromFormatName(input_format_);
+  }
+  if (container_name != CONTAINER_MOV) {
+    return Status(error::UNIMPLEMENTED,
+                  "Sample timings can only be read from MP4 files.");
+  }
+
+  std::vector<std::shared_ptr<StreamInfo>> all_stream_infos;
+  mp4::MP4MediaParser parser;
+  parser.Init(
+      [&all_stream_infos](
+          const std::vector<std::shared_ptr<StreamInfo>>& parsed_stream_infos) {
+        all_stream_infos = parsed_stream_infos;
+      },
+      [](uint32_t, std::shared_ptr<MediaSample>) { return true; },
+      [](uint32_t, std::shared_ptr<TextSample>) { return true; }, nullptr);
+  std::map<uint32_t, std::vector<SampleTiming>> track_sample_timings;
+  if (!parser.ReadSampleTimings(file_name_, &track_sample_timings)) {
+    return Status(error::PARSER_FAILURE,
+                  "Cannot read sample timings from " + file_name_);
+  }
+
+  const std::set<size_t> consumed_stream_indexes(
+      requested_stream_indexes.begin(), requested_stream_indexes.end());
+  const std::vector<size_t> output_stream_indexes =
+      GetOutputStreamIndexes(all_stream_infos, consumed_stream_indexes);
+  stream_infos->clear();
+  sample_timings->clear();
+  for (size_t requested_stream_index : requested_stream_indexes) {
+    auto iter = std::find(output_stream_indexes.begin(),
+                          output_stream_indexes.end(), requested_stream_index);
+    if (iter == output_stream_indexes.end()) {
+      return Status(error::INVALID_ARGUMENT,
+                    "Stream " + GetStreamLabel(requested_stream_index) +
+                        " not available.");
+    }
+    std::shared_ptr<StreamInfo> stream_info =
+        all_stream_infos[iter - output_stream_indexes.begin()];
+    sample_timings->push_back(
+        std::move(track_sample_timings[stream_info->track_id()]));
+    stream_infos->push_back(std::move(stream_info));
+  }
+  return Status::OK;
+}
+
+void Demuxer::SetSampleRange(const std::string& stream_label,
+                             int64_t start_dts,
+                             int64_t end_dts) {
+  size_t stream_index = kInvalidStreamIndex;
+  if (!GetStreamIndex(stream_label, &stream_index)) {
+    LOG(WARNING) << "Invalid stream for sample range " << stream_label;
+    return;
+  }
+  SampleRange& sample_range = sample_ranges_[stream_index];
+  sample_range.start_dts = start_dts;
+  sample_range.end_dts = end_dts;
+}
+
 Status Demuxer::InitializeParser() {
   DCHECK(!media_file_);
   DCHECK(!all_streams_ready_);
@@ -240,7 +380,7 @@ Status Demuxer::InitializeParser() {
                 std::placeholders::_2),
       std::bind(&Demuxer::NewTextSampleEvent, this, std::placeholders::_1,
                 std::placeholders::_2),
-      key_source_.get());
+      leave_samples_encrypted_ ? nullptr : key_source_.get());
 
   // Handle trailing 'moov'.
   if (container_name_ == CONTAINER_MOV &&
@@ -248,6 +388,7 @@ Status Demuxer::InitializeParser() {
     // TODO(kqyang): Investigate whether we can reuse the existing file
     // descriptor |media_file_| instead of opening the same file again.
     static_cast<mp4::MP4MediaParser*>(parser_.get())->LoadMoov(file_name_);
+    can_skip_data_ = !sample_ranges_.empty();
   }
   if (!parser_->Parse(buffer_.get(), bytes_read) ||
       (eof && !parser_->Flush())) {
@@ -266,56 +407,43 @@ void Demuxer::ParserInitEvent(
       printf("Stream [%zu] %s\n", i, stream_infos[i]->ToString().c_str());
   }
 
-  int base_stream_index = 0;
-  bool video_handler_set =
-      output_handlers().find(kBaseVideoOutputStreamIndex) !=
-      output_handlers().end();
-  bool audio_handler_set =
-      output_handlers().find(kBaseAudioOutputStreamIndex) !=
-      output_handlers().end();
-  bool text_handler_set = output_handlers().find(kBaseTextOutputStreamIndex) !=
-                          output_handlers().end();
-  for (const std::shared_ptr<StreamInfo>& stream_info : stream_infos) {
-    size_t stream_index = base_stream_index;
-    if (video_handler_set && stream_info->stream_type() == kStreamVideo) {
-      stream_index = kBaseVideoOutputStreamIndex;
-      // Only for the first video stream.
-      video_handler_set = false;
+  std::set<size_t> consumed_stream_indexes;
+  for (const auto& pair : output_handlers())
+    consumed_stream_indexes.insert(pair.first);
+  const std::vector<size_t> output_stream_indexes =
+      GetOutputStreamIndexes(stream_infos, consumed_stream_indexes);
+
+  std::set<uint32_t> selected_tracks;
+  for (size_t i = 0; i < stream_infos.size(); ++i) {
+    const std::shared_ptr<StreamInfo>& stream_info = stream_infos[i];
+    const size_t stream_index = output_stream_indexes[i];
+    track_id_to_stream_index_map_[stream_info->track_id()] = stream_index;
+    if (stream_index == kInvalidStreamIndex)
+      continue;
+
+    stream_indexes_.push_back(stream_index);
+    selected_tracks.insert(stream_info->track_id());
+    auto sample_range_iter = sample_ranges_.find(stream_index);
+    if (sample_range_iter != sample_ranges_.end()) {
+      parser_->SetTrackStartTimestamp(stream_info->track_id(),
+                                      sample_range_iter->second.start_dts);
     }
-    if (audio_handler_set && stream_info->stream_type() == kStreamAudio) {
-      stream_index = kBaseAudioOutputStreamIndex;
-      // Only for the first audio stream.
-      audio_handler_set = false;
-    }
-    if (text_handler_set && stream_info->stream_type() == kStreamText) {
-      stream_index = kBaseTextOutputStreamIndex;
-      text_handler_set = false;
+    auto iter = language_overrides_.find(stream_index);
+    if (iter != language_overrides_.end() &&
+        stream_info->stream_type() != kStreamVideo) {
+      stream_info->set_language(iter->second);
     }
-
-    const bool handler_set =
-        output_handlers().find(stream_index) != output_handlers().end();
-    if (handler_set) {
-      track_id_to_stream_index_map_[stream_info->track_id()] = stream_index;
-      stream_indexes_.push_back(stream_index);
-      auto iter = language_overrides_.find(stream_index);
-      if (iter != language_overrides_.end() &&
-          stream_info->stream_type() != kStreamVideo) {
-        stream_info->set_language(iter->second);
-      }
-      if (stream_info->is_encrypted()) {
-        init_event_status_.Update(Status(error::INVALID_ARGUMENT,
-                                         "A decryption key source is not "
-                                         "provided for an encrypted stream."));
-      } else {
-        init_event_status_.Update(
-            DispatchStreamInfo(stream_index, stream_info));
-      }
+    if (stream_info->is_encrypted() && !leave_samples_encrypted_) {
+      init_event_status_.Update(Status(error::INVALID_ARGUMENT,
+                                       "A decryption key source is not "
+                                       "provided for an encrypted stream."));
     } else {
-      track_id_to_stream_index_map_[stream_info->track_id()] =
-          kInvalidStreamIndex;
+      init_event_status_.Update(DispatchStreamInfo(stream_index, stream_info));
     }
-    ++base_stream_index;
   }
+  // Let the parser skip the streams which are not consumed.
+  if (!output_handlers().empty())
+    parser_->SetSelectedTracks(selected_tracks);
   all_streams_ready_ = true;
 }
 
@@ -376,6 +504,17 @@ bool Demuxer::PushMediaSample(uint32_t track_id,
   }
   if (stream_index_iter->second == kInvalidStreamIndex)
     return true;
+  auto sample_range_iter = sample_ranges_.find(stream_index_iter->second);
+  if (sample_range_iter != sample_ranges_.end()) {
+    // Samples are parsed in decoding order within a stream.
+    SampleRange& sample_range = sample_range_iter->second;
+    if (!sample_range.done && sample->dts() >= sample_range.end_dts) {
+      sample_range.done = true;
+      ++num_sample_ranges_done_;
+    }
+    if (sample_range.done || sample->dts() < sample_range.start_dts)
+      return true;
+  }
   Status status = DispatchMediaSample(stream_index_iter->second, sample);
   if (!status.ok()) {
     LOG(ERROR) << "Failed to process sample " << stream_index_iter->second
@@ -408,6 +547,8 @@ Status Demuxer::Parse() {
   DCHECK(parser_);
   DCHECK(buffer_);
 
+  RETURN_IF_ERROR(SkipUnneededData());
+
   int64_t bytes_read = media_file_->Read(buffer_.get(), kBufSize);
   if (bytes_read == 0) {
     if (!parser_->Flush())
@@ -423,5 +564,29 @@ Status Demuxer::Parse() {
                       "Cannot parse media file " + file_name_);
 }
 
+Status Demuxer::SkipUnneededData() {
+  if (!can_skip_data_)
+    return Status::OK;
+
+  auto* parser = static_cast<mp4::MP4MediaParser*>(parser_.get());
+  uint64_t position = 0;
+  if (!media_file_->Tell(&position))
+    return Status::OK;
+  const int64_t offset = parser->GetNextDataOffset();
+  // Seeking drops the data read ahead, so only skip more than a read.
+  if (offset < static_cast<int64_t>(position + kBufSize))
+    return Status::OK;
+
+  VLOG(1) << "Skipping from " << position << " to " << offset << " in "
+          << file_name_;
+  if (!media_file_->Seek(offset)) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot seek to " + std::to_string(offset) + " in " +
+                      file_name_);
+  }
+  parser->SkipTo(offset);
+  return Status::OK;
+}
+
 }  // namespace media
 }  // namespace shaka
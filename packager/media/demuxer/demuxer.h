@@ -17,6 +17,7 @@
 
 #include <packager/media/base/container_names.h>
 #include <packager/media/base/media_handler.h>
+#include <packager/media/base/media_sample.h>
 #include <packager/media/base/text_sample.h>
 #include <packager/media/origin/origin_handler.h>
 #include <packager/status.h>
@@ -30,7 +31,6 @@ namespace media {
 class Decryptor;
 class KeySource;
 class MediaParser;
-class MediaSample;
 class StreamInfo;
 
 /// Demuxer is responsible for extracting elementary stream samples from a
@@ -49,6 +49,9 @@ class Demuxer : public OriginHandler {
   ///        demuxed.
   void SetKeySource(std::unique_ptr<KeySource> key_source);
 
+  /// @return the KeySource for media decryption, which may be null.
+  KeySource* key_source() const { return key_source_.get(); }
+
   /// Drive the remuxing from demuxer side (push). Read the file and push
   /// the Data to Muxer until Eof.
   Status Run() override;
@@ -84,6 +87,38 @@ class Demuxer : public OriginHandler {
     input_format_ = input_format;
   }
 
+  /// Leaves encrypted samples encrypted, with their decrypt config, instead of
+  /// decrypting them with the KeySource. They are then expected to be
+  /// decrypted downstream, e.g. by an EncryptionHandler re-encrypting them.
+  void set_leave_samples_encrypted(bool leave_samples_encrypted) {
+    leave_samples_encrypted_ = leave_samples_encrypted;
+  }
+
+  bool leave_samples_encrypted() const { return leave_samples_encrypted_; }
+
+  /// Reads the timing of every sample of the specified streams up front,
+  /// without demuxing the samples. Only supported for non-fragmented MP4
+  /// files, whose sample tables list every sample.
+  /// @param stream_labels are the streams to read, see SetHandler().
+  /// @param[out] stream_infos gets the stream info of each stream.
+  /// @param[out] sample_timings gets the sample timings of each stream, in
+  ///        decoding order.
+  Status ReadSampleTimings(
+      const std::vector<std::string>& stream_labels,
+      std::vector<std::shared_ptr<StreamInfo>>* stream_infos,
+      std::vector<std::vector<SampleTiming>>* sample_timings);
+
+  /// Restricts the specified stream to the samples with decoding timestamps
+  /// in [@a start_dts, @a end_dts). The samples before the range are not
+  /// read from local MP4 files, which the demuxer seeks past instead. Once
+  /// every restricted stream has passed the end of its range, the demuxer
+  /// stops reading and flushes the streams as at the end of the file.
+  /// @param stream_label can be 'audio', 'video', or stream number (zero
+  ///        based).
+  void SetSampleRange(const std::string& stream_label,
+                      int64_t start_dts,
+                      int64_t end_dts);
+
  protected:
   /// @name MediaHandler implementation overrides.
   /// @{
@@ -103,6 +138,12 @@ class Demuxer : public OriginHandler {
   Demuxer(const Demuxer&) = delete;
   Demuxer& operator=(const Demuxer&) = delete;
 
+  struct SampleRange {
+    int64_t start_dts = 0;
+    int64_t end_dts = 0;
+    bool done = false;
+  };
+
   template <typename T>
   struct QueuedSample {
     QueuedSample(uint32_t track_id, std::shared_ptr<T> sample)
@@ -135,6 +176,15 @@ class Demuxer : public OriginHandler {
   // Read from the source and send it to the parser.
   Status Parse();
 
+  // Seek past the data which the parser does not need, if any.
+  Status SkipUnneededData();
+
+  // Returns true if there are sample ranges and all of them are done.
+  bool SampleRangesDone() const {
+    return !sample_ranges_.empty() &&
+           num_sample_ranges_done_ == sample_ranges_.size();
+  }
+
   std::string file_name_;
   File* media_file_ = nullptr;
   // A stream is considered ready after receiving the stream info.
@@ -150,12 +200,19 @@ class Demuxer : public OriginHandler {
   std::vector<size_t> stream_indexes_;
   // StreamIndex -> language_override map.
   std::map<size_t, std::string> language_overrides_;
+  // StreamIndex -> sample range map.
+  std::map<size_t, SampleRange> sample_ranges_;
+  size_t num_sample_ranges_done_ = 0;
+  // Whether the data before the sample ranges can be skipped by seeking.
+  bool can_skip_data_ = false;
   MediaContainerName container_name_ = CONTAINER_UNKNOWN;
   std::unique_ptr<uint8_t[]> buffer_;
   std::unique_ptr<KeySource> key_source_;
   bool cancelled_ = false;
   // Whether to dump stream info when it is received.
   bool dump_stream_info_ = false;
+  // Whether encrypted samples are passed downstream without being decrypted.
+  bool leave_samples_encrypted_ = false;
   Status init_event_status_;
   // Explicitly defined input format, for avoiding autodetection.
   std::string input_format_;
@@ -0,0 +1,226 @@
+// Copyright 2024 Google LLC. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <packager/media/event/range_muxer_listener.h>
+
+#include <optional>
+#include <utility>
+
+#include <absl/log/check.h>
+#include <absl/synchronization/mutex.h>
+
+#include <packager/media/base/protection_system_specific_info.h>
+
+namespace shaka {
+namespace media {
+
+// The state of the joined events of an output.
+struct RangeMuxerListener::Output {
+  std::unique_ptr<MuxerListener> listener;
+  std::optional<int32_t> sample_duration;
+  std::vector<uint8_t> key_id;
+  bool encryption_started = false;
+};
+
+// The state shared by the listeners of the ranges of the outputs. Everything
+// is guarded by |mutex|, which is held while the events run.
+struct RangeMuxerListener::Ranges {
+  Ranges(std::vector<std::unique_ptr<MuxerListener>> listeners,
+         size_t num_ranges)
+      : outputs(listeners.size()),
+        held_back_events(num_ranges),
+        num_ended_outputs(num_ranges, 0) {
+    for (size_t i = 0; i < listeners.size(); ++i)
+      outputs[i].listener = std::move(listeners[i]);
+  }
+
+  absl::Mutex mutex;
+  std::vector<Output> outputs;
+  // The first range which has not ended. Its events run right away.
+  size_t current_range = 0;
+  std::vector<std::vector<std::function<void()>>> held_back_events;
+  std::vector<size_t> num_ended_outputs;
+};
+
+std::vector<std::vector<std::unique_ptr<MuxerListener>>>
+RangeMuxerListener::CreateListeners(
+    std::vector<std::unique_ptr<MuxerListener>> listeners,
+    size_t num_ranges) {
+  DCHECK_GT(num_ranges, 0u);
+  const size_t num_outputs = listeners.size();
+  std::shared_ptr<Ranges> ranges =
+      std::make_shared<Ranges>(std::move(listeners), num_ranges);
+  std::vector<std::vector<std::unique_ptr<MuxerListener>>> range_listeners(
+      num_ranges);
+  for (size_t r = 0; r < num_ranges; ++r) {
+    for (size_t i = 0; i < num_outputs; ++i)
+      range_listeners[r].emplace_back(new RangeMuxerListener(ranges, r, i));
+  }
+  return range_listeners;
+}
+
+RangeMuxerListener::RangeMuxerListener(std::shared_ptr<Ranges> ranges,
+                                       size_t range_index,
+                                       size_t output_index)
+    : ranges_(std::move(ranges)),
+      range_index_(range_index),
+      output_index_(output_index) {}
+
+RangeMuxerListener::~RangeMuxerListener() {
+  EndRange();
+}
+
+void RangeMuxerListener::OnEncryptionInfoReady(
+    bool is_initial_encryption_info,
+    FourCC protection_scheme,
+    const std::vector<uint8_t>& key_id,
+    const std::vector<uint8_t>& iv,
+    const std::vector<ProtectionSystemSpecificInfo>& key_system_info) {
+  // The initial encryption info is the same for every range. Later ones are
+  // reported on key changes, which may span ranges.
+  if (is_initial_encryption_info && !is_first_range())
+    return;
+  Post([is_initial_encryption_info, protection_scheme, key_id, iv,
+        key_system_info](Output* output) {
+    if (!is_initial_encryption_info && key_id == output->key_id)
+      return;
+    output->key_id = key_id;
+    output->listener->OnEncryptionInfoReady(is_initial_encryption_info,
+                                            protection_scheme, key_id, iv,
+                                            key_system_info);
+  });
+}
+
+void RangeMuxerListener::OnEncryptionStart() {
+  Post([](Output* output) {
+    if (output->encryption_started)
+      return;
+    output->encryption_started = true;
+    output->listener->OnEncryptionStart();
+  });
+}
+
+void RangeMuxerListener::OnMediaStart(const MuxerOptions& muxer_options,
+                                      const StreamInfo& stream_info,
+                                      int32_t time_scale,
+                                      ContainerType container_type) {
+  // The first range is always running its events, so the references can be
+  // used right away.
+  if (!is_first_range())
+    return;
+  Post([&muxer_options, &stream_info, time_scale,
+        container_type](Output* output) {
+    output->listener->OnMediaStart(muxer_options, stream_info, time_scale,
+                                   container_type);
+  });
+}
+
+void RangeMuxerListener::OnAvailabilityOffsetReady() {
+  if (!is_first_range())
+    return;
+  Post([](Output* output) { output->listener->OnAvailabilityOffsetReady(); });
+}
+
+void RangeMuxerListener::OnSampleDurationReady(int32_t sample_duration) {
+  // The sample duration is estimated from the first samples of a stream,
+  // which only the first range has.
+  const bool first_range = is_first_range();
+  Post([first_range, sample_duration](Output* output) {
+    if (first_range)
+      output->sample_duration = sample_duration;
+    output->listener->OnSampleDurationReady(
+        output->sample_duration.value_or(sample_duration));
+  });
+}
+
+void RangeMuxerListener::OnSegmentDurationReady() {
+  if (!is_first_range())
+    return;
+  Post([](Output* output) { output->listener->OnSegmentDurationReady(); });
+}
+
+void RangeMuxerListener::OnMediaEnd(const MediaRanges& media_ranges,
+                                    float duration_seconds) {
+  // The muxer of the last range reports the duration of the whole output.
+  if (is_last_range()) {
+    Post([media_ranges, duration_seconds](Output* output) {
+      output->listener->OnMediaEnd(media_ranges, duration_seconds);
+    });
+  }
+  EndRange();
+}
+
+void RangeMuxerListener::OnNewSegment(const std::string& segment_name,
+                                      int64_t start_time,
+                                      int64_t duration,
+                                      uint64_t segment_file_size,
+                                      int64_t segment_number) {
+  Post([segment_name, start_time, duration, segment_file_size,
+        segment_number](Output* output) {
+    output->listener->OnNewSegment(segment_name, start_time, duration,
+                                   segment_file_size, segment_number);
+  });
+}
+
+void RangeMuxerListener::OnCompletedSegment(int64_t duration,
+                                            uint64_t segment_file_size) {
+  Post([duration, segment_file_size](Output* output) {
+    output->listener->OnCompletedSegment(duration, segment_file_size);
+  });
+}
+
+void RangeMuxerListener::OnKeyFrame(int64_t timestamp,
+                                    uint64_t start_byte_offset,
+                                    uint64_t size) {
+  Post([timestamp, start_byte_offset, size](Output* output) {
+    output->listener->OnKeyFrame(timestamp, start_byte_offset, size);
+  });
+}
+
+void RangeMuxerListener::OnCueEvent(int64_t timestamp,
+                                    const std::string& cue_data) {
+  Post([timestamp, cue_data](Output* output) {
+    output->listener->OnCueEvent(timestamp, cue_data);
+  });
+}
+
+bool RangeMuxerListener::is_last_range() const {
+  return range_index_ + 1 == ranges_->held_back_events.size();
+}
+
+void RangeMuxerListener::Post(Event event) {
+  Output* output = &ranges_->outputs[output_index_];
+  absl::MutexLock lock(ranges_->mutex);
+  if (range_index_ == ranges_->current_range) {
+    event(output);
+  } else {
+    ranges_->held_back_events[range_index_].push_back(
+        [event, output]() { event(output); });
+  }
+}
+
+void RangeMuxerListener::EndRange() {
+  if (range_ended_)
+    return;
+  range_ended_ = true;
+
+  absl::MutexLock lock(ranges_->mutex);
+  ++ranges_->num_ended_outputs[range_index_];
+  const size_t num_ranges = ranges_->held_back_events.size();
+  while (ranges_->current_range < num_ranges &&
+         ranges_->num_ended_outputs[ranges_->current_range] ==
+             ranges_->outputs.size()) {
+    if (++ranges_->current_range == num_ranges)
+      break;
+    std::vector<std::function<void()>> events =
+        std::move(ranges_->held_back_events[ranges_->current_range]);
+    for (const auto& event : events)
+      event();
+  }
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,107 @@
+// Copyright 2024 Google LLC. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#ifndef PACKAGER_MEDIA_EVENT_RANGE_MUXER_LISTENER_H_
+#define PACKAGER_MEDIA_EVENT_RANGE_MUXER_LISTENER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <packager/media/base/fourccs.h>
+#include <packager/media/event/muxer_listener.h>
+
+namespace shaka {
+namespace media {
+
+/// A MuxerListener of one of the muxers packaging consecutive time ranges of
+/// the outputs of an input, e.g. in parallel. The events of the muxers of an
+/// output are joined into the events of a single muxer packaging the whole
+/// output. The events of a range are held back until the muxers of all the
+/// outputs in the ranges before it are finalized, so that the listeners get
+/// the events in the same order as when packaging the input as a whole.
+class RangeMuxerListener : public MuxerListener {
+ public:
+  /// Creates the listeners of the muxers of the ranges of the outputs.
+  /// @param listeners are the listeners receiving the joined events of each
+  ///        output.
+  /// @param num_ranges is the number of ranges.
+  /// @return the listeners of each range, in time order, with the listener of
+  ///         each output.
+  static std::vector<std::vector<std::unique_ptr<MuxerListener>>>
+  CreateListeners(std::vector<std::unique_ptr<MuxerListener>> listeners,
+                  size_t num_ranges);
+
+  /// Ends the range if its muxer was not finalized, e.g. on errors, so that
+  /// the events of the later ranges are not held back forever.
+  ~RangeMuxerListener() override;
+
+  /// @name MuxerListener implementation overrides.
+  /// @{
+  void OnEncryptionInfoReady(bool is_initial_encryption_info,
+                             FourCC protection_scheme,
+                             const std::vector<uint8_t>& key_id,
+                             const std::vector<uint8_t>& iv,
+                             const std::vector<ProtectionSystemSpecificInfo>&
+                                 key_system_info) override;
+  void OnEncryptionStart() override;
+  void OnMediaStart(const MuxerOptions& muxer_options,
+                    const StreamInfo& stream_info,
+                    int32_t time_scale,
+                    ContainerType container_type) override;
+  void OnAvailabilityOffsetReady() override;
+  void OnSampleDurationReady(int32_t sample_duration) override;
+  void OnSegmentDurationReady() override;
+  void OnMediaEnd(const MediaRanges& media_ranges,
+                  float duration_seconds) override;
+  void OnNewSegment(const std::string& segment_name,
+                    int64_t start_time,
+                    int64_t duration,
+                    uint64_t segment_file_size,
+                    int64_t segment_number) override;
+  void OnCompletedSegment(int64_t duration,
+                          uint64_t segment_file_size) override;
+  void OnKeyFrame(int64_t timestamp,
+                  uint64_t start_byte_offset,
+                  uint64_t size) override;
+  void OnCueEvent(int64_t timestamp, const std::string& cue_data) override;
+  /// @}
+
+ private:
+  struct Output;
+  struct Ranges;
+  using Event = std::function<void(Output*)>;
+
+  RangeMuxerListener(std::shared_ptr<Ranges> ranges,
+                     size_t range_index,
+                     size_t output_index);
+  RangeMuxerListener(const RangeMuxerListener&) = delete;
+  RangeMuxerListener& operator=(const RangeMuxerListener&) = delete;
+
+  bool is_first_range() const { return range_index_ == 0; }
+  bool is_last_range() const;
+
+  // Runs |event| now if the ranges before this one have ended, or once they
+  // have ended otherwise.
+  void Post(Event event);
+  // Marks the range of the output as ended. Once the range has ended for all
+  // the outputs, runs the held back events of the next ranges up to the first
+  // range which has not ended.
+  void EndRange();
+
+  const std::shared_ptr<Ranges> ranges_;
+  const size_t range_index_;
+  const size_t output_index_;
+  bool range_ended_ = false;
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // PACKAGER_MEDIA_EVENT_RANGE_MUXER_LISTENER_H_
@@ -0,0 +1,207 @@
+// Copyright 2024 Google LLC. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <packager/media/event/range_muxer_listener.h>
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <packager/media/base/fourccs.h>
+#include <packager/media/base/muxer_options.h>
+#include <packager/media/event/mock_muxer_listener.h>
+#include <packager/media/event/muxer_listener_test_helper.h>
+
+namespace shaka {
+namespace media {
+
+using ::testing::_;
+using ::testing::InSequence;
+using ::testing::StrictMock;
+
+namespace {
+
+const size_t kNumRanges = 3;
+const size_t kNumOutputs = 2;
+const int64_t kSegmentDuration = 1000;
+const uint64_t kSegmentSize = 100;
+const int32_t kTimescale = 1000;
+const int32_t kSampleDuration = 40;
+const float kDurationSeconds = 3.0f;
+const bool kInitialEncryptionInfo = true;
+const std::vector<uint8_t> kDefaultKeyId(16, 0x00);
+const std::vector<uint8_t> kKeyId1(16, 0x01);
+const std::vector<uint8_t> kKeyId2(16, 0x02);
+const std::vector<uint8_t> kIv(16, 0x03);
+
+MuxerListener::ContainerType kContainer = MuxerListener::kContainerMp4;
+
+}  // namespace
+
+class RangeMuxerListenerTest : public ::testing::Test {
+ protected:
+  RangeMuxerListenerTest() {
+    std::vector<std::unique_ptr<MuxerListener>> listeners;
+    for (size_t i = 0; i < kNumOutputs; ++i) {
+      std::unique_ptr<StrictMock<MockMuxerListener>> listener(
+          new StrictMock<MockMuxerListener>);
+      listeners_.push_back(listener.get());
+      listeners.push_back(std::move(listener));
+    }
+    range_listeners_ =
+        RangeMuxerListener::CreateListeners(std::move(listeners), kNumRanges);
+
+    video_stream_info_ =
+        CreateVideoStreamInfo(GetDefaultVideoStreamInfoParams());
+  }
+
+  MuxerListener* listener(size_t range_index, size_t output_index = 0) {
+    return range_listeners_[range_index][output_index].get();
+  }
+
+  void NewSegment(size_t range_index,
+                  int64_t segment_number,
+                  size_t output_index = 0) {
+    listener(range_index, output_index)
+        ->OnNewSegment("segment", segment_number * kSegmentDuration,
+                       kSegmentDuration, kSegmentSize, segment_number);
+  }
+
+  void EncryptionInfoReady(size_t range_index,
+                           bool is_initial_encryption_info,
+                           const std::vector<uint8_t>& key_id) {
+    listener(range_index)
+        ->OnEncryptionInfoReady(is_initial_encryption_info, FOURCC_cbcs,
+                                key_id, kIv,
+                                std::vector<ProtectionSystemSpecificInfo>());
+  }
+
+  void MediaEnd(size_t range_index, size_t output_index = 0) {
+    listener(range_index, output_index)
+        ->OnMediaEnd(MuxerListener::MediaRanges(), kDurationSeconds);
+  }
+
+  // Ends the ranges of the second output, which does not get events.
+  void EndSecondOutput() {
+    for (size_t r = 0; r < kNumRanges; ++r)
+      range_listeners_[r][1].reset();
+  }
+
+  std::vector<StrictMock<MockMuxerListener>*> listeners_;
+  std::vector<std::vector<std::unique_ptr<MuxerListener>>> range_listeners_;
+  MuxerOptions muxer_options_;
+  std::shared_ptr<StreamInfo> video_stream_info_;
+};
+
+TEST_F(RangeMuxerListenerTest, ForwardsEventsInRangeOrder) {
+  {
+    InSequence s;
+    EXPECT_CALL(*listeners_[0],
+                OnMediaStart(_, _, kTimescale, MuxerListener::kContainerMp4));
+    EXPECT_CALL(*listeners_[0], OnNewSegment(_, _, _, _, 1));
+    EXPECT_CALL(*listeners_[0], OnNewSegment(_, _, _, _, 2));
+    EXPECT_CALL(*listeners_[0], OnNewSegment(_, _, _, _, 3));
+    EXPECT_CALL(*listeners_[0],
+                OnMediaEndMock(_, _, _, _, _, _, _, _, kDurationSeconds));
+  }
+
+  EndSecondOutput();
+  // The ranges run out of order.
+  listener(2)->OnMediaStart(muxer_options_, *video_stream_info_, kTimescale,
+                            kContainer);
+  NewSegment(2, 3);
+  MediaEnd(2);
+  listener(1)->OnMediaStart(muxer_options_, *video_stream_info_, kTimescale,
+                            kContainer);
+  NewSegment(1, 2);
+  listener(0)->OnMediaStart(muxer_options_, *video_stream_info_, kTimescale,
+                            kContainer);
+  NewSegment(0, 1);
+  MediaEnd(0);
+  MediaEnd(1);
+}
+
+TEST_F(RangeMuxerListenerTest, HoldsBackRangeUntilAllOutputsEnd) {
+  {
+    InSequence s;
+    EXPECT_CALL(*listeners_[0], OnNewSegment(_, _, _, _, 1));
+    EXPECT_CALL(*listeners_[1], OnNewSegment(_, _, _, _, 1));
+  }
+  NewSegment(0, 1, 0);
+  NewSegment(0, 1, 1);
+  NewSegment(1, 2, 1);
+  NewSegment(1, 2, 0);
+  MediaEnd(0, 0);
+  ::testing::Mock::VerifyAndClearExpectations(listeners_[0]);
+  ::testing::Mock::VerifyAndClearExpectations(listeners_[1]);
+
+  // The events of the second range run in the order they were posted once
+  // the first range has ended for both outputs.
+  {
+    InSequence s;
+    EXPECT_CALL(*listeners_[1], OnNewSegment(_, _, _, _, 2));
+    EXPECT_CALL(*listeners_[0], OnNewSegment(_, _, _, _, 2));
+  }
+  MediaEnd(0, 1);
+  range_listeners_.clear();
+}
+
+TEST_F(RangeMuxerListenerTest, JoinsEncryptionEvents) {
+  {
+    InSequence s;
+    EXPECT_CALL(*listeners_[0],
+                OnEncryptionInfoReady(kInitialEncryptionInfo, FOURCC_cbcs,
+                                      kDefaultKeyId, kIv, _));
+    EXPECT_CALL(*listeners_[0],
+                OnEncryptionInfoReady(!kInitialEncryptionInfo, FOURCC_cbcs,
+                                      kKeyId1, kIv, _));
+    EXPECT_CALL(*listeners_[0], OnEncryptionStart());
+    EXPECT_CALL(*listeners_[0], OnNewSegment(_, _, _, _, 1));
+    EXPECT_CALL(*listeners_[0], OnNewSegment(_, _, _, _, 2));
+    EXPECT_CALL(*listeners_[0],
+                OnEncryptionInfoReady(!kInitialEncryptionInfo, FOURCC_cbcs,
+                                      kKeyId2, kIv, _));
+    EXPECT_CALL(*listeners_[0], OnNewSegment(_, _, _, _, 3));
+  }
+
+  // Every range starts with the initial encryption info. The key of the
+  // second range is the key the first range ends with.
+  EncryptionInfoReady(0, kInitialEncryptionInfo, kDefaultKeyId);
+  EncryptionInfoReady(0, !kInitialEncryptionInfo, kKeyId1);
+  listener(0)->OnEncryptionStart();
+  NewSegment(0, 1);
+  EncryptionInfoReady(1, kInitialEncryptionInfo, kDefaultKeyId);
+  EncryptionInfoReady(1, !kInitialEncryptionInfo, kKeyId1);
+  listener(1)->OnEncryptionStart();
+  NewSegment(1, 2);
+  EncryptionInfoReady(2, kInitialEncryptionInfo, kDefaultKeyId);
+  EncryptionInfoReady(2, !kInitialEncryptionInfo, kKeyId2);
+  listener(2)->OnEncryptionStart();
+  NewSegment(2, 3);
+  EndSecondOutput();
+  MediaEnd(0);
+  MediaEnd(1);
+
+  // The muxers of the last range are not finalized.
+  range_listeners_.clear();
+}
+
+TEST_F(RangeMuxerListenerTest, ForwardsSampleDurationOfFirstRange) {
+  EXPECT_CALL(*listeners_[0], OnSampleDurationReady(kSampleDuration))
+      .Times(2);
+
+  EndSecondOutput();
+  listener(1)->OnSampleDurationReady(kSampleDuration + 1);
+  listener(0)->OnSampleDurationReady(kSampleDuration);
+  MediaEnd(0);
+}
+
+}  // namespace media
+}  // namespace shaka
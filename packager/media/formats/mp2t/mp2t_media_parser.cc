@@ -4,6 +4,7 @@
 
 #include <packager/media/formats/mp2t/mp2t_media_parser.h>
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <deque>
@@ -162,7 +163,9 @@ void PidState::ResetState() {
 }
 
 Mp2tMediaParser::Mp2tMediaParser()
-    : sbr_in_mimetype_(false), is_initialized_(false) {}
+    : sbr_in_mimetype_(false),
+      pid_table_(TsSection::kPidMax + 1, nullptr),
+      is_initialized_(false) {}
 
 Mp2tMediaParser::~Mp2tMediaParser() {}
 
@@ -192,6 +195,7 @@ bool Mp2tMediaParser::Flush() {
   }
   bool result = EmitRemainingSamples();
   pids_.clear();
+  std::fill(pid_table_.begin(), pid_table_.end(), nullptr);
 
   // Remove any bytes left in the TS buffer.
   // (i.e. any partial TS packet => less than 188 bytes).
@@ -202,63 +206,143 @@ bool Mp2tMediaParser::Flush() {
 bool Mp2tMediaParser::Parse(const uint8_t* buf, int size) {
   DVLOG(2) << "Mp2tMediaParser::Parse size=" << size;
 
-  // Add the data to the parser state.
-  ts_byte_queue_.Push(buf, size);
-
-  while (true) {
+  // Complete the partial TS packet left over from the previous call, if any.
+  // Only the bytes needed to get a whole packet are copied into the queue.
+  while (size > 0) {
     const uint8_t* ts_buffer;
     int ts_buffer_size;
     ts_byte_queue_.Peek(&ts_buffer, &ts_buffer_size);
-    if (ts_buffer_size < TsPacket::kPacketSize)
+    if (ts_buffer_size == 0)
       break;
 
+    DCHECK_LT(ts_buffer_size, TsPacket::kPacketSize);
+    const int bytes_to_push =
+        std::min(size, TsPacket::kPacketSize - ts_buffer_size);
+    ts_byte_queue_.Push(buf, bytes_to_push);
+    buf += bytes_to_push;
+    size -= bytes_to_push;
+
+    ts_byte_queue_.Peek(&ts_buffer, &ts_buffer_size);
+    int bytes_consumed = 0;
+    RCHECK(ParseTsPackets(ts_buffer, ts_buffer_size, &bytes_consumed));
+    ts_byte_queue_.Pop(bytes_consumed);
+  }
+
+  // Parse the rest of the input in place, without going through the queue.
+  if (size > 0) {
+    int bytes_consumed = 0;
+    RCHECK(ParseTsPackets(buf, size, &bytes_consumed));
+    ts_byte_queue_.Push(buf + bytes_consumed, size - bytes_consumed);
+  }
+
+  // Emit the A/V buffers that kept accumulating during TS parsing.
+  return EmitRemainingSamples();
+}
+
+void Mp2tMediaParser::SetSelectedTracks(const std::set<uint32_t>& track_ids) {
+  MediaParser::SetSelectedTracks(track_ids);
+  track_selection_pending_ = true;
+}
+
+bool Mp2tMediaParser::ParseTsPackets(const uint8_t* buf,
+                                     int size,
+                                     int* bytes_consumed) {
+  int offset = 0;
+  while (size - offset >= TsPacket::kPacketSize) {
     // Synchronization.
-    int skipped_bytes = TsPacket::Sync(ts_buffer, ts_buffer_size);
+    int skipped_bytes = TsPacket::Sync(buf + offset, size - offset);
     if (skipped_bytes > 0) {
       DVLOG(1) << "Packet not aligned on a TS syncword:"
                << " skipped_bytes=" << skipped_bytes;
-      ts_byte_queue_.Pop(skipped_bytes);
+      offset += skipped_bytes;
       continue;
     }
 
-    // Parse the TS header, skipping 1 byte if the header is invalid.
-    std::unique_ptr<TsPacket> ts_packet(
-        TsPacket::Parse(ts_buffer, ts_buffer_size));
-    if (!ts_packet) {
-      DVLOG(1) << "Error: invalid TS packet";
-      ts_byte_queue_.Pop(1);
-      continue;
-    }
-    DVLOG(LOG_LEVEL_TS) << "Processing PID=" << ts_packet->pid()
-                        << " start_unit="
-                        << ts_packet->payload_unit_start_indicator()
-                        << " continuity_counter="
-                        << ts_packet->continuity_counter();
-    // Parse the section.
-    auto it = pids_.find(ts_packet->pid());
-    if (it == pids_.end() && ts_packet->pid() == TsSection::kPidPat) {
-      // Create the PAT state here if needed.
-      std::unique_ptr<TsSection> pat_section_parser(new TsSectionPat(
-          std::bind(&Mp2tMediaParser::RegisterPmt, this, std::placeholders::_1,
-                    std::placeholders::_2)));
-      std::unique_ptr<PidState> pat_pid_state(new PidState(
-          ts_packet->pid(), PidState::kPidPat, std::move(pat_section_parser)));
-      pat_pid_state->Enable();
-      it = pids_.emplace(ts_packet->pid(), std::move(pat_pid_state)).first;
+    // Process the run of packets which are known to be synchronized without
+    // looking for the syncword again.
+    int num_packets =
+        TsPacket::CountSyncedPackets(buf + offset, size - offset);
+    DCHECK_GT(num_packets, 0);
+    for (int i = 0; i < num_packets; ++i) {
+      int packet_size = 0;
+      RCHECK(ProcessTsPacket(buf + offset, size - offset, &packet_size));
+      offset += packet_size;
+      // Go back to synchronization if the TS header was invalid.
+      if (packet_size != TsPacket::kPacketSize)
+        break;
     }
+  }
+  *bytes_consumed = offset;
+  return true;
+}
 
-    if (it != pids_.end()) {
-      RCHECK(it->second->PushTsPacket(*ts_packet));
-    } else {
-      DVLOG(LOG_LEVEL_TS) << "Ignoring TS packet for pid: " << ts_packet->pid();
-    }
+bool Mp2tMediaParser::ProcessTsPacket(const uint8_t* buf,
+                                      int size,
+                                      int* packet_size) {
+  if (track_selection_pending_)
+    ApplyTrackSelection();
+
+  const int pid = TsPacket::PeekPid(buf);
+  PidState* pid_state = pid_table_[pid];
+  if (!pid_state && pid != TsSection::kPidPat) {
+    DVLOG(LOG_LEVEL_TS) << "Ignoring TS packet for pid: " << pid;
+    *packet_size = TsPacket::kPacketSize;
+    return true;
+  }
 
-    // Go to the next packet.
-    ts_byte_queue_.Pop(TsPacket::kPacketSize);
+  // Parse the TS header, skipping 1 byte if the header is invalid.
+  std::unique_ptr<TsPacket> ts_packet(TsPacket::Parse(buf, size));
+  if (!ts_packet) {
+    DVLOG(1) << "Error: invalid TS packet";
+    *packet_size = 1;
+    return true;
+  }
+  DVLOG(LOG_LEVEL_TS) << "Processing PID=" << ts_packet->pid() << " start_unit="
+                      << ts_packet->payload_unit_start_indicator()
+                      << " continuity_counter="
+                      << ts_packet->continuity_counter();
+  *packet_size = TsPacket::kPacketSize;
+
+  if (!pid_state) {
+    // Create the PAT state here if needed.
+    std::unique_ptr<TsSection> pat_section_parser(new TsSectionPat(
+        std::bind(&Mp2tMediaParser::RegisterPmt, this, std::placeholders::_1,
+                  std::placeholders::_2)));
+    std::unique_ptr<PidState> pat_pid_state(new PidState(
+        ts_packet->pid(), PidState::kPidPat, std::move(pat_section_parser)));
+    pat_pid_state->Enable();
+    pid_state = pat_pid_state.get();
+    AddPidState(ts_packet->pid(), std::move(pat_pid_state));
   }
 
-  // Emit the A/V buffers that kept accumulating during TS parsing.
-  return EmitRemainingSamples();
+  // Parse the section.
+  return pid_state->PushTsPacket(*ts_packet);
+}
+
+void Mp2tMediaParser::AddPidState(int pid,
+                                  std::unique_ptr<PidState> pid_state) {
+  DCHECK(pid >= 0 && pid <= TsSection::kPidMax);
+  pid_table_[pid] = pid_state.get();
+  pids_.emplace(pid, std::move(pid_state));
+}
+
+void Mp2tMediaParser::ApplyTrackSelection() {
+  track_selection_pending_ = false;
+  for (const auto& pair : pids_) {
+    PidState* pid_state = pair.second.get();
+    if (pid_state->pid_type() == PidState::kPidPat ||
+        pid_state->pid_type() == PidState::kPidPmt ||
+        IsTrackSelected(pair.first)) {
+      continue;
+    }
+    DVLOG(1) << "Skipping unselected PID: " << pair.first;
+    // The TS packets of this PID are dropped before reaching the PES and ES
+    // parsers.
+    pid_state->Disable();
+    pid_state->media_sample_queue_.clear();
+    pid_state->text_sample_queue_.clear();
+    pid_table_[pair.first] = nullptr;
+  }
 }
 
 void Mp2tMediaParser::RegisterPmt(int program_number, int pmt_pid) {
@@ -285,7 +369,7 @@ void Mp2tMediaParser::RegisterPmt(int program_number, int pmt_pid) {
   std::unique_ptr<PidState> pmt_pid_state(
       new PidState(pmt_pid, PidState::kPidPmt, std::move(pmt_section_parser)));
   pmt_pid_state->Enable();
-  pids_.emplace(pmt_pid, std::move(pmt_pid_state));
+  AddPidState(pmt_pid, std::move(pmt_pid_state));
 }
 
 void Mp2tMediaParser::RegisterPes(int pmt_pid,
@@ -358,7 +442,7 @@ void Mp2tMediaParser::RegisterPes(int pmt_pid,
   std::unique_ptr<PidState> pes_pid_state(
       new PidState(pes_pid, pid_type, std::move(pes_section_parser)));
   pes_pid_state->Enable();
-  pids_.emplace(pes_pid, std::move(pes_pid_state));
+  AddPidState(pes_pid, std::move(pes_pid_state));
 
   // Store PES metadata.
   pes_metadata_.insert(
@@ -536,6 +620,8 @@ void Mp2tMediaParser::update_biggest_pts(int64_t pts) {
                    << " )";
         continue;
       }
+      if (!pid_state->second->IsEnabled())
+        continue;
       TextSettings text_settings;
       auto heartbeat = std::make_shared<TextSample>(
           "", pts, pts, text_settings, TextFragment({}, ""),
@@ -10,8 +10,10 @@
 #include <cstdint>
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 #include <packager/macros/classes.h>
 #include <packager/media/base/byte_queue.h>
@@ -50,9 +52,28 @@ class Mp2tMediaParser : public MediaParser {
             KeySource* decryption_key_source) override;
   [[nodiscard]] bool Flush() override;
   [[nodiscard]] bool Parse(const uint8_t* buf, int size) override;
+  void SetSelectedTracks(const std::set<uint32_t>& track_ids) override;
   /// @}
 
  private:
+  // Parse as many whole TS packets as possible directly from |buf|.
+  // |bytes_consumed| is set to the number of bytes processed; at most one
+  // partial TS packet is left unprocessed at the end of |buf|.
+  bool ParseTsPackets(const uint8_t* buf, int size, int* bytes_consumed);
+
+  // Dispatch the TS packet starting at |buf| to the state of its PID.
+  // |packet_size| is set to the number of bytes to skip to get to the next
+  // packet, which is 1 if the TS header is invalid.
+  bool ProcessTsPacket(const uint8_t* buf, int size, int* packet_size);
+
+  // Take ownership of |pid_state| and make it reachable from |pid_table_|.
+  void AddPidState(int pid, std::unique_ptr<PidState> pid_state);
+
+  // Disable the PES PIDs which are not selected. The selection is usually made
+  // from within the section parser of one of the PIDs, so it is only applied
+  // before the next TS packet is processed.
+  void ApplyTrackSelection();
+
   // Callback invoked to register a Program Map Table.
   // Note: Does nothing if the PID is already registered.
   void RegisterPmt(int program_number, int pmt_pid);
@@ -105,19 +126,27 @@ class Mp2tMediaParser : public MediaParser {
 
   bool sbr_in_mimetype_;
 
-  // Bytes of the TS media.
+  // Bytes of the TS media which could not be parsed in place, i.e. a partial
+  // TS packet left at the end of the previous Parse() call.
   ByteQueue ts_byte_queue_;
 
   // Map of PIDs and their states.  Use an ordered map so manifest generation
   // has a deterministic order.
   std::map<int, std::unique_ptr<PidState>> pids_;
 
+  // Flat lookup table indexed by PID, pointing to the states owned by |pids_|,
+  // so that the per-packet PID lookup is a single array access.
+  std::vector<PidState*> pid_table_;
+
   // Map of PIDs and their metadata.
   std::map<int, PesMetadata> pes_metadata_;
 
   // Whether |init_cb_| has been invoked.
   bool is_initialized_;
 
+  // Whether a track selection still needs to be applied to |pids_|.
+  bool track_selection_pending_ = false;
+
   // A map used to track unsupported stream types and make sure the error is
   // only logged once.
   std::bitset<256> stream_type_logged_once_;
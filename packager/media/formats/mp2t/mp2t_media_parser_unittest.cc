@@ -10,6 +10,7 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -177,6 +178,57 @@ TEST_F(Mp2tMediaParserTest, UnalignedAppend512_H265) {
   EXPECT_EQ(82, video_frame_count_);
 }
 
+TEST_F(Mp2tMediaParserTest, SingleAppend_H264) {
+  // Test parsing the whole file in place in a single append.
+  std::vector<uint8_t> buffer = ReadTestDataFile("bear-640x360.ts");
+  ASSERT_TRUE(ParseMpeg2TsFile("bear-640x360.ts",
+                               static_cast<int>(buffer.size())));
+  EXPECT_EQ(79, video_frame_count_);
+  EXPECT_TRUE(parser_->Flush());
+  EXPECT_EQ(82, video_frame_count_);
+}
+
+TEST_F(Mp2tMediaParserTest, ResyncAfterLeadingGarbage_H264) {
+  // Test that the parser synchronizes on the first TS packet when the input
+  // does not start on a TS syncword.
+  InitializeParser();
+  std::vector<uint8_t> buffer = ReadTestDataFile("bear-640x360.ts");
+  ASSERT_FALSE(buffer.empty());
+  buffer.insert(buffer.begin(), {0x47, 0x00, 0x12, 0x34, 0x56});
+  ASSERT_TRUE(AppendDataInPieces(buffer.data(), buffer.size(), 4096));
+  EXPECT_TRUE(parser_->Flush());
+  EXPECT_EQ(82, video_frame_count_);
+}
+
+TEST_F(Mp2tMediaParserTest, SelectedTracks) {
+  // The PES packets of the audio PID should be skipped when only the video
+  // track is selected.
+  parser_->Init(
+      [this](const std::vector<std::shared_ptr<StreamInfo>>& stream_infos) {
+        OnInit(stream_infos);
+        std::set<uint32_t> selected_tracks;
+        for (const auto& stream_info : stream_infos) {
+          if (stream_info->stream_type() == kStreamVideo)
+            selected_tracks.insert(stream_info->track_id());
+        }
+        parser_->SetSelectedTracks(selected_tracks);
+      },
+      [this](uint32_t track_id, std::shared_ptr<MediaSample> sample) {
+        return OnNewSample(track_id, sample);
+      },
+      [this](uint32_t track_id, std::shared_ptr<TextSample> sample) {
+        return OnNewTextSample(track_id, sample);
+      },
+      NULL);
+
+  std::vector<uint8_t> buffer = ReadTestDataFile("bear-640x360.ts");
+  ASSERT_FALSE(buffer.empty());
+  ASSERT_TRUE(AppendDataInPieces(buffer.data(), buffer.size(), 512));
+  EXPECT_TRUE(parser_->Flush());
+  EXPECT_EQ(82, video_frame_count_);
+  EXPECT_EQ(0, audio_frame_count_);
+}
+
 TEST_F(Mp2tMediaParserTest, TimestampWrapAround) {
   // "bear-640x360_ptszero_dtswraparound.ts" has been transcoded from
   // bear-640x360.mp4 by applying a time offset of 95442s (close to 2^33 /
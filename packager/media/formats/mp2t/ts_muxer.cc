@@ -19,8 +19,6 @@
 #include <packager/file.h>
 #include <packager/file/file_closer.h>
 #include <packager/macros/status.h>
-#include <packager/media/base/aes_cryptor.h>
-#include <packager/media/base/aes_encryptor.h>
 #include <packager/media/base/buffer_writer.h>
 #include <packager/media/base/fourccs.h>
 #include <packager/media/base/media_handler.h>
@@ -61,13 +59,6 @@ Status TsMuxer::InitializeMuxer() {
   segmenter_.reset(new TsSegmenter(options(), muxer_listener()));
   Status status = segmenter_->Initialize(*streams()[0]);
 
-  // Capture AES-128 encryption config once so FinalizeSegment can encrypt.
-  const auto& stream = *streams()[0];
-  if (stream.is_encrypted() &&
-      stream.encryption_config().protection_scheme == kAes128ProtectionScheme) {
-    aes128_encryption_config_ = stream.encryption_config();
-  }
-
   FireOnMediaStartEvent();
   return status;
 }
@@ -114,10 +105,9 @@ Status TsMuxer::FinalizeSegment(size_t stream_id,
           : GetSegmentName(options().segment_template, segment_start_timestamp,
                            segment_info.segment_number, options().bandwidth);
 
-  const int64_t file_size = segmenter_->segment_buffer()->Size();
-
-  EncryptSegmentIfNeeded(segmenter_->segment_buffer());
-
+  // The AES-128 padding is not counted in the reported segment size.
+  const int64_t file_size = segmenter_->segment_buffer()->Size() -
+                            segmenter_->segment_padding_size();
   RETURN_IF_ERROR(WriteSegment(segment_path, segmenter_->segment_buffer()));
 
   total_duration_ += segment_info.duration;
@@ -136,37 +126,11 @@ Status TsMuxer::FinalizeSegment(size_t stream_id,
   return Status::OK;
 }
 
-void TsMuxer::EncryptSegmentIfNeeded(BufferWriter* segment_buffer) {
-  if (aes128_encryption_config_.protection_scheme != kAes128ProtectionScheme)
-    return;
-  if (segment_buffer->Size() == 0)
-    return;
-
-  // AES-128 HLS: encrypt the entire TS segment as one CBC stream.
-  // Per RFC 8216 §5.2, PKCS7 padding is required; TS packet size (188 bytes)
-  // is not a multiple of 16, so segments are not guaranteed to be
-  // block-aligned.
-  AesCbcEncryptor encryptor(kPkcs5Padding, AesCryptor::kUseConstantIv);
-  if (!encryptor.InitializeWithIv(aes128_encryption_config_.key,
-                                  aes128_encryption_config_.constant_iv)) {
-    LOG(ERROR) << "AES-128: failed to initialize encryptor for segment.";
-    return;
-  }
-
-  std::vector<uint8_t> plaintext(
-      segment_buffer->Buffer(),
-      segment_buffer->Buffer() + segment_buffer->Size());
-  std::vector<uint8_t> ciphertext;
-  if (!encryptor.Crypt(plaintext, &ciphertext)) {
-    LOG(ERROR) << "AES-128: encryption failed for segment.";
-    return;
-  }
-  segment_buffer->Clear();
-  segment_buffer->AppendVector(ciphertext);
-}
-
 Status TsMuxer::WriteSegment(const std::string& segment_path,
                              BufferWriter* segment_buffer) {
+  if (!output_file_ && segment_output_queue())
+    return segment_output_queue()->PostSegment(segment_path, segment_buffer);
+
   std::unique_ptr<File, FileCloser> file;
 
   if (output_file_) {
@@ -4,6 +4,7 @@
 
 #include <packager/media/formats/mp2t/ts_packet.h>
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <ios>
@@ -49,6 +50,26 @@ int TsPacket::Sync(const uint8_t* buf, int size) {
   return k;
 }
 
+// static
+int TsPacket::CountSyncedPackets(const uint8_t* buf, int size) {
+  // Sync() looks ahead at up to 4 syncwords, so a packet is only considered
+  // synchronized if the syncwords of the next 3 packets (when available) are
+  // present as well.
+  const int kLookAheadPackets = 3;
+  const int num_whole_packets = size / kPacketSize;
+  const int num_syncwords = (size + kPacketSize - 1) / kPacketSize;
+
+  int num_valid_syncwords = 0;
+  while (num_valid_syncwords < num_syncwords &&
+         buf[num_valid_syncwords * kPacketSize] == kTsHeaderSyncword) {
+    ++num_valid_syncwords;
+  }
+  if (num_valid_syncwords == num_syncwords)
+    return num_whole_packets;
+  return std::max(
+      0, std::min(num_valid_syncwords - kLookAheadPackets, num_whole_packets));
+}
+
 // static
 TsPacket* TsPacket::Parse(const uint8_t* buf, int size) {
   if (size < kPacketSize) {
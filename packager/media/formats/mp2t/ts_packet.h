@@ -24,6 +24,18 @@ class TsPacket {
   // to be synchronized on a TS syncword.
   static int Sync(const uint8_t* buf, int size);
 
+  // Return the number of consecutive whole TS packets at the start of |buf|
+  // for which Sync() would report no bytes to discard. |buf| must start on a
+  // TS syncword. The sync bytes are validated in a single pass so that a run
+  // of packets can be processed without re-synchronizing on each packet.
+  static int CountSyncedPackets(const uint8_t* buf, int size);
+
+  // Return the PID of the TS packet starting at |buf|, without parsing the
+  // rest of the header. |buf| should hold at least 3 bytes.
+  static int PeekPid(const uint8_t* buf) {
+    return ((buf[1] & 0x1f) << 8) | buf[2];
+  }
+
   // Parse a TS packet.
   // Return a TsPacket only when parsing was successful.
   // Return NULL otherwise.
@@ -15,6 +15,9 @@
 #include <absl/log/check.h>
 #include <absl/log/log.h>
 
+#include <packager/macros/crypto.h>
+#include <packager/media/base/aes_encryptor.h>
+#include <packager/media/base/encryption_config.h>
 #include <packager/media/base/media_sample.h>
 #include <packager/media/base/muxer_util.h>
 #include <packager/media/base/stream_info.h>
@@ -70,6 +73,22 @@ Status TsSegmenter::Initialize(const StreamInfo& stream_info) {
     audio_codec_config_ = stream_info.codec_config();
 
   timescale_scale_ = kTsTimescale / stream_info.time_scale();
+
+  if (stream_info.is_encrypted() &&
+      stream_info.encryption_config().protection_scheme ==
+          kAes128ProtectionScheme) {
+    const EncryptionConfig& config = stream_info.encryption_config();
+    // The padding is added in FinalizeSegment, so that the segment can be
+    // encrypted in pieces as it is written.
+    segment_encryptor_.reset(
+        new AesCbcEncryptor(kNoPadding, AesCryptor::kDontUseConstantIv));
+    if (!segment_encryptor_->InitializeWithIv(config.key,
+                                              config.constant_iv)) {
+      return Status(error::MUXER_FAILURE,
+                    "Failed to initialize AES-128 segment encryptor.");
+    }
+    segment_iv_ = config.constant_iv;
+  }
   return Status::OK;
 }
 
@@ -137,6 +156,13 @@ Status TsSegmenter::StartSegmentIfNeeded(int64_t next_pts) {
   segment_start_timestamp_ = next_pts;
   if (!ts_writer_->NewSegment(&segment_buffer_))
     return Status(error::MUXER_FAILURE, "Failed to initialize new segment.");
+  if (segment_encryptor_) {
+    // Every segment is encrypted on its own, starting from the same IV.
+    if (!segment_encryptor_->SetIv(segment_iv_))
+      return Status(error::MUXER_FAILURE, "Failed to reset AES-128 IV.");
+    num_encrypted_bytes_ = 0;
+    segment_padding_size_ = 0;
+  }
   segment_started_ = true;
   return Status::OK;
 }
@@ -164,6 +190,26 @@ Status TsSegmenter::WritePesPackets() {
         return Status(error::MUXER_FAILURE, "Failed to add PES packet.");
     }
   }
+  return EncryptSegmentBuffer();
+}
+
+Status TsSegmenter::EncryptSegmentBuffer() {
+  if (!segment_encryptor_ || !segment_started_)
+    return Status::OK;
+
+  // Bytes of an incomplete trailing block are left for the next call, as the
+  // chain can only be continued on block boundaries.
+  const size_t encrypt_end =
+      segment_buffer_.Size() - segment_buffer_.Size() % AES_BLOCK_SIZE;
+  if (encrypt_end == num_encrypted_bytes_)
+    return Status::OK;
+
+  uint8_t* data = segment_buffer_.MutableBuffer() + num_encrypted_bytes_;
+  const size_t size = encrypt_end - num_encrypted_bytes_;
+  if (!segment_encryptor_->Crypt(data, size, data)) {
+    return Status(error::MUXER_FAILURE, "Failed to encrypt AES-128 segment.");
+  }
+  num_encrypted_bytes_ = encrypt_end;
   return Status::OK;
 }
 
@@ -174,6 +220,20 @@ Status TsSegmenter::FinalizeSegment(int64_t start_timestamp, int64_t duration) {
   Status status = WritePesPackets();
   if (!status.ok())
     return status;
+
+  if (segment_encryptor_ && segment_started_) {
+    // RFC 8216 5.2: AES-128 segments are padded with PKCS7, which always adds
+    // between 1 and 16 bytes.
+    segment_padding_size_ =
+        AES_BLOCK_SIZE - segment_buffer_.Size() % AES_BLOCK_SIZE;
+    const std::vector<uint8_t> padding(
+        segment_padding_size_, static_cast<uint8_t>(segment_padding_size_));
+    segment_buffer_.AppendVector(padding);
+    status = EncryptSegmentBuffer();
+    if (!status.ok())
+      return status;
+    DCHECK_EQ(num_encrypted_bytes_, segment_buffer_.Size());
+  }
   return Status::OK;
 }
 
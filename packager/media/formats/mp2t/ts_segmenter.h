@@ -7,11 +7,13 @@
 #ifndef PACKAGER_MEDIA_FORMATS_MP2T_TS_SEGMENTER_H_
 #define PACKAGER_MEDIA_FORMATS_MP2T_TS_SEGMENTER_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <vector>
 
 #include <packager/macros/classes.h>
+#include <packager/media/base/aes_cryptor.h>
 #include <packager/media/base/buffer_writer.h>
 #include <packager/media/base/media_sample.h>
 #include <packager/media/base/muxer_options.h>
@@ -78,6 +80,9 @@ class TsSegmenter {
   BufferWriter* segment_buffer() { return &segment_buffer_; }
   void set_segment_started(bool value) { segment_started_ = value; }
   bool segment_started() const { return segment_started_; }
+  /// @return the number of AES-128 padding bytes at the end of the finalized
+  ///         segment in segment_buffer().
+  size_t segment_padding_size() const { return segment_padding_size_; }
 
   double timescale() const { return timescale_scale_; }
   uint32_t transport_stream_timestamp_offset() const {
@@ -90,6 +95,10 @@ class TsSegmenter {
   // Writes PES packets (carried in TsPackets) to a buffer.
   Status WritePesPackets();
 
+  // Encrypts the complete cipher blocks written to |segment_buffer_| since the
+  // last call, for AES-128 full segment encryption.
+  Status EncryptSegmentBuffer();
+
   MuxerListener* const listener_;
 
   // Codec for the stream.
@@ -112,6 +121,15 @@ class TsSegmenter {
   std::unique_ptr<PesPacketGenerator> pes_packet_generator_;
 
   int64_t segment_start_timestamp_ = -1;
+
+  // Set for AES-128 full segment encryption. The segment is encrypted while it
+  // is written, with the cipher block chain carried over between writes.
+  std::unique_ptr<AesCryptor> segment_encryptor_;
+  std::vector<uint8_t> segment_iv_;
+  // Number of bytes at the start of |segment_buffer_| that are encrypted.
+  size_t num_encrypted_bytes_ = 0;
+  size_t segment_padding_size_ = 0;
+
   DISALLOW_COPY_AND_ASSIGN(TsSegmenter);
 };
 
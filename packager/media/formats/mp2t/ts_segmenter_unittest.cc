@@ -11,10 +11,13 @@
 #include <iterator>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <packager/media/base/aes_encryptor.h>
+#include <packager/media/base/encryption_config.h>
 #include <packager/media/base/media_sample.h>
 #include <packager/media/base/muxer_options.h>
 #include <packager/media/base/stream_info.h>
@@ -32,6 +35,7 @@ namespace mp2t {
 
 using ::testing::_;
 using ::testing::InSequence;
+using ::testing::Invoke;
 using ::testing::Return;
 using ::testing::Sequence;
 using ::testing::StrEq;
@@ -410,6 +414,87 @@ TEST_F(TsSegmenterTest, EncryptedSample) {
   EXPECT_OK(segmenter.AddSample(*sample2));
 }
 
+// AES-128 segments are encrypted as they are written, which should give the
+// same result as encrypting the whole segment at once.
+TEST_F(TsSegmenterTest, Aes128FullSegmentEncryption) {
+  const std::vector<uint8_t> kKey(16, 0x11);
+  const std::vector<uint8_t> kIv(16, 0x22);
+  // Enough samples for the segment to cross several cipher blocks.
+  const int kNumSamples = 11;
+
+  std::shared_ptr<VideoStreamInfo> stream_info(new VideoStreamInfo(
+      kTrackId, kTimeScale, kDuration, kH264Codec,
+      H26xStreamFormat::kAnnexbByteStream, kCodecString, kExtraData,
+      std::size(kExtraData), kWidth, kHeight, kPixelWidth, kPixelHeight,
+      kColorPrimaries, kMatrixCoefficients, kTransferCharacteristics,
+      kTrickPlayFactor, kNaluLengthSize, kLanguage, true /* is_encrypted */));
+  EncryptionConfig encryption_config;
+  encryption_config.protection_scheme = kAes128ProtectionScheme;
+  encryption_config.key = kKey;
+  encryption_config.constant_iv = kIv;
+  stream_info->set_encryption_config(encryption_config);
+
+  MuxerOptions options;
+  options.segment_template = "file$Number$.ts";
+  TsSegmenter segmenter(options, nullptr);
+
+  size_t num_ready_pes_packets = 0;
+  ON_CALL(*mock_ts_writer_, NewSegment(_)).WillByDefault(Return(true));
+  ON_CALL(*mock_ts_writer_, AddPesPacketMock(_, _)).WillByDefault(Return(true));
+  ON_CALL(*mock_pes_packet_generator_, Initialize(_))
+      .WillByDefault(Return(true));
+  ON_CALL(*mock_pes_packet_generator_, Flush()).WillByDefault(Return(true));
+  ON_CALL(*mock_pes_packet_generator_, PushSample(_))
+      .WillByDefault(Invoke([&num_ready_pes_packets](const MediaSample&) {
+        num_ready_pes_packets = 1;
+        return true;
+      }));
+  ON_CALL(*mock_pes_packet_generator_, NumberOfReadyPesPackets())
+      .WillByDefault(Invoke(
+          [&num_ready_pes_packets]() { return num_ready_pes_packets; }));
+  // The pointers are released inside the segmenter.
+  ON_CALL(*mock_pes_packet_generator_, GetNextPesPacketMock())
+      .WillByDefault(Invoke([&num_ready_pes_packets]() {
+        num_ready_pes_packets = 0;
+        return new PesPacket();
+      }));
+
+  segmenter.InjectPesPacketGeneratorForTesting(
+      std::move(mock_pes_packet_generator_));
+  ASSERT_OK(segmenter.Initialize(*stream_info));
+  segmenter.InjectTsWriterForTesting(std::move(mock_ts_writer_));
+
+  std::shared_ptr<MediaSample> sample =
+      MediaSample::CopyFrom(kAnyData, std::size(kAnyData), kIsKeyFrame);
+  std::vector<uint8_t> clear_segment;
+  for (int i = 0; i < kNumSamples; ++i) {
+    clear_segment.insert(clear_segment.end(), std::begin(kAnyData),
+                         std::end(kAnyData));
+  }
+  AesCbcEncryptor encryptor(kPkcs5Padding, AesCryptor::kUseConstantIv);
+  ASSERT_TRUE(encryptor.InitializeWithIv(kKey, kIv));
+  std::vector<uint8_t> expected_segment;
+  ASSERT_TRUE(encryptor.Crypt(clear_segment, &expected_segment));
+
+  // Every segment starts over with the IV, so both give the same output.
+  for (int segment = 0; segment < 2; ++segment) {
+    for (int i = 0; i < kNumSamples; ++i)
+      ASSERT_OK(segmenter.AddSample(*sample));
+    ASSERT_OK(segmenter.FinalizeSegment(0, kDuration));
+
+    BufferWriter* segment_buffer = segmenter.segment_buffer();
+    EXPECT_EQ(expected_segment,
+              std::vector<uint8_t>(
+                  segment_buffer->Buffer(),
+                  segment_buffer->Buffer() + segment_buffer->Size()));
+    EXPECT_EQ(expected_segment.size() - clear_segment.size(),
+              segmenter.segment_padding_size());
+    // What TsMuxer does after writing the segment.
+    segment_buffer->Clear();
+    segmenter.set_segment_started(false);
+  }
+}
+
 }  // namespace mp2t
 }  // namespace media
 }  // namespace shaka
@@ -13,6 +13,7 @@
 #include <utility>
 #include <vector>
 
+#include <absl/base/internal/endian.h>
 #include <absl/flags/flag.h>
 #include <absl/log/check.h>
 #include <absl/log/log.h>
@@ -148,6 +149,88 @@ bool IsProtectionSchemeSupported(FourCC scheme) {
          scheme == FOURCC_cbc1 || scheme == FOURCC_cbcs;
 }
 
+// Writes the per-sample fields of |trun|, which make up the bulk of a
+// fragment header, directly into |writer| instead of one field at a time
+// through BoxBuffer.
+void WriteTrackFragmentRunSamples(const TrackFragmentRun& trun,
+                                  BufferWriter* writer) {
+  const bool sample_duration_present =
+      (trun.flags & TrackFragmentRun::kSampleDurationPresentMask) != 0;
+  const bool sample_size_present =
+      (trun.flags & TrackFragmentRun::kSampleSizePresentMask) != 0;
+  const bool sample_flags_present =
+      (trun.flags & TrackFragmentRun::kSampleFlagsPresentMask) != 0;
+  const bool sample_composition_time_offsets_present =
+      (trun.flags & TrackFragmentRun::kSampleCompTimeOffsetsPresentMask) != 0;
+  const size_t num_fields = sample_duration_present + sample_size_present +
+                            sample_flags_present +
+                            sample_composition_time_offsets_present;
+  if (num_fields == 0 || trun.sample_count == 0)
+    return;
+
+  uint8_t* out =
+      writer->AppendSpace(num_fields * sizeof(uint32_t) * trun.sample_count);
+  for (uint32_t i = 0; i < trun.sample_count; ++i) {
+    if (sample_duration_present) {
+      absl::big_endian::Store32(out, trun.sample_durations[i]);
+      out += sizeof(uint32_t);
+    }
+    if (sample_size_present) {
+      absl::big_endian::Store32(out, trun.sample_sizes[i]);
+      out += sizeof(uint32_t);
+    }
+    if (sample_flags_present) {
+      absl::big_endian::Store32(out, trun.sample_flags[i]);
+      out += sizeof(uint32_t);
+    }
+    if (sample_composition_time_offsets_present) {
+      // Version 0 and version 1 offsets have the same 32-bit representation.
+      absl::big_endian::Store32(
+          out, static_cast<uint32_t>(trun.sample_composition_time_offsets[i]));
+      out += sizeof(uint32_t);
+    }
+  }
+}
+
+// Writes the per-sample entries of |senc| directly into |writer|, like
+// WriteTrackFragmentRunSamples() above. Returns false if an entry cannot be
+// written.
+bool WriteSampleEncryptionEntries(const SampleEncryption& senc,
+                                  BufferWriter* writer) {
+  const bool has_subsamples =
+      (senc.flags & SampleEncryption::kUseSubsampleEncryption) != 0;
+  // The entries are checked before the space is reserved, as they are
+  // written into it without bounds checks.
+  size_t size = 0;
+  for (const SampleEncryptionEntry& entry : senc.sample_encryption_entries) {
+    RCHECK(entry.initialization_vector.size() == senc.iv_size);
+    RCHECK(!has_subsamples ||
+           (!entry.subsamples.empty() &&
+            entry.subsamples.size() <= std::numeric_limits<uint16_t>::max()));
+    size += has_subsamples ? entry.ComputeSize() : senc.iv_size;
+  }
+  if (size == 0)
+    return true;
+
+  uint8_t* out = writer->AppendSpace(size);
+  for (const SampleEncryptionEntry& entry : senc.sample_encryption_entries) {
+    out = std::copy(entry.initialization_vector.begin(),
+                    entry.initialization_vector.end(), out);
+    if (!has_subsamples)
+      continue;
+    absl::big_endian::Store16(out,
+                              static_cast<uint16_t>(entry.subsamples.size()));
+    out += sizeof(uint16_t);
+    for (const SubsampleEntry& subsample : entry.subsamples) {
+      absl::big_endian::Store16(out, subsample.clear_bytes);
+      out += sizeof(uint16_t);
+      absl::big_endian::Store32(out, subsample.cipher_bytes);
+      out += sizeof(uint32_t);
+    }
+  }
+  return true;
+}
+
 }  // namespace
 
 FileType::FileType() = default;
@@ -359,6 +442,8 @@ bool SampleEncryption::ReadWriteInternal(BoxBuffer* buffer) {
   uint32_t sample_count =
       static_cast<uint32_t>(sample_encryption_entries.size());
   RCHECK(buffer->ReadWriteUInt32(&sample_count));
+  if (!buffer->Reading())
+    return WriteSampleEncryptionEntries(*this, buffer->writer());
 
   sample_encryption_entries.resize(sample_count);
   for (auto& sample_encryption_entry : sample_encryption_entries) {
@@ -2793,6 +2878,9 @@ bool TrackFragmentRun::ReadWriteInternal(BoxBuffer* buffer) {
       DCHECK(sample_flags.size() == sample_count);
     if (sample_composition_time_offsets_present)
       DCHECK(sample_composition_time_offsets.size() == sample_count);
+
+    WriteTrackFragmentRunSamples(*this, buffer->writer());
+    return true;
   }
 
   for (uint32_t i = 0; i < sample_count; ++i) {
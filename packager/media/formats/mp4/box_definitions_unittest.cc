@@ -1449,6 +1449,43 @@ TEST_F(BoxDefinitionsTest, SampleEncryptionWithIvKnownWhenReading) {
   ASSERT_EQ(senc, senc_readback);
 }
 
+TEST_F(BoxDefinitionsTest, SampleEncryptionWrite) {
+  SampleEncryption senc;
+  Fill(&senc);
+  senc.Write(buffer_.get());
+
+  const uint8_t kExpectedSenc[] = {
+      0, 0, 0, 60, 's', 'e', 'n', 'c', 0, 0, 0, 2,  // Header.
+      0, 0, 0, 2,                                   // Sample count.
+      3, 4, 5, 6, 7, 8, 9, 0,                       // IV.
+      0, 2,                                         // Subsample count.
+      0, 17, 0, 0, 0x0d, 0x80,                      // Subsample.
+      0x06, 0x07, 0, 0, 0, 0,                       // Subsample.
+      3, 4, 5, 6, 7, 8, 9, 0,                       // IV.
+      0, 2,                                         // Subsample count.
+      0, 0, 0, 0, 0, 15,                            // Subsample.
+      0x07, 0xc4, 0, 0, 0x22, 0x3d,                 // Subsample.
+  };
+  EXPECT_EQ(std::vector<uint8_t>(std::begin(kExpectedSenc),
+                                 std::end(kExpectedSenc)),
+            std::vector<uint8_t>(buffer_->Buffer(),
+                                 buffer_->Buffer() + buffer_->Size()));
+}
+
+TEST_F(BoxDefinitionsTest, SampleEncryptionConstantIv) {
+  SampleEncryption senc;
+  Fill(&senc);
+  senc.iv_size = 0;
+  for (SampleEncryptionEntry& entry : senc.sample_encryption_entries)
+    entry.initialization_vector.clear();
+  senc.Write(buffer_.get());
+
+  SampleEncryption senc_readback;
+  senc_readback.iv_size = senc.iv_size;
+  ASSERT_TRUE(ReadBack(&senc_readback));
+  ASSERT_EQ(senc, senc_readback);
+}
+
 TEST_F(BoxDefinitionsTest, SampleEncryptionWithIvUnknownWhenReading) {
   SampleEncryption senc;
   Fill(&senc);
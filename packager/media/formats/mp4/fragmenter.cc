@@ -99,10 +99,11 @@ Status Fragmenter::AddSample(const MediaSample& sample) {
 
   if (stream_info_->stream_type() == StreamType::kStreamVideo &&
       sample.is_key_frame()) {
-    key_frame_infos_.push_back({pts, data_->Size(), sample.data_size()});
+    key_frame_infos_.push_back({pts, data_size_, sample.data_size()});
   }
 
-  data_->AppendArray(sample.data(), sample.data_size());
+  samples_.emplace_back(sample.shared_data(), sample.data_size());
+  data_size_ += sample.data_size();
 
   traf_->runs[0].sample_composition_time_offsets.push_back(pts - dts);
   if (pts != dts)
@@ -159,7 +160,8 @@ Status Fragmenter::InitializeFragment(int64_t first_sample_dts) {
   fragment_duration_ = 0;
   earliest_presentation_time_ = kInvalidTime;
   first_sap_time_ = kInvalidTime;
-  data_.reset(new BufferWriter());
+  samples_.clear();
+  data_size_ = 0;
   key_frame_infos_.clear();
   return Status::OK;
 }
@@ -232,6 +234,12 @@ Status Fragmenter::FinalizeFragment() {
   return Status::OK;
 }
 
+void Fragmenter::WriteData(BufferWriter* buffer) const {
+  DCHECK(buffer);
+  for (const auto& sample : samples_)
+    buffer->AppendArray(sample.first.get(), sample.second);
+}
+
 void Fragmenter::GenerateSegmentReference(SegmentReference* reference) const {
   // NOTE: Daisy chain is not supported currently.
   reference->reference_type = false;
@@ -9,6 +9,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include <absl/log/check.h>
@@ -69,7 +70,12 @@ class Fragmenter {
   }
   bool fragment_initialized() const { return fragment_initialized_; }
   bool fragment_finalized() const { return fragment_finalized_; }
-  BufferWriter* data() { return data_.get(); }
+  /// @return the size of the sample data in the current fragment, i.e. the
+  ///         payload of the corresponding 'mdat' box.
+  uint64_t data_size() const { return data_size_; }
+  /// Append the sample data of the current fragment to @a buffer. The samples
+  /// are referenced, not copied, until the fragment is written.
+  void WriteData(BufferWriter* buffer) const;
   const std::vector<KeyFrameInfo>& key_frame_infos() const {
     return key_frame_infos_;
   }
@@ -97,7 +103,9 @@ class Fragmenter {
   int64_t fragment_duration_ = 0;
   int64_t earliest_presentation_time_ = 0;
   int64_t first_sap_time_ = 0;
-  std::unique_ptr<BufferWriter> data_;
+  // Sample data of the current fragment, in decoding order.
+  std::vector<std::pair<std::shared_ptr<const uint8_t>, size_t>> samples_;
+  uint64_t data_size_ = 0;
   // Saves key frames information, for Video.
   std::vector<KeyFrameInfo> key_frame_infos_;
 
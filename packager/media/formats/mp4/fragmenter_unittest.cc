@@ -0,0 +1,111 @@
+// Copyright 2024 Google LLC. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include <packager/media/formats/mp4/fragmenter.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <packager/media/base/buffer_writer.h>
+#include <packager/media/base/media_sample.h>
+#include <packager/media/base/video_stream_info.h>
+#include <packager/media/formats/mp4/box_definitions.h>
+#include <packager/status/status_test_util.h>
+
+namespace shaka {
+namespace media {
+namespace mp4 {
+namespace {
+
+const int32_t kTimeScale = 90000;
+const int64_t kSampleDuration = 3000;
+const uint8_t kCodecConfig[] = {0x00};
+const uint8_t kKeyFrameData[] = {0x01, 0x02, 0x03, 0x04};
+const uint8_t kFrameData[] = {0x05, 0x06};
+
+std::shared_ptr<MediaSample> CreateSample(const uint8_t* data,
+                                          size_t data_size,
+                                          bool is_key_frame,
+                                          int64_t dts) {
+  std::shared_ptr<MediaSample> sample =
+      MediaSample::CopyFrom(data, data_size, is_key_frame);
+  sample->set_dts(dts);
+  sample->set_pts(dts);
+  sample->set_duration(kSampleDuration);
+  return sample;
+}
+
+}  // namespace
+
+class FragmenterTest : public ::testing::Test {
+ protected:
+  FragmenterTest()
+      : fragmenter_(std::make_shared<VideoStreamInfo>(
+                        1, kTimeScale, 0, kCodecH264,
+                        H26xStreamFormat::kNalUnitStreamWithoutParameterSetNalus,
+                        "avc1", kCodecConfig, sizeof(kCodecConfig), 640, 360,
+                        1, 1, 0, 0, 0, 0, 4, "und", false),
+                    &traf_,
+                    0) {}
+
+  TrackFragment traf_;
+  Fragmenter fragmenter_;
+};
+
+TEST_F(FragmenterTest, WriteData) {
+  ASSERT_OK(fragmenter_.AddSample(*CreateSample(
+      kKeyFrameData, sizeof(kKeyFrameData), true, 0)));
+  ASSERT_OK(fragmenter_.AddSample(
+      *CreateSample(kFrameData, sizeof(kFrameData), false, kSampleDuration)));
+  ASSERT_OK(fragmenter_.AddSample(*CreateSample(
+      kKeyFrameData, sizeof(kKeyFrameData), true, 2 * kSampleDuration)));
+  ASSERT_OK(fragmenter_.FinalizeFragment());
+
+  const size_t kDataSize = 2 * sizeof(kKeyFrameData) + sizeof(kFrameData);
+  EXPECT_EQ(kDataSize, fragmenter_.data_size());
+  ASSERT_EQ(2u, fragmenter_.key_frame_infos().size());
+  EXPECT_EQ(0u, fragmenter_.key_frame_infos()[0].start_byte_offset);
+  EXPECT_EQ(sizeof(kKeyFrameData) + sizeof(kFrameData),
+            fragmenter_.key_frame_infos()[1].start_byte_offset);
+
+  // The samples are written after the fragment is finalized, even though the
+  // samples themselves are gone.
+  BufferWriter buffer;
+  buffer.AppendInt(static_cast<uint8_t>(0xFF));
+  fragmenter_.WriteData(&buffer);
+  std::vector<uint8_t> expected_data = {0xFF};
+  expected_data.insert(expected_data.end(), std::begin(kKeyFrameData),
+                       std::end(kKeyFrameData));
+  expected_data.insert(expected_data.end(), std::begin(kFrameData),
+                       std::end(kFrameData));
+  expected_data.insert(expected_data.end(), std::begin(kKeyFrameData),
+                       std::end(kKeyFrameData));
+  EXPECT_EQ(expected_data, std::vector<uint8_t>(buffer.Buffer(),
+                                                buffer.Buffer() + buffer.Size()));
+}
+
+TEST_F(FragmenterTest, InitializeFragmentDropsData) {
+  ASSERT_OK(fragmenter_.AddSample(*CreateSample(
+      kKeyFrameData, sizeof(kKeyFrameData), true, 0)));
+  ASSERT_OK(fragmenter_.FinalizeFragment());
+  ASSERT_OK(fragmenter_.InitializeFragment(kSampleDuration));
+  ASSERT_OK(fragmenter_.AddSample(
+      *CreateSample(kFrameData, sizeof(kFrameData), false, kSampleDuration)));
+
+  EXPECT_EQ(sizeof(kFrameData), fragmenter_.data_size());
+  BufferWriter buffer;
+  fragmenter_.WriteData(&buffer);
+  EXPECT_EQ(std::vector<uint8_t>(std::begin(kFrameData), std::end(kFrameData)),
+            std::vector<uint8_t>(buffer.Buffer(),
+                                 buffer.Buffer() + buffer.Size()));
+}
+
+}  // namespace mp4
+}  // namespace media
+}  // namespace shaka
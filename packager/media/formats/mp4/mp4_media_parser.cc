@@ -9,6 +9,7 @@
 #include <cstdint>
 #include <functional>
 #include <limits>
+#include <map>
 #include <memory>
 #include <string>
 #include <utility>
@@ -345,7 +346,66 @@ bool MP4MediaParser::Parse(const uint8_t* buf, int size) {
   return true;
 }
 
+void MP4MediaParser::SetTrackStartTimestamp(uint32_t track_id,
+                                            int64_t start_dts) {
+  track_start_timestamps_[track_id] = start_dts;
+}
+
 bool MP4MediaParser::LoadMoov(const std::string& file_path) {
+  const bool kSkipLeadingMoov = true;
+  return ParseMoovFromFile(file_path, kSkipLeadingMoov);
+}
+
+bool MP4MediaParser::ReadSampleTimings(
+    const std::string& file_path,
+    std::map<uint32_t, std::vector<SampleTiming>>* sample_timings) {
+  DCHECK(sample_timings);
+  const bool kSkipLeadingMoov = false;
+  if (!ParseMoovFromFile(file_path, kSkipLeadingMoov) || !moov_)
+    return false;
+  // The samples of fragmented files are not listed in 'moov'.
+  if (!moov_->extends.tracks.empty()) {
+    VLOG(1) << "Not reading sample timings of fragmented file '" << file_path
+            << "'.";
+    return false;
+  }
+
+  TrackRunIterator runs(moov_.get());
+  RCHECK(runs.Init());
+  sample_timings->clear();
+  for (; runs.IsRunValid(); runs.AdvanceRun()) {
+    std::vector<SampleTiming>& track_timings =
+        (*sample_timings)[runs.track_id()];
+    for (; runs.IsSampleValid(); runs.AdvanceSample()) {
+      SampleTiming timing;
+      timing.pts = runs.cts();
+      timing.dts = runs.dts();
+      timing.duration = runs.duration();
+      timing.is_key_frame = runs.is_keyframe();
+      track_timings.push_back(timing);
+    }
+  }
+  return true;
+}
+
+int64_t MP4MediaParser::GetNextDataOffset() {
+  const int64_t tail = queue_.tail();
+  if (state_ != kEmittingSamples || !runs_->IsRunValid())
+    return tail;
+  // The data up to the end of the current 'mdat' box only holds samples, while
+  // the box headers after it need to be parsed.
+  const int64_t offset =
+      std::min(runs_->GetMaxClearOffset() + moof_head_, mdat_tail_);
+  return std::max(offset, tail);
+}
+
+void MP4MediaParser::SkipTo(int64_t offset) {
+  DCHECK_LE(offset, GetNextDataOffset());
+  queue_.SkipTo(offset);
+}
+
+bool MP4MediaParser::ParseMoovFromFile(const std::string& file_path,
+                                       bool skip_leading_moov) {
   std::unique_ptr<File, FileCloser> file(
       File::OpenWithNoBuffering(file_path.c_str(), "r"));
   if (!file) {
@@ -383,11 +443,11 @@ bool MP4MediaParser::LoadMoov(const std::string& file_path) {
     if (box_type == FOURCC_mdat) {
       mdat_seen = true;
     } else if (box_type == FOURCC_moov) {
-      if (!mdat_seen) {
+      if (!mdat_seen && skip_leading_moov) {
         // 'moov' is before 'mdat'. Nothing to do.
         break;
       }
-      // 'mdat' before 'moov'. Read and parse 'moov'.
+      // Read and parse 'moov'.
       if (!Parse(&buffer[0], bytes_read)) {
         LOG(ERROR) << "Error parsing mp4 file '" << file_path << "'";
         return false;
@@ -980,6 +1040,21 @@ bool MP4MediaParser::EnqueueSample(bool* err) {
     return true;
   }
 
+  // Skip the runs of the tracks which are not consumed without reading their
+  // auxiliary information or sample data.
+  if (!IsTrackSelected(runs_->track_id())) {
+    runs_->AdvanceRun();
+    return true;
+  }
+
+  // Skip the samples before the start of the track without reading them.
+  auto start_iter = track_start_timestamps_.find(runs_->track_id());
+  if (start_iter != track_start_timestamps_.end() &&
+      runs_->dts() < start_iter->second) {
+    runs_->AdvanceSample();
+    return true;
+  }
+
   DCHECK(!(*err));
 
   const uint8_t* buf;
@@ -8,6 +8,7 @@
 #define PACKAGER_MEDIA_FORMATS_MP4_MP4_MEDIA_PARSER_H_
 
 #include <cstdint>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -17,6 +18,7 @@
 #include <packager/macros/classes.h>
 #include <packager/media/base/decryptor_source.h>
 #include <packager/media/base/media_parser.h>
+#include <packager/media/base/media_sample.h>
 #include <packager/media/base/offset_byte_queue.h>
 
 ABSL_DECLARE_FLAG(bool, use_dovi_supplemental_codecs);
@@ -43,6 +45,7 @@ class MP4MediaParser : public MediaParser {
             KeySource* decryption_key_source) override;
   [[nodiscard]] bool Flush() override;
   [[nodiscard]] bool Parse(const uint8_t* buf, int size) override;
+  void SetTrackStartTimestamp(uint32_t track_id, int64_t start_dts) override;
   /// @}
 
   /// Handles ISO-BMFF containers which have the 'moov' box trailing the
@@ -53,9 +56,39 @@ class MP4MediaParser : public MediaParser {
   /// @return true if successful, false otherwise.
   bool LoadMoov(const std::string& file_path);
 
+  /// Reads the timing of every sample from the 'moov' box, without reading the
+  /// sample data. The stream info is delivered to the init callback as when
+  /// parsing. The parser is not meant to parse the file afterwards.
+  /// @param file_path is the path to the media file to be read.
+  /// @param[out] sample_timings gets the timing of the samples of each track,
+  ///        keyed by track id, in decoding order.
+  /// @return true if successful, false otherwise, including for fragmented
+  ///         files, whose samples are not listed in the 'moov' box.
+  bool ReadSampleTimings(
+      const std::string& file_path,
+      std::map<uint32_t, std::vector<SampleTiming>>* sample_timings);
+
+  /// @return The offset in the file of the next data the parser needs. It is
+  ///         beyond the end of the data passed to Parse() if the data in
+  ///         between only holds samples which are skipped, e.g. those before
+  ///         the track start timestamps. The caller can then skip that data
+  ///         with SkipTo().
+  int64_t GetNextDataOffset();
+
+  /// Skips the data up to @a offset, so that the next data passed to Parse()
+  /// starts at @a offset.
+  /// @param offset is the offset to skip to, which must be between the end of
+  ///        the data passed to Parse() and GetNextDataOffset().
+  void SkipTo(int64_t offset);
+
  private:
   enum State { kWaitingForInit, kParsingBoxes, kEmittingSamples, kError };
 
+  // Locates the 'moov' box of |file_path| with a sparse parse of the file and
+  // parses it. A 'moov' box preceding the 'mdat' box is left to the regular
+  // parse if |skip_leading_moov| is set.
+  bool ParseMoovFromFile(const std::string& file_path, bool skip_leading_moov);
+
   bool ParseBox(bool* err);
   bool ParseMoov(mp4::BoxReader* reader);
   bool ParseMoof(mp4::BoxReader* reader);
@@ -99,6 +132,8 @@ class MP4MediaParser : public MediaParser {
 
   std::unique_ptr<Movie> moov_;
   std::unique_ptr<TrackRunIterator> runs_;
+  // Track id -> start decoding timestamp map.
+  std::map<uint32_t, int64_t> track_start_timestamps_;
 
   DISALLOW_COPY_AND_ASSIGN(MP4MediaParser);
 };
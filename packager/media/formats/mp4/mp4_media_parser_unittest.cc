@@ -236,6 +236,36 @@ TEST_F(MP4MediaParserTest, Flush) {
   EXPECT_EQ(201u, num_samples_);
 }
 
+TEST_F(MP4MediaParserTest, SelectedTracks) {
+  // Only the samples of the selected track should be emitted.
+  uint32_t video_track_id = 0;
+  parser_->Init(
+      [this, &video_track_id](
+          const std::vector<std::shared_ptr<StreamInfo>>& streams) {
+        InitF(streams);
+        for (const auto& stream_info : streams) {
+          if (stream_info->stream_type() == kStreamVideo)
+            video_track_id = stream_info->track_id();
+        }
+        parser_->SetSelectedTracks({video_track_id});
+      },
+      [this, &video_track_id](uint32_t track_id,
+                              std::shared_ptr<MediaSample> sample) {
+        EXPECT_EQ(video_track_id, track_id);
+        return NewSampleF(track_id, sample);
+      },
+      [this](uint32_t track_id, std::shared_ptr<TextSample> sample) {
+        return NewTextSampleF(track_id, sample);
+      },
+      NULL);
+
+  std::vector<uint8_t> buffer = ReadTestDataFile("bear-640x360-av_frag.mp4");
+  ASSERT_FALSE(buffer.empty());
+  EXPECT_TRUE(AppendDataInPieces(buffer.data(), buffer.size(), 512));
+  EXPECT_EQ(2u, num_streams_);
+  EXPECT_EQ(82u, num_samples_);
+}
+
 TEST_F(MP4MediaParserTest, MPEG2_AAC_LC) {
   ASSERT_TRUE(ParseMP4File("bear-mpeg2-aac-only_frag.mp4", 512));
   EXPECT_EQ(1u, num_streams_);
@@ -263,6 +293,75 @@ TEST_F(MP4MediaParserTest, NON_FRAGMENTED_MP4) {
   EXPECT_EQ(201u, num_samples_);
 }
 
+TEST_F(MP4MediaParserTest, TrackStartTimestamp) {
+  const std::string kFileName = "bear-640x360.mp4";
+
+  // Start the video track in the middle.
+  uint32_t video_track_id = 0;
+  std::map<uint32_t, std::vector<SampleTiming>> sample_timings;
+  MP4MediaParser timings_parser;
+  timings_parser.Init(
+      [&video_track_id](
+          const std::vector<std::shared_ptr<StreamInfo>>& streams) {
+        for (const auto& stream_info : streams) {
+          if (stream_info->stream_type() == kStreamVideo)
+            video_track_id = stream_info->track_id();
+        }
+      },
+      [](uint32_t, std::shared_ptr<MediaSample>) { return true; },
+      [](uint32_t, std::shared_ptr<TextSample>) { return true; }, NULL);
+  ASSERT_TRUE(timings_parser.ReadSampleTimings(
+      GetTestDataFilePath(kFileName).string(), &sample_timings));
+  const std::vector<SampleTiming>& video_timings =
+      sample_timings[video_track_id];
+  ASSERT_FALSE(video_timings.empty());
+  const size_t start_index = video_timings.size() / 2;
+  const int64_t start_dts = video_timings[start_index].dts;
+
+  std::vector<int64_t> sample_dts;
+  parser_->Init(
+      [this, video_track_id,
+       start_dts](const std::vector<std::shared_ptr<StreamInfo>>& streams) {
+        InitF(streams);
+        parser_->SetSelectedTracks({video_track_id});
+        parser_->SetTrackStartTimestamp(video_track_id, start_dts);
+      },
+      [this, &sample_dts](uint32_t track_id,
+                          std::shared_ptr<MediaSample> sample) {
+        sample_dts.push_back(sample->dts());
+        return NewSampleF(track_id, sample);
+      },
+      [this](uint32_t track_id, std::shared_ptr<TextSample> sample) {
+        return NewTextSampleF(track_id, sample);
+      },
+      NULL);
+  ASSERT_TRUE(parser_->LoadMoov(GetTestDataFilePath(kFileName).string()));
+
+  // Skip the data which the parser does not need, as the demuxer does.
+  std::vector<uint8_t> buffer = ReadTestDataFile(kFileName);
+  ASSERT_FALSE(buffer.empty());
+  const int64_t kPieceSize = 512;
+  const int64_t file_size = static_cast<int64_t>(buffer.size());
+  int64_t offset = 0;
+  int64_t skipped_bytes = 0;
+  while (offset < file_size) {
+    const int64_t next_offset = parser_->GetNextDataOffset();
+    if (next_offset > offset) {
+      parser_->SkipTo(next_offset);
+      skipped_bytes += next_offset - offset;
+      offset = next_offset;
+      continue;
+    }
+    const int64_t size = std::min(kPieceSize, file_size - offset);
+    ASSERT_TRUE(AppendData(buffer.data() + offset, size));
+    offset += size;
+  }
+
+  EXPECT_GT(skipped_bytes, 0);
+  ASSERT_EQ(video_timings.size() - start_index, sample_dts.size());
+  EXPECT_EQ(start_dts, sample_dts.front());
+}
+
 TEST_F(MP4MediaParserTest, CencWithoutDecryptionSource) {
   ASSERT_TRUE(ParseMP4File("bear-640x360-v_frag-cenc-aux.mp4", 512));
   EXPECT_EQ(1u, num_streams_);
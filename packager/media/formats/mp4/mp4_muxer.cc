@@ -350,8 +350,10 @@ Status MP4Muxer::DelayInitializeMuxer() {
     segmenter_.reset(new LowLatencySegmentSegmenter(options(), std::move(ftyp),
                                                     std::move(moov)));
   } else {
-    segmenter_.reset(
+    std::unique_ptr<MultiSegmentSegmenter> segmenter(
         new MultiSegmentSegmenter(options(), std::move(ftyp), std::move(moov)));
+    segmenter->set_segment_output_queue(segment_output_queue());
+    segmenter_ = std::move(segmenter);
   }
 
   const Status segmenter_initialized =
@@ -378,8 +380,12 @@ Status MP4Muxer::UpdateEditListOffsetFromSample(const MediaSample& sample) {
   if (edit_list_offset_)
     return Status::OK;
 
-  const int64_t pts = sample.pts();
-  const int64_t dts = sample.dts();
+  // The muxer of a time range derives the edit list from the first sample of
+  // the whole stream, as a muxer of the whole stream does.
+  const int64_t pts =
+      options().range ? options().range->stream_start_pts : sample.pts();
+  const int64_t dts =
+      options().range ? options().range->stream_start_dts : sample.dts();
   // An EditList entry is inserted if one of the below conditions occur [4]:
   // (1) pts > dts for the first sample. Due to Chrome's dts bug [1], dts is
   //     used in buffered range API, while pts is used elsewhere (players,
@@ -429,7 +435,7 @@ Status MP4Muxer::UpdateEditListOffsetFromSample(const MediaSample& sample) {
                << dts << ").";
     return Status(error::MUXER_FAILURE, "Not expecting pts < dts.");
   }
-  edit_list_offset_ = std::max(-sample.pts(), static_cast<int64_t>(0));
+  edit_list_offset_ = std::max(-pts, static_cast<int64_t>(0));
   return Status::OK;
 }
 
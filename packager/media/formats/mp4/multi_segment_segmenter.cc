@@ -17,7 +17,9 @@
 #include <absl/log/check.h>
 #include <absl/log/log.h>
 
+#include <packager/buffer_callback_params.h>
 #include <packager/file.h>
+#include <packager/file/callback_file.h>
 #include <packager/file/file_closer.h>
 #include <packager/macros/status.h>
 #include <packager/media/base/aes_cryptor.h>
@@ -27,6 +29,7 @@
 #include <packager/media/base/muxer_options.h>
 #include <packager/media/base/muxer_util.h>
 #include <packager/media/base/range.h>
+#include <packager/media/base/segment_output_queue.h>
 #include <packager/media/event/muxer_listener.h>
 #include <packager/media/formats/mp4/box_definitions.h>
 #include <packager/media/formats/mp4/key_frame_info.h>
@@ -37,6 +40,18 @@ namespace shaka {
 namespace media {
 namespace mp4 {
 
+namespace {
+
+// Moves the contents of |buffer| into a buffer which can be handed over to the
+// output callback without copying.
+std::shared_ptr<const std::vector<uint8_t>> TakeBuffer(BufferWriter* buffer) {
+  auto data = std::make_shared<std::vector<uint8_t>>();
+  buffer->SwapBuffer(data.get());
+  return data;
+}
+
+}  // namespace
+
 MultiSegmentSegmenter::MultiSegmentSegmenter(const MuxerOptions& options,
                                              std::unique_ptr<FileType> ftyp,
                                              std::unique_ptr<Movie> moov)
@@ -69,12 +84,15 @@ std::vector<Range> MultiSegmentSegmenter::GetSegmentRanges() {
 }
 
 Status MultiSegmentSegmenter::DoInitialize() {
+  if (!WritesInitSegment())
+    return Status::OK;
   return WriteInitSegment();
 }
 
 Status MultiSegmentSegmenter::DoFinalize() {
   // Update init segment with media duration set.
-  RETURN_IF_ERROR(WriteInitSegment());
+  if (WritesInitSegment())
+    RETURN_IF_ERROR(WriteInitSegment());
   SetComplete();
   return Status::OK;
 }
@@ -83,19 +101,37 @@ Status MultiSegmentSegmenter::DoFinalizeSegment(int64_t segment_number) {
   return WriteSegment(segment_number);
 }
 
+bool MultiSegmentSegmenter::WritesInitSegment() const {
+  // The init segment of a stream muxed in time ranges is written by the first
+  // range.
+  return !options().range || options().range->is_first_range;
+}
+
 Status MultiSegmentSegmenter::WriteInitSegment() {
   DCHECK(ftyp());
   DCHECK(moov());
+  std::unique_ptr<BufferWriter> buffer(new BufferWriter);
+  ftyp()->Write(buffer.get());
+  moov()->Write(buffer.get());
+
+  const std::string& file_name = options().output_file_name;
+  if (CallbackFile::HasOutputCallback(file_name)) {
+    CallbackOutput output;
+    output.type = CallbackOutput::Type::kInitSegment;
+    output.buffers.push_back(TakeBuffer(buffer.get()));
+    if (!CallbackFile::WriteOutput(file_name, file_name, &output)) {
+      return Status(error::FILE_FAILURE,
+                    "Output callback failed for " + file_name);
+    }
+    return Status::OK;
+  }
+
   // Generate the output file with init segment.
-  std::unique_ptr<File, FileCloser> file(
-      File::Open(options().output_file_name.c_str(), "w"));
+  std::unique_ptr<File, FileCloser> file(File::Open(file_name.c_str(), "w"));
   if (!file) {
     return Status(error::FILE_FAILURE,
-                  "Cannot open file for write " + options().output_file_name);
+                  "Cannot open file for write " + file_name);
   }
-  std::unique_ptr<BufferWriter> buffer(new BufferWriter);
-  ftyp()->Write(buffer.get());
-  moov()->Write(buffer.get());
   return buffer->WriteToFile(file.get());
 }
 
@@ -110,9 +146,19 @@ Status MultiSegmentSegmenter::WriteSegment(int64_t segment_number) {
   sidx()->earliest_presentation_time =
       sidx()->references[0].earliest_presentation_time;
 
+  int64_t segment_duration = 0;
+  // ISO/IEC 23009-1:2012: the value shall be identical to sum of the the
+  // values of all Subsegment_duration fields in the first ‘sidx’ box.
+  for (size_t i = 0; i < sidx()->references.size(); ++i)
+    segment_duration += sidx()->references[i].subsegment_duration;
+
   std::unique_ptr<BufferWriter> buffer(new BufferWriter());
   std::unique_ptr<File, FileCloser> file;
   std::string file_name;
+  // Complete segments written to separate files can be handed over to the
+  // output callback, without copying the fragments.
+  std::unique_ptr<CallbackOutput> callback_output;
+  bool queued = false;
   if (options().segment_template.empty()) {
     // Append the segment to output file if segment template is not specified.
     file_name = options().output_file_name.c_str();
@@ -125,10 +171,22 @@ Status MultiSegmentSegmenter::WriteSegment(int64_t segment_number) {
     file_name = GetSegmentName(options().segment_template,
                                sidx()->earliest_presentation_time,
                                segment_number, options().bandwidth);
-    file.reset(File::Open(file_name.c_str(), "w"));
-    if (!file) {
-      return Status(error::FILE_FAILURE,
-                    "Cannot open file for write " + file_name);
+    if (CallbackFile::HasOutputCallback(file_name)) {
+      callback_output.reset(new CallbackOutput);
+      callback_output->type = CallbackOutput::Type::kMediaSegment;
+      callback_output->segment_number = segment_number;
+      callback_output->start_time = sidx()->earliest_presentation_time;
+      callback_output->duration = segment_duration;
+      callback_output->timescale = sidx()->timescale;
+    } else if (segment_output_queue_) {
+      // The complete segment is posted to the queue, which opens the file.
+      queued = true;
+    } else {
+      file.reset(File::Open(file_name.c_str(), "w"));
+      if (!file) {
+        return Status(error::FILE_FAILURE,
+                      "Cannot open file for write " + file_name);
+      }
     }
     styp_->Write(buffer.get());
   }
@@ -166,11 +224,23 @@ Status MultiSegmentSegmenter::WriteSegment(int64_t segment_number) {
       return Status(error::ENCRYPTION_FAILURE,
                     "AES-128: segment encryption failed.");
     }
-    buffer->Clear();
-    buffer->AppendVector(ciphertext);
-    RETURN_IF_ERROR(buffer->WriteToFile(file.get()));
+    if (callback_output) {
+      callback_output->buffers.push_back(
+          std::make_shared<const std::vector<uint8_t>>(std::move(ciphertext)));
+    } else {
+      buffer->Clear();
+      buffer->AppendVector(ciphertext);
+      if (queued)
+        RETURN_IF_ERROR(segment_output_queue_->PostSegment(file_name,
+                                                           buffer.get()));
+      else
+        RETURN_IF_ERROR(buffer->WriteToFile(file.get()));
+    }
   } else {
-    RETURN_IF_ERROR(buffer->WriteToFile(file.get()));
+    if (callback_output)
+      callback_output->buffers.push_back(TakeBuffer(buffer.get()));
+    else if (!queued)
+      RETURN_IF_ERROR(buffer->WriteToFile(file.get()));
     if (muxer_listener()) {
       for (const KeyFrameInfo& key_frame_info : key_frame_infos()) {
         muxer_listener()->OnKeyFrame(
@@ -179,24 +249,33 @@ Status MultiSegmentSegmenter::WriteSegment(int64_t segment_number) {
             key_frame_info.size);
       }
     }
-    RETURN_IF_ERROR(fragment_buffer()->WriteToFile(file.get()));
+    if (callback_output) {
+      callback_output->buffers.push_back(TakeBuffer(fragment_buffer()));
+    } else if (queued) {
+      RETURN_IF_ERROR(segment_output_queue_->PostSegment(
+          file_name, buffer.get(), fragment_buffer()));
+    } else {
+      RETURN_IF_ERROR(fragment_buffer()->WriteToFile(file.get()));
+    }
   }
 
-  // Close the file, which also does flushing, to make sure the file is written
-  // before manifest is updated.
-  if (!file.release()->Close()) {
+  if (callback_output) {
+    // The segment is handed over before the manifest is updated, as a file
+    // would be closed.
+    if (!CallbackFile::WriteOutput(file_name, options().output_file_name,
+                                   callback_output.get())) {
+      return Status(error::FILE_FAILURE,
+                    "Output callback failed for " + file_name);
+    }
+  } else if (!queued && !file.release()->Close()) {
+    // Close the file, which also does flushing, to make sure the file is
+    // written before manifest is updated.
     return Status(
         error::FILE_FAILURE,
         "Cannot close file " + file_name +
             ", possibly file permission issue or running out of disk space.");
   }
 
-  int64_t segment_duration = 0;
-  // ISO/IEC 23009-1:2012: the value shall be identical to sum of the the
-  // values of all Subsegment_duration fields in the first ‘sidx’ box.
-  for (size_t i = 0; i < sidx()->references.size(); ++i)
-    segment_duration += sidx()->references[i].subsegment_duration;
-
   UpdateProgress(segment_duration);
   if (muxer_listener()) {
     muxer_listener()->OnSampleDurationReady(sample_duration());
@@ -20,6 +20,9 @@
 
 namespace shaka {
 namespace media {
+
+class SegmentOutputQueue;
+
 namespace mp4 {
 
 struct SegmentType;
@@ -36,6 +39,14 @@ class MultiSegmentSegmenter : public Segmenter {
                         std::unique_ptr<Movie> moov);
   ~MultiSegmentSegmenter() override;
 
+  /// Sets the queue writing the media segments in the background. The media
+  /// segments are written synchronously if it is not set, or if they go to
+  /// the main output file or to an output callback.
+  /// @param queue must outlive this object.
+  void set_segment_output_queue(SegmentOutputQueue* queue) {
+    segment_output_queue_ = queue;
+  }
+
   /// @name Segmenter implementation overrides.
   /// @{
   bool GetInitRange(size_t* offset, size_t* size) override;
@@ -49,11 +60,15 @@ class MultiSegmentSegmenter : public Segmenter {
   Status DoFinalize() override;
   Status DoFinalizeSegment(int64_t segment_number) override;
 
+  // Returns false for the muxers of the time ranges after the first one.
+  bool WritesInitSegment() const;
+
   // Write segment to file.
   Status WriteInitSegment();
   Status WriteSegment(int64_t segment_number);
 
   std::unique_ptr<SegmentType> styp_;
+  SegmentOutputQueue* segment_output_queue_ = nullptr;
 
   DISALLOW_COPY_AND_ASSIGN(MultiSegmentSegmenter);
 };
@@ -102,6 +102,8 @@ Status Segmenter::Initialize(
   // Use the reference stream's time scale as movie time scale.
   moov_->header.timescale = sidx_->timescale;
   moof_->header.sequence_number = 1;
+  if (options_.range)
+    moof_->header.sequence_number += options_.range->preceding_fragments;
 
   // Fill in version information.
   const std::string version = GetPackagerVersion();
@@ -122,8 +124,12 @@ Status Segmenter::Finalize() {
   // file for VOD and static live case only.
   moov_->extends.header.fragment_duration = 0;
   for (size_t i = 0; i < stream_durations_.size(); ++i) {
+    // A muxer of a time range reports the duration of the whole stream.
+    const int64_t stream_duration = options_.range
+                                        ? options_.range->stream_duration
+                                        : stream_durations_[i];
     int64_t duration =
-        Rescale(stream_durations_[i], moov_->tracks[i].media.header.timescale,
+        Rescale(stream_duration, moov_->tracks[i].media.header.timescale,
                 moov_->header.timescale);
     if (duration >
         static_cast<int64_t>(moov_->extends.header.fragment_duration))
@@ -202,7 +208,7 @@ Status Segmenter::FinalizeSegment(size_t stream_id,
           sizeof(uint32_t);  // for sample count field in 'senc'
     }
     traf.runs[0].data_offset = data_offset + mdat.data_size;
-    mdat.data_size += static_cast<uint32_t>(fragmenters_[i]->data()->Size());
+    mdat.data_size += static_cast<uint32_t>(fragmenters_[i]->data_size());
   }
 
   // Generate segment reference.
@@ -232,7 +238,7 @@ Status Segmenter::FinalizeSegment(size_t stream_id,
           {key_frame_info.timestamp, moof_start_offset,
            fragment_buffer_->Size() - moof_start_offset + key_frame_info.size});
     }
-    fragment_buffer_->AppendBuffer(*fragmenter->data());
+    fragmenter->WriteData(fragment_buffer_.get());
   }
 
   // Increase sequence_number for next fragment.
@@ -9,7 +9,9 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <limits>
 #include <memory>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -33,6 +35,31 @@ namespace shaka {
 namespace media {
 namespace mp4 {
 
+namespace {
+
+// Size of the header of a box with a 32-bit size.
+const uint64_t kBoxHeaderSize = 8;
+
+// The reserved header space is filled in at the end, which requires an output
+// that can be rewritten in place.
+bool IsSeekableOutput(const std::string& file_name) {
+  const size_t pos = file_name.find("://");
+  if (pos == std::string::npos)
+    return true;
+  const std::string_view prefix(file_name.data(), pos + 3);
+  return prefix == kLocalFilePrefix || prefix == kMemoryFilePrefix;
+}
+
+// Writes a 'free' box of |size| bytes, including the box header.
+void WriteFreeBox(uint64_t size, BufferWriter* buffer) {
+  DCHECK_GE(size, kBoxHeaderSize);
+  buffer->AppendInt(static_cast<uint32_t>(size));
+  buffer->AppendInt(static_cast<uint32_t>(FOURCC_free));
+  buffer->AppendVector(std::vector<uint8_t>(size - kBoxHeaderSize));
+}
+
+}  // namespace
+
 SingleSegmentSegmenter::SingleSegmentSegmenter(const MuxerOptions& options,
                                                std::unique_ptr<FileType> ftyp,
                                                std::unique_ptr<Movie> moov)
@@ -55,22 +82,28 @@ bool SingleSegmentSegmenter::GetInitRange(size_t* offset, size_t* size) {
 }
 
 bool SingleSegmentSegmenter::GetIndexRange(size_t* offset, size_t* size) {
-  // Index range is right after init range so the offset must be the size of
-  // ftyp and moov.
-  *offset = ftyp()->ComputeSize() + moov()->ComputeSize();
   *size = options().mp4_params.generate_sidx_in_media_segments
               ? vod_sidx_->ComputeSize()
               : 0;
+  // Index range is right after init range so the offset must be the size of
+  // ftyp and moov, unless the header space is reserved, in which case it ends
+  // where the reserved space ends.
+  *offset = reserved_header_size_ > 0
+                ? reserved_header_size_ - *size
+                : ftyp()->ComputeSize() + moov()->ComputeSize();
   return true;
 }
 
 std::vector<Range> SingleSegmentSegmenter::GetSegmentRanges() {
   std::vector<Range> ranges;
-  uint64_t next_offset = ftyp()->ComputeSize() + moov()->ComputeSize() +
-                         (options().mp4_params.generate_sidx_in_media_segments
-                              ? vod_sidx_->ComputeSize()
-                              : 0) +
-                         vod_sidx_->first_offset;
+  uint64_t next_offset =
+      (reserved_header_size_ > 0
+           ? reserved_header_size_
+           : ftyp()->ComputeSize() + moov()->ComputeSize() +
+                 (options().mp4_params.generate_sidx_in_media_segments
+                      ? vod_sidx_->ComputeSize()
+                      : 0)) +
+      vod_sidx_->first_offset;
   for (const SegmentReference& segment_reference : vod_sidx_->references) {
     Range r;
     r.start = next_offset;
@@ -83,6 +116,31 @@ std::vector<Range> SingleSegmentSegmenter::GetSegmentRanges() {
 }
 
 Status SingleSegmentSegmenter::DoInitialize() {
+  const uint64_t reserved_header_size =
+      options().mp4_params.reserved_header_size;
+  if (reserved_header_size > 0) {
+    if (reserved_header_size > std::numeric_limits<uint32_t>::max()) {
+      return Status(error::INVALID_ARGUMENT,
+                    "Reserved header size is too large.");
+    }
+    if (IsSeekableOutput(options().output_file_name)) {
+      // Write the fragments directly to the output, after the space reserved
+      // for the header, which is written in place when finalizing.
+      temp_file_.reset(File::Open(options().output_file_name.c_str(), "w"));
+      if (!temp_file_) {
+        return Status(error::FILE_FAILURE, "Cannot open file to write " +
+                                               options().output_file_name);
+      }
+      reserved_header_size_ = reserved_header_size;
+      BufferWriter buffer;
+      buffer.AppendVector(std::vector<uint8_t>(reserved_header_size_));
+      return buffer.WriteToFile(temp_file_.get());
+    }
+    LOG(WARNING) << "Cannot reserve header space in '"
+                 << options().output_file_name
+                 << "', which is not a local file. Writing to a temp file.";
+  }
+
   // Single segment segmentation involves two stages:
   //   Stage 1: Create media subsegments from media samples
   //   Stage 2: Update media header (moov) which involves copying of media
@@ -105,6 +163,27 @@ Status SingleSegmentSegmenter::DoFinalize() {
   DCHECK(moov());
   DCHECK(vod_sidx_);
 
+  if (reserved_header_size_ > 0) {
+    const uint64_t header_size =
+        ftyp()->ComputeSize() + moov()->ComputeSize() +
+        (options().mp4_params.generate_sidx_in_media_segments
+             ? vod_sidx_->ComputeSize()
+             : 0);
+    // The unused space must be large enough for a 'free' box.
+    if (header_size == reserved_header_size_ ||
+        header_size + kBoxHeaderSize <= reserved_header_size_) {
+      return WriteReservedHeader(header_size);
+    }
+    LOG(WARNING) << "The header of " << header_size
+                 << " bytes does not fit in the " << reserved_header_size_
+                 << " bytes reserved in '" << options().output_file_name
+                 << "'. Rewriting the file. Consider increasing "
+                    "--mp4_reserved_header_size.";
+    Status status = MoveFragmentsToTempFile();
+    if (!status.ok())
+      return status;
+  }
+
   // Close the temp file to prepare for reading later.
   if (!temp_file_.release()->Close()) {
     return Status(
@@ -146,22 +225,20 @@ Status SingleSegmentSegmenter::DoFinalize() {
   // The target of 2nd stage of single segment segmentation.
   const uint64_t re_segment_progress_target = progress_target() * 0.5;
 
-  const int kBufSize = 0x200000;  // 2MB.
-  std::unique_ptr<uint8_t[]> buf(new uint8_t[kBufSize]);
+  // Copy in chunks to report progress. File::Copy lets the kernel copy the
+  // data if both files are local files.
+  const int64_t kChunkSize = 0x2000000;  // 32MB.
+  const int64_t temp_file_size = temp_file->Size();
   while (true) {
-    int64_t size = temp_file->Read(buf.get(), kBufSize);
+    int64_t size = File::Copy(temp_file.get(), file.get(), kChunkSize);
     if (size == 0) {
       break;
     } else if (size < 0) {
-      return Status(error::FILE_FAILURE,
-                    "Failed to read file " + temp_file_name_);
-    }
-    int64_t size_written = file->Write(buf.get(), size);
-    if (size_written != size) {
-      return Status(error::FILE_FAILURE,
-                    "Failed to write file " + options().output_file_name);
+      return Status(error::FILE_FAILURE, "Failed to copy file " +
+                                             temp_file_name_ + " to " +
+                                             options().output_file_name);
     }
-    UpdateProgress(static_cast<double>(size) / temp_file->Size() *
+    UpdateProgress(static_cast<double>(size) / temp_file_size *
                    re_segment_progress_target);
   }
   if (!temp_file.release()->Close()) {
@@ -178,6 +255,70 @@ Status SingleSegmentSegmenter::DoFinalize() {
   return Status::OK;
 }
 
+Status SingleSegmentSegmenter::WriteReservedHeader(uint64_t header_size) {
+  LOG(INFO) << "Write media header (moov) to the space reserved in '"
+            << options().output_file_name << "'.";
+
+  BufferWriter buffer;
+  ftyp()->Write(&buffer);
+  moov()->Write(&buffer);
+  // Pad before 'sidx', so that it stays adjacent to the fragments it refers
+  // to.
+  if (header_size < reserved_header_size_)
+    WriteFreeBox(reserved_header_size_ - header_size, &buffer);
+  if (options().mp4_params.generate_sidx_in_media_segments)
+    vod_sidx_->Write(&buffer);
+  DCHECK_EQ(buffer.Size(), reserved_header_size_);
+
+  if (!temp_file_->Seek(0)) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot seek in file " + options().output_file_name);
+  }
+  Status status = buffer.WriteToFile(temp_file_.get());
+  if (!status.ok())
+    return status;
+  if (!temp_file_.release()->Close()) {
+    return Status(
+        error::FILE_FAILURE,
+        "Cannot close file " + options().output_file_name +
+            ", possibly file permission issue or running out of disk space.");
+  }
+  SetComplete();
+  return Status::OK;
+}
+
+Status SingleSegmentSegmenter::MoveFragmentsToTempFile() {
+  if (!temp_file_.release()->Close()) {
+    return Status(
+        error::FILE_FAILURE,
+        "Cannot close file " + options().output_file_name +
+            ", possibly file permission issue or running out of disk space.");
+  }
+  std::unique_ptr<File, FileCloser> output_file(
+      File::Open(options().output_file_name.c_str(), "r"));
+  if (!output_file || !output_file->Seek(reserved_header_size_)) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot read back file " + options().output_file_name);
+  }
+
+  if (!TempFilePath(options().temp_dir, &temp_file_name_))
+    return Status(error::FILE_FAILURE, "Unable to create temporary file.");
+  temp_file_.reset(File::Open(temp_file_name_.c_str(), "w"));
+  if (!temp_file_) {
+    return Status(error::FILE_FAILURE,
+                  "Cannot open file to write " + temp_file_name_);
+  }
+  if (File::Copy(output_file.get(), temp_file_.get()) < 0) {
+    return Status(error::FILE_FAILURE,
+                  "Failed to copy file " + options().output_file_name +
+                      " to " + temp_file_name_);
+  }
+  reserved_header_size_ = 0;
+  // Account for copying the temp file back.
+  set_progress_target(progress_target() * 2);
+  return Status::OK;
+}
+
 Status SingleSegmentSegmenter::DoFinalizeSegment(int64_t segment_number) {
   DCHECK(sidx());
   DCHECK(fragment_buffer());
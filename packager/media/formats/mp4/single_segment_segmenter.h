@@ -56,9 +56,20 @@ class SingleSegmentSegmenter : public Segmenter {
   Status DoFinalize() override;
   Status DoFinalizeSegment(int64_t segment_number) override;
 
+  // Writes the header boxes to the space reserved at the start of the output.
+  Status WriteReservedHeader(uint64_t header_size);
+  // Moves the fragments written after the reserved space to a temp file, when
+  // the header boxes do not fit in the reserved space.
+  Status MoveFragmentsToTempFile();
+
   std::unique_ptr<SegmentIndex> vod_sidx_;
   std::string temp_file_name_;
+  // The file the fragments are written to: the temp file, or the output file
+  // itself if |reserved_header_size_| is non-zero.
   std::unique_ptr<File, FileCloser> temp_file_;
+  // Space reserved at the start of the output for the header boxes, or 0 if
+  // the fragments are written to a temp file.
+  uint64_t reserved_header_size_ = 0;
 
   DISALLOW_COPY_AND_ASSIGN(SingleSegmentSegmenter);
 };
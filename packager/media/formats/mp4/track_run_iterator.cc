@@ -48,23 +48,22 @@ namespace shaka {
 namespace media {
 namespace mp4 {
 
-struct SampleInfo {
-  int64_t size;
-  int64_t duration;
-  int64_t cts_offset;
-  bool is_keyframe;
-};
-
 struct TrackRunInfo {
-  uint32_t track_id;
-  std::vector<SampleInfo> samples;
-  int64_t timescale;
-  int64_t start_dts;
-  int64_t sample_start_offset;
-
-  TrackType track_type;
-  const AudioSampleEntry* audio_description;
-  const VideoSampleEntry* video_description;
+  uint32_t track_id = 0;
+  int64_t timescale = -1;
+  int64_t start_dts = -1;
+  int64_t sample_start_offset = -1;
+
+  // Per-sample properties, stored column by column so that they can be copied
+  // in bulk from the 'trun' tables. All columns have the same size.
+  std::vector<uint32_t> sample_sizes;
+  std::vector<uint32_t> sample_durations;
+  std::vector<int64_t> sample_cts_offsets;
+  std::vector<uint8_t> sample_is_keyframe;
+
+  TrackType track_type = kInvalid;
+  const AudioSampleEntry* audio_description = nullptr;
+  const VideoSampleEntry* video_description = nullptr;
 
   // Stores sample encryption entries, which is populated from 'senc' box if it
   // is available, otherwise will try to load from cenc auxiliary information.
@@ -72,28 +71,12 @@ struct TrackRunInfo {
 
   // These variables are useful to load |sample_encryption_entries| from cenc
   // auxiliary information when 'senc' box is not available.
-  int64_t aux_info_start_offset;  // Only valid if aux_info_total_size > 0.
-  int aux_info_default_size;
+  int64_t aux_info_start_offset = -1;  // Only valid if aux_info_total_size > 0.
+  int aux_info_default_size = 0;
   std::vector<uint8_t> aux_info_sizes;  // Populated if default_size == 0.
-  int aux_info_total_size;
-
-  TrackRunInfo();
-  ~TrackRunInfo();
+  int aux_info_total_size = 0;
 };
 
-TrackRunInfo::TrackRunInfo()
-    : track_id(0),
-      timescale(-1),
-      start_dts(-1),
-      sample_start_offset(-1),
-      track_type(kInvalid),
-      audio_description(NULL),
-      video_description(NULL),
-      aux_info_start_offset(-1),
-      aux_info_default_size(0),
-      aux_info_total_size(0) {}
-TrackRunInfo::~TrackRunInfo() {}
-
 TrackRunIterator::TrackRunIterator(const Movie* moov)
     : moov_(moov), sample_dts_(0), sample_offset_(0) {
   CHECK(moov);
@@ -101,42 +84,47 @@ TrackRunIterator::TrackRunIterator(const Movie* moov)
 
 TrackRunIterator::~TrackRunIterator() {}
 
-static void PopulateSampleInfo(const TrackExtends& trex,
-                               const TrackFragmentHeader& tfhd,
-                               const TrackFragmentRun& trun,
-                               const size_t i,
-                               SampleInfo* sample_info) {
-  if (i < trun.sample_sizes.size()) {
-    sample_info->size = trun.sample_sizes[i];
-  } else if (tfhd.default_sample_size > 0) {
-    sample_info->size = tfhd.default_sample_size;
-  } else {
-    sample_info->size = trex.default_sample_size;
-  }
-
-  if (i < trun.sample_durations.size()) {
-    sample_info->duration = trun.sample_durations[i];
-  } else if (tfhd.default_sample_duration > 0) {
-    sample_info->duration = tfhd.default_sample_duration;
-  } else {
-    sample_info->duration = trex.default_sample_duration;
-  }
-
-  if (i < trun.sample_composition_time_offsets.size()) {
-    sample_info->cts_offset = trun.sample_composition_time_offsets[i];
-  } else {
-    sample_info->cts_offset = 0;
-  }
+// Fills |column| with the first |sample_count| entries of |values|, using
+// |default_value| for the samples past the end of |values|.
+template <typename T>
+static void FillSampleColumn(const std::vector<T>& values,
+                             T default_value,
+                             uint32_t sample_count,
+                             std::vector<T>* column) {
+  const size_t num_values = std::min<size_t>(values.size(), sample_count);
+  column->assign(values.begin(), values.begin() + num_values);
+  column->resize(sample_count, default_value);
+}
 
-  uint32_t flags;
-  if (i < trun.sample_flags.size()) {
-    flags = trun.sample_flags[i];
-  } else if (tfhd.flags & TrackFragmentHeader::kDefaultSampleFlagsPresentMask) {
-    flags = tfhd.default_sample_flags;
-  } else {
-    flags = trex.default_sample_flags;
+static void PopulateSampleColumns(const TrackExtends& trex,
+                                  const TrackFragmentHeader& tfhd,
+                                  const TrackFragmentRun& trun,
+                                  TrackRunInfo* tri) {
+  const uint32_t sample_count = trun.sample_count;
+  FillSampleColumn(trun.sample_sizes,
+                   tfhd.default_sample_size > 0 ? tfhd.default_sample_size
+                                                : trex.default_sample_size,
+                   sample_count, &tri->sample_sizes);
+  FillSampleColumn(trun.sample_durations,
+                   tfhd.default_sample_duration > 0
+                       ? tfhd.default_sample_duration
+                       : trex.default_sample_duration,
+                   sample_count, &tri->sample_durations);
+  FillSampleColumn(trun.sample_composition_time_offsets, int64_t{0},
+                   sample_count, &tri->sample_cts_offsets);
+
+  const uint32_t default_flags =
+      (tfhd.flags & TrackFragmentHeader::kDefaultSampleFlagsPresentMask)
+          ? tfhd.default_sample_flags
+          : trex.default_sample_flags;
+  const size_t num_flags =
+      std::min<size_t>(trun.sample_flags.size(), sample_count);
+  tri->sample_is_keyframe.resize(sample_count);
+  for (size_t i = 0; i < sample_count; ++i) {
+    const uint32_t flags = i < num_flags ? trun.sample_flags[i] : default_flags;
+    tri->sample_is_keyframe[i] =
+        !(flags & TrackFragmentHeader::kNonKeySampleMask);
   }
-  sample_info->is_keyframe = !(flags & TrackFragmentHeader::kNonKeySampleMask);
 }
 
 // In well-structured encrypted media, each track run will be immediately
@@ -255,18 +243,20 @@ bool TrackRunIterator::Init() {
       }
 
       uint32_t samples_per_chunk = chunk_info.samples_per_chunk();
-      tri.samples.resize(samples_per_chunk);
+      tri.sample_sizes.resize(samples_per_chunk);
+      tri.sample_durations.resize(samples_per_chunk);
+      tri.sample_cts_offsets.resize(samples_per_chunk);
+      tri.sample_is_keyframe.resize(samples_per_chunk);
       for (uint32_t k = 0; k < samples_per_chunk; ++k) {
-        SampleInfo& sample = tri.samples[k];
-        sample.size = sample_size.sample_size != 0
-                          ? sample_size.sample_size
-                          : sample_size.sizes[sample_index];
-        sample.duration = decoding_time.sample_delta();
-        sample.cts_offset =
+        tri.sample_sizes[k] = sample_size.sample_size != 0
+                                  ? sample_size.sample_size
+                                  : sample_size.sizes[sample_index];
+        tri.sample_durations[k] = decoding_time.sample_delta();
+        tri.sample_cts_offsets[k] =
             has_composition_offset ? composition_offset.sample_offset() : 0;
-        sample.is_keyframe = sync_sample.IsSyncSample();
+        tri.sample_is_keyframe[k] = sync_sample.IsSyncSample();
 
-        run_start_dts += sample.duration;
+        run_start_dts += tri.sample_durations[k];
 
         // Advance to next sample. Should success except for last sample.
         ++sample_index;
@@ -284,7 +274,7 @@ bool TrackRunIterator::Init() {
         }
       }
 
-      runs_.push_back(tri);
+      runs_.push_back(std::move(tri));
     }
   }
 
@@ -405,10 +395,12 @@ bool TrackRunIterator::Init(const MovieFragment& moof) {
       if (!sample_encryption_entries.empty()) {
         RCHECK(sample_encryption_entries.size() >=
                sample_count_sum + trun.sample_count);
-        for (size_t k = 0; k < trun.sample_count; ++k) {
-          tri.sample_encryption_entries.push_back(
-              sample_encryption_entries[sample_count_sum + k]);
-        }
+        // Each entry belongs to exactly one run, so it can be moved.
+        const auto entries_begin =
+            sample_encryption_entries.begin() + sample_count_sum;
+        tri.sample_encryption_entries.assign(
+            std::make_move_iterator(entries_begin),
+            std::make_move_iterator(entries_begin + trun.sample_count));
       } else if (traf.auxiliary_offset.offsets.size() > j) {
         // Collect information from the auxiliary_offset entry with the same
         // index in the 'saiz' container as the current run's index in the
@@ -442,12 +434,10 @@ bool TrackRunIterator::Init(const MovieFragment& moof) {
         }
       }
 
-      tri.samples.resize(trun.sample_count);
-      for (size_t k = 0; k < trun.sample_count; k++) {
-        PopulateSampleInfo(*trex, traf.header, trun, k, &tri.samples[k]);
-        run_start_dts += tri.samples[k].duration;
-      }
-      runs_.push_back(tri);
+      PopulateSampleColumns(*trex, traf.header, trun, &tri);
+      for (uint32_t duration : tri.sample_durations)
+        run_start_dts += duration;
+      runs_.push_back(std::move(tri));
       sample_count_sum += trun.sample_count;
     }
     next_fragment_start_dts_[track_index] = run_start_dts;
@@ -469,14 +459,14 @@ void TrackRunIterator::ResetRun() {
     return;
   sample_dts_ = run_itr_->start_dts;
   sample_offset_ = run_itr_->sample_start_offset;
-  sample_itr_ = run_itr_->samples.begin();
+  sample_index_ = 0;
 }
 
 void TrackRunIterator::AdvanceSample() {
   DCHECK(IsSampleValid());
-  sample_dts_ += sample_itr_->duration;
-  sample_offset_ += sample_itr_->size;
-  ++sample_itr_;
+  sample_dts_ += run_itr_->sample_durations[sample_index_];
+  sample_offset_ += run_itr_->sample_sizes[sample_index_];
+  ++sample_index_;
 }
 
 // This implementation only indicates a need for caching if CENC auxiliary
@@ -493,9 +483,9 @@ bool TrackRunIterator::CacheAuxInfo(const uint8_t* buf, int buf_size) {
 
   std::vector<SampleEncryptionEntry>& sample_encryption_entries =
       runs_[run_itr_ - runs_.begin()].sample_encryption_entries;
-  sample_encryption_entries.resize(run_itr_->samples.size());
+  sample_encryption_entries.resize(run_itr_->sample_sizes.size());
   int64_t pos = 0;
-  for (size_t i = 0; i < run_itr_->samples.size(); i++) {
+  for (size_t i = 0; i < run_itr_->sample_sizes.size(); i++) {
     int info_size = run_itr_->aux_info_default_size;
     if (!info_size)
       info_size = run_itr_->aux_info_sizes[i];
@@ -517,7 +507,7 @@ bool TrackRunIterator::IsRunValid() const {
 }
 
 bool TrackRunIterator::IsSampleValid() const {
-  return IsRunValid() && (sample_itr_ != run_itr_->samples.end());
+  return IsRunValid() && sample_index_ < run_itr_->sample_sizes.size();
 }
 
 // Because tracks are in sorted order and auxiliary information is cached when
@@ -594,7 +584,7 @@ int64_t TrackRunIterator::sample_offset() const {
 
 int TrackRunIterator::sample_size() const {
   DCHECK(IsSampleValid());
-  return sample_itr_->size;
+  return run_itr_->sample_sizes[sample_index_];
 }
 
 int64_t TrackRunIterator::dts() const {
@@ -604,17 +594,17 @@ int64_t TrackRunIterator::dts() const {
 
 int64_t TrackRunIterator::cts() const {
   DCHECK(IsSampleValid());
-  return sample_dts_ + sample_itr_->cts_offset;
+  return sample_dts_ + run_itr_->sample_cts_offsets[sample_index_];
 }
 
 int64_t TrackRunIterator::duration() const {
   DCHECK(IsSampleValid());
-  return sample_itr_->duration;
+  return run_itr_->sample_durations[sample_index_];
 }
 
 bool TrackRunIterator::is_keyframe() const {
   DCHECK(IsSampleValid());
-  return sample_itr_->is_keyframe;
+  return run_itr_->sample_is_keyframe[sample_index_] != 0;
 }
 
 const TrackEncryption& TrackRunIterator::track_encryption() const {
@@ -625,13 +615,16 @@ const TrackEncryption& TrackRunIterator::track_encryption() const {
 }
 
 std::unique_ptr<DecryptConfig> TrackRunIterator::GetDecryptConfig() {
-  std::vector<uint8_t> iv;
-  std::vector<SubsampleEntry> subsamples;
-
-  size_t sample_idx = sample_itr_ - run_itr_->samples.begin();
-  if (sample_idx < run_itr_->sample_encryption_entries.size()) {
+  // Refer to the cached entry rather than copying it, as the config makes its
+  // own copy.
+  const std::vector<uint8_t> no_iv;
+  const std::vector<SubsampleEntry> no_subsamples;
+  const std::vector<uint8_t>* iv = &no_iv;
+  const std::vector<SubsampleEntry>* subsamples = &no_subsamples;
+
+  if (sample_index_ < run_itr_->sample_encryption_entries.size()) {
     const SampleEncryptionEntry& sample_encryption_entry =
-        run_itr_->sample_encryption_entries[sample_idx];
+        run_itr_->sample_encryption_entries[sample_index_];
     DCHECK(is_encrypted());
     DCHECK(!AuxInfoNeedsToBeCached());
 
@@ -643,25 +636,25 @@ std::unique_ptr<DecryptConfig> TrackRunIterator::GetDecryptConfig() {
       return std::unique_ptr<DecryptConfig>();
     }
 
-    iv = sample_encryption_entry.initialization_vector;
-    subsamples = sample_encryption_entry.subsamples;
+    iv = &sample_encryption_entry.initialization_vector;
+    subsamples = &sample_encryption_entry.subsamples;
   }
 
   FourCC protection_scheme = is_audio() ? audio_description().sinf.type.type
                                         : video_description().sinf.type.type;
-  if (iv.empty()) {
+  if (iv->empty()) {
     if (protection_scheme != FOURCC_cbcs) {
       LOG(WARNING)
           << "Constant IV should only be used with 'cbcs' protection scheme.";
     }
-    iv = track_encryption().default_constant_iv;
-    if (iv.empty()) {
+    iv = &track_encryption().default_constant_iv;
+    if (iv->empty()) {
       LOG(ERROR) << "IV cannot be empty.";
       return std::unique_ptr<DecryptConfig>();
     }
   }
   return std::unique_ptr<DecryptConfig>(new DecryptConfig(
-      track_encryption().default_kid, iv, subsamples, protection_scheme,
+      track_encryption().default_kid, *iv, *subsamples, protection_scheme,
       track_encryption().default_crypt_byte_block,
       track_encryption().default_skip_byte_block));
 }
@@ -5,6 +5,7 @@
 #ifndef PACKAGER_MEDIA_FORMATS_MP4_TRACK_RUN_ITERATOR_H_
 #define PACKAGER_MEDIA_FORMATS_MP4_TRACK_RUN_ITERATOR_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <map>
 #include <memory>
@@ -20,7 +21,6 @@ class DecryptConfig;
 
 namespace mp4 {
 
-struct SampleInfo;
 struct TrackRunInfo;
 
 class TrackRunIterator {
@@ -114,7 +114,8 @@ class TrackRunIterator {
 
   std::vector<TrackRunInfo> runs_;
   std::vector<TrackRunInfo>::const_iterator run_itr_;
-  std::vector<SampleInfo>::const_iterator sample_itr_;
+  // Index of the current sample in the current run.
+  size_t sample_index_ = 0;
 
   // Track the start dts of the next segment, only useful if decode_time box is
   // absent.
@@ -456,6 +456,29 @@ TEST_F(TrackRunIteratorTest, FirstSampleFlagTest) {
   EXPECT_FALSE(iter_->is_keyframe());
 }
 
+TEST_F(TrackRunIteratorTest, PartialSampleTablesTest) {
+  // Samples past the end of the 'trun' tables use the 'tfhd' defaults.
+  iter_.reset(new TrackRunIterator(&moov_));
+  MovieFragment moof = CreateFragment();
+  moof.tracks[1].header.default_sample_size = 5;
+  moof.tracks[1].header.default_sample_duration = 20;
+  moof.tracks[1].runs[0].sample_sizes.resize(2);
+  moof.tracks[1].runs[0].sample_durations.resize(1);
+  ASSERT_TRUE(iter_->Init(moof));
+  iter_->AdvanceRun();
+  EXPECT_EQ(2u, iter_->track_id());
+  EXPECT_EQ(1, iter_->sample_size());
+  EXPECT_EQ(1, iter_->duration());
+  iter_->AdvanceSample();
+  EXPECT_EQ(2, iter_->sample_size());
+  EXPECT_EQ(20, iter_->duration());
+  iter_->AdvanceSample();
+  EXPECT_EQ(5, iter_->sample_size());
+  EXPECT_EQ(20, iter_->duration());
+  EXPECT_EQ(10 + 1 + 20, iter_->dts());
+  EXPECT_EQ(200 + 1 + 2, iter_->sample_offset());
+}
+
 TEST_F(TrackRunIteratorTest, EmptyEditTest) {
   iter_.reset(new TrackRunIterator(&moov_));
 
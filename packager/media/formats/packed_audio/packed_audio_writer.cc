@@ -114,6 +114,9 @@ Status PackedAudioWriter::FinalizeSegment(size_t stream_id,
 
 Status PackedAudioWriter::WriteSegment(const std::string& segment_path,
                                        BufferWriter* segment_buffer) {
+  if (!output_file_ && segment_output_queue())
+    return segment_output_queue()->PostSegment(segment_path, segment_buffer);
+
   std::unique_ptr<File, FileCloser> file;
   if (output_file_) {
     // This is in single segment mode.
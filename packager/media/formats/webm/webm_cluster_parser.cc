@@ -8,6 +8,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <limits>
 #include <memory>
 #include <set>
 #include <string>
@@ -45,6 +46,20 @@ namespace {
 
 const int64_t kMicrosecondsPerMillisecond = 1000;
 
+// Reads the body of an unsigned integer element, with the same restrictions
+// as WebMListParser.
+bool ReadUInt(const uint8_t* buf, int64_t size, int64_t* value) {
+  if (size <= 0 || size > 8)
+    return false;
+  uint64_t result = 0;
+  for (int i = 0; i < size; ++i)
+    result = (result << 8) | buf[i];
+  if (result > static_cast<uint64_t>(std::numeric_limits<int64_t>::max()))
+    return false;
+  *value = static_cast<int64_t>(result);
+  return true;
+}
+
 }  // namespace
 
 WebMClusterParser::WebMClusterParser(
@@ -97,6 +112,19 @@ WebMClusterParser::WebMClusterParser(
 
 WebMClusterParser::~WebMClusterParser() {}
 
+void WebMClusterParser::SetSelectedTracks(const std::set<uint32_t>& track_ids) {
+  auto ignore_if_not_selected = [this, &track_ids](int track_num) {
+    if (track_num >= 0 &&
+        track_ids.find(static_cast<uint32_t>(track_num)) == track_ids.end()) {
+      ignored_tracks_.insert(track_num);
+    }
+  };
+  ignore_if_not_selected(audio_.track_num());
+  ignore_if_not_selected(video_.track_num());
+  for (const auto& pair : text_track_map_)
+    ignore_if_not_selected(pair.first);
+}
+
 void WebMClusterParser::Reset() {
   last_block_timecode_ = -1;
   cluster_timecode_ = -1;
@@ -117,7 +145,30 @@ bool WebMClusterParser::Flush() {
 }
 
 int WebMClusterParser::Parse(const uint8_t* buf, int size) {
-  int result = parser_.Parse(buf, size);
+  // Complete SimpleBlocks and BlockGroups directly in the cluster are parsed
+  // in place. |parser_| handles the cluster header and everything else, and
+  // returns to us as soon as it is back at the cluster level.
+  int result = 0;
+  while (result < size && !parser_.IsParsingComplete()) {
+    int bytes_parsed =
+        ParseClusterElementsInPlace(buf + result, size - result);
+    if (bytes_parsed < 0) {
+      result = -1;
+      break;
+    }
+    result += bytes_parsed;
+    if (result == size || parser_.IsParsingComplete())
+      break;
+
+    bytes_parsed = parser_.ParseToRootListLevel(buf + result, size - result);
+    if (bytes_parsed < 0) {
+      result = -1;
+      break;
+    }
+    if (bytes_parsed == 0)
+      break;
+    result += bytes_parsed;
+  }
 
   if (result < 0) {
     cluster_ended_ = false;
@@ -216,6 +267,137 @@ bool WebMClusterParser::OnUInt(int id, int64_t val) {
   return true;
 }
 
+int WebMClusterParser::ParseClusterElementsInPlace(const uint8_t* buf,
+                                                   int size) {
+  int bytes_parsed = 0;
+  while (bytes_parsed < size && parser_.IsAtRootListLevel()) {
+    const uint8_t* cur = buf + bytes_parsed;
+    const int cur_size = size - bytes_parsed;
+
+    int id = 0;
+    int64_t element_size = 0;
+    const int header_size =
+        WebMParseElementHeader(cur, cur_size, &id, &element_size);
+    if (header_size <= 0 || element_size == kWebMUnknownSize ||
+        element_size > cur_size - header_size) {
+      break;
+    }
+    const int64_t total_size = header_size + element_size;
+    if (!parser_.RootListHasRoomFor(total_size))
+      break;
+
+    const uint8_t* data = cur + header_size;
+    const int data_size = static_cast<int>(element_size);
+    switch (id) {
+      case kWebMIdSimpleBlock:
+        if (!ParseBlock(true, data, data_size, NULL, 0, -1, 0, false))
+          return -1;
+        break;
+      case kWebMIdBlockGroup: {
+        const int result = ParseBlockGroupInPlace(data, data_size);
+        if (result < 0)
+          return -1;
+        if (result == 0)
+          return bytes_parsed;
+        break;
+      }
+      case kWebMIdTimecode:
+      case kWebMIdPosition:
+      case kWebMIdPrevSize: {
+        int64_t value = 0;
+        if (!ReadUInt(data, element_size, &value))
+          return bytes_parsed;
+        if (!OnUInt(id, value))
+          return -1;
+        break;
+      }
+      case kWebMIdVoid:
+      case kWebMIdCRC32:
+        break;
+      default:
+        return bytes_parsed;
+    }
+
+    if (!parser_.OnRootListElementParsed(total_size))
+      return -1;
+    bytes_parsed += static_cast<int>(total_size);
+  }
+  return bytes_parsed;
+}
+
+int WebMClusterParser::ParseBlockGroupInPlace(const uint8_t* buf, int size) {
+  // Nothing is changed until the whole BlockGroup has been validated, so that
+  // |parser_| can take over from the start of the BlockGroup if needed.
+  const uint8_t* block = NULL;
+  int block_size = 0;
+  int64_t block_duration = -1;
+  int64_t discard_padding = 0;
+  bool discard_padding_set = false;
+  bool reference_block_set = false;
+
+  int offset = 0;
+  while (offset < size) {
+    int id = 0;
+    int64_t element_size = 0;
+    const int header_size =
+        WebMParseElementHeader(buf + offset, size - offset, &id, &element_size);
+    if (header_size <= 0 || element_size == kWebMUnknownSize ||
+        element_size > size - offset - header_size) {
+      return 0;
+    }
+    const uint8_t* data = buf + offset + header_size;
+    const int data_size = static_cast<int>(element_size);
+
+    switch (id) {
+      case kWebMIdBlock:
+        if (block)
+          return 0;
+        block = data;
+        block_size = data_size;
+        break;
+      case kWebMIdBlockDuration:
+        if (block_duration != -1 ||
+            !ReadUInt(data, data_size, &block_duration)) {
+          return 0;
+        }
+        break;
+      case kWebMIdReferencePriority: {
+        int64_t unused;
+        if (!ReadUInt(data, data_size, &unused))
+          return 0;
+        break;
+      }
+      case kWebMIdReferenceBlock:
+        reference_block_set = true;
+        break;
+      case kWebMIdDiscardPadding:
+        if (discard_padding_set || data_size <= 0 || data_size > 8)
+          return 0;
+        discard_padding_set = true;
+        discard_padding = static_cast<int8_t>(data[0]);
+        for (int i = 1; i < data_size; ++i)
+          discard_padding = (discard_padding << 8) | data[i];
+        break;
+      case kWebMIdCodecState:
+      case kWebMIdVoid:
+      case kWebMIdCRC32:
+        break;
+      default:
+        // BlockAdditions, Slices or unexpected elements.
+        return 0;
+    }
+    offset += header_size + data_size;
+  }
+
+  if (!block)
+    return 0;
+  return ParseBlock(false, block, block_size, NULL, 0,
+                    static_cast<int>(block_duration), discard_padding,
+                    reference_block_set)
+             ? 1
+             : -1;
+}
+
 bool WebMClusterParser::ParseBlock(bool is_simple_block,
                                    const uint8_t* buf,
                                    int size,
@@ -352,7 +534,9 @@ bool WebMClusterParser::OnBlock(bool is_simple_block,
   Track* track = NULL;
   StreamType stream_type = kStreamUnknown;
   std::string encryption_key_id;
-  if (track_num == audio_.track_num()) {
+  if (ignored_tracks_.find(track_num) != ignored_tracks_.end()) {
+    return true;
+  } else if (track_num == audio_.track_num()) {
     track = &audio_;
     encryption_key_id = audio_encryption_key_id_;
     stream_type = kStreamAudio;
@@ -360,8 +544,6 @@ bool WebMClusterParser::OnBlock(bool is_simple_block,
     track = &video_;
     encryption_key_id = video_encryption_key_id_;
     stream_type = kStreamVideo;
-  } else if (ignored_tracks_.find(track_num) != ignored_tracks_.end()) {
-    return true;
   } else if (Track* const text_track = FindTextTrack(track_num)) {
     if (is_simple_block)  // BlockGroup is required for WebVTT cues
       return false;
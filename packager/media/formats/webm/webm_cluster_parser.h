@@ -137,6 +137,11 @@ class WebMClusterParser : public WebMParserClient {
                     KeySource* decryption_key_source);
   ~WebMClusterParser() override;
 
+  /// Skip the blocks of the tracks which are not in |track_ids|, the same way
+  /// as the blocks of ignored tracks.
+  /// @param track_ids contains the ids of the tracks which are consumed.
+  void SetSelectedTracks(const std::set<uint32_t>& track_ids);
+
   /// Resets the parser state so it can accept a new cluster.
   void Reset();
 
@@ -163,6 +168,19 @@ class WebMClusterParser : public WebMParserClient {
   bool OnUInt(int id, int64_t val) override;
   bool OnBinary(int id, const uint8_t* data, int size) override;
 
+  // Parses complete direct children of the cluster in place, without going
+  // through |parser_| and the WebMParserClient callbacks. Stops at the first
+  // element that is incomplete, not handled here or malformed, and leaves it
+  // to |parser_|.
+  // Returns < 0 on error, otherwise the number of bytes parsed.
+  int ParseClusterElementsInPlace(const uint8_t* buf, int size);
+
+  // Parses the body of a complete BlockGroup in place. The Block is passed on
+  // directly from |buf| instead of being copied to |block_data_| first.
+  // Returns < 0 on error, 0 if the BlockGroup has to be parsed by |parser_|
+  // instead, and > 0 on success.
+  int ParseBlockGroupInPlace(const uint8_t* buf, int size);
+
   bool ParseBlock(bool is_simple_block,
                   const uint8_t* buf,
                   int size,
@@ -7,6 +7,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <set>
 #include <string>
 
 #include <packager/macros/classes.h>
@@ -31,6 +32,7 @@ class WebMMediaParser : public MediaParser {
             KeySource* decryption_key_source) override;
   [[nodiscard]] bool Flush() override;
   [[nodiscard]] bool Parse(const uint8_t* buf, int size) override;
+  void SetSelectedTracks(const std::set<uint32_t>& track_ids) override;
   /// @}
 
  private:
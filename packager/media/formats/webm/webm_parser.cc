@@ -705,6 +705,16 @@ void WebMListParser::Reset() {
 }
 
 int WebMListParser::Parse(const uint8_t* buf, int size) {
+  return ParseInternal(buf, size, false);
+}
+
+int WebMListParser::ParseToRootListLevel(const uint8_t* buf, int size) {
+  return ParseInternal(buf, size, true);
+}
+
+int WebMListParser::ParseInternal(const uint8_t* buf,
+                                  int size,
+                                  bool stop_at_root_level) {
   DCHECK(buf);
 
   if (size < 0 || state_ == PARSE_ERROR || state_ == DONE_PARSING_LIST)
@@ -782,6 +792,9 @@ int WebMListParser::Parse(const uint8_t* buf, int size) {
     cur += result;
     cur_size -= result;
     bytes_parsed += result;
+
+    if (stop_at_root_level && IsAtRootListLevel())
+      break;
   }
 
   return (state_ == PARSE_ERROR) ? -1 : bytes_parsed;
@@ -791,6 +804,28 @@ bool WebMListParser::IsParsingComplete() const {
   return state_ == DONE_PARSING_LIST;
 }
 
+bool WebMListParser::IsAtRootListLevel() const {
+  return state_ == INSIDE_LIST && list_state_stack_.size() == 1;
+}
+
+bool WebMListParser::RootListHasRoomFor(int64_t size) const {
+  DCHECK(IsAtRootListLevel());
+  const ListState& list_state = list_state_stack_.back();
+  return list_state.size_ == kWebMUnknownSize ||
+         list_state.size_ >= list_state.bytes_parsed_ + size;
+}
+
+bool WebMListParser::OnRootListElementParsed(int64_t size) {
+  DCHECK(RootListHasRoomFor(size));
+  ListState& list_state = list_state_stack_.back();
+  list_state.bytes_parsed_ += size;
+  if (list_state.bytes_parsed_ == list_state.size_ && !OnListEnd()) {
+    ChangeState(PARSE_ERROR);
+    return false;
+  }
+  return true;
+}
+
 void WebMListParser::ChangeState(State new_state) {
   state_ = new_state;
 }
@@ -66,9 +66,36 @@ class WebMListParser {
   /// @return > 0 indicates success & the number of bytes parsed.
   int Parse(const uint8_t* buf, int size);
 
+  /// Same as Parse(), but returns as soon as the parser gets back to the root
+  /// list level, i.e. after the root list header or after a complete direct
+  /// child of the root list. This lets the caller handle the following
+  /// children itself, see OnRootListElementParsed().
+  /// @return < 0 if the parse fails.
+  /// @return 0 if more data is needed.
+  /// @return > 0 indicates success & the number of bytes parsed.
+  int ParseToRootListLevel(const uint8_t* buf, int size);
+
   /// @return true if the entire list has been parsed.
   bool IsParsingComplete() const;
 
+  /// @return true if the parser is inside the root list and not inside any of
+  ///         its child lists, i.e. the next element is a direct child of the
+  ///         root list.
+  bool IsAtRootListLevel() const;
+
+  /// @param size is the size of a direct child of the root list, including
+  ///        its header.
+  /// @return true if the child fits in the remaining part of the root list.
+  bool RootListHasRoomFor(int64_t size) const;
+
+  /// Accounts for a complete direct child of the root list which was parsed
+  /// by the caller instead of by this parser. Ends the root list if this was
+  /// its last child. Must only be called when IsAtRootListLevel() is true and
+  /// RootListHasRoomFor(@a size) is true.
+  /// @param size is the size of the child, including its header.
+  /// @return false if ending the root list failed.
+  bool OnRootListElementParsed(int64_t size);
+
  private:
   enum State {
     NEED_LIST_HEADER,
@@ -87,6 +114,9 @@ class WebMListParser {
 
   void ChangeState(State new_state);
 
+  // Implements Parse() and ParseToRootListLevel().
+  int ParseInternal(const uint8_t* buf, int size, bool stop_at_root_level);
+
   // Parses a single element in the current list.
   //
   // |header_size| - The size of the element header
@@ -265,6 +265,44 @@ TEST_F(WebMParserTest, ParseListElementWithMultipleCalls) {
   EXPECT_TRUE(parser.IsParsingComplete());
 }
 
+TEST_F(WebMParserTest, ParseToRootListLevel) {
+  const uint8_t kBuffer[] = {
+      0x1F, 0x43, 0xB6, 0x75, 0x8C,  // CLUSTER (size = 12)
+      0xE7, 0x81, 0x01,              //   Timecode (size=1, value=1)
+      0xA0, 0x83,                    //   BlockGroup (size = 3)
+      0xFB, 0x81, 0x00,              //     ReferenceBlock (size = 1)
+      0xEC, 0x82, 0x00, 0x00,        //   Void (size = 2)
+  };
+  int size = sizeof(kBuffer);
+
+  InSequence s;
+  EXPECT_CALL(client_, OnListStart(kWebMIdCluster)).WillOnce(Return(&client_));
+  EXPECT_CALL(client_, OnUInt(kWebMIdTimecode, 1)).WillOnce(Return(true));
+  EXPECT_CALL(client_, OnListStart(kWebMIdBlockGroup))
+      .WillOnce(Return(&client_));
+  EXPECT_CALL(client_, OnBinary(kWebMIdReferenceBlock, _, 1))
+      .WillOnce(Return(true));
+  EXPECT_CALL(client_, OnListEnd(kWebMIdBlockGroup)).WillOnce(Return(true));
+  EXPECT_CALL(client_, OnListEnd(kWebMIdCluster)).WillOnce(Return(true));
+
+  WebMListParser parser(kWebMIdCluster, &client_);
+  EXPECT_FALSE(parser.IsAtRootListLevel());
+
+  // Stops after the list header, and then after each complete child.
+  EXPECT_EQ(5, parser.ParseToRootListLevel(kBuffer, size));
+  EXPECT_TRUE(parser.IsAtRootListLevel());
+  EXPECT_EQ(3, parser.ParseToRootListLevel(kBuffer + 5, size - 5));
+  EXPECT_EQ(5, parser.ParseToRootListLevel(kBuffer + 8, size - 8));
+  EXPECT_TRUE(parser.IsAtRootListLevel());
+
+  // The caller handles the Void element itself, which ends the cluster.
+  EXPECT_FALSE(parser.RootListHasRoomFor(5));
+  EXPECT_TRUE(parser.RootListHasRoomFor(4));
+  EXPECT_TRUE(parser.OnRootListElementParsed(4));
+  EXPECT_TRUE(parser.IsParsingComplete());
+  EXPECT_FALSE(parser.IsAtRootListLevel());
+}
+
 TEST_F(WebMParserTest, Reset) {
   InSequence s;
   std::unique_ptr<Cluster> cluster(CreateCluster(kBlockCount));
@@ -11,6 +11,7 @@
 #include <cstddef>
 #include <memory>
 #include <random>
+#include <string>
 #include <string_view>
 #include <thread>
 #include <vector>
@@ -29,6 +30,9 @@
 // 1. Reflect the request method, body, and headers
 // 2. Return a requested status code
 // 3. Delay a response by a requested amount of time
+// 4. Count the connections it accepts
+// 5. Fail a number of requests before succeeding
+// 6. Truncate the responses of a number of requests before succeeding
 
 namespace {
 
@@ -83,7 +87,11 @@ bool GetIntQueryParameter(struct mg_http_message* message,
 namespace shaka {
 namespace media {
 
-TestWebServer::TestWebServer() : status_(kNew), stopped_(false) {}
+TestWebServer::TestWebServer()
+    : status_(kNew),
+      stopped_(false),
+      connections_accepted_(0),
+      requests_failed_(0) {}
 
 TestWebServer::~TestWebServer() {
   {
@@ -108,6 +116,11 @@ bool TestWebServer::Start() {
   return status_ == kStarted;
 }
 
+int TestWebServer::connections_accepted() {
+  absl::MutexLock lock(mutex_);
+  return connections_accepted_;
+}
+
 bool TestWebServer::TryListenOnPort(struct mg_mgr* manager, int port) {
   // Mongoose needs an HTTP server address in string format.
   // "127.0.0.1" is "localhost", and is not visible to other machines on the
@@ -195,6 +208,9 @@ void TestWebServer::HandleEvent(struct mg_connection* connection,
     for (const auto& delayed_connection : to_delete) {
       instance->delayed_connections_.erase(delayed_connection);
     }
+  } else if (event == MG_EV_ACCEPT) {
+    absl::MutexLock lock(instance->mutex_);
+    ++instance->connections_accepted_;
   } else if (event == MG_EV_CLOSE) {
     if (instance->delayed_connections_.count(connection)) {
       // The client hung up before our delay expired.  Remove this from our map.
@@ -216,6 +232,12 @@ void TestWebServer::HandleEvent(struct mg_connection* connection,
   } else if (mg_http_match_uri(message, "/delay")) {
     if (instance->HandleDelay(message, connection))
       return;
+  } else if (mg_http_match_uri(message, "/fail")) {
+    if (instance->HandleFail(message, connection))
+      return;
+  } else if (mg_http_match_uri(message, "/truncate")) {
+    if (instance->HandleTruncate(message, connection))
+      return;
   }
 
   mg_http_reply(connection, 400 /* bad request */, NULL /* headers */,
@@ -286,5 +308,46 @@ bool TestWebServer::HandleReflect(struct mg_http_message* message,
   return true;
 }
 
+bool TestWebServer::HandleFail(struct mg_http_message* message,
+                               struct mg_connection* connection) {
+  int failures = 0;
+  int code = 0;
+  if (!GetIntQueryParameter(message, "failures", &failures) ||
+      !GetIntQueryParameter(message, "code", &code)) {
+    return false;
+  }
+
+  if (requests_failed_ >= failures)
+    return HandleReflect(message, connection);
+
+  ++requests_failed_;
+  if (code == 0) {
+    // Hang up without a response.
+    connection->is_closing = 1;
+  } else {
+    mg_http_reply(connection, code, NULL /* headers */, "%s", "{}");
+  }
+  return true;
+}
+
+bool TestWebServer::HandleTruncate(struct mg_http_message* message,
+                                   struct mg_connection* connection) {
+  int failures = 0;
+  if (!GetIntQueryParameter(message, "failures", &failures))
+    return false;
+
+  if (requests_failed_ >= failures)
+    return HandleReflect(message, connection);
+
+  ++requests_failed_;
+  // Announce a longer body than is sent, then hang up once the partial body
+  // has been sent.
+  const std::string partial_body = "{\"partial\": \"";
+  mg_printf(connection, "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n%s",
+            static_cast<int>(partial_body.size()) + 1000, partial_body.c_str());
+  connection->is_draining = 1;
+  return true;
+}
+
 }  // namespace media
 }  // namespace shaka
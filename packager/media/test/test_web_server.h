@@ -44,6 +44,25 @@ class TestWebServer {
     return base_url_ + "/delay?seconds=" + std::to_string(seconds);
   }
 
+  // Fails the first |failures| requests with the status |code|, or by closing
+  // the connection without responding if |code| is 0.  Later requests are
+  // reflected back like ReflectUrl().
+  std::string FailUrl(int failures, int code) {
+    return base_url_ + "/fail?failures=" + std::to_string(failures) +
+           "&code=" + std::to_string(code);
+  }
+
+  // Fails the first |failures| requests by sending part of a response and
+  // closing the connection.  Later requests are reflected back like
+  // ReflectUrl().
+  std::string TruncateUrl(int failures) {
+    return base_url_ + "/truncate?failures=" + std::to_string(failures);
+  }
+
+  // Returns the number of client connections accepted so far, which lets tests
+  // check that connections are reused.
+  int connections_accepted();
+
  private:
   enum TestWebServerStatus {
     kNew,
@@ -57,6 +76,11 @@ class TestWebServer {
   absl::CondVar started_ ABSL_GUARDED_BY(mutex_);
   absl::CondVar stop_ ABSL_GUARDED_BY(mutex_);
   bool stopped_ ABSL_GUARDED_BY(mutex_);
+  int connections_accepted_ ABSL_GUARDED_BY(mutex_);
+
+  // Number of requests failed on purpose by HandleFail() and
+  // HandleTruncate().  Only ever accessed from |thread_|.
+  int requests_failed_;
 
   // Connections to be handled again later, mapped to the time at which we
   // should handle them again.  We can't block the server thread directly to
@@ -83,6 +107,10 @@ class TestWebServer {
                    struct mg_connection* connection);
   bool HandleReflect(struct mg_http_message* message,
                      struct mg_connection* connection);
+  bool HandleFail(struct mg_http_message* message,
+                  struct mg_connection* connection);
+  bool HandleTruncate(struct mg_http_message* message,
+                      struct mg_connection* connection);
 };
 
 }  // namespace media
@@ -7,6 +7,7 @@
 #include <packager/packager.h>
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
@@ -16,6 +17,7 @@
 #include <optional>
 #include <set>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -42,16 +44,20 @@
 #include <packager/media/base/container_names.h>
 #include <packager/media/base/fourccs.h>
 #include <packager/media/base/language_utils.h>
+#include <packager/media/base/media_sample.h>
 #include <packager/media/base/muxer.h>
 #include <packager/media/base/muxer_options.h>
 #include <packager/media/base/muxer_util.h>
+#include <packager/media/base/prefetching_key_source.h>
 #include <packager/media/chunking/chunking_handler.h>
 #include <packager/media/chunking/cue_alignment_handler.h>
+#include <packager/media/chunking/range_splitter.h>
 #include <packager/media/chunking/segment_coordinator.h>
 #include <packager/media/chunking/text_chunker.h>
 #include <packager/media/crypto/encryption_handler.h>
 #include <packager/media/demuxer/demuxer.h>
 #include <packager/media/event/muxer_listener_factory.h>
+#include <packager/media/event/range_muxer_listener.h>
 #include <packager/media/event/vod_media_info_dump_muxer_listener.h>
 #include <packager/media/formats/ttml/ttml_to_mp4_handler.h>
 #include <packager/media/formats/webvtt/text_padder.h>
@@ -78,6 +84,8 @@ namespace media {
 namespace {
 
 const char kMediaInfoSuffix[] = ".media_info";
+// Number of crypto periods for which the keys are fetched ahead.
+const uint32_t kNumPrefetchCryptoPeriods = 2;
 
 MuxerListenerFactory::StreamData ToMuxerListenerData(
     const StreamDescriptor& stream) {
@@ -358,6 +366,29 @@ Status ValidateParams(const PackagingParams& packaging_params,
     }
   }
 
+  // Without |write_func|, |write_output_func| has to serve every output, which
+  // it can only do for MP4 segments written to separate files and manifests.
+  const BufferCallbackParams& buffer_callback_params =
+      packaging_params.buffer_callback_params;
+  if (buffer_callback_params.write_output_func &&
+      !buffer_callback_params.write_func) {
+    for (const auto& descriptor : stream_descriptors) {
+      if (descriptor.output.empty() && descriptor.segment_template.empty())
+        continue;
+      if (descriptor.segment_template.empty() ||
+          GetOutputFormat(descriptor) != CONTAINER_MOV ||
+          packaging_params.chunking_params.low_latency_dash_mode) {
+        return Status(
+            error::INVALID_ARGUMENT,
+            "Output '" + descriptor.output +
+                "' cannot be handed over through write_output_func, which "
+                "only receives MP4 init and media segments written with a "
+                "segment template (not in low latency mode) and manifests. "
+                "write_func needs to be set for other outputs.");
+      }
+    }
+  }
+
   if (packaging_params.output_media_info && !on_demand_dash_profile) {
     // TODO(rkuroiwa, kqyang): Support partial media info dump for live.
     return Status(error::UNIMPLEMENTED,
@@ -399,6 +430,34 @@ Status ValidateParams(const PackagingParams& packaging_params,
   return Status::OK;
 }
 
+// Jobs in a batch run concurrently, so no output path, including the
+// manifests a job may inherit from the shared flags, can be used by two jobs.
+Status ValidateBatchJobs(const std::vector<PackagingJob>& jobs) {
+  std::map<std::string, std::string> job_names_by_output;
+  for (const PackagingJob& job : jobs) {
+    std::set<std::string> outputs;
+    outputs.insert(job.packaging_params.mpd_params.mpd_output);
+    outputs.insert(job.packaging_params.hls_params.master_playlist_output);
+    for (const StreamDescriptor& descriptor : job.stream_descriptors) {
+      outputs.insert(descriptor.output);
+      outputs.insert(descriptor.segment_template);
+    }
+    outputs.erase("");
+
+    for (const std::string& output : outputs) {
+      auto iter = job_names_by_output.find(output);
+      if (iter != job_names_by_output.end()) {
+        return Status(error::INVALID_ARGUMENT,
+                      "Seeing duplicated output '" + output +
+                          "' in packaging jobs '" + iter->second + "' and '" +
+                          job.name + "'. Every output must be unique.");
+      }
+      job_names_by_output[output] = job.name;
+    }
+  }
+  return Status::OK;
+}
+
 bool StreamDescriptorCompareFn(const StreamDescriptor& a,
                                const StreamDescriptor& b) {
   // This function is used by std::sort() to sort the stream descriptors.
@@ -495,7 +554,7 @@ Status CreateDemuxer(const StreamDescriptor& stream,
   return Status::OK;
 }
 
-std::shared_ptr<MediaHandler> CreateEncryptionHandler(
+std::shared_ptr<EncryptionHandler> CreateEncryptionHandler(
     const PackagingParams& packaging_params,
     const StreamDescriptor& stream,
     KeySource* key_source,
@@ -559,6 +618,251 @@ std::shared_ptr<MediaHandler> CreateEncryptionHandler(
   return std::make_shared<EncryptionHandler>(encryption_params, key_source);
 }
 
+/// Returns true if the encrypted streams of |input| can be decrypted and
+/// re-encrypted in one pass by the encryption handlers instead of being
+/// decrypted by the demuxer. That requires every output of the input to be
+/// encrypted, and every stream of the input to have a single output, so that a
+/// sample is never decrypted more than once.
+bool CanReencryptInput(
+    const std::string& input,
+    const std::vector<std::reference_wrapper<const StreamDescriptor>>& streams,
+    const PackagingParams& packaging_params,
+    KeySource* encryption_key_source) {
+  // Other decryption key sources need the protection system specific data of
+  // the input, which the demuxer only passes when it decrypts.
+  if (packaging_params.decryption_params.key_provider != KeyProvider::kRawKey ||
+      !encryption_key_source) {
+    return false;
+  }
+  std::set<std::string> stream_selectors;
+  for (const StreamDescriptor& stream : streams) {
+    if (stream.input != input ||
+        (stream.output.empty() && stream.segment_template.empty())) {
+      continue;
+    }
+    if (IsTextStream(stream) || stream.skip_encryption ||
+        !stream_selectors.insert(stream.stream_selector).second) {
+      return false;
+    }
+  }
+  return !stream_selectors.empty();
+}
+
+/// Returns true if the encryption of the outputs is the same whether |input|
+/// is packaged as a whole or in time ranges.
+bool CanEncryptInRanges(const PackagingParams& packaging_params) {
+  const EncryptionParams& encryption_params =
+      packaging_params.encryption_params;
+  // Other key sources may not return the keys of earlier crypto periods.
+  if (encryption_params.key_provider != KeyProvider::kRawKey)
+    return false;
+  // Every crypto period gets a new encryptor.
+  if (encryption_params.crypto_period_duration_in_seconds > 0)
+    return true;
+  // Otherwise every range gets an encryptor of its own. The IV must be
+  // constant, as the init segment of the first range declares it, and must
+  // not be incremented per sample, as the IVs would be reused by the ranges.
+  if (encryption_params.protection_scheme !=
+          EncryptionParams::kProtectionSchemeCbcs &&
+      encryption_params.protection_scheme !=
+          EncryptionParams::kProtectionSchemeAes128) {
+    return false;
+  }
+  const RawKeyParams& raw_key = encryption_params.raw_key;
+  if (!raw_key.iv.empty())
+    return true;
+  for (const auto& entry : raw_key.key_map) {
+    if (entry.second.iv.empty())
+      return false;
+  }
+  return !raw_key.key_map.empty();
+}
+
+/// Returns true if |input| may be split into time ranges packaged in parallel.
+/// That requires every output of the input to be MP4 segments, which can be
+/// written independently, and no handler depending on earlier ranges, e.g. on
+/// cues or trick play frames.
+bool CanSplitInput(
+    const std::string& input,
+    const std::vector<std::reference_wrapper<const StreamDescriptor>>& streams,
+    const PackagingParams& packaging_params,
+    KeySource* encryption_key_source,
+    SyncPointQueue* sync_points) {
+  if (packaging_params.vod_parallel_ranges < 2 || sync_points ||
+      packaging_params.chunking_params.low_latency_dash_mode) {
+    return false;
+  }
+  if (packaging_params.decryption_params.key_provider != KeyProvider::kNone &&
+      packaging_params.decryption_params.key_provider != KeyProvider::kRawKey) {
+    return false;
+  }
+  bool has_output = false;
+  bool encrypted = false;
+  for (const StreamDescriptor& stream : streams) {
+    if (stream.input != input ||
+        (stream.output.empty() && stream.segment_template.empty())) {
+      continue;
+    }
+    if (IsTextStream(stream) || stream.trick_play_factor ||
+        stream.cc_index >= 0 || GetOutputFormat(stream) != CONTAINER_MOV ||
+        stream.segment_template.empty() ||
+        stream.output.find('$') != std::string::npos) {
+      return false;
+    }
+    has_output = true;
+    encrypted = encrypted || !stream.skip_encryption;
+  }
+  if (encrypted && encryption_key_source &&
+      !CanEncryptInRanges(packaging_params)) {
+    return false;
+  }
+  return has_output;
+}
+
+/// Creates the jobs packaging |input| in consecutive time ranges, which start
+/// at segment boundaries, in parallel. |split| is set to false if the input
+/// cannot be split, e.g. if it is too short, in which case no job is created.
+Status CreateSplitInputJobs(
+    const std::string& input,
+    const std::vector<std::reference_wrapper<const StreamDescriptor>>& streams,
+    const PackagingParams& packaging_params,
+    KeySource* encryption_key_source,
+    MuxerListenerFactory* muxer_listener_factory,
+    MuxerFactory* muxer_factory,
+    JobManager* job_manager,
+    bool* split) {
+  *split = false;
+
+  // The outputs of the input, and their stream selectors. The streams are
+  // sorted by stream selector.
+  std::vector<std::reference_wrapper<const StreamDescriptor>> outputs;
+  std::vector<std::string> stream_selectors;
+  for (const StreamDescriptor& stream : streams) {
+    if (stream.input != input ||
+        (stream.output.empty() && stream.segment_template.empty())) {
+      continue;
+    }
+    outputs.push_back(stream);
+    if (stream_selectors.empty() ||
+        stream_selectors.back() != stream.stream_selector) {
+      stream_selectors.push_back(stream.stream_selector);
+    }
+  }
+  DCHECK(!outputs.empty());
+
+  Demuxer index_demuxer(input);
+  index_demuxer.set_input_format(outputs.front().get().input_format);
+  std::vector<std::shared_ptr<StreamInfo>> stream_infos;
+  std::vector<std::vector<SampleTiming>> sample_timings;
+  Status status = index_demuxer.ReadSampleTimings(
+      stream_selectors, &stream_infos, &sample_timings);
+  if (!status.ok()) {
+    LOG(INFO) << "Packaging " << input << " as a whole: " << status;
+    return Status::OK;
+  }
+
+  const EncryptionParams& encryption_params =
+      packaging_params.encryption_params;
+  const bool encrypted = encryption_key_source != nullptr;
+  RangeSplitter splitter(
+      packaging_params.chunking_params,
+      encrypted ? encryption_params.clear_lead_in_seconds : 0,
+      encrypted ? encryption_params.crypto_period_duration_in_seconds : 0);
+  std::vector<std::vector<StreamRange>> ranges;
+  RETURN_IF_ERROR(splitter.Split(stream_infos, sample_timings,
+                                 packaging_params.vod_parallel_ranges,
+                                 &ranges));
+  if (ranges.size() < 2) {
+    LOG(INFO) << "Packaging " << input
+              << " as a whole, as it cannot be split at segment boundaries.";
+    return Status::OK;
+  }
+  LOG(INFO) << "Packaging " << input << " in " << ranges.size()
+            << " time ranges.";
+
+  std::vector<std::unique_ptr<MuxerListener>> muxer_listeners;
+  for (const StreamDescriptor& stream : outputs) {
+    muxer_listeners.push_back(
+        muxer_listener_factory->CreateListener(ToMuxerListenerData(stream)));
+  }
+  std::vector<std::vector<std::unique_ptr<MuxerListener>>>
+      range_muxer_listeners = RangeMuxerListener::CreateListeners(
+          std::move(muxer_listeners), ranges.size());
+
+  const bool leave_samples_encrypted = CanReencryptInput(
+      input, streams, packaging_params, encryption_key_source);
+  for (size_t r = 0; r < ranges.size(); ++r) {
+    // The later ranges start after the clear lead.
+    PackagingParams range_packaging_params = packaging_params;
+    if (r > 0) {
+      range_packaging_params.test_params.dump_stream_info = false;
+      range_packaging_params.encryption_params.clear_lead_in_seconds = 0;
+    }
+
+    std::shared_ptr<Demuxer> demuxer;
+    RETURN_IF_ERROR(
+        CreateDemuxer(outputs.front(), range_packaging_params, &demuxer));
+    demuxer->set_leave_samples_encrypted(leave_samples_encrypted);
+    auto segment_coordinator = std::make_shared<SegmentCoordinator>();
+
+    // Replicators are shared among all outputs with the same stream selector.
+    std::shared_ptr<MediaHandler> replicator;
+    for (size_t i = 0; i < outputs.size(); ++i) {
+      const StreamDescriptor& stream = outputs[i];
+      const size_t stream_index =
+          std::find(stream_selectors.begin(), stream_selectors.end(),
+                    stream.stream_selector) -
+          stream_selectors.begin();
+      const StreamRange& stream_range = ranges[r][stream_index];
+
+      const bool new_stream =
+          i == 0 ||
+          stream.stream_selector != outputs[i - 1].get().stream_selector;
+      if (new_stream) {
+        demuxer->SetSampleRange(stream.stream_selector,
+                                stream_range.start_dts, stream_range.end_dts);
+        if (!stream.language.empty())
+          demuxer->SetLanguageOverride(stream.stream_selector, stream.language);
+
+        ChunkingParams chunking_params = packaging_params.chunking_params;
+        chunking_params.start_segment_number =
+            stream_range.first_segment_number;
+        replicator = std::make_shared<Replicator>();
+        std::vector<std::shared_ptr<MediaHandler>> handlers = {
+            std::make_shared<ChunkingHandler>(chunking_params),
+            segment_coordinator, replicator};
+        RETURN_IF_ERROR(MediaHandler::Chain(handlers));
+        RETURN_IF_ERROR(
+            demuxer->SetHandler(stream.stream_selector, handlers[0]));
+      }
+
+      std::shared_ptr<Muxer> muxer = muxer_factory->CreateMuxer(
+          GetOutputFormat(stream), stream, stream_range.muxer_range);
+      if (!muxer) {
+        return Status(error::INVALID_ARGUMENT, "Failed to create muxer for " +
+                                                   stream.input + ":" +
+                                                   stream.stream_selector);
+      }
+      muxer->SetMuxerListener(std::move(range_muxer_listeners[r][i]));
+
+      Status enc_handler_status;
+      std::shared_ptr<EncryptionHandler> encryption_handler =
+          CreateEncryptionHandler(range_packaging_params, stream,
+                                  encryption_key_source, &enc_handler_status);
+      RETURN_IF_ERROR(enc_handler_status);
+      if (encryption_handler && demuxer->leave_samples_encrypted())
+        encryption_handler->SetDecryptionKeySource(demuxer->key_source());
+
+      RETURN_IF_ERROR(MediaHandler::Chain(
+          {replicator, std::move(encryption_handler), muxer}));
+    }
+    job_manager->Add("RemuxJob", demuxer);
+  }
+
+  *split = true;
+  return Status::OK;
+}
+
 std::unique_ptr<MediaHandler> CreateTextChunker(
     const ChunkingParams& chunking_params,
     bool use_segment_coordinator = false) {
@@ -651,14 +955,33 @@ Status CreateAudioVideoJobs(
   std::map<std::string, std::shared_ptr<SegmentCoordinator>>
       segment_coordinators;
 
+  // Inputs split into time ranges get their own jobs.
+  std::set<std::string> checked_inputs;
+  std::set<std::string> split_inputs;
+  for (const StreamDescriptor& stream : streams) {
+    if (!checked_inputs.insert(stream.input).second ||
+        !CanSplitInput(stream.input, streams, packaging_params,
+                       encryption_key_source, sync_points)) {
+      continue;
+    }
+    bool split = false;
+    RETURN_IF_ERROR(CreateSplitInputJobs(
+        stream.input, streams, packaging_params, encryption_key_source,
+        muxer_listener_factory, muxer_factory, job_manager, &split));
+    if (split)
+      split_inputs.insert(stream.input);
+  }
+
   for (const StreamDescriptor& stream : streams) {
     bool seen_input_before = sources.find(stream.input) != sources.end();
-    if (seen_input_before) {
+    if (seen_input_before || split_inputs.count(stream.input) > 0) {
       continue;
     }
 
     RETURN_IF_ERROR(
         CreateDemuxer(stream, packaging_params, &sources[stream.input]));
+    sources[stream.input]->set_leave_samples_encrypted(CanReencryptInput(
+        stream.input, streams, packaging_params, encryption_key_source));
     cue_aligners[stream.input] =
         sync_points ? std::make_shared<CueAlignmentHandler>(sync_points)
                     : nullptr;
@@ -680,6 +1003,9 @@ Status CreateAudioVideoJobs(
   std::map<std::string, size_t> stream_counters;
 
   for (const StreamDescriptor& stream : streams) {
+    if (split_inputs.count(stream.input) > 0)
+      continue;
+
     // Get the demuxer for this stream.
     auto& demuxer = sources[stream.input];
     auto& cue_aligner = cue_aligners[stream.input];
@@ -771,10 +1097,13 @@ Status CreateAudioVideoJobs(
     // See https://github.com/shaka-project/shaka-packager/issues/987.
     if (!is_text) {
       Status enc_handler_status;
-      handlers.emplace_back(CreateEncryptionHandler(packaging_params, stream,
-                                                    encryption_key_source,
-                                                    &enc_handler_status));
+      std::shared_ptr<EncryptionHandler> encryption_handler =
+          CreateEncryptionHandler(packaging_params, stream,
+                                  encryption_key_source, &enc_handler_status);
       RETURN_IF_ERROR(enc_handler_status);
+      if (encryption_handler && demuxer->leave_samples_encrypted())
+        encryption_handler->SetDecryptionKeySource(demuxer->key_source());
+      handlers.emplace_back(std::move(encryption_handler));
     }
 
     // Trick play is optional.
@@ -924,6 +1253,15 @@ Status Packager::Initialize(
         packaging_params.encryption_params);
     if (!internal->encryption_key_source)
       return Status(error::INVALID_ARGUMENT, "Failed to create key source.");
+    // Fetch the keys of upcoming crypto periods in the background, so that
+    // the media threads do not wait for the key server at crypto period
+    // boundaries.
+    if (packaging_params.encryption_params.crypto_period_duration_in_seconds >
+        0) {
+      internal->encryption_key_source.reset(new media::PrefetchingKeySource(
+          std::move(internal->encryption_key_source),
+          media::kNumPrefetchCryptoPeriods));
+    }
   }
 
   // Update MPD output and HLS output if needed.
@@ -939,7 +1277,10 @@ Status Packager::Initialize(
 
   // Store callback params to make it available during packaging.
   internal->buffer_callback_params = packaging_params.buffer_callback_params;
-  if (internal->buffer_callback_params.write_func) {
+  const bool has_write_callback =
+      internal->buffer_callback_params.write_func ||
+      internal->buffer_callback_params.write_output_func;
+  if (has_write_callback) {
     mpd_params.mpd_output = File::MakeCallbackFileName(
         internal->buffer_callback_params, mpd_params.mpd_output);
     hls_params.master_playlist_output = File::MakeCallbackFileName(
@@ -1010,7 +1351,7 @@ Status Packager::Initialize(
                                               descriptor.input);
     }
 
-    if (internal->buffer_callback_params.write_func) {
+    if (has_write_callback) {
       copy.output = File::MakeCallbackFileName(internal->buffer_callback_params,
                                                descriptor.output);
       copy.segment_template = File::MakeCallbackFileName(
@@ -1076,6 +1417,55 @@ void Packager::Cancel() {
   internal_->job_manager->CancelJobs();
 }
 
+std::vector<Status> Packager::RunBatch(const std::vector<PackagingJob>& jobs,
+                                       int32_t max_concurrency) {
+  std::vector<Status> statuses(jobs.size());
+  if (jobs.empty())
+    return statuses;
+
+  const Status status = media::ValidateBatchJobs(jobs);
+  if (!status.ok()) {
+    LOG(ERROR) << "Packaging jobs not started: " << status.ToString();
+    std::fill(statuses.begin(), statuses.end(), status);
+    return statuses;
+  }
+
+  size_t num_threads = max_concurrency > 0
+                           ? static_cast<size_t>(max_concurrency)
+                           : std::thread::hardware_concurrency();
+  num_threads = std::max<size_t>(1, std::min(num_threads, jobs.size()));
+
+  // Each thread runs the next job which is not started yet until there is none
+  // left, so a slow job does not hold up the other jobs.
+  std::atomic<size_t> next_job(0);
+  auto run_jobs = [&jobs, &statuses, &next_job]() {
+    for (size_t i = next_job++; i < jobs.size(); i = next_job++) {
+      const PackagingJob& job = jobs[i];
+      LOG(INFO) << "Starting packaging job '" << job.name << "'.";
+      Packager packager;
+      Status status =
+          packager.Initialize(job.packaging_params, job.stream_descriptors);
+      if (status.ok())
+        status = packager.Run();
+      if (status.ok()) {
+        LOG(INFO) << "Packaging job '" << job.name << "' completed.";
+      } else {
+        LOG(ERROR) << "Packaging job '" << job.name
+                   << "' failed: " << status.ToString();
+      }
+      statuses[i] = status;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < num_threads; ++i)
+    threads.emplace_back(run_jobs);
+  run_jobs();
+  for (std::thread& thread : threads)
+    thread.join();
+  return statuses;
+}
+
 std::string Packager::GetLibraryVersion() {
   return GetPackagerVersion();
 }
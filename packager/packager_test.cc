@@ -126,6 +126,170 @@ TEST_F(PackagerTest, Success) {
   ASSERT_EQ(Status::OK, packager.Run());
 }
 
+TEST_F(PackagerTest, ReservedHeaderSize) {
+  const size_t kReservedHeaderSize = 16384;
+  auto packaging_params = SetupPackagingParams();
+  packaging_params.mp4_output_params.reserved_header_size =
+      kReservedHeaderSize;
+
+  Packager packager;
+  ASSERT_EQ(Status::OK,
+            packager.Initialize(packaging_params, SetupStreamDescriptors()));
+  ASSERT_EQ(Status::OK, packager.Run());
+
+  std::string content;
+  ASSERT_TRUE(
+      File::ReadFileToString(GetFullPath(kOutputVideo).c_str(), &content));
+  // The header boxes are padded to the reserved size, with 'sidx' right
+  // before the first fragment.
+  std::vector<std::string> box_types;
+  size_t box_end = 0;
+  for (size_t pos = 0; pos + 8 <= content.size() && box_types.size() < 5;
+       pos = box_end) {
+    size_t box_size = 0;
+    for (size_t i = 0; i < 4; ++i)
+      box_size = box_size << 8 | static_cast<uint8_t>(content[pos + i]);
+    ASSERT_GE(box_size, 8u);
+    box_types.push_back(content.substr(pos + 4, 4));
+    if (box_types.back() == "sidx")
+      EXPECT_EQ(kReservedHeaderSize, pos + box_size);
+    box_end = pos + box_size;
+  }
+  EXPECT_THAT(box_types,
+              testing::ElementsAre("ftyp", "moov", "free", "sidx", "moof"));
+}
+
+TEST_F(PackagerTest, SegmentOutputQueue) {
+  const std::string synchronous_directory = test_directory_ + "synchronous/";
+  const std::string queued_directory = test_directory_ + "queued/";
+  for (const std::string& directory :
+       {synchronous_directory, queued_directory}) {
+    auto packaging_params = SetupPackagingParams();
+    packaging_params.mpd_params.mpd_output = directory + kOutputMpd;
+    // Use the same IV in both runs, so the encrypted segments match.
+    packaging_params.encryption_params.raw_key.iv.assign(std::begin(kKeyId),
+                                                         std::end(kKeyId));
+    if (directory == queued_directory)
+      packaging_params.segment_output_queue_depth = 2;
+
+    auto stream_descriptors = SetupStreamDescriptors();
+    stream_descriptors[0].output = directory + kOutputVideo;
+    stream_descriptors[0].segment_template = directory + kOutputVideoTemplate;
+    stream_descriptors[1].output = directory + kOutputAudio;
+    stream_descriptors[1].segment_template = directory + kOutputAudioTemplate;
+
+    Packager packager;
+    ASSERT_EQ(Status::OK,
+              packager.Initialize(packaging_params, stream_descriptors));
+    ASSERT_EQ(Status::OK, packager.Run());
+  }
+
+  // The segments written in the background are all there, with the same
+  // content, when Run() returns.
+  for (const std::string& segment_prefix : {"output_video_", "output_audio_"}) {
+    for (int segment_number = 1;; ++segment_number) {
+      const std::string segment_name =
+          segment_prefix + std::to_string(segment_number) + ".m4s";
+      std::string synchronous_segment;
+      std::string queued_segment;
+      const bool synchronous_exists = File::ReadFileToString(
+          (synchronous_directory + segment_name).c_str(), &synchronous_segment);
+      const bool queued_exists = File::ReadFileToString(
+          (queued_directory + segment_name).c_str(), &queued_segment);
+      ASSERT_EQ(synchronous_exists, queued_exists) << segment_name;
+      if (!synchronous_exists) {
+        EXPECT_GT(segment_number, 1);
+        break;
+      }
+      EXPECT_EQ(synchronous_segment, queued_segment) << segment_name;
+    }
+  }
+
+  // So is the manifest, which is updated as the segments are written.
+  std::string synchronous_mpd;
+  std::string queued_mpd;
+  ASSERT_TRUE(File::ReadFileToString(
+      (synchronous_directory + kOutputMpd).c_str(), &synchronous_mpd));
+  ASSERT_TRUE(File::ReadFileToString((queued_directory + kOutputMpd).c_str(),
+                                     &queued_mpd));
+  EXPECT_EQ(synchronous_mpd, queued_mpd);
+}
+
+TEST_F(PackagerTest, VodParallelRanges) {
+  // Clear lead with a constant IV, and key rotation with per-sample IVs.
+  for (const bool key_rotation : {false, true}) {
+    const std::string whole_directory =
+        test_directory_ + (key_rotation ? "rotation_whole/" : "whole/");
+    const std::string ranges_directory =
+        test_directory_ + (key_rotation ? "rotation_ranges/" : "ranges/");
+    for (const std::string& directory : {whole_directory, ranges_directory}) {
+      auto packaging_params = SetupPackagingParams();
+      packaging_params.mpd_params.mpd_output = directory + kOutputMpd;
+      packaging_params.encryption_params.raw_key.iv.assign(std::begin(kKeyId),
+                                                           std::end(kKeyId));
+      // Leave out the creation times of the init segments and the publish
+      // time of the manifest.
+      packaging_params.test_params.inject_fake_clock = true;
+      packaging_params.mpd_params.generate_static_live_mpd = true;
+      if (key_rotation) {
+        packaging_params.encryption_params.clear_lead_in_seconds = 0;
+        packaging_params.encryption_params.crypto_period_duration_in_seconds =
+            kSegmentDurationInSeconds;
+      } else {
+        packaging_params.encryption_params.protection_scheme =
+            EncryptionParams::kProtectionSchemeCbcs;
+      }
+      if (directory == ranges_directory)
+        packaging_params.vod_parallel_ranges = 3;
+
+      auto stream_descriptors = SetupStreamDescriptors();
+      stream_descriptors[0].output = directory + kOutputVideo;
+      stream_descriptors[0].segment_template =
+          directory + kOutputVideoTemplate;
+      stream_descriptors[1].output = directory + kOutputAudio;
+      stream_descriptors[1].segment_template =
+          directory + kOutputAudioTemplate;
+
+      Packager packager;
+      ASSERT_EQ(Status::OK,
+                packager.Initialize(packaging_params, stream_descriptors));
+      ASSERT_EQ(Status::OK, packager.Run());
+    }
+
+    // The ranges write the same init segments, segments and manifest as
+    // packaging the input as a whole.
+    for (const std::string& output_name :
+         {kOutputVideo, kOutputAudio, kOutputMpd}) {
+      std::string whole_output;
+      std::string ranges_output;
+      ASSERT_TRUE(File::ReadFileToString(
+          (whole_directory + output_name).c_str(), &whole_output));
+      ASSERT_TRUE(File::ReadFileToString(
+          (ranges_directory + output_name).c_str(), &ranges_output));
+      EXPECT_EQ(whole_output, ranges_output) << output_name;
+    }
+    for (const std::string& segment_prefix :
+         {"output_video_", "output_audio_"}) {
+      for (int segment_number = 1;; ++segment_number) {
+        const std::string segment_name =
+            segment_prefix + std::to_string(segment_number) + ".m4s";
+        std::string whole_segment;
+        std::string ranges_segment;
+        const bool whole_exists = File::ReadFileToString(
+            (whole_directory + segment_name).c_str(), &whole_segment);
+        const bool ranges_exists = File::ReadFileToString(
+            (ranges_directory + segment_name).c_str(), &ranges_segment);
+        ASSERT_EQ(whole_exists, ranges_exists) << segment_name;
+        if (!whole_exists) {
+          EXPECT_GT(segment_number, 2);
+          break;
+        }
+        EXPECT_EQ(whole_segment, ranges_segment) << segment_name;
+      }
+    }
+  }
+}
+
 TEST_F(PackagerTest, MissingStreamDescriptors) {
   std::vector<StreamDescriptor> stream_descriptors;
   Packager packager;
@@ -239,6 +403,200 @@ TEST_F(PackagerTest, WriteOutputToBuffer) {
   ASSERT_EQ(Status::OK, packager.Run());
 }
 
+TEST_F(PackagerTest, WriteSegmentsToOutputCallback) {
+  auto packaging_params = SetupPackagingParams();
+
+  std::vector<CallbackOutput> outputs;
+  packaging_params.buffer_callback_params.write_output_func =
+      [&outputs](const CallbackOutput& output) {
+        outputs.push_back(output);
+        return true;
+      };
+
+  std::vector<StreamDescriptor> stream_descriptors;
+  StreamDescriptor stream_descriptor;
+  stream_descriptor.input = kTestFile;
+  stream_descriptor.stream_selector = "video";
+  stream_descriptor.output = GetFullPath(kOutputVideo);
+  stream_descriptor.segment_template = GetFullPath(kOutputVideoTemplate);
+  stream_descriptors.push_back(stream_descriptor);
+
+  Packager packager;
+  ASSERT_EQ(Status::OK,
+            packager.Initialize(packaging_params, stream_descriptors));
+  ASSERT_EQ(Status::OK, packager.Run());
+
+  int num_init_segments = 0;
+  int num_media_segments = 0;
+  int num_manifests = 0;
+  int64_t next_start_time = 0;
+  for (const CallbackOutput& output : outputs) {
+    ASSERT_FALSE(output.buffers.empty());
+    switch (output.type) {
+      case CallbackOutput::Type::kInitSegment:
+        EXPECT_EQ(GetFullPath(kOutputVideo), output.name);
+        EXPECT_EQ(GetFullPath(kOutputVideo), output.stream);
+        ++num_init_segments;
+        break;
+      case CallbackOutput::Type::kMediaSegment:
+        EXPECT_EQ(GetFullPath(kOutputVideo), output.stream);
+        EXPECT_EQ(++num_media_segments, output.segment_number);
+        EXPECT_EQ(GetFullPath("output_video_" +
+                              std::to_string(output.segment_number) + ".m4s"),
+                  output.name);
+        if (num_media_segments > 1)
+          EXPECT_EQ(next_start_time, output.start_time);
+        EXPECT_GT(output.duration, 0);
+        EXPECT_GT(output.timescale, 0);
+        next_start_time = output.start_time + output.duration;
+        break;
+      case CallbackOutput::Type::kManifest:
+        EXPECT_EQ(GetFullPath(kOutputMpd), output.name);
+        ++num_manifests;
+        break;
+    }
+  }
+  // The init segment is written again with the duration when finalizing.
+  EXPECT_EQ(2, num_init_segments);
+  EXPECT_GT(num_media_segments, 1);
+  EXPECT_GT(num_manifests, 0);
+}
+
+TEST_F(PackagerTest, SingleFileOutputWithOnlyOutputCallback) {
+  auto packaging_params = SetupPackagingParams();
+  packaging_params.buffer_callback_params.write_output_func =
+      [](const CallbackOutput&) { return true; };
+
+  std::vector<StreamDescriptor> stream_descriptors;
+  StreamDescriptor stream_descriptor;
+  stream_descriptor.input = kTestFile;
+  stream_descriptor.stream_selector = "video";
+  stream_descriptor.output = GetFullPath(kOutputVideo);
+  stream_descriptors.push_back(stream_descriptor);
+
+  Packager packager;
+  auto status = packager.Initialize(packaging_params, stream_descriptors);
+  ASSERT_EQ(error::INVALID_ARGUMENT, status.error_code());
+  EXPECT_THAT(status.error_message(), HasSubstr("write_func"));
+}
+
+TEST_F(PackagerTest, SingleFileOutputWithBothWriteCallbacks) {
+  auto packaging_params = SetupPackagingParams();
+
+  MockFunction<int64_t(const std::string& name, const void* buffer,
+                       uint64_t length)>
+      mock_write_func;
+  packaging_params.buffer_callback_params.write_func =
+      mock_write_func.AsStdFunction();
+  EXPECT_CALL(mock_write_func, Call(StrEq(GetFullPath(kOutputVideo)), _, _))
+      .WillRepeatedly(ReturnArg<2>());
+  std::vector<CallbackOutput> outputs;
+  packaging_params.buffer_callback_params.write_output_func =
+      [&outputs](const CallbackOutput& output) {
+        outputs.push_back(output);
+        return true;
+      };
+
+  std::vector<StreamDescriptor> stream_descriptors;
+  StreamDescriptor stream_descriptor;
+  stream_descriptor.input = kTestFile;
+  stream_descriptor.stream_selector = "video";
+  stream_descriptor.output = GetFullPath(kOutputVideo);
+  stream_descriptors.push_back(stream_descriptor);
+
+  Packager packager;
+  ASSERT_EQ(Status::OK,
+            packager.Initialize(packaging_params, stream_descriptors));
+  ASSERT_EQ(Status::OK, packager.Run());
+  // Only the MPD is handed over through the output callback.
+  ASSERT_FALSE(outputs.empty());
+  for (const CallbackOutput& output : outputs)
+    EXPECT_EQ(CallbackOutput::Type::kManifest, output.type);
+}
+
+TEST_F(PackagerTest, RunBatch) {
+  std::vector<PackagingJob> jobs(3);
+  jobs[0].name = "first";
+  jobs[0].packaging_params = SetupPackagingParams();
+  jobs[0].stream_descriptors = SetupStreamDescriptors();
+
+  jobs[1].name = "missing input";
+  jobs[1].packaging_params = SetupPackagingParams();
+  jobs[1].packaging_params.mpd_params.mpd_output = GetFullPath("missing.mpd");
+  jobs[1].stream_descriptors = SetupStreamDescriptors();
+  for (StreamDescriptor& descriptor : jobs[1].stream_descriptors) {
+    descriptor.input = GetFullPath("missing.mp4");
+    descriptor.output = GetFullPath("missing_" + descriptor.stream_selector +
+                                    ".mp4");
+  }
+
+  jobs[2].name = "second";
+  jobs[2].packaging_params = SetupPackagingParams();
+  jobs[2].packaging_params.mpd_params.mpd_output = GetFullPath("second.mpd");
+  jobs[2].stream_descriptors = SetupStreamDescriptors();
+  for (StreamDescriptor& descriptor : jobs[2].stream_descriptors)
+    descriptor.output = GetFullPath("second_" + descriptor.stream_selector +
+                                    ".mp4");
+
+  const std::vector<Status> statuses = Packager::RunBatch(jobs, 2);
+  ASSERT_EQ(3u, statuses.size());
+  EXPECT_EQ(Status::OK, statuses[0]);
+  EXPECT_FALSE(statuses[1].ok());
+  EXPECT_EQ(Status::OK, statuses[2]);
+
+  std::string mpd;
+  EXPECT_TRUE(File::ReadFileToString(GetFullPath(kOutputMpd).c_str(), &mpd));
+  EXPECT_TRUE(
+      File::ReadFileToString(GetFullPath("second.mpd").c_str(), &mpd));
+}
+
+TEST_F(PackagerTest, RunBatchWithDuplicatedMpdOutputs) {
+  // Both jobs inherit the same MPD output.
+  std::vector<PackagingJob> jobs(2);
+  jobs[0].name = "first";
+  jobs[0].packaging_params = SetupPackagingParams();
+  jobs[0].stream_descriptors = SetupStreamDescriptors();
+
+  jobs[1].name = "second";
+  jobs[1].packaging_params = SetupPackagingParams();
+  jobs[1].stream_descriptors = SetupStreamDescriptors();
+  for (StreamDescriptor& descriptor : jobs[1].stream_descriptors)
+    descriptor.output = GetFullPath("second_" + descriptor.stream_selector +
+                                    ".mp4");
+
+  const std::vector<Status> statuses = Packager::RunBatch(jobs, 2);
+  ASSERT_EQ(2u, statuses.size());
+  for (const Status& status : statuses) {
+    EXPECT_EQ(error::INVALID_ARGUMENT, status.error_code());
+    EXPECT_THAT(status.error_message(), HasSubstr("duplicated output"));
+  }
+  // No job is started.
+  std::string mpd;
+  EXPECT_FALSE(File::ReadFileToString(GetFullPath(kOutputMpd).c_str(), &mpd));
+}
+
+TEST_F(PackagerTest, RunBatchWithDuplicatedSegmentTemplates) {
+  std::vector<PackagingJob> jobs(2);
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    const std::string prefix = "job" + std::to_string(i) + "_";
+    jobs[i].name = prefix;
+    jobs[i].packaging_params = SetupPackagingParams();
+    jobs[i].packaging_params.mpd_params.mpd_output =
+        GetFullPath(prefix + kOutputMpd);
+    StreamDescriptor stream_descriptor;
+    stream_descriptor.input = kTestFile;
+    stream_descriptor.stream_selector = "video";
+    stream_descriptor.output = GetFullPath(prefix + kOutputVideo);
+    stream_descriptor.segment_template = GetFullPath(kOutputVideoTemplate);
+    jobs[i].stream_descriptors.push_back(stream_descriptor);
+  }
+
+  const std::vector<Status> statuses = Packager::RunBatch(jobs, 1);
+  ASSERT_EQ(2u, statuses.size());
+  for (const Status& status : statuses)
+    EXPECT_EQ(error::INVALID_ARGUMENT, status.error_code());
+}
+
 TEST_F(PackagerTest, ReadFromBuffer) {
   auto packaging_params = SetupPackagingParams();
 